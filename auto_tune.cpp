@@ -0,0 +1,297 @@
+#include "auto_tune.h"
+#include "compress.h"
+#include "crypto.h"
+#include "logger.h"
+#include "thread_config.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <fstream>
+#include <jsoncpp/json/json.h>
+#include <omp.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <zip.h>
+
+using namespace std;
+using namespace std::chrono;
+
+// Tamaño de la muestra: suficiente para medir, pequeño para no retrasar la
+// copia (unos segundos como mucho incluso en discos lentos)
+static const size_t SAMPLE_BYTES = 16 * 1024 * 1024;
+static const size_t SAMPLE_FILES = 64;
+static const size_t CHUNK_BYTES = 1024 * 1024;
+
+// Por encima de esta relación el deflate casi no reduce nada y conviene
+// guardar los datos sin comprimir
+static const double INCOMPRESSIBLE_RATIO = 0.95;
+
+string tuningProfileKey(const vector<string> &sourceDirs, int maxSizeMB,
+                        bool encrypted) {
+  string dirs;
+  for (const auto &sourceDir : sourceDirs) {
+    error_code ec;
+    filesystem::path dir = filesystem::weakly_canonical(sourceDir, ec);
+    if (ec) {
+      dir = filesystem::absolute(sourceDir);
+    }
+    dirs += (dirs.empty() ? "" : ";") + dir.string();
+  }
+  return dirs + "|" + to_string(omp_get_max_threads()) + " hilos|" +
+         to_string(maxSizeMB) + "MB|" + (encrypted ? "cifrado" : "plano");
+}
+
+bool loadTuningProfile(const string &path, const string &key,
+                       TuningProfile &profile) {
+  ifstream in(path);
+  if (!in.is_open()) {
+    return false;
+  }
+  Json::Value root;
+  Json::Reader reader;
+  if (!reader.parse(in, root) || !root.isObject() || !root.isMember(key)) {
+    return false;
+  }
+
+  const Json::Value &entry = root[key];
+  profile.key = key;
+  profile.readMBps = entry["read_mb_s"].asDouble();
+  profile.deflateMBps = entry["deflate_mb_s_per_core"].asDouble();
+  profile.cryptoMBps = entry["crypto_mb_s_per_core"].asDouble();
+  profile.ratio = entry["ratio"].asDouble();
+  profile.compressThreads = entry["compress_threads"].asInt();
+  profile.compressionLevel = entry["compression_level"].asInt();
+  profile.bufferedParts = entry["buffered_parts"].asInt();
+  return profile.compressThreads > 0;
+}
+
+bool saveTuningProfile(const string &path, const TuningProfile &profile) {
+  // Conservar los perfiles de otros directorios o configuraciones
+  Json::Value root(Json::objectValue);
+  {
+    ifstream in(path);
+    Json::Reader reader;
+    if (in.is_open() && (!reader.parse(in, root) || !root.isObject())) {
+      root = Json::Value(Json::objectValue);
+    }
+  }
+
+  Json::Value entry;
+  entry["read_mb_s"] = profile.readMBps;
+  entry["deflate_mb_s_per_core"] = profile.deflateMBps;
+  entry["crypto_mb_s_per_core"] = profile.cryptoMBps;
+  entry["ratio"] = profile.ratio;
+  entry["compress_threads"] = profile.compressThreads;
+  entry["compression_level"] = profile.compressionLevel;
+  entry["buffered_parts"] = profile.bufferedParts;
+  entry["calibrated_at"] = static_cast<Json::Int64>(time(nullptr));
+  root[profile.key] = entry;
+
+  ofstream out(path);
+  if (!out) {
+    return false;
+  }
+  Json::StreamWriterBuilder writer;
+  out << Json::writeString(writer, root) << endl;
+  return static_cast<bool>(out);
+}
+
+// Leer hasta CHUNK_BYTES del inicio de archivos repartidos por todo el
+// directorio. Si los archivos ya están en la caché de páginas la lectura
+// sale optimista, lo que solo lleva a pedir algún hilo de más
+static vector<vector<char>> readSample(const vector<filesystem::path> &files,
+                                       double &seconds) {
+  vector<vector<char>> chunks;
+  size_t stride = max<size_t>(1, files.size() / SAMPLE_FILES);
+  size_t total = 0;
+  auto start = steady_clock::now();
+  for (size_t i = 0; i < files.size() && total < SAMPLE_BYTES; i += stride) {
+    FILE *file = fopen(files[i].string().c_str(), "rb");
+    if (!file) {
+      continue;
+    }
+    vector<char> chunk(min(CHUNK_BYTES, SAMPLE_BYTES - total));
+    chunk.resize(fread(chunk.data(), 1, chunk.size(), file));
+    fclose(file);
+    if (!chunk.empty()) {
+      total += chunk.size();
+      chunks.push_back(std::move(chunk));
+    }
+  }
+  seconds = duration<double>(steady_clock::now() - start).count();
+  return chunks;
+}
+
+// Comprimir la muestra en un ZIP en memoria con un nivel dado, en un solo
+// hilo, midiendo el tiempo y el tamaño resultante
+static bool deflateSample(const vector<vector<char>> &chunks, int level,
+                          double &seconds, uint64_t &compressedBytes) {
+  zip_error_t error;
+  zip_error_init(&error);
+  zip_source_t *memory = zip_source_buffer_create(nullptr, 0, 0, &error);
+  zip_t *archive = nullptr;
+  if (memory) {
+    zip_source_keep(memory);
+    archive = zip_open_from_source(memory, ZIP_TRUNCATE, &error);
+    if (!archive) {
+      zip_source_free(memory); // La referencia extra
+      zip_source_free(memory); // La de zip_source_buffer_create
+    }
+  }
+  zip_error_fini(&error);
+  if (!archive) {
+    return false;
+  }
+
+  auto start = steady_clock::now();
+  bool ok = true;
+  for (size_t i = 0; i < chunks.size() && ok; i++) {
+    zip_source_t *source =
+        zip_source_buffer(archive, chunks[i].data(), chunks[i].size(), 0);
+    string name = "muestra" + to_string(i);
+    zip_int64_t index =
+        source ? zip_file_add(archive, name.c_str(), source, 0) : -1;
+    if (index < 0) {
+      if (source) {
+        zip_source_free(source);
+      }
+      ok = false;
+    } else {
+      zip_set_file_compression(archive, index,
+                               level == 0 ? ZIP_CM_STORE : ZIP_CM_DEFLATE,
+                               level);
+    }
+  }
+  if (!ok) {
+    zip_discard(archive);
+    zip_source_free(memory);
+    return false;
+  }
+
+  // Aquí libzip comprime todas las entradas
+  ok = zip_close(archive) == 0;
+  if (!ok) {
+    zip_discard(archive);
+  }
+  seconds = duration<double>(steady_clock::now() - start).count();
+
+  zip_stat_t st;
+  if (ok && zip_source_stat(memory, &st) == 0 && (st.valid & ZIP_STAT_SIZE)) {
+    compressedBytes = st.size;
+  } else {
+    ok = false;
+  }
+  zip_source_free(memory);
+  return ok;
+}
+
+// MB/s a partir de bytes y segundos, acotado para tiempos casi nulos
+static double rateMBps(uint64_t bytes, double seconds) {
+  return bytes / (1024.0 * 1024.0) / max(seconds, 1e-6);
+}
+
+TuningProfile calibrate(const vector<filesystem::path> &files,
+                        size_t maxSizeBytes, const string &password) {
+  TuningProfile profile;
+  int cores = omp_get_max_threads();
+
+  double readSeconds = 0;
+  vector<vector<char>> chunks = readSample(files, readSeconds);
+  uint64_t sampleBytes = 0;
+  for (const auto &chunk : chunks) {
+    sampleBytes += chunk.size();
+  }
+  if (sampleBytes == 0) {
+    // Nada que medir: quedarse con los valores por defecto
+    profile.compressThreads = cores;
+    return profile;
+  }
+  profile.readMBps = rateMBps(sampleBytes, readSeconds);
+
+  // Deflate rápido (1) y predeterminado de zlib (6) sobre la misma muestra
+  double fastSeconds = 0, defaultSeconds = 0;
+  uint64_t fastBytes = sampleBytes, defaultBytes = sampleBytes;
+  bool measured = deflateSample(chunks, 1, fastSeconds, fastBytes) &&
+                  deflateSample(chunks, 6, defaultSeconds, defaultBytes);
+  double fastMBps = rateMBps(sampleBytes, fastSeconds);
+  double defaultMBps = rateMBps(sampleBytes, defaultSeconds);
+  double fastRatio = static_cast<double>(fastBytes) / sampleBytes;
+
+  // Nivel: sin comprimir si los datos no se reducen; el predeterminado si
+  // todos los núcleos juntos siguen el ritmo del disco; si no, el rápido
+  if (!measured) {
+    profile.compressionLevel = -1;
+    profile.deflateMBps = 0;
+  } else if (fastRatio > INCOMPRESSIBLE_RATIO) {
+    double storeSeconds = 0;
+    uint64_t storeBytes = sampleBytes;
+    deflateSample(chunks, 0, storeSeconds, storeBytes);
+    profile.compressionLevel = 0;
+    profile.deflateMBps = rateMBps(sampleBytes, storeSeconds);
+    profile.ratio = static_cast<double>(storeBytes) / sampleBytes;
+  } else if (defaultMBps * cores >= profile.readMBps) {
+    profile.compressionLevel = 6;
+    profile.deflateMBps = defaultMBps;
+    profile.ratio = static_cast<double>(defaultBytes) / sampleBytes;
+  } else {
+    profile.compressionLevel = 1;
+    profile.deflateMBps = fastMBps;
+    profile.ratio = fastRatio;
+  }
+
+  // Cifrado por núcleo, si se usa
+  if (!password.empty()) {
+    SimpleCrypto crypto;
+    auto start = steady_clock::now();
+    for (const auto &chunk : chunks) {
+      crypto.encrypt(reinterpret_cast<const unsigned char *>(chunk.data()),
+                     chunk.size(), password);
+    }
+    profile.cryptoMBps =
+        rateMBps(sampleBytes, duration<double>(steady_clock::now() - start)
+                                  .count());
+  }
+
+  // Hilos: los necesarios para que compresión y cifrado sigan a la lectura,
+  // sin pasar de los núcleos disponibles
+  double secondsPerMB = 0;
+  if (profile.deflateMBps > 0) {
+    secondsPerMB += 1.0 / profile.deflateMBps;
+  }
+  if (profile.cryptoMBps > 0) {
+    secondsPerMB += 1.0 / profile.cryptoMBps;
+  }
+  int needed = secondsPerMB > 0 ? static_cast<int>(ceil(profile.readMBps *
+                                                        secondsPerMB))
+                                : cores;
+  profile.compressThreads = clamp(needed, 1, cores);
+
+  // Partes en vuelo: hasta una cuarta parte de la memoria libre, sin pasar
+  // de una por hilo de compresión y de subida
+  long pages = sysconf(_SC_AVPHYS_PAGES);
+  long pageSize = sysconf(_SC_PAGESIZE);
+  int maxInFlight = profile.compressThreads + uploadThreadCount();
+  if (pages > 0 && pageSize > 0 && maxSizeBytes > 0) {
+    uint64_t budget = static_cast<uint64_t>(pages) * pageSize / 4;
+    uint64_t fit = budget / maxSizeBytes;
+    profile.bufferedParts = static_cast<int>(
+        clamp<uint64_t>(fit, 1, static_cast<uint64_t>(maxInFlight)));
+  } else {
+    profile.bufferedParts = maxInFlight;
+  }
+  return profile;
+}
+
+void applyTuningProfile(const TuningProfile &profile) {
+  ThreadConfig &config = threadConfig();
+  if (config.compressThreads == 0) {
+    config.compressThreads = profile.compressThreads;
+  }
+  if (config.bufferedParts == 0) {
+    config.bufferedParts = profile.bufferedParts;
+  }
+  if (compressionLevel() < 0) {
+    setCompressionLevel(profile.compressionLevel);
+  }
+}
@@ -0,0 +1,86 @@
+#ifndef AUTO_TUNE_H
+#define AUTO_TUNE_H
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Archivo donde se guardan los perfiles calibrados, junto al ejecutable
+// como s3_credentials.json
+#define TUNING_PROFILE_FILE "backup_profile.json"
+
+/**
+ * Resultado de la calibración: lo medido sobre una muestra del directorio y
+ * la configuración elegida a partir de ello.
+ */
+struct TuningProfile {
+  std::string key; // Directorios, núcleos, tamaño de parte y cifrado
+
+  // Mediciones (MB/s)
+  double readMBps = 0;    // Lectura de la muestra
+  double deflateMBps = 0; // Deflate por núcleo al nivel elegido
+  double cryptoMBps = 0;  // Cifrado por núcleo (0 si no se cifra)
+  double ratio = 1.0;     // Tamaño comprimido / original al nivel elegido
+
+  // Configuración elegida
+  int compressThreads = 1;
+  int compressionLevel = -1;
+  int bufferedParts = 0;
+};
+
+/**
+ * Clave con la que se guarda el perfil. Si cambia cualquiera de sus partes
+ * (directorios, núcleos disponibles, tamaño de parte o cifrado) la
+ * calibración guardada deja de valer.
+ *
+ * @param sourceDirs Directorios a comprimir
+ * @param maxSizeMB Tamaño máximo de cada parte en MB
+ * @param encrypted Si la copia se cifra
+ * @return Clave del perfil
+ */
+std::string tuningProfileKey(const std::vector<std::string> &sourceDirs,
+                             int maxSizeMB, bool encrypted);
+
+/**
+ * Busca un perfil guardado con la clave indicada.
+ *
+ * @param path Archivo de perfiles
+ * @param key Clave del perfil buscado
+ * @param profile Perfil leído si existe
+ * @return true si se encontró
+ */
+bool loadTuningProfile(const std::string &path, const std::string &key,
+                       TuningProfile &profile);
+
+/**
+ * Guarda o reemplaza un perfil, conservando los de otras claves.
+ *
+ * @param path Archivo de perfiles
+ * @param profile Perfil a guardar
+ * @return true si se pudo escribir
+ */
+bool saveTuningProfile(const std::string &path, const TuningProfile &profile);
+
+/**
+ * Mide lectura, deflate y cifrado sobre una muestra pequeña de los archivos
+ * (unos pocos MB repartidos por todo el directorio) y elige hilos de
+ * compresión, nivel de deflate y partes en vuelo.
+ *
+ * @param files Archivos a comprimir
+ * @param maxSizeBytes Tamaño máximo de cada parte en bytes
+ * @param password Contraseña de cifrado (vacía si no se cifra)
+ * @return Perfil calibrado, sin clave
+ */
+TuningProfile calibrate(const std::vector<std::filesystem::path> &files,
+                        size_t maxSizeBytes, const std::string &password);
+
+/**
+ * Aplica un perfil a threadConfig() y al nivel de compresión. Los valores
+ * fijados explícitamente (-j, -J) se respetan.
+ *
+ * @param profile Perfil a aplicar
+ */
+void applyTuningProfile(const TuningProfile &profile);
+
+#endif // AUTO_TUNE_H
@@ -0,0 +1,347 @@
+#include "batch_reader.h"
+#include "logger.h"
+#include "page_cache.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <functional>
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define HAVE_IO_URING 1
+#endif
+
+using namespace std;
+
+#ifdef HAVE_IO_URING
+
+// Archivos por ventana: se abren y se leen a la vez, una petición en vuelo
+// por archivo
+static const unsigned QUEUE_DEPTH = 64;
+
+// Bytes máximos por petición de lectura (el campo len es de 32 bits)
+static const size_t MAX_READ_CHUNK = 1u << 30;
+
+// Anillo de io_uring mínimo sobre las llamadas al sistema, sin liburing
+class Ring {
+public:
+  ~Ring() { release(); }
+
+  bool ready() const { return fd >= 0; }
+
+  bool init() {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    fd = static_cast<int>(syscall(__NR_io_uring_setup, QUEUE_DEPTH, &params));
+    if (fd < 0) {
+      return false;
+    }
+
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMmap) {
+      sqRingSize = cqRingSize = max(sqRingSize, cqRingSize);
+    }
+    sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED) {
+      release();
+      return false;
+    }
+    cqRing = singleMmap ? sqRing
+                        : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE,
+                               MAP_SHARED | MAP_POPULATE, fd,
+                               IORING_OFF_CQ_RING);
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqeMemory =
+        cqRing == MAP_FAILED
+            ? MAP_FAILED
+            : mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqeMemory == MAP_FAILED) {
+      release();
+      return false;
+    }
+    sqes = static_cast<io_uring_sqe *>(sqeMemory);
+
+    char *sq = static_cast<char *>(sqRing);
+    char *cq = static_cast<char *>(cqRing);
+    sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sqMask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    sqEntries = params.sq_entries;
+    cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cqMask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+    // OPENAT y READ existen desde Linux 5.6; con núcleos anteriores el
+    // anillo se crea pero no sirve
+    if (!supportsOps()) {
+      release();
+      return false;
+    }
+    return true;
+  }
+
+  // Siguiente petición libre, ya a cero (nullptr si la cola está llena)
+  io_uring_sqe *nextSqe() {
+    unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    unsigned tail = *sqTail + pending;
+    if (tail - head >= sqEntries) {
+      return nullptr;
+    }
+    unsigned index = tail & sqMask;
+    sqArray[index] = index;
+    pending++;
+    memset(&sqes[index], 0, sizeof(io_uring_sqe));
+    return &sqes[index];
+  }
+
+  // Envía lo preparado y espera a que haya al menos una respuesta
+  bool submitAndWait() {
+    unsigned toSubmit = pending;
+    __atomic_store_n(sqTail, *sqTail + pending, __ATOMIC_RELEASE);
+    pending = 0;
+    while (true) {
+      long ret = syscall(__NR_io_uring_enter, fd, toSubmit, 1,
+                         IORING_ENTER_GETEVENTS, nullptr, 0);
+      if (ret >= 0) {
+        return true;
+      }
+      if (errno != EINTR) {
+        return false;
+      }
+      // El núcleo ya pudo consumir parte de las peticiones
+      toSubmit = 0;
+    }
+  }
+
+  bool popCompletion(uint64_t &userData, int &result) {
+    unsigned head = *cqHead;
+    if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+      return false;
+    }
+    const io_uring_cqe &cqe = cqes[head & cqMask];
+    userData = cqe.user_data;
+    result = cqe.res;
+    __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+    return true;
+  }
+
+  void release() {
+    if (sqes) {
+      munmap(sqes, sqesSize);
+      sqes = nullptr;
+    }
+    if (cqRing != MAP_FAILED && !singleMmap) {
+      munmap(cqRing, cqRingSize);
+    }
+    if (sqRing != MAP_FAILED) {
+      munmap(sqRing, sqRingSize);
+    }
+    sqRing = cqRing = MAP_FAILED;
+    if (fd >= 0) {
+      close(fd);
+      fd = -1;
+    }
+    pending = 0;
+  }
+
+private:
+  bool supportsOps() {
+    const unsigned opCount = 256;
+    vector<char> memory(sizeof(io_uring_probe) +
+                        opCount * sizeof(io_uring_probe_op));
+    auto *probe = reinterpret_cast<io_uring_probe *>(memory.data());
+    if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe,
+                opCount) < 0) {
+      return false;
+    }
+    for (unsigned op : {IORING_OP_OPENAT, IORING_OP_READ}) {
+      if (op > probe->last_op ||
+          !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  int fd = -1;
+  bool singleMmap = false;
+  void *sqRing = MAP_FAILED;
+  void *cqRing = MAP_FAILED;
+  size_t sqRingSize = 0;
+  size_t cqRingSize = 0;
+  io_uring_sqe *sqes = nullptr;
+  size_t sqesSize = 0;
+  unsigned *sqHead = nullptr;
+  unsigned *sqTail = nullptr;
+  unsigned *sqArray = nullptr;
+  unsigned sqMask = 0;
+  unsigned sqEntries = 0;
+  unsigned *cqHead = nullptr;
+  unsigned *cqTail = nullptr;
+  unsigned cqMask = 0;
+  io_uring_cqe *cqes = nullptr;
+  unsigned pending = 0; // Peticiones preparadas que aún no se han enviado
+};
+
+// Espera las respuestas de las peticiones en vuelo. El manejador puede
+// preparar peticiones nuevas (y sumarlas a inFlight) para seguir leyendo
+static bool drain(Ring &ring, unsigned &inFlight,
+                  const function<void(size_t, int)> &onComplete) {
+  while (inFlight > 0) {
+    if (!ring.submitAndWait()) {
+      return false;
+    }
+    uint64_t userData;
+    int result;
+    while (ring.popCompletion(userData, result)) {
+      inFlight--;
+      onComplete(static_cast<size_t>(userData), result);
+    }
+  }
+  return true;
+}
+
+// Abre y lee una ventana de hasta QUEUE_DEPTH rangos
+static bool readWindow(Ring &ring, RangeRead *reads, size_t count) {
+  vector<int> fds(count, -1);
+  vector<size_t> done(count, 0);
+  vector<bool> busy(count, false);
+  unsigned inFlight = 0;
+
+  auto queueRead = [&](size_t i) {
+    io_uring_sqe *sqe = ring.nextSqe();
+    if (!sqe) {
+      return false;
+    }
+    size_t chunk = min(reads[i].length - done[i], MAX_READ_CHUNK);
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fds[i];
+    sqe->addr = reinterpret_cast<uint64_t>(reads[i].buffer + done[i]);
+    sqe->len = static_cast<uint32_t>(chunk);
+    sqe->off = reads[i].offset + done[i];
+    sqe->user_data = i;
+    busy[i] = true;
+    inFlight++;
+    return true;
+  };
+
+  // Todas las aperturas de la ventana en un solo envío
+  bool ringOk = true;
+  for (size_t i = 0; i < count && ringOk; i++) {
+    io_uring_sqe *sqe = ring.nextSqe();
+    if (!sqe) {
+      ringOk = false;
+      break;
+    }
+    sqe->opcode = IORING_OP_OPENAT;
+    sqe->fd = AT_FDCWD;
+    sqe->addr = reinterpret_cast<uint64_t>(reads[i].path.c_str());
+    sqe->open_flags = O_RDONLY | O_CLOEXEC;
+    sqe->user_data = i;
+    busy[i] = true;
+    inFlight++;
+  }
+  ringOk = ringOk && drain(ring, inFlight, [&](size_t i, int result) {
+             busy[i] = false;
+             fds[i] = result;
+           });
+
+  // Después todas las lecturas; las lecturas cortas se continúan
+  for (size_t i = 0; i < count && ringOk; i++) {
+    if (fds[i] < 0) {
+      continue;
+    }
+    reads[i].buffer = new char[reads[i].length];
+    if (reads[i].length > 0 && !queueRead(i)) {
+      ringOk = false;
+    }
+  }
+  ringOk = ringOk && drain(ring, inFlight, [&](size_t i, int result) {
+             busy[i] = false;
+             if (result <= 0) {
+               // Error o fin de archivo antes de tiempo
+               delete[] reads[i].buffer;
+               reads[i].buffer = nullptr;
+               return;
+             }
+             done[i] += static_cast<size_t>(result);
+             if (done[i] < reads[i].length && !queueRead(i)) {
+               delete[] reads[i].buffer;
+               reads[i].buffer = nullptr;
+             }
+           });
+
+  for (size_t i = 0; i < count; i++) {
+    if (fds[i] >= 0) {
+      // Lo leído ya no hace falta en la caché de páginas
+      if (!busy[i]) {
+        dropReadCache(fds[i], reads[i].offset, done[i]);
+      }
+      close(fds[i]);
+    }
+    if (reads[i].buffer && done[i] < reads[i].length) {
+      // Si el anillo falló con la lectura en vuelo el núcleo aún puede
+      // escribir en el buffer: se abandona en lugar de liberarlo
+      if (!busy[i]) {
+        delete[] reads[i].buffer;
+      }
+      reads[i].buffer = nullptr;
+    }
+  }
+  return ringOk;
+}
+
+static bool probeIoUring() {
+  Ring ring;
+  bool available = ring.init();
+  if (!available) {
+    LOG_DEBUG("io_uring no disponible: se usa la lectura archivo a archivo");
+  }
+  return available;
+}
+
+bool batchReadAvailable() {
+  static const bool available = probeIoUring();
+  return available;
+}
+
+bool readRangesBatched(vector<RangeRead> &reads) {
+  if (!batchReadAvailable()) {
+    return false;
+  }
+  // Un anillo por hilo: las tareas de las partes leen sin compartirlo
+  static thread_local Ring ring;
+  if (!ring.ready() && !ring.init()) {
+    return false;
+  }
+
+  for (size_t start = 0; start < reads.size(); start += QUEUE_DEPTH) {
+    size_t count = min<size_t>(QUEUE_DEPTH, reads.size() - start);
+    if (!readWindow(ring, reads.data() + start, count)) {
+      // Anillo inservible: las ventanas restantes quedan sin buffer y se
+      // leerán de la forma normal
+      LOG_DEBUG("Error en io_uring; se vuelve a la lectura normal");
+      ring.release();
+      break;
+    }
+  }
+  return true;
+}
+
+#else
+
+bool batchReadAvailable() { return false; }
+
+bool readRangesBatched(vector<RangeRead> &) { return false; }
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef BATCH_READER_H
+#define BATCH_READER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Lectura de un rango de un archivo dentro de un lote. El lector reserva
+ * buffer con new[]; quien llama pasa a ser su dueño.
+ */
+struct RangeRead {
+  std::string path;       // Archivo de origen
+  uint64_t offset = 0;    // Primer byte a leer
+  size_t length = 0;      // Bytes a leer
+  char *buffer = nullptr; // Datos leídos (nullptr si la lectura falló)
+};
+
+/**
+ * Indica si el lector por lotes se puede usar en este sistema (io_uring
+ * disponible y con las operaciones necesarias). Se comprueba una sola vez.
+ *
+ * @return true si readRangesBatched puede atender lecturas
+ */
+bool batchReadAvailable();
+
+/**
+ * Lee todos los rangos con io_uring: las aperturas de una ventana de
+ * archivos se envían juntas y después sus lecturas, de modo que el disco
+ * recibe muchas peticiones a la vez en lugar de una tras otra. Cada hilo
+ * usa su propio anillo.
+ *
+ * @param reads Rangos a leer; al volver, cada uno tiene su buffer o
+ * nullptr si no se pudo leer completo (se puede reintentar con la lectura
+ * normal, que informa del error)
+ * @return false si io_uring no está disponible (no se ha leído nada y hay
+ * que usar la lectura normal)
+ */
+bool readRangesBatched(std::vector<RangeRead> &reads);
+
+#endif // BATCH_READER_H
@@ -0,0 +1,553 @@
+#include "compress.h"
+#include "decompress.h"
+#include "instrumentation.h"
+#include "logger.h"
+#include "thread_config.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <jsoncpp/json/json.h>
+#include <map>
+#include <omp.h>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+#ifndef BACKUP_VERSION
+#define BACKUP_VERSION "desconocida"
+#endif
+
+// Semilla fija: los mismos parámetros generan siempre los mismos bytes
+static const uint64_t DATASET_SEED = 20240611;
+
+// Tipo de contenido de un archivo generado, de menos a más comprimible
+enum class Content { RANDOM, TEXT, ZEROS };
+
+// Configuración de la suite, ajustable desde la línea de comandos
+struct BenchConfig {
+  string workDir = "./bench_work";
+  string outputJson = "bench_results.json";
+  string baselineJson = "";
+  double scale = 1.0;
+  int repeats = 3;
+  vector<int> threadCounts;
+  vector<int> partSizesMB = {8, 32};
+  vector<bool> encryption = {false, true};
+  vector<string> datasets = {"pequenos", "grandes", "mixto", "profundo",
+                             "entradas"};
+  double regressionThreshold = 0.10; // 10 % más lento se marca como regresión
+};
+
+// ----------- Generación de datos -----------
+
+static const vector<string> WORDS = {
+    "respaldo", "archivo",  "parte",    "fragmento", "servidor", "copia",
+    "datos",    "registro", "usuario",  "factura",   "cliente",  "pedido",
+    "2024",     "total",    "estado",   "pendiente", "enviado",  "error",
+    "{",        "}",        "\"id\":",  "\"valor\":", "\n",      "\t"};
+
+static void fillContent(vector<char> &buffer, Content content,
+                        mt19937_64 &rng) {
+  switch (content) {
+  case Content::RANDOM: {
+    for (size_t i = 0; i < buffer.size(); i += 8) {
+      uint64_t value = rng();
+      memcpy(buffer.data() + i, &value, min<size_t>(8, buffer.size() - i));
+    }
+    break;
+  }
+  case Content::TEXT: {
+    size_t pos = 0;
+    while (pos < buffer.size()) {
+      const string &word = WORDS[rng() % WORDS.size()];
+      size_t len = min(word.size(), buffer.size() - pos);
+      memcpy(buffer.data() + pos, word.data(), len);
+      pos += len;
+      if (pos < buffer.size()) {
+        buffer[pos++] = ' ';
+      }
+    }
+    break;
+  }
+  case Content::ZEROS:
+    // Casi todo ceros con alguna marca, como un archivo de base de datos
+    // recién reservado
+    fill(buffer.begin(), buffer.end(), 0);
+    for (size_t i = 0; i < buffer.size(); i += 4096) {
+      buffer[i] = static_cast<char>(rng());
+    }
+    break;
+  }
+}
+
+static void writeGeneratedFile(const filesystem::path &path, size_t size,
+                               Content content, mt19937_64 &rng) {
+  filesystem::create_directories(path.parent_path());
+  ofstream out(path, ios::binary | ios::trunc);
+  // Escribir por bloques para no depender del tamaño total
+  const size_t blockSize = 1 << 20;
+  vector<char> buffer;
+  size_t remaining = size;
+  while (remaining > 0) {
+    buffer.resize(min(blockSize, remaining));
+    fillContent(buffer, content, rng);
+    out.write(buffer.data(), buffer.size());
+    remaining -= buffer.size();
+  }
+}
+
+// FNV-1a: a diferencia de std::hash, da el mismo valor en cualquier versión
+static uint64_t stableHash(const string &text) {
+  uint64_t hash = 1469598103934665603ULL;
+  for (unsigned char c : text) {
+    hash = (hash ^ c) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+// Genera un conjunto de datos conocido. Devuelve false si el nombre no existe
+static bool generateDataset(const string &name, const filesystem::path &dir,
+                            double scale) {
+  mt19937_64 rng(DATASET_SEED ^ stableHash(name));
+  auto scaled = [scale](double value) {
+    return max<size_t>(1, static_cast<size_t>(value * scale));
+  };
+
+  if (name == "pequenos") {
+    // Muchos archivos diminutos repartidos en carpetas
+    size_t count = scaled(2000);
+    for (size_t i = 0; i < count; i++) {
+      size_t size = 512 + rng() % (8 * 1024);
+      Content content = i % 4 == 0 ? Content::RANDOM : Content::TEXT;
+      writeGeneratedFile(dir / ("dir" + to_string(i % 20)) /
+                             ("f" + to_string(i) + ".txt"),
+                         size, content, rng);
+    }
+  } else if (name == "grandes") {
+    // Pocos archivos mayores que cualquier tamaño de parte: se fragmentan
+    size_t size = scaled(48) * 1024 * 1024;
+    writeGeneratedFile(dir / "aleatorio.bin", size, Content::RANDOM, rng);
+    writeGeneratedFile(dir / "registro.log", size, Content::TEXT, rng);
+  } else if (name == "mixto") {
+    // Tamaños variados y compresibilidad alterna
+    size_t count = scaled(150);
+    for (size_t i = 0; i < count; i++) {
+      size_t size = 4 * 1024 + rng() % (2 * 1024 * 1024);
+      Content content = static_cast<Content>(i % 3);
+      writeGeneratedFile(dir / ("m" + to_string(i % 7)) /
+                             ("d" + to_string(i) + ".dat"),
+                         size, content, rng);
+    }
+  } else if (name == "profundo") {
+    // Árbol profundo con pocos archivos por nivel
+    size_t depth = 16;
+    size_t branches = scaled(6);
+    for (size_t b = 0; b < branches; b++) {
+      filesystem::path current = dir / ("rama" + to_string(b));
+      for (size_t level = 0; level < depth; level++) {
+        current /= "nivel" + to_string(level);
+        for (int f = 0; f < 3; f++) {
+          writeGeneratedFile(current / ("h" + to_string(f) + ".txt"),
+                             1024 + rng() % (32 * 1024), Content::TEXT, rng);
+        }
+      }
+    }
+  } else if (name == "entradas") {
+    // Más entradas de las que caben en un ZIP clásico en pocos MB: con
+    // partes de 32 MB van todas a la misma, que necesita el fin de
+    // directorio ZIP64. El primer fragmento del archivo aleatorio llena
+    // otra parte y, al pasar de 16 MB, se lee en streaming, cifrado por
+    // trozos en los casos con contraseña. Nada se escala: los límites son
+    // fijos
+    for (size_t i = 0; i < 70000; i++) {
+      writeGeneratedFile(dir / ("lote" + to_string(i / 1000)) /
+                             ("e" + to_string(i) + ".txt"),
+                         8 + rng() % 24, Content::TEXT, rng);
+    }
+    writeGeneratedFile(dir / "flujo.bin", 40 * 1024 * 1024, Content::RANDOM,
+                       rng);
+  } else if (name == "zip64") {
+    // Fuera de la lista por defecto: más entradas de las que caben en un
+    // ZIP clásico y un archivo de más de 4 GB. Con -s 8192 todo va a una
+    // sola parte ZIP64. El número de archivos no se escala: tiene que
+    // pasar de 65 535
+    for (size_t i = 0; i < 70000; i++) {
+      writeGeneratedFile(dir / ("lote" + to_string(i / 1000)) /
+                             ("e" + to_string(i) + ".txt"),
+                         16 + rng() % 240, Content::TEXT, rng);
+    }
+    writeGeneratedFile(dir / "volumen.img", scaled(4608) * 1024 * 1024,
+                       Content::ZEROS, rng);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Regenera el conjunto solo si falta o se creó con otra escala
+static bool ensureDataset(const string &name, const filesystem::path &root,
+                          double scale, filesystem::path &datasetDir) {
+  datasetDir = root / "datos" / name;
+  filesystem::path marker = root / "datos" / (name + ".ok");
+  ostringstream expected;
+  expected << DATASET_SEED << " " << scale;
+
+  ifstream markerIn(marker);
+  string existing;
+  getline(markerIn, existing);
+  if (existing == expected.str() && filesystem::exists(datasetDir)) {
+    return true;
+  }
+
+  cout << "Generando conjunto de datos '" << name << "'..." << endl;
+  filesystem::remove_all(datasetDir);
+  if (!generateDataset(name, datasetDir, scale)) {
+    cerr << "Conjunto de datos desconocido: " << name << endl;
+    return false;
+  }
+  ofstream(marker) << expected.str() << "\n";
+  return true;
+}
+
+// ----------- Medición -----------
+
+static void treeStats(const filesystem::path &dir, size_t &files,
+                      uint64_t &bytes) {
+  files = 0;
+  bytes = 0;
+  for (const auto &entry : filesystem::recursive_directory_iterator(dir)) {
+    if (entry.is_regular_file()) {
+      files++;
+      bytes += entry.file_size();
+    }
+  }
+}
+
+// Comprueba que la extracción reproduce exactamente el conjunto original
+static bool sameTree(const filesystem::path &original,
+                     const filesystem::path &extracted) {
+  for (const auto &entry :
+       filesystem::recursive_directory_iterator(original)) {
+    if (!entry.is_regular_file()) {
+      continue;
+    }
+    filesystem::path copy =
+        extracted / filesystem::relative(entry.path(), original);
+    if (!filesystem::exists(copy) ||
+        filesystem::file_size(copy) != entry.file_size()) {
+      return false;
+    }
+    ifstream a(entry.path(), ios::binary), b(copy, ios::binary);
+    vector<char> bufA(1 << 20), bufB(1 << 20);
+    while (a && b) {
+      a.read(bufA.data(), bufA.size());
+      b.read(bufB.data(), bufB.size());
+      if (a.gcount() != b.gcount() ||
+          memcmp(bufA.data(), bufB.data(), a.gcount()) != 0) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static Json::Value timingSummary(vector<double> times) {
+  sort(times.begin(), times.end());
+  Json::Value summary;
+  summary["min_s"] = times.front();
+  summary["median_s"] = times[times.size() / 2];
+  summary["max_s"] = times.back();
+  return summary;
+}
+
+static string caseKey(const Json::Value &result) {
+  return result["dataset"].asString() + "/t" +
+         to_string(result["threads"].asInt()) + "/s" +
+         to_string(result["part_mb"].asInt()) +
+         (result["encrypted"].asBool() ? "/e" : "");
+}
+
+// Ejecuta un caso de la matriz: compresión y descompresión repetidas
+static Json::Value runCase(const string &dataset,
+                           const filesystem::path &datasetDir, int threads,
+                           int partSizeMB, bool encrypted,
+                           const BenchConfig &config) {
+  filesystem::path outDir = filesystem::path(config.workDir) / "salida";
+  filesystem::path extractDir = filesystem::path(config.workDir) / "extraido";
+  string password = encrypted ? "clave-de-benchmark" : "";
+
+  size_t inputFiles = 0;
+  uint64_t inputBytes = 0;
+  treeStats(datasetDir, inputFiles, inputBytes);
+
+  vector<double> compressTimes, decompressTimes;
+  size_t parts = 0;
+  uint64_t outputBytes = 0;
+  bool ok = true;
+  bool verified = true;
+  Json::Value stages;
+
+  for (int r = 0; r < config.repeats; r++) {
+    filesystem::remove_all(outDir);
+    filesystem::remove_all(extractDir);
+    filesystem::create_directories(extractDir);
+    // Todas las etapas con el mismo número de hilos del caso
+    threadConfig().compressThreads = threads;
+    threadConfig().ioThreads = threads;
+
+    // Desglose por etapa de la primera repetición
+    if (r == 0) {
+      resetInstrumentation();
+    }
+    auto start = steady_clock::now();
+    ok = compressFolderToSplitZip(datasetDir.string(),
+                                  (outDir / "bench.zip").string(), partSizeMB,
+                                  password, threads > 1) &&
+         ok;
+    compressTimes.push_back(
+        duration<double>(steady_clock::now() - start).count());
+
+    start = steady_clock::now();
+    ok = decompressPartsWithPassword(outDir.string(), extractDir.string(),
+                                     password) &&
+         ok;
+    decompressTimes.push_back(
+        duration<double>(steady_clock::now() - start).count());
+
+    // Verificar solo la primera repetición: el resultado es determinista
+    if (r == 0) {
+      stages = instrumentationReport(compressTimes[0] + decompressTimes[0]);
+      verified = sameTree(datasetDir, extractDir);
+      treeStats(outDir, parts, outputBytes);
+    }
+  }
+
+  Json::Value result;
+  result["dataset"] = dataset;
+  result["threads"] = threads;
+  result["part_mb"] = partSizeMB;
+  result["encrypted"] = encrypted;
+  result["input_files"] = static_cast<Json::UInt64>(inputFiles);
+  result["input_bytes"] = static_cast<Json::UInt64>(inputBytes);
+  result["output_bytes"] = static_cast<Json::UInt64>(outputBytes);
+  result["parts"] = static_cast<Json::UInt64>(parts);
+  result["ratio"] =
+      inputBytes > 0 ? static_cast<double>(outputBytes) / inputBytes : 0.0;
+  result["compress"] = timingSummary(compressTimes);
+  result["decompress"] = timingSummary(decompressTimes);
+  double mb = inputBytes / (1024.0 * 1024.0);
+  result["compress_mb_s"] = mb / result["compress"]["median_s"].asDouble();
+  result["decompress_mb_s"] = mb / result["decompress"]["median_s"].asDouble();
+  result["success"] = ok;
+  result["verified"] = verified;
+  result["stages"] = stages["stages"];
+  return result;
+}
+
+// Compara con una ejecución anterior; devuelve el número de regresiones
+static int compareWithBaseline(const Json::Value &report,
+                               const BenchConfig &config) {
+  ifstream in(config.baselineJson);
+  Json::Value baseline;
+  Json::CharReaderBuilder reader;
+  string errors;
+  if (!in || !Json::parseFromStream(reader, in, &baseline, &errors)) {
+    cerr << "No se pudo leer la referencia " << config.baselineJson << ": "
+         << errors << endl;
+    return 0;
+  }
+
+  map<string, Json::Value> previous;
+  for (const auto &result : baseline["results"]) {
+    previous[caseKey(result)] = result;
+  }
+
+  cout << "\nComparación con " << config.baselineJson << " (versión "
+       << baseline["version"].asString() << "):" << endl;
+  int regressions = 0;
+  for (const auto &result : report["results"]) {
+    auto it = previous.find(caseKey(result));
+    if (it == previous.end()) {
+      continue;
+    }
+    double before = it->second["compress"]["median_s"].asDouble();
+    double now = result["compress"]["median_s"].asDouble();
+    double change = before > 0 ? (now - before) / before : 0.0;
+    bool regression = change > config.regressionThreshold;
+    regressions += regression ? 1 : 0;
+    cout << "  " << (regression ? "⚠️ " : "   ") << left << setw(28)
+         << caseKey(result) << right << fixed << setprecision(3) << before
+         << "s -> " << now << "s (" << showpos << setprecision(1)
+         << change * 100 << "%" << noshowpos << ")" << endl;
+  }
+  return regressions;
+}
+
+// ----------- Línea de comandos -----------
+
+static vector<int> parseIntList(const string &text) {
+  vector<int> values;
+  stringstream ss(text);
+  string item;
+  while (getline(ss, item, ',')) {
+    values.push_back(stoi(item));
+  }
+  return values;
+}
+
+static vector<string> parseStringList(const string &text) {
+  vector<string> values;
+  stringstream ss(text);
+  string item;
+  while (getline(ss, item, ',')) {
+    values.push_back(item);
+  }
+  return values;
+}
+
+static void showHelp() {
+  cout << "Uso: benchmark [opciones]" << endl;
+  cout << "  -w : Directorio de trabajo para datos y salidas (default: "
+          "./bench_work)"
+       << endl;
+  cout << "  -o : Archivo JSON de resultados (default: bench_results.json)"
+       << endl;
+  cout << "  -c : JSON de una ejecución anterior para detectar regresiones"
+       << endl;
+  cout << "  -S : Factor de escala de los conjuntos de datos (default: 1)"
+       << endl;
+  cout << "  -r : Repeticiones por caso (default: 3)" << endl;
+  cout << "  -t : Lista de hilos, p. ej. 1,4,8 (default: 1 y el máximo)"
+       << endl;
+  cout << "  -s : Lista de tamaños de parte en MB (default: 8,32)" << endl;
+  cout << "  -d : Conjuntos de datos (default: pequenos,grandes,mixto,"
+          "profundo,entradas; además zip64, para usar con -s 8192)"
+       << endl;
+  cout << "  -e : Cifrado: 0, 1 o 0,1 (default: 0,1)" << endl;
+  cout << "  -h : Mostrar esta ayuda" << endl;
+}
+
+int main(int argc, char *argv[]) {
+  BenchConfig config;
+  int maxThreads = omp_get_max_threads();
+  config.threadCounts = {1};
+  if (maxThreads > 2) {
+    config.threadCounts.push_back(maxThreads / 2);
+  }
+  if (maxThreads > 1) {
+    config.threadCounts.push_back(maxThreads);
+  }
+
+  try {
+    for (int i = 1; i < argc; i++) {
+      string arg = argv[i];
+      bool hasValue = i + 1 < argc;
+      if (arg == "-w" && hasValue) {
+        config.workDir = argv[++i];
+      } else if (arg == "-o" && hasValue) {
+        config.outputJson = argv[++i];
+      } else if (arg == "-c" && hasValue) {
+        config.baselineJson = argv[++i];
+      } else if (arg == "-S" && hasValue) {
+        config.scale = stod(argv[++i]);
+      } else if (arg == "-r" && hasValue) {
+        config.repeats = max(1, stoi(argv[++i]));
+      } else if (arg == "-t" && hasValue) {
+        config.threadCounts = parseIntList(argv[++i]);
+      } else if (arg == "-s" && hasValue) {
+        config.partSizesMB = parseIntList(argv[++i]);
+      } else if (arg == "-d" && hasValue) {
+        config.datasets = parseStringList(argv[++i]);
+      } else if (arg == "-e" && hasValue) {
+        config.encryption.clear();
+        for (int value : parseIntList(argv[++i])) {
+          config.encryption.push_back(value != 0);
+        }
+      } else if (arg == "-h" || arg == "--help") {
+        showHelp();
+        return 0;
+      } else {
+        cerr << "Opción no reconocida: " << arg << endl;
+        showHelp();
+        return 1;
+      }
+    }
+  } catch (const exception &e) {
+    cerr << "Error al interpretar los argumentos: " << e.what() << endl;
+    return 1;
+  }
+
+  filesystem::create_directories(config.workDir);
+  enableInstrumentation();
+  // Solo errores: la salida de la compresión no debe contar en los tiempos
+  setLogLevel(LogLevel::QUIET);
+
+  Json::Value report;
+  report["version"] = BACKUP_VERSION;
+  char host[256] = "";
+  gethostname(host, sizeof(host) - 1);
+  report["host"] = host;
+  report["timestamp"] = static_cast<Json::Int64>(time(nullptr));
+  report["max_threads"] = maxThreads;
+  report["scale"] = config.scale;
+  report["repeats"] = config.repeats;
+  report["seed"] = static_cast<Json::UInt64>(DATASET_SEED);
+  report["results"] = Json::arrayValue;
+
+  bool allOk = true;
+  for (const auto &dataset : config.datasets) {
+    filesystem::path datasetDir;
+    if (!ensureDataset(dataset, config.workDir, config.scale, datasetDir)) {
+      return 1;
+    }
+    for (int threads : config.threadCounts) {
+      for (int partSize : config.partSizesMB) {
+        for (bool encrypted : config.encryption) {
+          Json::Value result = runCase(dataset, datasetDir, threads, partSize,
+                                       encrypted, config);
+          allOk = allOk && result["success"].asBool() &&
+                  result["verified"].asBool();
+          cout << left << setw(10) << dataset << right << " hilos=" << setw(2)
+               << threads << " parte=" << setw(3) << partSize << "MB"
+               << (encrypted ? " cifrado" : "        ") << fixed
+               << setprecision(3)
+               << "  compresión " << result["compress"]["median_s"].asDouble()
+               << "s (" << setprecision(1)
+               << result["compress_mb_s"].asDouble() << " MB/s)"
+               << setprecision(3) << "  descompresión "
+               << result["decompress"]["median_s"].asDouble() << "s"
+               << (result["verified"].asBool() ? "" : "  ❌ NO VERIFICADO")
+               << endl;
+          report["results"].append(result);
+        }
+      }
+    }
+  }
+
+  ofstream out(config.outputJson);
+  Json::StreamWriterBuilder writer;
+  writer["indentation"] = "  ";
+  out << Json::writeString(writer, report) << endl;
+  cout << "\nResultados guardados en " << config.outputJson << endl;
+
+  int regressions = 0;
+  if (!config.baselineJson.empty()) {
+    regressions = compareWithBaseline(report, config);
+  }
+
+  // Código de salida útil para integración continua
+  if (!allOk) {
+    return 1;
+  }
+  return regressions > 0 ? 2 : 0;
+}
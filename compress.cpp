@@ -1,22 +1,63 @@
+#include "batch_reader.h"
+#include "compress.h"
 #include "crypto.h"
+#include "instrumentation.h"
+#include "logger.h"
+#include "low_impact.h"
+#include "page_cache.h"
+#include "thread_config.h"
 #include <algorithm>
 #include <atomic>
+#include <cerrno>
 #include <cstring>
+#include <fcntl.h>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <omp.h>
 #include <set>
 #include <stdio.h>
 #include <string>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <vector>
 #include <zip.h>
+#include <zlib.h>
 
 using namespace std;
 
 static SimpleCrypto crypto;
+static atomic<int> deflateLevel{-1};
+
+void setCompressionLevel(int level) { deflateLevel = level; }
+
+int compressionLevel() { return deflateLevel; }
+
+static atomic<bool> solidMode{false};
+
+void setSolidBlocks(bool enabled) { solidMode = enabled; }
+
+bool solidBlocks() { return solidMode; }
+
+// Aplicar el nivel configurado a una entrada recién añadida
+static bool applyCompressionLevel(zip_t *archive, zip_int64_t index,
+                                  const string &zipPath) {
+  int level = deflateLevel;
+  if (level < 0) {
+    return true;
+  }
+  zip_int32_t method = level == 0 ? ZIP_CM_STORE : ZIP_CM_DEFLATE;
+  if (zip_set_file_compression(archive, index, method, level) < 0) {
+    LOG_ERROR("Error al fijar el nivel de compresión de "
+              << zipPath << ": " << zip_strerror(archive));
+    return false;
+  }
+  return true;
+}
 
 // Función para verificar si un archivo debe ser ignorado según los patrones
 bool shouldIgnoreFile(const string &relativePath,
@@ -61,7 +102,10 @@ bool shouldIgnoreFile(const string &relativePath,
 
 // Función para recolectar todos los archivos no ignorados en un directorio
 vector<filesystem::path> collectFiles(const string &folderPath,
-                                      const set<string> &ignorePatterns) {
+                                      const set<string> &ignorePatterns,
+                                      int numThreads) {
+  ScopedStage timer(Stage::WALK);
+  int threads = numThreads > 0 ? numThreads : ioThreadCount();
   vector<filesystem::path> allFiles;
 
   // Recorrer el filesystem (aún secuencial) y guardar todos los archivos
@@ -75,10 +119,7 @@ vector<filesystem::path> collectFiles(const string &folderPath,
   }
 
   // Filtrar en paralelo los archivos a ignorar
-  vector<filesystem::path> tempFiles;
-  std::mutex mtx;
-
-#pragma omp parallel
+#pragma omp parallel num_threads(threads)
   {
     vector<filesystem::path> localFiles;
 
@@ -111,9 +152,85 @@ vector<filesystem::path> collectFiles(const string &folderPath,
     allFiles.insert(allFiles.end(), localFiles.begin(), localFiles.end());
   }
 
+  // Los hilos fusionan sus listas en cualquier orden: ordenar por ruta para
+  // que el plan de partes, y con él sus nombres, sea siempre el mismo
+  sort(allFiles.begin(), allFiles.end());
+
   return allFiles;
 }
 
+// Nombre de la carpeta usado como prefijo dentro del ZIP
+static string rootName(const string &folderPath) {
+  error_code ec;
+  filesystem::path canonical = filesystem::weakly_canonical(folderPath, ec);
+  string name = (ec ? filesystem::path(folderPath).lexically_normal()
+                    : canonical)
+                    .filename()
+                    .string();
+  return name.empty() || name == "." ? "raiz" : name;
+}
+
+// Recorrer todas las carpetas de origen a la vez, una por hilo
+bool collectSources(const vector<string> &folderPaths, SourceFiles &files,
+                    int numThreads) {
+  int threads = numThreads > 0 ? numThreads : ioThreadCount();
+  for (const auto &folder : folderPaths) {
+    if (!filesystem::is_directory(folder)) {
+      LOG_ERROR("La carpeta de origen no existe: " << folder);
+      return false;
+    }
+  }
+
+  // Prefijo de cada carpeta (ninguno si solo hay una)
+  vector<string> prefixes(folderPaths.size());
+  if (folderPaths.size() > 1) {
+    set<string> taken;
+    for (size_t i = 0; i < folderPaths.size(); i++) {
+      string name = rootName(folderPaths[i]);
+      string prefix = name;
+      for (int n = 2; taken.count(prefix); n++) {
+        prefix = name + "_" + to_string(n);
+      }
+      taken.insert(prefix);
+      prefixes[i] = prefix;
+    }
+  }
+
+  // Con varias carpetas el paralelismo es entre carpetas; con una sola, el
+  // grupo de E/S filtra sus archivos
+  vector<vector<filesystem::path>> perRoot(folderPaths.size());
+  int rootThreads = max(1, min(threads, static_cast<int>(folderPaths.size())));
+  int filterThreads = folderPaths.size() > 1 ? 1 : threads;
+#pragma omp parallel for schedule(dynamic) num_threads(rootThreads)
+  for (long i = 0; i < static_cast<long>(folderPaths.size()); i++) {
+    perRoot[i] = collectFiles(folderPaths[i],
+                              readIgnorePatterns(folderPaths[i]),
+                              filterThreads);
+  }
+
+  // Unir todo en una sola lista ordenada por nombre dentro del ZIP
+  vector<pair<string, filesystem::path>> merged;
+  for (size_t i = 0; i < folderPaths.size(); i++) {
+    for (auto &path : perRoot[i]) {
+      filesystem::path relative = filesystem::relative(path, folderPaths[i]);
+      string zipPath =
+          prefixes[i].empty()
+              ? relative.string()
+              : (filesystem::path(prefixes[i]) / relative).string();
+      merged.emplace_back(std::move(zipPath), std::move(path));
+    }
+  }
+  sort(merged.begin(), merged.end());
+
+  files.paths.clear();
+  files.zipPaths.clear();
+  for (auto &[zipPath, path] : merged) {
+    files.zipPaths.push_back(std::move(zipPath));
+    files.paths.push_back(std::move(path));
+  }
+  return true;
+}
+
 // función para leer patrones a ignorar desde un archivo .ignore
 set<string> readIgnorePatterns(const string &folderPath) {
   set<string> patterns;
@@ -123,7 +240,7 @@ set<string> readIgnorePatterns(const string &folderPath) {
 
   // Verificar si existe el archivo .ignore
   if (filesystem::exists(ignorePath)) {
-    cout << "Leyendo patrones de ignorar desde " << ignorePath << endl;
+    LOG_INFO("Leyendo patrones de ignorar desde " << ignorePath);
 
     // Leer el archivo línea por línea
     ifstream ignoreFile(ignorePath);
@@ -141,11 +258,9 @@ set<string> readIgnorePatterns(const string &folderPath) {
       patterns.insert(line);
     }
 
-    cout << "Se cargaron " << patterns.size() << " patrones para ignorar."
-         << endl;
+    LOG_INFO("Se cargaron " << patterns.size() << " patrones para ignorar.");
   } else {
-    cout << "No se encontró archivo .ignore, no se ignorará ningún archivo."
-         << endl;
+    LOG_INFO("No se encontró archivo .ignore, no se ignorará ningún archivo.");
   }
 
   return patterns;
@@ -154,9 +269,8 @@ set<string> readIgnorePatterns(const string &folderPath) {
 // Función mejorada para añadir un buffer de memoria a un ZIP con opción de
 // copiar
 bool addBufferToZip(zip_t *archive, const char *buffer, size_t bufferSize,
-                    const string &zipPath, bool makeCopy = false,
-                    bool freeBuffer = true, bool *overallSuccess = nullptr,
-                    bool *opSuccess = nullptr) {
+                    const string &zipPath, bool makeCopy, bool freeBuffer,
+                    bool *overallSuccess, bool *opSuccess) {
 
   // Opcionalmente crear una copia del buffer
   char *finalBuffer = (char *)buffer;
@@ -169,8 +283,8 @@ bool addBufferToZip(zip_t *archive, const char *buffer, size_t bufferSize,
   zip_source_t *source =
       zip_source_buffer(archive, finalBuffer, bufferSize, freeBuffer ? 1 : 0);
   if (source == nullptr) {
-    cerr << "Error al crear fuente ZIP para " << zipPath << ": "
-         << zip_strerror(archive) << endl;
+    LOG_ERROR("Error al crear fuente ZIP para " << zipPath << ": "
+                                                << zip_strerror(archive));
     if (makeCopy && freeBuffer) {
       delete[] finalBuffer;
     }
@@ -182,11 +296,14 @@ bool addBufferToZip(zip_t *archive, const char *buffer, size_t bufferSize,
   }
 
   // Agregar el buffer al ZIP
-  zip_int64_t index =
-      zip_file_add(archive, zipPath.c_str(), source, ZIP_FL_ENC_UTF_8);
+  zip_int64_t index;
+  {
+    ScopedStage timer(Stage::ZIP_ADD);
+    index = zip_file_add(archive, zipPath.c_str(), source, ZIP_FL_ENC_UTF_8);
+  }
   if (index < 0) {
-    cerr << "Error al añadir " << zipPath
-         << " al ZIP: " << zip_strerror(archive) << endl;
+    LOG_ERROR("Error al añadir " << zipPath
+                                 << " al ZIP: " << zip_strerror(archive));
     zip_source_free(source);
     if (overallSuccess)
       *overallSuccess = false;
@@ -195,7 +312,7 @@ bool addBufferToZip(zip_t *archive, const char *buffer, size_t bufferSize,
     return false;
   }
 
-  return true;
+  return applyCompressionLevel(archive, index, zipPath);
 }
 
 // Función para añadir un archivo de texto en memoria al ZIP (usado en el .info)
@@ -213,7 +330,7 @@ bool addFileToZip(zip_t *archive, const string &filePath,
   // Leer todo el archivo en memoria primero
   ifstream file(filePath, ios::binary);
   if (!file) {
-    cerr << "No se pudo abrir el archivo: " << filePath << endl;
+    LOG_ERROR("No se pudo abrir el archivo: " << filePath);
     return false;
   }
 
@@ -224,8 +341,13 @@ bool addFileToZip(zip_t *archive, const string &filePath,
 
   // Crear un buffer para el contenido del archivo
   auto fileContent = new char[size];
-  if (!file.read(fileContent, size)) {
-    cerr << "Error al leer el archivo: " << filePath << endl;
+  bool readOk;
+  {
+    ScopedStage timer(Stage::READ, size);
+    readOk = static_cast<bool>(file.read(fileContent, size));
+  }
+  if (!readOk) {
+    LOG_ERROR("Error al leer el archivo: " << filePath);
     delete[] fileContent;
     return false;
   }
@@ -235,16 +357,16 @@ bool addFileToZip(zip_t *archive, const string &filePath,
 
 bool addEncryptedBufferToZip(zip_t *archive, const char *buffer,
                              size_t bufferSize, const string &zipPath,
-                             const string &password = "", bool makeCopy = false,
-                             bool freeBuffer = true,
-                             bool *overallSuccess = nullptr,
-                             bool *opSuccess = nullptr) {
+                             const string &password, bool makeCopy,
+                             bool freeBuffer, bool *overallSuccess,
+                             bool *opSuccess) {
 
   char *finalBuffer = nullptr;
   size_t finalSize = bufferSize;
 
   if (!password.empty()) {
     // Encriptar el buffer
+    ScopedStage timer(Stage::ENCRYPT, bufferSize);
     auto encrypted = crypto.encrypt(
         reinterpret_cast<const unsigned char *>(buffer), bufferSize, password);
     finalSize = encrypted.size();
@@ -265,8 +387,8 @@ bool addEncryptedBufferToZip(zip_t *archive, const char *buffer,
       archive, finalBuffer, finalSize,
       (!password.empty() || (makeCopy && freeBuffer)) ? 1 : 0);
   if (source == nullptr) {
-    cerr << "Error al crear fuente ZIP para " << zipPath << ": "
-         << zip_strerror(archive) << endl;
+    LOG_ERROR("Error al crear fuente ZIP para " << zipPath << ": "
+                                                << zip_strerror(archive));
     if (!password.empty() || (makeCopy && freeBuffer)) {
       delete[] finalBuffer;
     }
@@ -278,11 +400,14 @@ bool addEncryptedBufferToZip(zip_t *archive, const char *buffer,
   }
 
   // Agregar al ZIP
-  zip_int64_t index =
-      zip_file_add(archive, zipPath.c_str(), source, ZIP_FL_ENC_UTF_8);
+  zip_int64_t index;
+  {
+    ScopedStage timer(Stage::ZIP_ADD);
+    index = zip_file_add(archive, zipPath.c_str(), source, ZIP_FL_ENC_UTF_8);
+  }
   if (index < 0) {
-    cerr << "Error al añadir " << zipPath
-         << " al ZIP: " << zip_strerror(archive) << endl;
+    LOG_ERROR("Error al añadir " << zipPath
+                                 << " al ZIP: " << zip_strerror(archive));
     zip_source_free(source);
     if (overallSuccess)
       *overallSuccess = false;
@@ -291,16 +416,16 @@ bool addEncryptedBufferToZip(zip_t *archive, const char *buffer,
     return false;
   }
 
-  return true;
+  return applyCompressionLevel(archive, index, zipPath);
 }
 
 // Función modificada para añadir archivo encriptado al ZIP
 bool addEncryptedFileToZip(zip_t *archive, const string &filePath,
-                           const string &zipPath, const string &password = "") {
+                           const string &zipPath, const string &password) {
   // Leer archivo
   ifstream file(filePath, ios::binary);
   if (!file) {
-    cerr << "No se pudo abrir el archivo: " << filePath << endl;
+    LOG_ERROR("No se pudo abrir el archivo: " << filePath);
     return false;
   }
 
@@ -309,8 +434,13 @@ bool addEncryptedFileToZip(zip_t *archive, const string &filePath,
   file.seekg(0, ios::beg);
 
   auto fileContent = new char[size];
-  if (!file.read(fileContent, size)) {
-    cerr << "Error al leer el archivo: " << filePath << endl;
+  bool readOk;
+  {
+    ScopedStage timer(Stage::READ, size);
+    readOk = static_cast<bool>(file.read(fileContent, size));
+  }
+  if (!readOk) {
+    LOG_ERROR("Error al leer el archivo: " << filePath);
     delete[] fileContent;
     return false;
   }
@@ -320,363 +450,1223 @@ bool addEncryptedFileToZip(zip_t *archive, const string &filePath,
   return result;
 }
 
-// Función para calcular el número de partes necesarias según el tamaño de los
-// archivos
-int calculateTotalParts(const vector<filesystem::path> &allFiles,
-                        size_t maxSizeBytes, int maxSizeMB) {
-  size_t estimatedSize = 0;
-  int estimatedParts = 0;
-  bool afterBigFile =
-      false; // Para rastrear si estamos después de un archivo grande
-
-  for (const auto &filePath : allFiles) {
-    uintmax_t fileSize = filesystem::file_size(filePath);
-
-    if (fileSize > maxSizeBytes) {
-      // Archivo grande
-      int fragmentsNeeded =
-          static_cast<int>((fileSize + maxSizeBytes - 1) / maxSizeBytes);
-      estimatedParts += fragmentsNeeded;
-      afterBigFile = true; // Marcar que venimos de un archivo grande
-      estimatedSize = 0;   // Resetear acumulador
+// Tamaño de un archivo, contabilizado en la etapa de consultas de tamaño
+static uintmax_t timedFileSize(const filesystem::path &path) {
+  ScopedStage timer(Stage::STAT);
+  return filesystem::file_size(path);
+}
+
+// Reserva por parte para el directorio central, los registros de fin
+// (también los de ZIP64) y la entrada del propio .info (cabeceras y
+// primeras líneas)
+static const uintmax_t PART_OVERHEAD = 4096;
+
+// Bytes del inicio de cada archivo que se comprimen para estimar su tamaño
+static const size_t ESTIMATE_SAMPLE_BYTES = 64 * 1024;
+
+// Entradas de al menos este tamaño no se leen antes de cerrar la parte:
+// libzip las lee por trozos mientras comprime
+static const uintmax_t STREAM_ENTRY_BYTES = 16 * 1024 * 1024;
+
+// Máximo de datos de una parte que se leen a memoria antes de cerrarla
+static const uintmax_t PART_BUFFER_BYTES = 256 * 1024 * 1024;
+
+// A partir de aquí los tamaños y posiciones no caben en los campos de 32
+// bits del ZIP y libzip escribe los campos extra de ZIP64
+static const uintmax_t ZIP32_LIMIT = 0xffffffffu;
+
+// Partes con más entradas que esto necesitan el fin de directorio ZIP64
+static const size_t ZIP32_MAX_ENTRIES = 0xffff;
+
+// En modo sólido, los archivos de hasta este tamaño se empaquetan en bloques
+static const uintmax_t SOLID_FILE_BYTES = 64 * 1024;
+
+// Datos de cada bloque sólido antes de comprimir: pequeño para que extraer
+// un solo archivo no obligue a descomprimir mucho más
+static const uintmax_t SOLID_BLOCK_BYTES = 4 * 1024 * 1024;
+
+// Cabeceras local y central de una entrada más su descriptor de datos. En
+// partes de más de 4 GB se reserva además el campo extra de ZIP64 de ambas
+// cabeceras (tamaños y posición de 64 bits)
+static uintmax_t entryOverhead(const string &zipPath, bool zip64) {
+  return 30 + 46 + 16 + 2 * zipPath.size() + (zip64 ? 20 + 32 + 8 : 0);
+}
+
+// Línea de una entrada en el .info
+static uintmax_t infoLineSize(const PlannedEntry &entry) {
+  uintmax_t size = entry.zipPath.size() + 3 + entry.source.string().size() + 1;
+  if (entry.sparseSize > 0) {
+    // "sparse: <posición> <tamaño> <ruta>", con la posición acotada por el
+    // tamaño
+    size += 8 + 2 * to_string(entry.sparseSize).size() + 2 +
+            entry.zipPath.size() + 1;
+  }
+  return size;
+}
+
+// Nombre dentro del ZIP del bloque sólido número block de una parte
+static string solidBlockName(int part, size_t block) {
+  return "part_" + to_string(part) + ".solid" + to_string(block);
+}
+
+// Entradas que en modo sólido van dentro de un bloque: archivos pequeños
+// completos
+static bool solidCandidate(const PlannedEntry &entry) {
+  return solidBlocks() && !entry.fragment && entry.sparseSize == 0 &&
+         entry.length <= SOLID_FILE_BYTES;
+}
+
+// Lo que añade al ZIP un archivo dentro de un bloque sólido: su línea
+// "solid: <bloque> <posición> <longitud> <ruta>" en el .info y su parte
+// proporcional de las cabeceras del bloque
+static uintmax_t solidMemberOverhead(const PlannedEntry &entry, bool zip64) {
+  string block = solidBlockName(99999, 99999);
+  uintmax_t line = 7 + block.size() + 1 +
+                   2 * to_string(SOLID_BLOCK_BYTES).size() + 2 +
+                   entry.zipPath.size() + 1;
+  return line + entryOverhead(block, zip64) * (entry.length + 1) /
+                    SOLID_BLOCK_BYTES +
+         1;
+}
+
+// Peor caso de deflate (datos incompresibles en bloques guardados)
+static uintmax_t deflateWorstCase(uintmax_t length) {
+  return length + (length >> 12) + (length >> 14) + (length >> 25) + 13;
+}
+
+// Mayor longitud cuyo peor caso de deflate cabe en available bytes
+static uintmax_t largestPayload(uintmax_t available) {
+  return available - min(available, (available >> 12) + (available >> 14) +
+                                        (available >> 25) + 13);
+}
+
+// Estimación de lo que ocupará comprimido el rango [offset, offset +
+// length) de un archivo: se aplica deflate rápido (nivel 1, que comprime
+// menos que el predeterminado y por tanto no se queda corto) a sus primeros
+// bytes, ya cifrados si hay contraseña, y la relación obtenida se extiende
+// al resto del rango
+static uintmax_t estimateCompressedSize(const filesystem::path &path,
+                                        uintmax_t offset, uintmax_t length,
+                                        const string &password) {
+  if (length == 0 || compressionLevel() == 0) {
+    return length;
+  }
+  size_t sampleSize =
+      static_cast<size_t>(min<uintmax_t>(length, ESTIMATE_SAMPLE_BYTES));
+  vector<unsigned char> sample(sampleSize);
+  FILE *file = fopen(path.string().c_str(), "rb");
+  if (!file) {
+    return deflateWorstCase(length);
+  }
+  if (fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0) {
+    sample.resize(fread(sample.data(), 1, sampleSize, file));
+  } else {
+    sample.clear();
+  }
+  fclose(file);
+  if (sample.empty()) {
+    return deflateWorstCase(length);
+  }
+  if (!password.empty()) {
+    // Cada entrada se cifra desde su primer byte, igual que aquí
+    sample = crypto.encrypt(sample.data(), sample.size(), password);
+  }
+
+  uLongf compressedSize = compressBound(sample.size());
+  vector<unsigned char> compressed(compressedSize);
+  if (compress2(compressed.data(), &compressedSize, sample.data(),
+                sample.size(), 1) != Z_OK) {
+    return deflateWorstCase(length);
+  }
+  if (sample.size() == length) {
+    return compressedSize;
+  }
+  double ratio = static_cast<double>(compressedSize) / sample.size();
+  return min(deflateWorstCase(length),
+             static_cast<uintmax_t>(ratio * length) + 1);
+}
+
+// Orden de las entradas dentro de una parte y de las partes entre sí: por
+// archivo de origen y posición
+static bool entryBefore(const PlannedEntry &a, const PlannedEntry &b) {
+  return a.source != b.source ? a.source < b.source : a.offset < b.offset;
+}
+
+// Empaquetar entradas en el menor número de partes posible: de mayor a
+// menor estimación, cada una va a la parte con menos hueco en la que cabe
+// (best fit decreasing) o a una nueva si no cabe en ninguna
+static vector<PartPlan> packBins(vector<PlannedEntry> &&items,
+                                 uintmax_t budget) {
+  stable_sort(items.begin(), items.end(),
+              [](const PlannedEntry &a, const PlannedEntry &b) {
+                return a.estimated != b.estimated ? a.estimated > b.estimated
+                                                  : entryBefore(a, b);
+              });
+
+  vector<PartPlan> bins;
+  multimap<uintmax_t, size_t> freeSpace; // Hueco libre -> parte
+  for (auto &item : items) {
+    auto fit = freeSpace.lower_bound(item.estimated);
+    size_t bin;
+    if (fit == freeSpace.end()) {
+      bin = bins.size();
+      bins.emplace_back();
     } else {
-      // Archivo normal
-      if (afterBigFile || estimatedSize + fileSize > maxSizeBytes) {
-        // Si venimos de un archivo grande o excedemos el tamaño,
-        // necesitamos una nueva parte
-        estimatedParts++;
-        estimatedSize = fileSize;
-        afterBigFile = false; // Ya no venimos de un archivo grande
-      } else {
-        estimatedSize += fileSize;
-      }
+      bin = fit->second;
+      freeSpace.erase(fit);
+    }
+    PartPlan &part = bins[bin];
+    part.bytes += item.length;
+    part.estimated += item.estimated;
+    part.entries.push_back(std::move(item));
+    if (part.estimated < budget) {
+      freeSpace.emplace(budget - part.estimated, bin);
     }
   }
+  return bins;
+}
 
-  // No olvidar la última parte si hay archivos pendientes
-  if (estimatedSize > 0) {
-    estimatedParts++;
+// Numerar las partes desde firstNumber en el orden de su primera entrada,
+// así los nombres no dependen del orden de empaquetado
+static void numberParts(vector<PartPlan> &parts, int firstNumber) {
+  for (auto &part : parts) {
+    sort(part.entries.begin(), part.entries.end(), entryBefore);
+  }
+  sort(parts.begin(), parts.end(), [](const PartPlan &a, const PartPlan &b) {
+    return entryBefore(a.entries.front(), b.entries.front());
+  });
+  for (size_t i = 0; i < parts.size(); i++) {
+    parts[i].number = firstNumber + static_cast<int>(i);
   }
+}
 
-  int totalParts = estimatedParts > 0 ? estimatedParts : 1;
-  cout << "Dividiendo en aproximadamente " << totalParts << " partes de hasta "
-       << maxSizeMB << "MB cada una." << endl;
+// Repartir en partes nuevas, numeradas desde firstNumber, las entradas que
+// no cupieron en la parte que les asignó el plan
+static vector<PartPlan> planOverflow(vector<PlannedEntry> &&entries,
+                                     size_t maxSizeBytes, int firstNumber) {
+  uintmax_t budget = maxSizeBytes - min<uintmax_t>(maxSizeBytes, PART_OVERHEAD);
+  vector<PartPlan> plan = packBins(std::move(entries), budget);
+  numberParts(plan, firstNumber);
+  return plan;
+}
 
-  return totalParts;
+// Hueco mínimo que se salta en un archivo disperso: los menores se leen como
+// ceros, para no partir el archivo en demasiados fragmentos
+static const uintmax_t MIN_SPARSE_HOLE = 1024 * 1024;
+
+// Rango con datos de un archivo
+struct DataExtent {
+  uintmax_t offset;
+  uintmax_t length;
+};
+
+// Rangos con datos de un archivo disperso según SEEK_DATA/SEEK_HOLE, unidos
+// cuando los separa un hueco menor que MIN_SPARSE_HOLE. false si el archivo
+// no tiene huecos que merezca la pena saltar o no se pueden localizar
+static bool dataExtents(const filesystem::path &path, uintmax_t size,
+                        vector<DataExtent> &extents) {
+  extents.clear();
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0 ||
+      static_cast<uintmax_t>(st.st_blocks) * 512 >= size) {
+    return false; // Todos los bloques asignados: no hay huecos
+  }
+#ifdef SEEK_DATA
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  bool ok = true;
+  uintmax_t position = 0;
+  uintmax_t dataBytes = 0;
+  while (position < size) {
+    off_t data = lseek(fd, static_cast<off_t>(position), SEEK_DATA);
+    if (data < 0) {
+      ok = errno == ENXIO; // ENXIO: solo queda hueco hasta el final
+      break;
+    }
+    off_t hole = lseek(fd, data, SEEK_HOLE);
+    if (hole < 0) {
+      ok = false;
+      break;
+    }
+    uintmax_t start = min<uintmax_t>(data, size);
+    uintmax_t end = min<uintmax_t>(hole, size);
+    if (start >= end) {
+      break;
+    }
+    if (!extents.empty() &&
+        start - (extents.back().offset + extents.back().length) <
+            MIN_SPARSE_HOLE) {
+      dataBytes -= extents.back().length;
+      extents.back().length = end - extents.back().offset;
+      dataBytes += extents.back().length;
+    } else {
+      extents.push_back({start, end - start});
+      dataBytes += end - start;
+    }
+    position = end;
+  }
+  close(fd);
+  if (ok && dataBytes < size) {
+    return true;
+  }
+#endif
+  extents.clear();
+  return false;
 }
 
-// Versión optimizada para procesar archivos grandes con paralelismo eficiente
-bool processLargeFile(const filesystem::path &filePath,
-                      const string &relativePath, const string &folderPath,
-                      size_t maxSizeBytes, const string &baseName,
-                      const string &extension,
-                      const filesystem::path &outputDir, int &part,
-                      int &totalParts, int &totalFragments,
-                      bool &overallSuccess, const string &password = "") {
+// Reparte los archivos en partes según lo que ocuparán dentro del ZIP, no
+// según su tamaño original. Los archivos grandes se dividen en fragmentos
+// que llenan una parte cada uno; su último fragmento, más corto, se
+// empaqueta junto con los archivos normales para no dejar partes a medias.
+// De los archivos grandes dispersos solo se guardan los rangos con datos,
+// cada uno con sus propios fragmentos
+vector<PartPlan> planParts(const vector<filesystem::path> &allFiles,
+                           const vector<string> &zipPaths, size_t maxSizeBytes,
+                           const string &password, int numThreads) {
+  int threads = numThreads > 0 ? numThreads : ioThreadCount();
+  uintmax_t budget = maxSizeBytes - min<uintmax_t>(maxSizeBytes, PART_OVERHEAD);
+  bool zip64 = maxSizeBytes > ZIP32_LIMIT;
+
+  // Por archivo: tamaño, tamaño de fragmento (0 si cabe entero en una parte
+  // aun en el peor caso) y estimación de lo que ocupará el archivo. Si se
+  // fragmenta, sus rangos con datos (el archivo entero salvo que sea
+  // disperso) y la estimación del último fragmento de cada rango
+  vector<uintmax_t> sizes(allFiles.size());
+  vector<uintmax_t> payloads(allFiles.size());
+  vector<uintmax_t> estimates(allFiles.size());
+  vector<vector<DataExtent>> extents(allFiles.size());
+  vector<vector<uintmax_t>> tailEstimates(allFiles.size());
+  vector<char> sparse(allFiles.size(), 0);
+  atomic<bool> partTooSmall{false};
+#pragma omp parallel for schedule(dynamic) num_threads(threads)
+  for (long i = 0; i < static_cast<long>(allFiles.size()); i++) {
+    sizes[i] = timedFileSize(allFiles[i]);
+
+    PlannedEntry probe;
+    probe.source = allFiles[i];
+    probe.zipPath = zipPaths[i];
+    probe.length = sizes[i];
+    uintmax_t fixed =
+        solidCandidate(probe)
+            ? solidMemberOverhead(probe, zip64)
+            : entryOverhead(probe.zipPath, zip64) + infoLineSize(probe);
+    if (deflateWorstCase(sizes[i]) + fixed <= budget) {
+      ScopedStage timer(Stage::ESTIMATE,
+                        min<uintmax_t>(sizes[i], ESTIMATE_SAMPLE_BYTES));
+      estimates[i] =
+          estimateCompressedSize(allFiles[i], 0, sizes[i], password) + fixed;
+      continue;
+    }
 
-  bool isEncrypted = !password.empty();
-  uintmax_t fileSize = filesystem::file_size(filePath);
-
-  cout << "  Archivo grande detectado: " << relativePath << " ("
-       << (fileSize / 1024 / 1024) << "MB)" << endl;
-
-  int fragmentsNeeded =
-      static_cast<int>((fileSize + maxSizeBytes - 1) / maxSizeBytes);
-  int startingPart = part + 1;
-
-  // Actualizar totalParts si es necesario
-  if (fragmentsNeeded > totalParts) {
-    totalParts = fragmentsNeeded;
-  }
-
-  cout << "  Dividiendo en " << fragmentsNeeded << " archivos ZIP"
-       << (isEncrypted ? " encriptados" : "") << "..." << endl;
-
-  // Preparamos los argumentos para cada hilo
-  struct FragmentTask {
-    int fragNum;
-    streamsize offset;
-    streamsize bytesToRead;
-    string fragmentName;
-    int localPart;
-    string partFileName;
-    filesystem::path partPath;
-    bool success;
-    vector<char> buffer; // Cada tarea tiene su propio buffer
-  };
-
-  // Preparar todas las tareas antes de la ejecución paralela
-  vector<FragmentTask> tasks(fragmentsNeeded);
-  for (int fragNum = 0; fragNum < fragmentsNeeded; fragNum++) {
-    tasks[fragNum].fragNum = fragNum;
-    tasks[fragNum].offset = fragNum * maxSizeBytes;
-    tasks[fragNum].bytesToRead = min(
-        maxSizeBytes, static_cast<size_t>(fileSize - tasks[fragNum].offset));
-    tasks[fragNum].localPart = startingPart + fragNum;
-    tasks[fragNum].fragmentName = relativePath + ".fragment" +
-                                  to_string(fragNum + 1) + "_of_" +
-                                  to_string(fragmentsNeeded);
-    tasks[fragNum].partFileName = baseName + "_part" +
-                                  to_string(tasks[fragNum].localPart) + "_of_" +
-                                  to_string(totalParts) + extension;
-    tasks[fragNum].partPath = outputDir / tasks[fragNum].partFileName;
-    tasks[fragNum].success = true;
-    tasks[fragNum].buffer.resize(
-        tasks[fragNum].bytesToRead); // Pre-asignar el buffer
-  }
-
-// MEJORA 1: Usar lecturas directas del sistema operativo para cada fragmento
-#pragma omp parallel for schedule(dynamic)
-  for (int i = 0; i < fragmentsNeeded; i++) {
-    // Abrir el archivo de forma independiente para cada fragmento (evita la
-    // contención del mutex)
-    FILE *file = fopen(filePath.string().c_str(), "rb");
-    if (!file) {
-#pragma omp critical
-      cerr << "  Error al abrir archivo grande para el fragmento " << i + 1
-           << endl;
-      tasks[i].success = false;
+    {
+      ScopedStage timer(Stage::STAT);
+      sparse[i] = dataExtents(allFiles[i], sizes[i], extents[i]);
+    }
+    if (sparse[i]) {
+      probe.sparseSize = sizes[i];
+    } else {
+      extents[i].push_back({0, sizes[i]});
+    }
+    probe.zipPath += ".fragment99999_of_99999";
+    fixed = entryOverhead(probe.zipPath, zip64) + infoLineSize(probe);
+    payloads[i] = largestPayload(budget - min(budget, fixed));
+    if (payloads[i] == 0) {
+      partTooSmall = true;
       continue;
     }
+    for (const DataExtent &extent : extents[i]) {
+      uintmax_t length = extent.length % payloads[i];
+      uintmax_t estimate = 0; // 0: todos los fragmentos llenan su parte
+      if (length > 0) {
+        ScopedStage timer(Stage::ESTIMATE,
+                          min<uintmax_t>(length, ESTIMATE_SAMPLE_BYTES));
+        estimate = estimateCompressedSize(allFiles[i],
+                                          extent.offset + extent.length -
+                                              length,
+                                          length, password) +
+                   fixed;
+      }
+      tailEstimates[i].push_back(estimate);
+    }
+  }
+  if (partTooSmall) {
+    LOG_ERROR("El tamaño de parte es demasiado pequeño para los nombres de "
+              "los fragmentos");
+    return vector<PartPlan>();
+  }
 
-    // Posicionar y leer directamente
-    if (fseeko(file, tasks[i].offset, SEEK_SET) != 0 ||
-        fread(tasks[i].buffer.data(), 1, tasks[i].bytesToRead, file) !=
-            tasks[i].bytesToRead) {
-#pragma omp critical
-      cerr << "  Error al leer fragmento " << i + 1 << endl;
-      tasks[i].success = false;
-      fclose(file);
+  vector<PartPlan> plan;      // Fragmentos que llenan una parte cada uno
+  vector<PlannedEntry> items; // Archivos normales y últimos fragmentos
+
+  for (size_t i = 0; i < allFiles.size(); i++) {
+    const filesystem::path &filePath = allFiles[i];
+    uintmax_t fileSize = sizes[i];
+    const string &relativePath = zipPaths[i];
+
+    if (payloads[i] == 0) {
+      PlannedEntry entry;
+      entry.source = filePath;
+      entry.zipPath = relativePath;
+      entry.length = fileSize;
+      entry.estimated = estimates[i];
+      items.push_back(std::move(entry));
       continue;
     }
 
-    fclose(file);
+    // Archivo grande: fragmentos del mayor tamaño cuyo peor caso
+    // comprimido cabe en una parte con sus cabeceras, numerados a lo largo
+    // de todos sus rangos con datos
+    uintmax_t payload = payloads[i];
+    const vector<DataExtent> &ranges = extents[i];
+    int fragmentsNeeded = 0;
+    for (const DataExtent &range : ranges) {
+      fragmentsNeeded +=
+          static_cast<int>((range.length + payload - 1) / payload);
+    }
 
-#pragma omp critical
-    cout << "    Fragmento " << i + 1 << " leído correctamente ("
-         << tasks[i].bytesToRead / 1024 << "KB)" << endl;
-  }
+    if (fragmentsNeeded == 0) {
+      // Archivo disperso sin datos: basta un fragmento vacío para recrearlo
+      PlannedEntry entry;
+      entry.source = filePath;
+      entry.zipPath = relativePath + ".fragment1_of_1";
+      entry.fragment = true;
+      entry.sparseSize = fileSize;
+      entry.estimated =
+          entryOverhead(entry.zipPath, zip64) + infoLineSize(entry);
+      items.push_back(std::move(entry));
+      continue;
+    }
 
-  // MEJORA 2: Optimizar la creación de archivos ZIP y encriptación
-  std::atomic<bool> atomicSuccess{true};
-  std::atomic<int> completedFragments{0};
+    int fragNum = 0;
+    for (size_t r = 0; r < ranges.size(); r++) {
+      for (uintmax_t done = 0; done < ranges[r].length; done += payload) {
+        PlannedEntry entry;
+        entry.source = filePath;
+        entry.zipPath = relativePath + ".fragment" + to_string(++fragNum) +
+                        "_of_" + to_string(fragmentsNeeded);
+        entry.offset = ranges[r].offset + done;
+        entry.length = min<uintmax_t>(payload, ranges[r].length - done);
+        entry.fragment = true;
+        entry.sparseSize = sparse[i] ? fileSize : 0;
+
+        if (entry.length < payload) {
+          // El último fragmento del rango comparte parte con otros archivos
+          entry.estimated = tailEstimates[i][r];
+          items.push_back(std::move(entry));
+          continue;
+        }
+        entry.estimated = deflateWorstCase(entry.length) +
+                          entryOverhead(entry.zipPath, zip64) +
+                          infoLineSize(entry);
+        PartPlan fragmentPart;
+        fragmentPart.bytes = entry.length;
+        fragmentPart.estimated = entry.estimated;
+        fragmentPart.entries.push_back(std::move(entry));
+        plan.push_back(std::move(fragmentPart));
+      }
+    }
+  }
 
-  // MEJORA 3: Ajustar dinámicamente la granularidad
-  int chunksPerThread =
-      std::max(1, fragmentsNeeded / (omp_get_max_threads() * 2));
+  // Archivos normales y últimos fragmentos como un solo problema de
+  // empaquetado
+  vector<PartPlan> bins = packBins(std::move(items), budget);
+  plan.insert(plan.end(), make_move_iterator(bins.begin()),
+              make_move_iterator(bins.end()));
+  numberParts(plan, 1);
+  return plan;
+}
 
-#pragma omp parallel for schedule(dynamic, chunksPerThread)
-  for (int i = 0; i < fragmentsNeeded; i++) {
-    // Si la lectura falló, omitir este fragmento
-    if (!tasks[i].success)
-      continue;
+// ZIP de una parte en construcción: en disco o sobre un buffer en memoria
+struct PartArchive {
+  zip_t *archive = nullptr;
+  zip_source_t *memory = nullptr; // Solo si la parte se construye en memoria
+};
 
-    // Crear archivo ZIP
+// Abrir el ZIP de una parte según el destino configurado
+static bool openPartArchive(const filesystem::path &partPath,
+                            const PartSink &sink, PartArchive &part) {
+  if (!sink.inMemory()) {
     int zip_error = 0;
-    zip_t *archive = zip_open(tasks[i].partPath.string().c_str(),
-                              ZIP_CREATE | ZIP_TRUNCATE, &zip_error);
-    if (!archive) {
+    part.archive = zip_open(partPath.string().c_str(),
+                            ZIP_CREATE | ZIP_TRUNCATE, &zip_error);
+    if (!part.archive) {
       char errstr[128];
       zip_error_to_str(errstr, sizeof(errstr), zip_error, errno);
-#pragma omp critical
-      cerr << "No se pudo crear el archivo ZIP: " << tasks[i].partPath << " - "
-           << errstr << endl;
-      tasks[i].success = false;
-      atomicSuccess = false;
-      continue;
+      LOG_ERROR("No se pudo crear el archivo ZIP: " << partPath << " - "
+                                                    << errstr);
+      return false;
     }
+    return true;
+  }
 
-    // MEJORA 4: Encriptación más eficiente
-    bool addSuccess = false;
-    if (isEncrypted) {
-      // Encriptar solo el buffer ya cargado
-      addSuccess = addEncryptedBufferToZip(
-          archive, tasks[i].buffer.data(), tasks[i].buffer.size(),
-          tasks[i].fragmentName, password, true, false);
-    } else {
-      addSuccess = addBufferToZip(archive, tasks[i].buffer.data(),
-                                  tasks[i].buffer.size(), tasks[i].fragmentName,
-                                  true, false);
+  // En memoria: libzip escribe el archivo completo sobre una fuente buffer.
+  // Se retiene una referencia extra para poder leerla tras zip_close
+  zip_error_t error;
+  zip_error_init(&error);
+  part.memory = zip_source_buffer_create(nullptr, 0, 0, &error);
+  if (part.memory) {
+    zip_source_keep(part.memory);
+    part.archive = zip_open_from_source(part.memory, ZIP_TRUNCATE, &error);
+    if (!part.archive) {
+      zip_source_free(part.memory); // La referencia extra
+      zip_source_free(part.memory); // La de zip_source_buffer_create
     }
+  }
+  if (!part.archive) {
+    LOG_ERROR("No se pudo crear el ZIP en memoria para "
+              << partPath.filename() << " - " << zip_error_strerror(&error));
+    zip_error_fini(&error);
+    return false;
+  }
+  zip_error_fini(&error);
+  return true;
+}
 
-    // Liberar memoria del buffer una vez que se haya utilizado
-    vector<char>().swap(tasks[i].buffer);
+// Cerrar el ZIP de una parte y, si deliver es true, entregarla al destino.
+// En memoria, el contenido se copia a un vector y la fuente se libera. Si
+// maxBytes no es 0 y la parte lo supera, se descarta sin entregarla y su
+// tamaño se devuelve en oversizedBytes
+static bool closePartArchive(PartArchive &part,
+                             const filesystem::path &partPath,
+                             const PartSink &sink, bool deliver,
+                             uintmax_t maxBytes = 0,
+                             uintmax_t *oversizedBytes = nullptr) {
+  // Aquí libzip comprime y escribe la parte completa
+  int closeResult;
+  {
+    ScopedStage closeTimer(Stage::ZIP_CLOSE);
+    closeResult = zip_close(part.archive);
+    if (closeResult == 0 && instrumentationEnabled() && !part.memory) {
+      error_code ec;
+      closeTimer.addBytes(filesystem::file_size(partPath, ec));
+    }
+  }
+  if (closeResult < 0) {
+    LOG_ERROR("Error al cerrar el archivo ZIP: " << partPath);
+    if (part.memory) {
+      zip_source_free(part.memory);
+    }
+    return false;
+  }
 
-    if (!addSuccess) {
-      zip_close(archive);
-      tasks[i].success = false;
-      atomicSuccess = false;
-      continue;
+  if (!part.memory) {
+    error_code ec;
+    uintmax_t partSize = filesystem::file_size(partPath, ec);
+    // La escritura de la parte cuenta para el tope de disco
+    throttleDisk(ec ? 0 : partSize);
+    if (maxBytes > 0 && !ec && partSize > maxBytes) {
+      filesystem::remove(partPath, ec);
+      *oversizedBytes = partSize;
+      return true;
+    }
+    // La parte ya está completa en disco: entregarla de inmediato
+    if (deliver && sink.onPartReady) {
+      sink.onPartReady(partPath);
     }
+    return true;
+  }
+
+  vector<char> data;
+  zip_stat_t st;
+  bool readOk = zip_source_stat(part.memory, &st) == 0 &&
+                (st.valid & ZIP_STAT_SIZE) && zip_source_open(part.memory) == 0;
+  if (readOk) {
+    data.resize(st.size);
+    readOk = zip_source_read(part.memory, data.data(), st.size) ==
+             static_cast<zip_int64_t>(st.size);
+    zip_source_close(part.memory);
+  }
+  zip_source_free(part.memory);
 
-    // Crear y añadir archivo .info
-    ostringstream fragInfoContent;
-    fragInfoContent << totalParts << "\n" << tasks[i].localPart << "\n";
-    if (isEncrypted) {
-      fragInfoContent << "encrypted: " << crypto.generatePasswordHash(password)
-                      << "\n";
+  if (!readOk) {
+    LOG_ERROR("Error al leer el ZIP en memoria: " << partPath.filename());
+    return false;
+  }
+  if (maxBytes > 0 && data.size() > maxBytes) {
+    *oversizedBytes = data.size();
+    return true;
+  }
+  if (deliver) {
+    sink.onPartBuffer(partPath.filename().string(), std::move(data));
+  }
+  return true;
+}
+
+// Orden de ejecución de las partes: de mayor a menor volumen (LPT). Así las
+// partes más largas empiezan primero y las pequeñas rellenan los huecos al
+// final, en lugar de que una parte grande al final de la lista deje al resto
+// de hilos esperando. Los empates conservan el orden del plan
+static vector<size_t> largestFirstOrder(const vector<PartPlan> &plan) {
+  vector<size_t> order(plan.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+  stable_sort(order.begin(), order.end(), [&plan](size_t a, size_t b) {
+    return plan[a].bytes > plan[b].bytes;
+  });
+  return order;
+}
+
+// Añade al ZIP un rango ya leído, cifrado si hay contraseña. Se queda con
+// buffer (reservado con new[])
+static bool addRangeBufferToZip(zip_t *archive, char *buffer, size_t length,
+                                const string &zipPath,
+                                const string &password) {
+  if (password.empty()) {
+    // libzip se queda con el buffer y lo libera al cerrar la parte
+    return addBufferToZip(archive, buffer, length, zipPath, false, true);
+  }
+
+  // El cifrado genera su propio buffer; el texto plano ya no hace falta
+  bool result = addEncryptedBufferToZip(archive, buffer, length, zipPath,
+                                        password, false, false);
+  delete[] buffer;
+  return result;
+}
+
+// Lee el rango [offset, offset + length) de un archivo en buffer. Cada
+// llamada abre su propio descriptor, así varias tareas pueden leer el mismo
+// archivo grande a la vez. Lo leído se descarta de la caché de páginas para
+// no desplazar a otros procesos
+static bool readFileRange(const PlannedEntry &entry, char *buffer) {
+  size_t length = static_cast<size_t>(entry.length);
+  throttleDisk(length);
+
+  if (directIO()) {
+    ScopedStage timer(Stage::READ, length);
+    if (readDirect(entry.source.string(), entry.offset, length, buffer)) {
+      return true;
     }
-    fragInfoContent << tasks[i].fragmentName << " | " << filePath.string()
-                    << "\n";
+  }
+
+  FILE *file = fopen(entry.source.string().c_str(), "rb");
+  if (!file) {
+    LOG_ERROR("No se pudo abrir el archivo: " << entry.source);
+    return false;
+  }
 
-    string infoStr = fragInfoContent.str();
-    if (!addBufferToZip(archive, infoStr.data(), infoStr.size(),
-                        "part_" + to_string(tasks[i].localPart) + ".info", true,
-                        true)) {
-#pragma omp critical
-      cerr << "  Error al agregar archivo de información al fragmento "
-           << tasks[i].fragNum << endl;
-      tasks[i].success = false;
-      atomicSuccess = false;
+  bool readOk;
+  {
+    ScopedStage timer(Stage::READ, length);
+    adviseSequential(fileno(file), entry.offset, length);
+    readOk = fseeko(file, static_cast<off_t>(entry.offset), SEEK_SET) == 0 &&
+             fread(buffer, 1, length, file) == length;
+    dropReadCache(fileno(file), entry.offset, length);
+  }
+  fclose(file);
+  if (!readOk) {
+    LOG_ERROR("Error al leer el archivo: " << entry.source);
+  }
+  return readOk;
+}
+
+// Lee un rango de un archivo y lo añade al ZIP, cifrado si hay contraseña
+static bool addFileRangeToZip(zip_t *archive, const PlannedEntry &entry,
+                              const string &password) {
+  size_t length = static_cast<size_t>(entry.length);
+  char *buffer = new char[length];
+  if (!readFileRange(entry, buffer)) {
+    delete[] buffer;
+    return false;
+  }
+  return addRangeBufferToZip(archive, buffer, length, entry.zipPath, password);
+}
+
+// libzip pide unos 8 KB por lectura: el archivo se lee en trozos de este
+// tamaño y las lecturas de libzip se sirven desde ahí
+static const size_t STREAM_STAGING_BYTES = 4 * 1024 * 1024;
+
+// Estado de una entrada que libzip lee por trozos durante zip_close
+struct StreamedRange {
+  PlannedEntry entry;
+  string password;
+  int fd = -1;
+  uint64_t position = 0; // Bytes ya entregados a libzip
+  vector<char> staging;  // Trozo leído (y cifrado) que aún se entrega
+  uint64_t stagedPosition = 0; // Posición en la entrada de staging[0]
+  size_t stagedBytes = 0;
+  zip_error_t error;
+};
+
+// Lee el siguiente trozo de la entrada en staging, con una sola lectura
+// (directa si se pidió -D), y lo cifra y lo descarta de la caché de una vez
+static bool refillStreamedRange(StreamedRange &range) {
+  const PlannedEntry &entry = range.entry;
+  size_t chunk = static_cast<size_t>(
+      min<uint64_t>(STREAM_STAGING_BYTES, entry.length - range.position));
+  range.staging.resize(STREAM_STAGING_BYTES);
+  range.stagedPosition = range.position;
+  range.stagedBytes = 0;
+  errno = 0;
+  uint64_t offset = entry.offset + range.position;
+  char *buffer = range.staging.data();
+  throttleDisk(chunk);
+  {
+    ScopedStage timer(Stage::READ, chunk);
+    if (directIO() &&
+        readDirect(entry.source.string(), offset, chunk, buffer)) {
+      range.stagedBytes = chunk;
     }
+    while (range.stagedBytes < chunk) {
+      ssize_t got = pread(range.fd, buffer + range.stagedBytes,
+                          chunk - range.stagedBytes,
+                          static_cast<off_t>(offset + range.stagedBytes));
+      if (got < 0 && errno == EINTR) {
+        continue;
+      }
+      if (got <= 0) {
+        break;
+      }
+      range.stagedBytes += static_cast<size_t>(got);
+    }
+    dropReadCache(range.fd, offset, range.stagedBytes);
+  }
+  if (range.stagedBytes == 0) {
+    return false;
+  }
+  if (!range.password.empty()) {
+    ScopedStage timer(Stage::ENCRYPT, range.stagedBytes);
+    crypto.transformAt(reinterpret_cast<unsigned char *>(buffer),
+                       range.stagedBytes, range.password, range.position);
+  }
+  return true;
+}
 
-    if (zip_close(archive) < 0) {
-#pragma omp critical
-      cerr << "Error al cerrar el archivo ZIP: " << tasks[i].partPath << endl;
-      tasks[i].success = false;
-      atomicSuccess = false;
+// Fuente de libzip para un rango de un archivo: se abre, se lee, se cifra
+// y se descarta de la caché por trozos de STREAM_STAGING_BYTES a medida que
+// libzip comprime, así una entrada de varios GB no se carga entera en
+// memoria. El tamaño se conoce de antemano, y con él libzip decide si la
+// entrada necesita cabeceras ZIP64
+static zip_int64_t streamedRangeCallback(void *state, void *data,
+                                         zip_uint64_t length,
+                                         zip_source_cmd_t command) {
+  StreamedRange *range = static_cast<StreamedRange *>(state);
+  const PlannedEntry &entry = range->entry;
+  switch (command) {
+  case ZIP_SOURCE_OPEN:
+    range->fd = open(entry.source.c_str(), O_RDONLY | O_CLOEXEC);
+    if (range->fd < 0) {
+      LOG_ERROR("No se pudo abrir el archivo: " << entry.source);
+      zip_error_set(&range->error, ZIP_ER_OPEN, errno);
+      return -1;
     }
+    adviseSequential(range->fd, entry.offset, entry.length);
+    range->position = 0;
+    range->stagedBytes = 0;
+    return 0;
+
+  case ZIP_SOURCE_READ: {
+    size_t chunk = static_cast<size_t>(
+        min<uint64_t>(length, entry.length - range->position));
+    if (chunk == 0) {
+      return 0;
+    }
+    if (range->position == range->stagedPosition + range->stagedBytes &&
+        !refillStreamedRange(*range)) {
+      // Un archivo que encoge mientras se copia también es un error
+      LOG_ERROR("Error al leer el archivo: " << entry.source);
+      zip_error_set(&range->error, ZIP_ER_READ, errno ? errno : EIO);
+      return -1;
+    }
+    size_t staged = static_cast<size_t>(range->position -
+                                        range->stagedPosition);
+    chunk = min(chunk, range->stagedBytes - staged);
+    memcpy(data, range->staging.data() + staged, chunk);
+    range->position += chunk;
+    return static_cast<zip_int64_t>(chunk);
+  }
 
-    // Incrementar contador de fragmentos completados y mostrar progreso
-    int completed = ++completedFragments;
-#pragma omp critical
-    {
-      cout << "    Fragmento " << tasks[i].fragNum + 1 << " de "
-           << fragmentsNeeded << " (" << (tasks[i].bytesToRead / 1024)
-           << "KB) completado - Progreso: " << completed << "/"
-           << fragmentsNeeded << endl;
+  case ZIP_SOURCE_CLOSE:
+    close(range->fd);
+    range->fd = -1;
+    range->staging = vector<char>();
+    return 0;
+
+  case ZIP_SOURCE_STAT: {
+    zip_stat_t *st = static_cast<zip_stat_t *>(data);
+    zip_stat_init(st);
+    st->size = entry.length;
+    st->valid |= ZIP_STAT_SIZE;
+    return sizeof(zip_stat_t);
+  }
+
+  case ZIP_SOURCE_ERROR:
+    return zip_error_to_data(&range->error, data, length);
+
+  case ZIP_SOURCE_FREE:
+    if (range->fd >= 0) {
+      close(range->fd);
     }
+    zip_error_fini(&range->error);
+    delete range;
+    return 0;
+
+  case ZIP_SOURCE_SUPPORTS:
+    return zip_source_make_command_bitmap(
+        ZIP_SOURCE_OPEN, ZIP_SOURCE_READ, ZIP_SOURCE_CLOSE, ZIP_SOURCE_STAT,
+        ZIP_SOURCE_ERROR, ZIP_SOURCE_FREE, -1);
+
+  default:
+    zip_error_set(&range->error, ZIP_ER_OPNOTSUPP, 0);
+    return -1;
   }
+}
 
-  // MEJORA 5: Eliminar dependencias y actualizar contadores más eficientemente
-  part += fragmentsNeeded;
-  totalFragments += fragmentsNeeded;
+// Añade una entrada que no se lee hasta zip_close (ver
+// streamedRangeCallback), cifrada si hay contraseña
+static bool addStreamedRangeToZip(zip_t *archive, const PlannedEntry &entry,
+                                  const string &password) {
+  StreamedRange *range = new StreamedRange;
+  range->entry = entry;
+  range->password = password;
+  zip_error_init(&range->error);
+  zip_source_t *source =
+      zip_source_function(archive, streamedRangeCallback, range);
+  if (!source) {
+    LOG_ERROR("Error al crear la fuente de " << entry.zipPath << ": "
+                                             << zip_strerror(archive));
+    zip_error_fini(&range->error);
+    delete range;
+    return false;
+  }
 
-  // Verificar resultado final
-  overallSuccess = atomicSuccess;
-  if (!overallSuccess) {
-    cerr << "Error al fragmentar el archivo " << filePath << endl;
-  } else {
-    cout << "  Archivo fragmentado correctamente: " << relativePath << endl;
+  zip_int64_t index;
+  {
+    ScopedStage timer(Stage::ZIP_ADD);
+    index = zip_file_add(archive, entry.zipPath.c_str(), source,
+                         ZIP_FL_ENC_UTF_8);
   }
+  if (index < 0) {
+    LOG_ERROR("Error al añadir " << entry.zipPath
+                                 << " al ZIP: " << zip_strerror(archive));
+    zip_source_free(source); // Libera también range
+    return false;
+  }
+  return applyCompressionLevel(archive, index, entry.zipPath);
+}
 
-  return overallSuccess;
+// Bloque sólido: archivos pequeños concatenados que se guardan como una
+// sola entrada
+struct SolidBlock {
+  string name;
+  vector<PlannedEntry> members;
+  vector<uint64_t> positions; // Posición de cada archivo dentro del bloque
+  uint64_t size = 0;
+  string password;
+  vector<char> data;     // Contenido, solo mientras libzip lo lee
+  uint64_t position = 0; // Bytes ya entregados a libzip
+  zip_error_t error;
+};
+
+// Lee todos los archivos de un bloque en block.data, de una vez con
+// io_uring si se puede, y lo cifra entero como una sola entrada
+static bool fillSolidBlock(SolidBlock &block) {
+  block.data.resize(block.size);
+  vector<bool> loaded(block.members.size(), false);
+  if (block.members.size() > 1 && !directIO() && batchReadAvailable()) {
+    vector<RangeRead> batch(block.members.size());
+    for (size_t k = 0; k < batch.size(); k++) {
+      batch[k].path = block.members[k].source.string();
+      batch[k].length = static_cast<size_t>(block.members[k].length);
+    }
+    throttleDisk(block.size);
+    ScopedStage timer(Stage::READ, block.size);
+    readRangesBatched(batch);
+    for (size_t k = 0; k < batch.size(); k++) {
+      if (batch[k].buffer) {
+        memcpy(block.data.data() + block.positions[k], batch[k].buffer,
+               batch[k].length);
+        loaded[k] = true;
+        delete[] batch[k].buffer;
+      }
+    }
+  }
+  // Sin io_uring, o solo los que fallaron en el lote, uno a uno
+  for (size_t k = 0; k < block.members.size(); k++) {
+    if (!loaded[k] && !readFileRange(block.members[k],
+                                     block.data.data() + block.positions[k])) {
+      return false;
+    }
+  }
+  if (!block.password.empty()) {
+    ScopedStage timer(Stage::ENCRYPT, block.size);
+    crypto.transformAt(reinterpret_cast<unsigned char *>(block.data.data()),
+                       block.data.size(), block.password, 0);
+  }
+  return true;
+}
+
+// Fuente de libzip para un bloque sólido: los archivos se leen al abrirla,
+// dentro de zip_close, así cada parte solo tiene en memoria el bloque que
+// se está comprimiendo
+static zip_int64_t solidBlockCallback(void *state, void *data,
+                                      zip_uint64_t length,
+                                      zip_source_cmd_t command) {
+  SolidBlock *block = static_cast<SolidBlock *>(state);
+  switch (command) {
+  case ZIP_SOURCE_OPEN:
+    block->position = 0;
+    if (!fillSolidBlock(*block)) {
+      zip_error_set(&block->error, ZIP_ER_READ, EIO);
+      return -1;
+    }
+    return 0;
+
+  case ZIP_SOURCE_READ: {
+    size_t chunk = static_cast<size_t>(
+        min<uint64_t>(length, block->size - block->position));
+    memcpy(data, block->data.data() + block->position, chunk);
+    block->position += chunk;
+    return chunk;
+  }
+
+  case ZIP_SOURCE_CLOSE:
+    block->data = vector<char>();
+    return 0;
+
+  case ZIP_SOURCE_STAT: {
+    zip_stat_t *st = static_cast<zip_stat_t *>(data);
+    zip_stat_init(st);
+    st->size = block->size;
+    st->valid |= ZIP_STAT_SIZE;
+    return sizeof(zip_stat_t);
+  }
+
+  case ZIP_SOURCE_ERROR:
+    return zip_error_to_data(&block->error, data, length);
+
+  case ZIP_SOURCE_FREE:
+    zip_error_fini(&block->error);
+    delete block;
+    return 0;
+
+  case ZIP_SOURCE_SUPPORTS:
+    return zip_source_make_command_bitmap(
+        ZIP_SOURCE_OPEN, ZIP_SOURCE_READ, ZIP_SOURCE_CLOSE, ZIP_SOURCE_STAT,
+        ZIP_SOURCE_ERROR, ZIP_SOURCE_FREE, -1);
+
+  default:
+    zip_error_set(&block->error, ZIP_ER_OPNOTSUPP, 0);
+    return -1;
+  }
+}
+
+// Añade un bloque sólido al ZIP. El bloque pasa a ser de libzip, que lo
+// libera al cerrar la parte
+static bool addSolidBlockToZip(zip_t *archive, SolidBlock *block) {
+  zip_error_init(&block->error);
+  zip_source_t *source = zip_source_function(archive, solidBlockCallback,
+                                             block);
+  if (!source) {
+    LOG_ERROR("Error al crear la fuente de " << block->name << ": "
+                                             << zip_strerror(archive));
+    zip_error_fini(&block->error);
+    delete block;
+    return false;
+  }
+
+  zip_int64_t index;
+  {
+    ScopedStage timer(Stage::ZIP_ADD);
+    index =
+        zip_file_add(archive, block->name.c_str(), source, ZIP_FL_ENC_UTF_8);
+  }
+  if (index < 0) {
+    LOG_ERROR("Error al añadir " << block->name
+                                 << " al ZIP: " << zip_strerror(archive));
+    zip_source_free(source); // Libera también el bloque
+    return false;
+  }
+  return applyCompressionLevel(archive, index, block->name);
+}
+
+// Reparte en bloques sólidos, en el orden de la parte, las entradas que
+// pueden ir en uno. solid queda marcado para cada entrada empaquetada
+static vector<SolidBlock *> planSolidBlocks(int number,
+                                            const vector<PlannedEntry> &entries,
+                                            size_t count,
+                                            const string &password,
+                                            vector<bool> &solid) {
+  vector<SolidBlock *> blocks;
+  solid.assign(count, false);
+  for (size_t i = 0; i < count; i++) {
+    if (!solidCandidate(entries[i])) {
+      continue;
+    }
+    if (blocks.empty() ||
+        blocks.back()->size + entries[i].length > SOLID_BLOCK_BYTES) {
+      blocks.push_back(new SolidBlock);
+      blocks.back()->name = solidBlockName(number, blocks.size());
+      blocks.back()->password = password;
+    }
+    SolidBlock &block = *blocks.back();
+    block.positions.push_back(block.size);
+    block.members.push_back(entries[i]);
+    block.size += entries[i].length;
+    solid[i] = true;
+  }
+  return blocks;
+}
+
+// Entradas que se leen durante zip_close en lugar de antes: las grandes
+// siempre y, en cuanto lo leído por adelantado llega a PART_BUFFER_BYTES,
+// también el resto. Así la memoria de una parte no depende de -s
+static vector<bool> streamedEntries(const vector<PlannedEntry> &entries,
+                                    size_t count) {
+  vector<bool> streamed(count, false);
+  uintmax_t buffered = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (entries[i].length >= STREAM_ENTRY_BYTES ||
+        buffered + entries[i].length > PART_BUFFER_BYTES) {
+      streamed[i] = true;
+    } else {
+      buffered += entries[i].length;
+    }
+  }
+  return streamed;
 }
-bool processNormalFiles(vector<filesystem::path> &allFiles, size_t &fileIndex,
-                        const string &folderPath, size_t maxSizeBytes,
-                        const string &baseName, const string &extension,
-                        const filesystem::path &outputDir, int part,
-                        int totalParts, bool &overallSuccess,
-                        const string &password = "") {
 
+// Lee de una vez con io_uring las entradas de la parte que no van en
+// streaming, en lugar de abrir y leer cada archivo por turno. Devuelve
+// vacío si no se puede (menos de dos entradas, O_DIRECT activo o io_uring
+// no disponible) y la parte usa la lectura normal; si no, un elemento por
+// entrada, sin buffer en las de streaming
+static vector<RangeRead>
+readEntriesBatched(const vector<PlannedEntry> &entries, size_t count,
+                   const vector<bool> &streamed) {
+  vector<RangeRead> reads;
+  vector<size_t> indexes;
+  for (size_t i = 0; i < count; i++) {
+    if (!streamed[i]) {
+      indexes.push_back(i);
+    }
+  }
+  if (indexes.size() < 2 || directIO() || !batchReadAvailable()) {
+    return reads;
+  }
+  vector<RangeRead> batch(indexes.size());
+  uintmax_t bytes = 0;
+  for (size_t k = 0; k < indexes.size(); k++) {
+    const PlannedEntry &entry = entries[indexes[k]];
+    batch[k].path = entry.source.string();
+    batch[k].offset = entry.offset;
+    batch[k].length = static_cast<size_t>(entry.length);
+    bytes += entry.length;
+  }
+  throttleDisk(bytes);
+  ScopedStage timer(Stage::READ, bytes);
+  if (!readRangesBatched(batch)) {
+    return reads;
+  }
+  reads.resize(count);
+  for (size_t k = 0; k < indexes.size(); k++) {
+    reads[indexes[k]] = std::move(batch[k]);
+  }
+  return reads;
+}
+
+// Construir un ZIP con las primeras count entradas de la parte: leer y
+// añadir cada una, escribir el .info y cerrar (aquí libzip comprime). Con
+// maxBytes distinto de 0, una parte que lo supere no se entrega y su
+// tamaño queda en oversizedBytes
+static bool writePart(int number, const vector<PlannedEntry> &entries,
+                      size_t count, int totalParts,
+                      const filesystem::path &partPath,
+                      const string &password, const PartSink &sink,
+                      uintmax_t maxBytes, uintmax_t &oversizedBytes) {
   bool isEncrypted = !password.empty();
-  string partFileName = baseName + "_part" + to_string(part) + "_of_" +
-                        to_string(totalParts) + extension;
-  filesystem::path partPath = outputDir / partFileName;
 
-  // Abrir el archivo ZIP para esta parte
-  int zip_error = 0;
-  zip_t *archive = zip_open(partPath.string().c_str(),
-                            ZIP_CREATE | ZIP_TRUNCATE, &zip_error);
-  if (!archive) {
-    char errstr[128];
-    zip_error_to_str(errstr, sizeof(errstr), zip_error, errno);
-    cerr << "No se pudo crear el archivo ZIP: " << partPath << " - " << errstr
-         << endl;
-    overallSuccess = false;
+  PartArchive partArchive;
+  if (!openPartArchive(partPath, sink, partArchive)) {
     return false;
   }
+  zip_t *archive = partArchive.archive;
 
   bool partSuccess = true;
-  size_t currentSize = 0;
 
   // Crear archivo .info básico para esta parte
   ostringstream infoContent;
   infoContent << totalParts << "\n";
-  infoContent << part << "\n";
-
-  // Añadir información de encriptación si hay contraseña
+  infoContent << number << "\n";
   if (isEncrypted) {
     infoContent << "encrypted: " << crypto.generatePasswordHash(password)
                 << "\n";
-    cout << "  Usando encriptación para parte " << part << endl;
   }
 
-  // Procesar archivos para esta parte
-  while (fileIndex < allFiles.size()) {
-    uintmax_t fileSize = filesystem::file_size(allFiles[fileIndex]);
-    string relativePath =
-        filesystem::relative(allFiles[fileIndex], folderPath).string();
-
-    // Si es un archivo grande, salir del bucle
-    if (fileSize > maxSizeBytes) {
-      break;
-    }
+  vector<bool> solid;
+  vector<SolidBlock *> blocks =
+      planSolidBlocks(number, entries, count, password, solid);
+  size_t zipEntries = count + 1 + blocks.size() -
+                      static_cast<size_t>(
+                          std::count(solid.begin(), solid.end(), true));
 
-    // Si añadir este archivo excede el tamaño máximo, terminar esta parte
-    if (currentSize > 0 && (currentSize + fileSize) > maxSizeBytes) {
-      break;
-    }
+  uintmax_t estimated = 0;
+  for (size_t i = 0; i < count; i++) {
+    estimated += entries[i].estimated;
+  }
+  if (zipEntries > ZIP32_MAX_ENTRIES || estimated > ZIP32_LIMIT) {
+    LOG_DEBUG("  La parte " << number << " usa ZIP64 (" << zipEntries
+                            << " entradas, " << (estimated >> 20)
+                            << " MB estimados)");
+  }
 
-    // Agregar archivo al ZIP
-    cout << "  Agregando" << (isEncrypted ? " (encriptado)" : "") << ": "
-         << relativePath << " (" << (fileSize / 1024) << "KB)" << endl;
+  // Los archivos de los bloques sólidos se leen al comprimir cada bloque
+  vector<bool> streamed = streamedEntries(entries, count);
+  vector<bool> deferred = streamed;
+  for (size_t i = 0; i < count; i++) {
+    deferred[i] = deferred[i] || solid[i];
+  }
+  vector<RangeRead> reads = readEntriesBatched(entries, count, deferred);
 
-    bool success = false;
-    if (isEncrypted) {
-      success = addEncryptedFileToZip(archive, allFiles[fileIndex].string(),
-                                      relativePath, password);
+  for (size_t i = 0; i < count; i++) {
+    const PlannedEntry &entry = entries[i];
+    if (solid[i]) {
+      continue;
+    }
+    LOG_DEBUG("  Agregando" << (isEncrypted ? " (encriptado)" : "") << ": "
+                            << entry.zipPath << " (" << (entry.length / 1024)
+                            << "KB) en la parte " << number);
+
+    // Lo que no va en streaming ni se leyó en el lote se lee ahora archivo
+    // a archivo
+    bool added;
+    if (i < reads.size() && reads[i].buffer) {
+      added = addRangeBufferToZip(archive, reads[i].buffer, reads[i].length,
+                                  entry.zipPath, password);
+    } else if (streamed[i]) {
+      added = addStreamedRangeToZip(archive, entry, password);
     } else {
-      success =
-          addFileToZip(archive, allFiles[fileIndex].string(), relativePath);
+      added = addFileRangeToZip(archive, entry, password);
     }
-
-    if (!success) {
-      cerr << "  Error al agregar: " << allFiles[fileIndex] << endl;
+    if (!added) {
+      LOG_ERROR("  Error al agregar: " << entry.source);
       partSuccess = false;
-      overallSuccess = false;
     } else {
       // Añadir información del archivo
-      infoContent << relativePath << " | " << allFiles[fileIndex].string()
-                  << "\n";
-      currentSize += fileSize;
+      infoContent << entry.zipPath << " | " << entry.source.string() << "\n";
+      if (entry.sparseSize > 0) {
+        // Posición del fragmento y tamaño total, para recrear los huecos
+        infoContent << "sparse: " << entry.offset << " " << entry.sparseSize
+                    << " " << entry.zipPath << "\n";
+      }
     }
+  }
 
-    fileIndex++;
+  for (SolidBlock *block : blocks) {
+    LOG_DEBUG("  Agregando bloque sólido" << (isEncrypted ? " (encriptado)"
+                                                          : "")
+                                          << ": " << block->name << " ("
+                                          << block->members.size()
+                                          << " archivos, "
+                                          << (block->size / 1024) << "KB)");
+    // El .info se escribe antes de ceder el bloque a libzip
+    for (size_t k = 0; k < block->members.size(); k++) {
+      infoContent << "solid: " << block->name << " " << block->positions[k]
+                  << " " << block->members[k].length << " "
+                  << block->members[k].zipPath << "\n";
+    }
+    string name = block->name;
+    if (!addSolidBlockToZip(archive, block)) {
+      LOG_ERROR("  Error al agregar el bloque sólido " << name);
+      partSuccess = false;
+    }
   }
 
   // Añadir el archivo .info al ZIP (siempre sin encriptar)
   string infoStr = infoContent.str();
   if (!addBufferToZip(archive, infoStr.data(), infoStr.size(),
-                      "part_" + to_string(part) + ".info", true, true)) {
-    cerr << "  Error al agregar archivo de información" << endl;
+                      "part_" + to_string(number) + ".info", true, true)) {
+    LOG_ERROR("  Error al agregar archivo de información a la parte "
+              << number);
     partSuccess = false;
-    overallSuccess = false;
-  } else {
-    cout << "  Agregado: part_" << part << ".info (Información de rutas)"
-         << endl;
   }
 
-  // Cerrar el archivo ZIP
-  if (zip_close(archive) < 0) {
-    cerr << "Error al cerrar el archivo ZIP: " << partPath << endl;
-    overallSuccess = false;
+  // Cerrar el archivo ZIP y entregarlo al destino
+  if (!closePartArchive(partArchive, partPath, sink, partSuccess, maxBytes,
+                        &oversizedBytes)) {
     partSuccess = false;
   }
-
   return partSuccess;
 }
 
+// Tarea completa de una parte. Si la estimación del plan se quedó corta y
+// la parte supera el límite, se vuelve a construir con menos entradas y las
+// que sobran pasan a overflow
+bool buildPart(const PartPlan &plan, int totalParts,
+               const filesystem::path &partPath, const string &password,
+               const PartSink &sink, size_t maxSizeBytes,
+               vector<PlannedEntry> *overflow) {
+  size_t count = plan.entries.size();
+  uintmax_t budget = maxSizeBytes - min<uintmax_t>(maxSizeBytes, PART_OVERHEAD);
+
+  while (true) {
+    // Una sola entrada cabe siempre: el plan la dimensiona por el peor caso
+    uintmax_t oversizedBytes = 0;
+    uintmax_t limit = (overflow && count > 1) ? maxSizeBytes : 0;
+    if (!writePart(plan.number, plan.entries, count, totalParts, partPath,
+                   password, sink, limit, oversizedBytes)) {
+      return false;
+    }
+    if (oversizedBytes == 0) {
+      break;
+    }
+
+    // Corregir la estimación con el tamaño real y quedarse con las entradas
+    // que caben con esa corrección (al menos una, y siempre alguna menos)
+    uintmax_t estimated = 0;
+    for (size_t i = 0; i < count; i++) {
+      estimated += plan.entries[i].estimated;
+    }
+    double factor =
+        static_cast<double>(oversizedBytes) / max<uintmax_t>(estimated, 1);
+    size_t keep = 0;
+    uintmax_t kept = 0;
+    while (keep < count - 1 &&
+           (kept + plan.entries[keep].estimated) * factor <= budget) {
+      kept += plan.entries[keep].estimated;
+      keep++;
+    }
+    keep = max<size_t>(keep, 1);
+    LOG_DEBUG("  La parte " << plan.number << " supera el límite: "
+                            << (count - keep)
+                            << " entradas pasan a una parte nueva");
+    overflow->insert(overflow->end(), plan.entries.begin() + keep,
+                     plan.entries.begin() + count);
+    count = keep;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    progressAdvance(1, plan.entries[i].length);
+  }
+  LOG_DEBUG("  Parte " << plan.number
+                       << (totalParts > 0 ? " de " + to_string(totalParts)
+                                          : string(" adicional"))
+                       << " terminada (" << (plan.bytes / 1024) << "KB)");
+  return true;
+}
+
 // Función principal unificada con soporte explícito para control de paralelismo
 bool compressFolderToSplitZip(const string &folderPath,
                               const string &zipOutputPath, int maxSizeMB,
-                              const string &password, bool useParallel) {
+                              const string &password, bool useParallel,
+                              const PartSink &sink) {
+  return compressFoldersToSplitZip(vector<string>{folderPath}, zipOutputPath,
+                                   maxSizeMB, password, useParallel, sink);
+}
+
+// Varias carpetas de origen en un solo plan y una sola secuencia de partes
+bool compressFoldersToSplitZip(const vector<string> &folderPaths,
+                               const string &zipOutputPath, int maxSizeMB,
+                               const string &password, bool useParallel,
+                               const PartSink &sink) {
 
   bool isEncrypted = !password.empty();
 
   // Validar tamaño máximo
   if (maxSizeMB <= 0) {
-    cerr << "El tamaño máximo debe ser positivo" << endl;
+    LOG_ERROR("El tamaño máximo debe ser positivo");
     return false;
   }
 
@@ -685,45 +1675,44 @@ bool compressFolderToSplitZip(const string &folderPath,
   // Tamaño máximo en bytes
   size_t maxSizeBytes = static_cast<size_t>(maxSizeMB) * 1024 * 1024;
 
-  // Recolectar todos los archivos a comprimir (ignorando los que deben
-  // excluirse)
-  set<string> ignorePatterns = readIgnorePatterns(folderPath);
-
-  // Configurar el número de hilos basado en el parámetro useParallel
-  int originalMaxThreads = omp_get_max_threads();
+  // Hilos de cada etapa. Se pasan a cada región paralela en lugar de
+  // cambiar el valor global de OpenMP
+  int compressThreads = useParallel ? compressThreadCount() : 1;
+  int ioThreads = useParallel ? ioThreadCount() : 1;
   if (!useParallel) {
-    omp_set_num_threads(1); // Forzar ejecución serial
-    cout << "Modo serial activado (sin paralelismo)" << endl;
+    LOG_INFO("Modo serial activado (sin paralelismo)");
   } else {
-    cout << "Modo paralelo activado con " << originalMaxThreads << " hilos"
-         << endl;
-
-    // Opcional: Ajustar la política de planificación de OpenMP para mejor
-    // rendimiento
-    omp_set_schedule(omp_sched_dynamic, 0);
+    LOG_INFO("Modo paralelo activado con " << compressThreads
+                                           << " hilos de compresión y "
+                                           << ioThreads << " de E/S");
   }
 
-  // Guardar la ruta de los archivos a comprimir
-  vector<filesystem::path> allFiles = collectFiles(folderPath, ignorePatterns);
+  // Recolectar todos los archivos a comprimir (ignorando los que deben
+  // excluirse según el .ignore de cada carpeta)
+  if (folderPaths.size() > 1) {
+    LOG_INFO("Carpetas de origen: " << folderPaths.size());
+  }
+  SourceFiles sources;
+  if (!collectSources(folderPaths, sources, ioThreads)) {
+    return false;
+  }
+  const vector<filesystem::path> &allFiles = sources.paths;
 
   // Verificar si hay archivos para comprimir
   if (allFiles.empty()) {
-    cerr << "No hay archivos para comprimir" << endl;
-    // Restaurar configuración original de hilos
-    if (!useParallel) {
-      omp_set_num_threads(originalMaxThreads);
-    }
+    LOG_ERROR("No hay archivos para comprimir");
     return false;
   }
 
   if (isEncrypted) {
-    cout << "Modo encriptado activado" << endl;
-    cout << "Hash de verificación: " << crypto.generatePasswordHash(password)
-         << endl;
+    LOG_INFO("Modo encriptado activado");
+    LOG_INFO("Hash de verificación: "
+             << crypto.generatePasswordHash(password));
   }
 
-  cout << "Total de archivos a comprimir: " << allFiles.size()
-       << (useParallel ? " (usando paralelismo)" : " (modo serial)") << endl;
+  LOG_INFO("Total de archivos a comprimir: "
+           << allFiles.size()
+           << (useParallel ? " (usando paralelismo)" : " (modo serial)"));
 
   // Crear la base para los nombres de archivo de salida
   filesystem::path baseOutputPath(zipOutputPath);
@@ -736,81 +1725,97 @@ bool compressFolderToSplitZip(const string &folderPath,
   }
   filesystem::path outputDir = baseOutputPath.parent_path();
 
-  // Asegurarse de que el directorio de salida exista
-  filesystem::create_directories(outputDir);
+  // Asegurarse de que el directorio de salida exista (salvo que las partes
+  // vayan directamente desde memoria al destino)
+  if (!sink.inMemory()) {
+    filesystem::create_directories(outputDir);
+  }
 
   // -------------- PROCESAMIENTO --------------
 
-  bool overallSuccess = true;
-  int part = 0;
-  size_t fileIndex = 0;
-  int totalParts = 0;
+  // Planificar todas las partes antes de empezar: cada una queda definida
+  // por completo y puede construirse sin esperar a las demás
+  vector<PartPlan> plan =
+      planParts(allFiles, sources.zipPaths, maxSizeBytes, password, ioThreads);
+  if (plan.empty()) {
+    return false;
+  }
+  int totalParts = static_cast<int>(plan.size());
+  uint64_t totalEntries = 0;
+  uintmax_t totalBytes = 0;
   int totalFragments = 0;
-
-  // Calcular el número de partes necesarias
-  totalParts = calculateTotalParts(allFiles, maxSizeBytes, maxSizeMB);
-
-  // Procesar todos los archivos
-  while (fileIndex < allFiles.size()) {
-    // Verificar el próximo archivo
-    uintmax_t nextFileSize = filesystem::file_size(allFiles[fileIndex]);
-    string relativePath =
-        filesystem::relative(allFiles[fileIndex], folderPath).string();
-
-    // Si es un archivo grande, procesar con o sin paralelismo según el
-    // parámetro useParallel
-    if (nextFileSize > maxSizeBytes) {
-      if (!useParallel) {
-// Garantizar que las directivas paralelas en processLargeFile no tengan efecto
-#pragma omp parallel num_threads(1)
-        {
-#pragma omp master
-          {
-            if (omp_get_num_threads() > 1) {
-              cerr << "Error: El paralelismo no se desactivó correctamente"
-                   << endl;
-            }
-          }
+  for (const auto &partPlan : plan) {
+    totalEntries += partPlan.entries.size();
+    totalBytes += partPlan.bytes;
+    for (const auto &entry : partPlan.entries) {
+      totalFragments += entry.fragment ? 1 : 0;
+    }
+  }
+  LOG_INFO("Dividiendo en " << totalParts << " partes de hasta " << maxSizeMB
+                            << "MB comprimidos cada una.");
+  progressBegin("Comprimiendo", totalEntries, totalBytes);
+
+  // Cada parte es una tarea OpenMP (lectura, cifrado, .info, cierre y
+  // entrega encadenados sobre su propio ZIP). Los hilos del grupo toman
+  // tareas pendientes en cuanto quedan libres, de modo que las partes
+  // pequeñas y los fragmentos de archivos grandes se solapan sin barreras
+  // intermedias; solo se espera al final de la región. Las tareas se crean
+  // de mayor a menor, pero los números de parte son los del plan.
+  // Si alguna parte no cabe, las entradas que sobran se reparten en una
+  // nueva ronda de partes numeradas a continuación del plan
+  atomic<bool> overallSuccess{true};
+  int extraParts = 0;
+  vector<PartPlan> pending = std::move(plan);
+  while (!pending.empty()) {
+    vector<PlannedEntry> overflow;
+    vector<size_t> order = largestFirstOrder(pending);
+#pragma omp parallel num_threads(compressThreads)
+#pragma omp single
+    for (size_t i : order) {
+#pragma omp task firstprivate(i) shared(pending, overflow, overallSuccess)
+      {
+        // Las partes adicionales se entregan antes de saber cuántas harán
+        // falta, así que ni su nombre ni su .info llevan un total (0)
+        vector<PlannedEntry> spilled;
+        bool extra = pending[i].number > totalParts;
+        string partFileName =
+            baseName + "_part" + to_string(pending[i].number) +
+            (extra ? string("_extra") : "_of_" + to_string(totalParts)) +
+            extension;
+        if (!buildPart(pending[i], extra ? 0 : totalParts,
+                       outputDir / partFileName, password, sink,
+                       maxSizeBytes, &spilled)) {
+          overallSuccess = false;
+        }
+        if (!spilled.empty()) {
+#pragma omp critical(overflow)
+          overflow.insert(overflow.end(), spilled.begin(), spilled.end());
         }
-      } else {
-        // Configuración óptima para archivos grandes cuando se usa paralelismo
-        int chunkSize = 0; // 0 significa que OpenMP decide automáticamente
-        omp_set_schedule(omp_sched_dynamic, chunkSize);
       }
-
-      // Procesar el archivo grande (la función interna respetará la
-      // configuración de hilos)
-      cout << "Procesando archivo grande"
-           << (useParallel ? " con paralelismo..." : " en modo secuencial...")
-           << endl;
-
-      bool result = processLargeFile(allFiles[fileIndex], relativePath,
-                                     folderPath, maxSizeBytes, baseName,
-                                     extension, outputDir, part, totalParts,
-                                     totalFragments, overallSuccess, password);
-      fileIndex++;
-      continue;
     }
 
-    // Si es un archivo normal
-    part++;
-    bool result = processNormalFiles(
-        allFiles, fileIndex, folderPath, maxSizeBytes, baseName, extension,
-        outputDir, part, totalParts, overallSuccess, password);
+    pending = planOverflow(std::move(overflow), maxSizeBytes,
+                           totalParts + extraParts + 1);
+    extraParts += static_cast<int>(pending.size());
   }
-
-  cout << "\nCompresión" << (isEncrypted ? " encriptada" : "")
-       << " completada en " << part << " partes";
-  if (totalFragments > 0) {
-    cout << " (incluyendo " << totalFragments
-         << " fragmentos de archivos grandes)";
+  if (extraParts > 0) {
+    LOG_INFO("La estimación de compresión se quedó corta: "
+             << extraParts << " partes adicionales a continuación del plan");
   }
-  cout << "." << endl;
 
-  // Restaurar configuración original de hilos al finalizar
-  if (!useParallel) {
-    omp_set_num_threads(originalMaxThreads);
+  progressEnd();
+  if (!overallSuccess) {
+    LOG_ERROR("Error al construir una o más partes");
   }
+  LOG_INFO("Compresión" << (isEncrypted ? " encriptada" : "")
+                        << " completada en " << totalParts + extraParts
+                        << " partes"
+                        << (totalFragments > 0
+                                ? " (incluyendo " + to_string(totalFragments) +
+                                      " fragmentos de archivos grandes)"
+                                : "")
+                        << ".");
+  logFlush();
 
   return overallSuccess;
-}
\ No newline at end of file
+}
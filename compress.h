@@ -2,6 +2,7 @@
 #define COMPRESS_H
 
 #include <filesystem>
+#include <functional>
 #include <set>
 #include <string>
 #include <vector>
@@ -9,6 +10,56 @@
 
 using namespace std;
 
+/**
+ * Función que se invoca con la ruta de cada parte ZIP en cuanto zip_close
+ * termina con éxito. Puede llamarse desde varios hilos a la vez.
+ */
+using PartReadyCallback = function<void(const filesystem::path &)>;
+
+/**
+ * Función que recibe una parte ZIP construida en memoria: el nombre que
+ * tendría el archivo y su contenido completo. Puede llamarse desde varios
+ * hilos a la vez y puede bloquear para limitar las partes en vuelo.
+ */
+using PartBufferCallback =
+    function<void(const string &partName, vector<char> &&data)>;
+
+/**
+ * Destino de las partes terminadas. Si onPartBuffer está definido las partes
+ * se construyen en memoria y nunca se escriben en el directorio de salida;
+ * si no, se escriben en disco y se notifica onPartReady (si existe).
+ */
+struct PartSink {
+  PartReadyCallback onPartReady = nullptr;
+  PartBufferCallback onPartBuffer = nullptr;
+
+  bool inMemory() const { return static_cast<bool>(onPartBuffer); }
+};
+
+/**
+ * Fija el nivel de deflate de las entradas de las partes: de 1 (rápido) a 9
+ * (máxima compresión), 0 para guardarlas sin comprimir o -1 para usar el
+ * predeterminado de libzip.
+ *
+ * @param level Nivel a usar a partir de ahora
+ */
+void setCompressionLevel(int level);
+
+// Nivel de deflate configurado (-1 = predeterminado de libzip)
+int compressionLevel();
+
+/**
+ * Activa el modo sólido: los archivos pequeños de cada parte se concatenan
+ * en bloques de unos pocos MB que se comprimen y cifran como una sola
+ * entrada, con la posición de cada archivo en el .info.
+ *
+ * @param enabled true para empaquetar los archivos pequeños en bloques
+ */
+void setSolidBlocks(bool enabled);
+
+// Si el modo sólido está activo
+bool solidBlocks();
+
 /**
  * Verifica si un archivo debe ser ignorado según los patrones de exclusión.
  *
@@ -32,10 +83,33 @@ set<string> readIgnorePatterns(const string &folderPath);
  *
  * @param folderPath Ruta del directorio a analizar
  * @param ignorePatterns Conjunto de patrones para ignorar
+ * @param numThreads Hilos para filtrar (0 = grupo de E/S configurado)
  * @return Vector con las rutas de todos los archivos a comprimir
  */
 vector<filesystem::path> collectFiles(const string &folderPath,
-                                      const set<string> &ignorePatterns);
+                                      const set<string> &ignorePatterns,
+                                      int numThreads = 0);
+
+// Archivos de todas las carpetas de origen de un trabajo, ordenados por su
+// nombre dentro del ZIP
+struct SourceFiles {
+  vector<filesystem::path> paths; // Ruta de cada archivo en disco
+  vector<string> zipPaths;        // Nombre de cada archivo dentro del ZIP
+};
+
+/**
+ * Recorre varias carpetas de origen en paralelo, cada una con su propio
+ * .ignore. Con una sola carpeta los nombres dentro del ZIP son relativos a
+ * ella; con varias, llevan delante el nombre de su carpeta (con _2, _3...
+ * si dos carpetas se llaman igual) para que no se mezclen al restaurar.
+ *
+ * @param folderPaths Carpetas a respaldar
+ * @param files Archivos encontrados
+ * @param numThreads Hilos de recorrido (0 = grupo de E/S configurado)
+ * @return false si alguna carpeta no existe
+ */
+bool collectSources(const vector<string> &folderPaths, SourceFiles &files,
+                    int numThreads = 0);
 
 /**
  * Función mejorada para añadir un buffer de memoria a un ZIP con opción de
@@ -115,66 +189,76 @@ bool addEncryptedFileToZip(zip_t *archive, const string &filePath,
                            const string &zipPath, const string &password = "");
 
 /**
- * Función para calcular el número de partes necesarias según el tamaño de los
- * archivos
+ * Entrada de una parte planificada: un archivo completo o un fragmento de
+ * un archivo grande.
+ */
+struct PlannedEntry {
+  filesystem::path source; // Archivo de origen
+  string zipPath;          // Nombre dentro del ZIP
+  uintmax_t offset = 0;    // Primer byte a leer
+  uintmax_t length = 0;    // Bytes a leer
+  uintmax_t estimated = 0; // Bytes estimados dentro del ZIP, con cabeceras
+  bool fragment = false;   // true si es un fragmento de un archivo grande
+  uintmax_t sparseSize = 0; // Tamaño del archivo disperso (0 si no lo es)
+};
+
+// Contenido y número de una parte ZIP, decidido antes de comprimir
+struct PartPlan {
+  int number = 0;
+  vector<PlannedEntry> entries;
+  uintmax_t bytes = 0;     // Bytes originales
+  uintmax_t estimated = 0; // Bytes estimados dentro del ZIP
+};
+
+/**
+ * Reparte los archivos en partes antes de comprimir nada, según lo que
+ * ocuparán dentro del ZIP. El tamaño comprimido de cada archivo se estima
+ * con deflate rápido sobre sus primeros bytes. Los archivos que ni sin
+ * comprimirse caben solos en una parte se dividen en fragmentos que llenan
+ * una parte cada uno (de los dispersos, solo sus rangos con datos); el
+ * último fragmento de cada rango, más corto, queda con los archivos
+ * normales. Estos se empaquetan de mayor a menor estimación, cada uno en la
+ * parte con menos hueco en la que cabe (best fit decreasing), y las partes
+ * se numeran por el orden de sus archivos. En modo sólido (-S) los archivos
+ * pequeños cuentan lo que ocupan dentro de un bloque sólido, su línea del
+ * .info y su parte de las cabeceras del bloque, en lugar de una entrada
+ * propia; los bloques se forman al construir cada parte.
  *
  * @param allFiles Vector con las rutas de todos los archivos a comprimir
- * @param maxSizeBytes Tamaño máximo de cada parte en bytes
- * @param maxSizeMB Tamaño máximo de cada parte en MB (para mensajes)
- * @return Número estimado de partes necesarias
- */
-int calculateTotalParts(const vector<filesystem::path> &allFiles,
-                        size_t maxSizeBytes, int maxSizeMB);
-
-/**
- * Procesa un único archivo grande dividiéndolo en múltiples archivos ZIP
- *
- * @param filePath Ruta del archivo a fragmentar
- * @param relativePath Ruta relativa del archivo respecto al directorio base
- * @param folderPath Ruta del directorio base
- * @param maxSizeBytes Tamaño máximo de cada fragmento en bytes
- * @param baseName Nombre base para los archivos ZIP de salida
- * @param extension Extensión para los archivos ZIP de salida
- * @param outputDir Directorio de salida para los archivos ZIP
- * @param part Referencia al contador de partes actual (se incrementa por cada
- * parte creada)
- * @param totalParts Referencia al número total de partes (puede actualizarse)
- * @param totalFragments Referencia al contador de fragmentos total
- * @param overallSuccess Referencia a variable de éxito global
- * @param password Contraseña para encriptación (opcional)
- * @return true si la operación tuvo éxito, false en caso contrario
+ * @param zipPaths Nombre de cada archivo dentro del ZIP
+ * @param maxSizeBytes Tamaño máximo de cada parte ZIP en bytes
+ * @param password Contraseña de cifrado (la estimación se hace sobre los
+ * datos cifrados)
+ * @param numThreads Hilos para estimar (0 = grupo de E/S configurado)
+ * @return Partes numeradas desde 1 (vacío si el tamaño de parte no alcanza)
  */
-bool processLargeFile(const filesystem::path &filePath,
-                      const string &relativePath, const string &folderPath,
-                      size_t maxSizeBytes, const string &baseName,
-                      const string &extension,
-                      const filesystem::path &outputDir, int &part,
-                      int &totalParts, int &totalFragments,
-                      bool &overallSuccess, const string &password = "");
+vector<PartPlan> planParts(const vector<filesystem::path> &allFiles,
+                           const vector<string> &zipPaths, size_t maxSizeBytes,
+                           const string &password = "", int numThreads = 0);
 
 /**
- * Procesa archivos normales agregándolos a un único archivo ZIP
+ * Construye una parte planificada: lee cada entrada, la cifra si hay
+ * contraseña, la añade al ZIP junto con el .info y entrega la parte cerrada
+ * al destino. Es independiente del resto de partes, por lo que puede
+ * ejecutarse como tarea en cualquier hilo.
  *
- * @param allFiles Vector con las rutas de todos los archivos a comprimir
- * @param fileIndex Referencia al índice actual en el vector de archivos (se
- * incrementa)
- * @param folderPath Ruta del directorio base
- * @param maxSizeBytes Tamaño máximo del archivo ZIP en bytes
- * @param baseName Nombre base para el archivo ZIP de salida
- * @param extension Extensión para el archivo ZIP de salida
- * @param outputDir Directorio de salida para el archivo ZIP
- * @param part Número de parte actual
- * @param totalParts Número total de partes
- * @param overallSuccess Referencia a variable de éxito global
+ * Si la parte terminada supera maxSizeBytes (la estimación se quedó corta),
+ * no se entrega: se vuelve a construir con las entradas que caben según el
+ * tamaño real y el resto se devuelve en overflow.
+ *
+ * @param plan Parte a construir
+ * @param totalParts Número total de partes del plan
+ * @param partPath Ruta del archivo ZIP de la parte
  * @param password Contraseña para encriptación (opcional)
+ * @param sink Destino de la parte cerrada (por defecto solo en disco)
+ * @param maxSizeBytes Tamaño máximo de la parte ZIP en bytes
+ * @param overflow Entradas que no cupieron (nulo = no comprobar el tamaño)
  * @return true si la operación tuvo éxito, false en caso contrario
  */
-bool processNormalFiles(vector<filesystem::path> &allFiles, size_t &fileIndex,
-                        const string &folderPath, size_t maxSizeBytes,
-                        const string &baseName, const string &extension,
-                        const filesystem::path &outputDir, int part,
-                        int totalParts, bool &overallSuccess,
-                        const string &password = "");
+bool buildPart(const PartPlan &plan, int totalParts,
+               const filesystem::path &partPath, const string &password = "",
+               const PartSink &sink = PartSink(), size_t maxSizeBytes = 0,
+               vector<PlannedEntry> *overflow = nullptr);
 
 /**
  * Comprime un directorio completo en múltiples archivos ZIP.
@@ -183,14 +267,37 @@ bool processNormalFiles(vector<filesystem::path> &allFiles, size_t &fileIndex,
  * @param zipOutputPath Ruta base para los archivos ZIP de salida
  * @param maxSizeMB Tamaño máximo de cada archivo ZIP en MB
  * @param password Contraseña para encriptación (opcional)
+ * @param useParallel Si es true, usa los grupos de hilos de threadConfig();
+ * si no, todo se hace en un solo hilo
+ * @param sink Destino de cada parte terminada, p. ej. para subirla mientras
+ * la compresión continúa o enviarla desde memoria (opcional)
  * @return true si la compresión tuvo éxito, false en caso contrario
  */
 bool compressFolderToSplitZip(const string &folderPath,
                               const string &zipOutputPath, int maxSizeMB,
                               const string &password = "",
-                              bool useParallel = false);
+                              bool useParallel = false,
+                              const PartSink &sink = PartSink());
+
+/**
+ * Comprime varias carpetas en una sola secuencia de partes ZIP: se recorren
+ * en paralelo y sus archivos se planifican juntos, así no queda una parte
+ * final a medio llenar por carpeta.
+ *
+ * @param folderPaths Carpetas a comprimir (ver collectSources)
+ * @param zipOutputPath Ruta base para los archivos ZIP de salida
+ * @param maxSizeMB Tamaño máximo de cada archivo ZIP en MB
+ * @param password Contraseña para encriptación (opcional)
+ * @param useParallel Si es true, usa los grupos de hilos de threadConfig();
+ * si no, todo se hace en un solo hilo
+ * @param sink Destino de cada parte terminada (opcional)
+ * @return true si la compresión tuvo éxito, false en caso contrario
+ */
+bool compressFoldersToSplitZip(const vector<string> &folderPaths,
+                               const string &zipOutputPath, int maxSizeMB,
+                               const string &password = "",
+                               bool useParallel = false,
+                               const PartSink &sink = PartSink());
 
 set<string> readIgnorePatterns(const string &folderPath);
-vector<filesystem::path> collectFiles(const string &folderPath,
-                                      const set<string> &ignorePatterns);
 #endif // COMPRESS_H
\ No newline at end of file
@@ -0,0 +1,121 @@
+#include "content_hash.h"
+#include "thread_config.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <openssl/evp.h>
+#include <sstream>
+#include <vector>
+
+using namespace std;
+
+static const size_t DROPBOX_BLOCK_SIZE = 4 * 1024 * 1024;
+
+// Bloques que se leen y resumen juntos al procesar un archivo
+static const size_t BLOCKS_PER_BATCH = 16;
+
+static string toHex(const unsigned char *data, size_t len) {
+  stringstream ss;
+  for (size_t i = 0; i < len; i++) {
+    ss << hex << setw(2) << setfill('0') << static_cast<int>(data[i]);
+  }
+  return ss.str();
+}
+
+// Acumula los resúmenes de cada bloque y produce el hash final
+class BlockHasher {
+private:
+  ContentHashKind kind;
+  size_t blockSize;
+  uint64_t totalSize;
+  const EVP_MD *md;
+  string digests; // Resúmenes binarios concatenados, en orden
+  size_t blockCount = 0;
+
+public:
+  BlockHasher(ContentHashKind kind, uint64_t totalSize, size_t partSize)
+      : kind(kind), totalSize(totalSize) {
+    md = kind == ContentHashKind::DROPBOX ? EVP_sha256() : EVP_md5();
+    blockSize = kind == ContentHashKind::DROPBOX ? DROPBOX_BLOCK_SIZE
+                                                 : max<size_t>(1, partSize);
+  }
+
+  size_t getBlockSize() const { return blockSize; }
+
+  // Resume en paralelo los bloques consecutivos contenidos en data
+  void addBlocks(const char *data, size_t size) {
+    size_t count = (size + blockSize - 1) / blockSize;
+    size_t digestLen = EVP_MD_size(md);
+    string batch(count * digestLen, '\0');
+
+#pragma omp parallel for schedule(static) num_threads(compressThreadCount())
+    for (long i = 0; i < static_cast<long>(count); i++) {
+      size_t offset = i * blockSize;
+      size_t len = min(blockSize, size - offset);
+      unsigned int outLen = 0;
+      EVP_Digest(data + offset, len,
+                 reinterpret_cast<unsigned char *>(&batch[i * digestLen]),
+                 &outLen, md, nullptr);
+    }
+
+    digests += batch;
+    blockCount += count;
+  }
+
+  string finish() {
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digestLen = 0;
+
+    if (kind == ContentHashKind::S3_ETAG && totalSize <= blockSize) {
+      // Objeto subido con un único PUT: el ETag es el MD5 del contenido,
+      // que coincide con el resumen del único bloque
+      if (blockCount == 1) {
+        return toHex(reinterpret_cast<const unsigned char *>(digests.data()),
+                     digests.size());
+      }
+      EVP_Digest("", 0, digest, &digestLen, md, nullptr);
+      return toHex(digest, digestLen);
+    }
+
+    EVP_Digest(digests.data(), digests.size(), digest, &digestLen, md,
+               nullptr);
+    string result = toHex(digest, digestLen);
+    if (kind == ContentHashKind::S3_ETAG) {
+      result += "-" + to_string(blockCount);
+    }
+    return result;
+  }
+};
+
+string computeContentHash(ContentHashKind kind, const char *data, size_t size,
+                          size_t partSize) {
+  BlockHasher hasher(kind, size, partSize);
+  hasher.addBlocks(data, size);
+  return hasher.finish();
+}
+
+string computeFileContentHash(ContentHashKind kind, const string &path,
+                              size_t partSize) {
+  ifstream file(path, ios::binary | ios::ate);
+  if (!file.is_open()) {
+    return "";
+  }
+  uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+  file.seekg(0, ios::beg);
+
+  BlockHasher hasher(kind, fileSize, partSize);
+  size_t batchSize = hasher.getBlockSize() * BLOCKS_PER_BATCH;
+  vector<char> buffer(static_cast<size_t>(min<uint64_t>(batchSize, fileSize)));
+
+  uint64_t remaining = fileSize;
+  while (remaining > 0) {
+    size_t len = static_cast<size_t>(min<uint64_t>(batchSize, remaining));
+    if (!file.read(buffer.data(), len)) {
+      return "";
+    }
+    hasher.addBlocks(buffer.data(), len);
+    remaining -= len;
+  }
+
+  return hasher.finish();
+}
@@ -0,0 +1,39 @@
+#ifndef CONTENT_HASH_H
+#define CONTENT_HASH_H
+
+#include <cstddef>
+#include <string>
+
+// Esquemas de hash de contenido que reportan los proveedores al listar
+enum class ContentHashKind {
+  // Dropbox content_hash: SHA-256 de la concatenación de los SHA-256 de
+  // cada bloque de 4 MB
+  DROPBOX,
+  // ETag de S3: MD5 del objeto, o MD5 de los MD5 de cada parte más "-N"
+  // si se subió por partes
+  S3_ETAG
+};
+
+/**
+ * Calcula el hash de contenido de un buffer. Los bloques se resumen en
+ * paralelo y luego se combinan.
+ *
+ * @param kind Esquema de hash del proveedor
+ * @param data Datos a resumir
+ * @param size Tamaño en bytes
+ * @param partSize Tamaño de parte usado en subidas por partes (S3)
+ * @return Hash en hexadecimal
+ */
+std::string computeContentHash(ContentHashKind kind, const char *data,
+                               size_t size, size_t partSize);
+
+/**
+ * Calcula el hash de contenido de un archivo leyéndolo por lotes de bloques,
+ * de modo que la memoria no depende del tamaño del archivo.
+ *
+ * @return Hash en hexadecimal, o cadena vacía si no se pudo leer
+ */
+std::string computeFileContentHash(ContentHashKind kind,
+                                   const std::string &path, size_t partSize);
+
+#endif // CONTENT_HASH_H
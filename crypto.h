@@ -1,6 +1,7 @@
 #ifndef CRYPTO_H
 #define CRYPTO_H
 
+#include <cstdint>
 #include <cstring>
 #include <iomanip>
 #include <sstream>
@@ -56,6 +57,21 @@ public:
     return encrypt(encryptedData, dataLength, password);
   }
 
+  // Encriptar o desencriptar en el sitio un trozo que empieza en el byte
+  // position del contenido: el resultado es el mismo que con encrypt sobre
+  // el contenido completo, sin tenerlo entero en memoria
+  void transformAt(unsigned char *data, size_t dataLength,
+                   const std::string &password, uint64_t position) {
+    const std::string key =
+        password.empty() ? std::string("DefaultBackupKey2024!") : password;
+    for (size_t k = 0; k < dataLength; ++k) {
+      uint64_t i = position + k;
+      unsigned char modifier =
+          password.empty() ? 0 : (i / key.length()) & 0xFF;
+      data[k] ^= key[i % key.length()] ^ modifier ^ (i & 0xFF);
+    }
+  }
+
   // Encriptar string
   std::string encryptString(const std::string &plaintext,
                             const std::string &password = "") {
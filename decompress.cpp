@@ -1,6 +1,12 @@
 #include "decompress.h"
 #include "crypto.h"
+#include "instrumentation.h"
+#include "logger.h"
+#include "low_impact.h"
+#include "page_cache.h"
+#include "thread_config.h"
 #include <algorithm>
+#include <atomic>
 #include <cstring>
 #include <filesystem>
 #include <fstream>
@@ -11,6 +17,7 @@
 #include <set>
 #include <sstream>
 #include <string>
+#include <unistd.h>
 #include <vector>
 #include <zip.h>
 
@@ -38,7 +45,7 @@ PartInfo parseInfoFile(const string &infoContent) {
     try {
       info.totalParts = stoi(line);
     } catch (...) {
-      cerr << "Error al parsear el número total de partes: " << line << endl;
+      LOG_ERROR("Error al parsear el número total de partes: " << line);
       info.totalParts = 0;
     }
   }
@@ -48,7 +55,7 @@ PartInfo parseInfoFile(const string &infoContent) {
     try {
       info.partNumber = stoi(line);
     } catch (...) {
-      cerr << "Error al parsear el número de parte: " << line << endl;
+      LOG_ERROR("Error al parsear el número de parte: " << line);
       info.partNumber = 0;
     }
   }
@@ -73,8 +80,29 @@ PartInfo parseInfoFile(const string &infoContent) {
         info.encryptionHash.erase(
             info.encryptionHash.find_last_not_of(" \t\r\n") + 1);
 
-      cout << "Archivo encriptado detectado (hash: '" << info.encryptionHash
-           << "')" << endl;
+      LOG_DEBUG("Archivo encriptado detectado (hash: '"
+                << info.encryptionHash << "')");
+    } else if (line.find("sparse:") == 0) {
+      // Fragmento de un archivo disperso: posición y tamaño total
+      istringstream fields(line.substr(7));
+      uint64_t offset = 0;
+      uint64_t fileSize = 0;
+      string zipPath;
+      if (fields >> offset >> fileSize && getline(fields >> ws, zipPath) &&
+          !zipPath.empty()) {
+        info.sparseFragments[zipPath] = make_pair(offset, fileSize);
+      }
+    } else if (line.find("solid:") == 0) {
+      // Archivo dentro de un bloque sólido: bloque, posición y longitud
+      istringstream fields(line.substr(6));
+      string block;
+      uint64_t offset = 0;
+      uint64_t length = 0;
+      string zipPath;
+      if (fields >> block >> offset >> length &&
+          getline(fields >> ws, zipPath) && !zipPath.empty()) {
+        info.solidBlocks[block].emplace_back(zipPath, offset, length);
+      }
     } else {
       // Procesar como mapeo de archivos
       size_t pos = line.find(" | ");
@@ -144,6 +172,64 @@ PartInfo parseInfoFile(const string &infoContent) {
   return info;
 }
 
+// Bytes que se descomprimen, descifran y escriben de cada vez al extraer
+// una entrada: así una entrada de varios GB (ZIP64) no se carga entera en
+// memoria
+static const size_t COPY_CHUNK_BYTES = 4 * 1024 * 1024;
+
+// Copia una entrada ya abierta en outFile a partir de su posición actual,
+// que es writeOffset, descifrándola por trozos si hay contraseña. Cada
+// trozo se manda a disco nada más escribirse y el anterior, ya escrito, se
+// descarta de la caché. Devuelve en copied los bytes escritos
+static bool copyEntryToFile(zip_file_t *zf, const zip_stat_t &stat,
+                            FILE *outFile, uint64_t writeOffset,
+                            const string &password, uint64_t &copied) {
+  vector<unsigned char> buffer(
+      static_cast<size_t>(min<uint64_t>(stat.size, COPY_CHUNK_BYTES)));
+  int fd = fileno(outFile);
+  uint64_t previousLength = 0;
+  copied = 0;
+  throttleDisk(stat.comp_size);
+  while (copied < stat.size) {
+    size_t chunk =
+        static_cast<size_t>(min<uint64_t>(buffer.size(), stat.size - copied));
+    zip_int64_t bytesRead;
+    {
+      ScopedStage timer(Stage::INFLATE, chunk);
+      bytesRead = zip_fread(zf, buffer.data(), chunk);
+    }
+    if (bytesRead != static_cast<zip_int64_t>(chunk)) {
+      LOG_ERROR("Error al leer la entrada completa ("
+                << copied + max<zip_int64_t>(bytesRead, 0) << " de "
+                << stat.size << " bytes)");
+      return false;
+    }
+
+    if (!password.empty()) {
+      ScopedStage timer(Stage::DECRYPT, chunk);
+      crypto.transformAt(buffer.data(), chunk, password, copied);
+    }
+
+    throttleDisk(chunk);
+    {
+      ScopedStage timer(Stage::WRITE, chunk);
+      if (fwrite(buffer.data(), 1, chunk, outFile) != chunk ||
+          fflush(outFile) != 0) {
+        return false;
+      }
+      uint64_t offset = writeOffset + copied;
+      startWriteback(fd, offset, chunk);
+      if (previousLength > 0) {
+        dropWrittenCache(fd, offset - previousLength, previousLength);
+      }
+      previousLength = chunk;
+    }
+    copied += chunk;
+    progressAdvance(0, chunk);
+  }
+  return true;
+}
+
 // Función modificada para extraer un archivo encriptado de un ZIP
 bool extractFileFromZipWithDecryption(zip_t *archive, const string &zipPath,
                                       const string &outputPath,
@@ -151,61 +237,121 @@ bool extractFileFromZipWithDecryption(zip_t *archive, const string &zipPath,
   // Encontrar el archivo en el ZIP
   zip_int64_t index = zip_name_locate(archive, zipPath.c_str(), 0);
   if (index < 0) {
-    cerr << "No se encuentra el archivo " << zipPath << " en el ZIP" << endl;
+    LOG_ERROR("No se encuentra el archivo " << zipPath << " en el ZIP");
     return false;
   }
 
   // Abrir el archivo dentro del ZIP
   zip_file_t *zf = zip_fopen_index(archive, index, 0);
   if (!zf) {
-    cerr << "No se puede abrir el archivo " << zipPath << " dentro del ZIP"
-         << endl;
+    LOG_ERROR("No se puede abrir el archivo " << zipPath << " dentro del ZIP");
     return false;
   }
 
   // Obtener información del archivo
   zip_stat_t stat;
   if (zip_stat_index(archive, index, 0, &stat) < 0) {
-    cerr << "No se puede obtener información del archivo " << zipPath << endl;
+    LOG_ERROR("No se puede obtener información del archivo " << zipPath);
     zip_fclose(zf);
     return false;
   }
 
-  // Leer todo el contenido en memoria
-  vector<unsigned char> buffer(stat.size);
-  zip_int64_t bytesRead = zip_fread(zf, buffer.data(), stat.size);
-  zip_fclose(zf);
-
-  if (bytesRead < 0 || bytesRead != static_cast<zip_int64_t>(stat.size)) {
-    cerr << "Error al leer el archivo completo " << zipPath << endl;
-    return false;
-  }
-
-  // Decrypt if password is provided
-  if (!password.empty()) {
-    auto decrypted = crypto.decrypt(buffer.data(), buffer.size(), password);
-    buffer = decrypted;
-  }
-
   // Crear directorio destino si no existe
   filesystem::path outputFile(outputPath);
   filesystem::create_directories(outputFile.parent_path());
 
   // Escribir archivo destino
-  ofstream outFile(outputPath, ios::binary);
+  FILE *outFile = fopen(outputPath.c_str(), "wb");
   if (!outFile) {
-    cerr << "No se puede crear el archivo destino " << outputPath << endl;
+    LOG_ERROR("No se puede crear el archivo destino " << outputPath);
+    zip_fclose(zf);
     return false;
   }
 
-  outFile.write(reinterpret_cast<const char *>(buffer.data()), buffer.size());
-  outFile.close();
+  uint64_t copied = 0;
+  bool copyOk = copyEntryToFile(zf, stat, outFile, 0, password, copied);
+  zip_fclose(zf);
+  bool writeOk = fclose(outFile) == 0 && copyOk;
+  if (!writeOk) {
+    LOG_ERROR("Error al extraer " << zipPath << " en " << outputPath);
+    return false;
+  }
 
-  cout << "    Extraído" << (password.empty() ? "" : " (desencriptado)") << ": "
-       << outputPath << " (" << buffer.size() << " bytes)" << endl;
+  progressAdvance(1, 0);
+  LOG_DEBUG("    Extraído" << (password.empty() ? "" : " (desencriptado)")
+                           << ": " << outputPath << " (" << copied
+                           << " bytes)");
   return true;
 }
 
+// Extrae los archivos de un bloque sólido: el bloque se descomprime y
+// descifra entero (unos pocos MB) y cada archivo se escribe desde su
+// posición
+static bool extractSolidBlock(
+    zip_t *archive, const string &blockName,
+    const vector<tuple<string, uint64_t, uint64_t>> &members,
+    const string &outputPath, const string &password) {
+  zip_int64_t index = zip_name_locate(archive, blockName.c_str(), 0);
+  zip_stat_t stat;
+  if (index < 0 || zip_stat_index(archive, index, 0, &stat) < 0) {
+    LOG_ERROR("No se encuentra el bloque " << blockName << " en el ZIP");
+    return false;
+  }
+  zip_file_t *zf = zip_fopen_index(archive, index, 0);
+  if (!zf) {
+    LOG_ERROR("No se puede abrir el bloque " << blockName);
+    return false;
+  }
+
+  vector<unsigned char> data(stat.size);
+  throttleDisk(stat.comp_size);
+  zip_int64_t bytesRead;
+  {
+    ScopedStage timer(Stage::INFLATE, data.size());
+    bytesRead = zip_fread(zf, data.data(), data.size());
+  }
+  zip_fclose(zf);
+  if (bytesRead != static_cast<zip_int64_t>(data.size())) {
+    LOG_ERROR("Error al leer el bloque " << blockName);
+    return false;
+  }
+  if (!password.empty()) {
+    ScopedStage timer(Stage::DECRYPT, data.size());
+    crypto.transformAt(data.data(), data.size(), password, 0);
+  }
+
+  bool success = true;
+  for (const auto &[zipPath, offset, length] : members) {
+    if (offset + length > data.size()) {
+      LOG_ERROR("  " << zipPath << " queda fuera del bloque " << blockName);
+      success = false;
+      continue;
+    }
+    filesystem::path destPath = filesystem::path(outputPath) / zipPath;
+    filesystem::create_directories(destPath.parent_path());
+    throttleDisk(length);
+    ScopedStage timer(Stage::WRITE, length);
+    FILE *outFile = fopen(destPath.string().c_str(), "wb");
+    bool written = outFile && fwrite(data.data() + offset, 1, length,
+                                     outFile) == length;
+    if (outFile) {
+      written = fflush(outFile) == 0 && written;
+      startWriteback(fileno(outFile), 0, length);
+      written = fclose(outFile) == 0 && written;
+    }
+    if (!written) {
+      LOG_ERROR("  Error al extraer " << zipPath << " en " << destPath);
+      success = false;
+      continue;
+    }
+    progressAdvance(1, length);
+    LOG_DEBUG("    Extraído" << (password.empty() ? "" : " (desencriptado)")
+                             << ": " << destPath << " (" << length
+                             << " bytes, bloque " << blockName << ")");
+  }
+  return success;
+}
+
 // Extrae un archivo específico de un ZIP a la ruta destino
 bool extractFileFromZip(zip_t *archive, const string &zipPath,
                         const string &outputPath) {
@@ -225,7 +371,11 @@ string readTextFileFromZipWithDecryption(zip_t *archive, const string &zipPath,
         zip_stat_t stat;
         if (zip_stat_index(archive, index, 0, &stat) >= 0) {
           vector<unsigned char> buffer(stat.size);
-          zip_int64_t bytesRead = zip_fread(zf, buffer.data(), stat.size);
+          zip_int64_t bytesRead;
+          {
+            ScopedStage timer(Stage::INFLATE, stat.size);
+            bytesRead = zip_fread(zf, buffer.data(), stat.size);
+          }
           zip_fclose(zf);
           if (bytesRead > 0) {
             string content(buffer.begin(), buffer.begin() + bytesRead);
@@ -254,35 +404,39 @@ string readTextFileFromZipWithDecryption(zip_t *archive, const string &zipPath,
   // proceso normal
   zip_int64_t index = zip_name_locate(archive, zipPath.c_str(), 0);
   if (index < 0) {
-    cerr << "No se encuentra el archivo " << zipPath << " en el ZIP" << endl;
+    LOG_ERROR("No se encuentra el archivo " << zipPath << " en el ZIP");
     return "";
   }
 
   zip_file_t *zf = zip_fopen_index(archive, index, 0);
   if (!zf) {
-    cerr << "No se puede abrir el archivo " << zipPath << " dentro del ZIP"
-         << endl;
+    LOG_ERROR("No se puede abrir el archivo " << zipPath << " dentro del ZIP");
     return "";
   }
 
   zip_stat_t stat;
   if (zip_stat_index(archive, index, 0, &stat) < 0) {
-    cerr << "No se puede obtener información del archivo " << zipPath << endl;
+    LOG_ERROR("No se puede obtener información del archivo " << zipPath);
     zip_fclose(zf);
     return "";
   }
 
   vector<unsigned char> buffer(stat.size);
-  zip_int64_t bytesRead = zip_fread(zf, buffer.data(), stat.size);
+  zip_int64_t bytesRead;
+  {
+    ScopedStage timer(Stage::INFLATE, stat.size);
+    bytesRead = zip_fread(zf, buffer.data(), stat.size);
+  }
   zip_fclose(zf);
 
   if (bytesRead < 0) {
-    cerr << "Error al leer el archivo " << zipPath << endl;
+    LOG_ERROR("Error al leer el archivo " << zipPath);
     return "";
   }
 
   // Decrypt if password is provided
   if (!password.empty()) {
+    ScopedStage timer(Stage::DECRYPT, bytesRead);
     auto decrypted = crypto.decrypt(buffer.data(), bytesRead, password);
     return string(decrypted.begin(), decrypted.end());
   }
@@ -308,16 +462,15 @@ bool decompressPartsWithPassword(const string &folderPath,
   }
 
   if (zipFiles.empty()) {
-    cerr << "No se encontraron archivos ZIP en " << folderPath << endl;
+    LOG_ERROR("No se encontraron archivos ZIP en " << folderPath);
     return false;
   }
 
-  cout << "Se encontraron " << zipFiles.size()
-       << " archivos ZIP para descomprimir" << endl;
+  LOG_INFO("Se encontraron " << zipFiles.size()
+                             << " archivos ZIP para descomprimir");
   if (!password.empty()) {
-    cout << "Modo desencriptado activado" << endl;
-    cout << "Hash de verificación: " << crypto.generatePasswordHash(password)
-         << endl;
+    LOG_INFO("Modo desencriptado activado");
+    LOG_INFO("Hash de verificación: " << crypto.generatePasswordHash(password));
   }
 
   // Mantener una lista de todos los archivos ZIP abiertos para buscar
@@ -325,23 +478,29 @@ bool decompressPartsWithPassword(const string &folderPath,
   vector<pair<string, zip_t *>> allArchives;
   mutex archivesMutex; // Para proteger allArchives
   map<string, vector<tuple<string, string, int, int>>> allFragments;
+  map<string, pair<uint64_t, uint64_t>> sparseFragments;
   mutex fragmentsMutex; // Para proteger allFragments
 
   // Primera pasada: recopilar información de todos los fragmentos
-  bool encryptionDetected = false;
-  string detectedHash = "";
+  size_t normalFiles = 0; // Archivos completos, para la línea de progreso
+  // Un return no puede salir de una región paralela: los errores de
+  // contraseña se marcan aquí y se atienden al terminar el bucle
+  atomic<bool> authFailed{false};
 
-  // Modificar el bucle para procesar en paralelo
-#pragma omp parallel for
+  // Apertura e índice de las partes con el grupo de hilos de E/S
+#pragma omp parallel for schedule(dynamic) num_threads(ioThreadCount())
   for (size_t i = 0; i < zipFiles.size(); i++) {
     const auto &zipFile = zipFiles[i];
     int err = 0;
-    zip_t *archive = zip_open(zipFile.string().c_str(), 0, &err);
+    zip_t *archive;
+    {
+      ScopedStage timer(Stage::ZIP_OPEN);
+      archive = zip_open(zipFile.string().c_str(), 0, &err);
+    }
     if (!archive) {
       char errStr[128];
       zip_error_to_str(errStr, sizeof(errStr), err, errno);
-#pragma omp critical
-      { cerr << "Error al abrir ZIP " << zipFile << ": " << errStr << endl; }
+      LOG_ERROR("Error al abrir ZIP " << zipFile << ": " << errStr);
       continue;
     }
 
@@ -361,7 +520,7 @@ bool decompressPartsWithPassword(const string &folderPath,
     }
 
     if (infoFileName.empty()) {
-      cerr << "No se encontró archivo .info en " << zipFile << endl;
+      LOG_ERROR("No se encontró archivo .info en " << zipFile);
       continue;
     }
 
@@ -374,7 +533,7 @@ bool decompressPartsWithPassword(const string &folderPath,
     }
 
     if (infoContent.empty()) {
-      cerr << "No se pudo leer el archivo .info en " << zipFile << endl;
+      LOG_ERROR("No se pudo leer el archivo .info en " << zipFile);
       continue;
     }
 
@@ -382,78 +541,77 @@ bool decompressPartsWithPassword(const string &folderPath,
 
     // Check for encryption and verify password if provided
     if (!info.encryptionHash.empty()) {
-      encryptionDetected = true;
-      detectedHash = info.encryptionHash;
-      cout << "Detectado archivo encriptado con hash: " << info.encryptionHash
-           << endl;
+      LOG_DEBUG("Detectado archivo encriptado con hash: "
+                << info.encryptionHash);
 
       if (!password.empty()) {
         string providedHash = crypto.generatePasswordHash(password);
-        cout << "Contraseña proporcionada con hash: " << providedHash << endl;
+        LOG_DEBUG("Contraseña proporcionada con hash: " << providedHash);
 
         if (providedHash != info.encryptionHash) {
-          cerr << "\n";
-          cerr << "╔══════════════════════════════════════════════════════════╗"
-               << endl;
-          cerr << "║                ¡ERROR DE AUTENTICACIÓN!                 ║"
-               << endl;
-          cerr << "╠══════════════════════════════════════════════════════════╣"
-               << endl;
-          cerr << "║ La contraseña proporcionada es incorrecta.              ║"
-               << endl;
-          cerr << "║ No se puede desencriptar el archivo.                    ║"
-               << endl;
-          cerr << "╚══════════════════════════════════════════════════════════╝"
-               << endl;
-          cerr << "\n";
-          cerr << "Hash esperado:    " << info.encryptionHash << endl;
-          cerr << "Hash recibido:    " << providedHash << endl;
-          cerr << "Intente de nuevo con la contraseña correcta usando: -p "
-                  "[contraseña]"
-               << endl;
-
-          // Cerrar archivos abiertos
-          for (auto &[path, arch] : allArchives) {
-            zip_close(arch);
+          // Mostrar el aviso una sola vez aunque fallen varias partes
+          if (!authFailed.exchange(true)) {
+            LOG_ERROR("");
+            LOG_ERROR(
+                "╔══════════════════════════════════════════════════════════╗");
+            LOG_ERROR(
+                "║                ¡ERROR DE AUTENTICACIÓN!                 ║");
+            LOG_ERROR(
+                "╠══════════════════════════════════════════════════════════╣");
+            LOG_ERROR(
+                "║ La contraseña proporcionada es incorrecta.              ║");
+            LOG_ERROR(
+                "║ No se puede desencriptar el archivo.                    ║");
+            LOG_ERROR(
+                "╚══════════════════════════════════════════════════════════╝");
+            LOG_ERROR("");
+            LOG_ERROR("Hash esperado:    " << info.encryptionHash);
+            LOG_ERROR("Hash recibido:    " << providedHash);
+            LOG_ERROR("Intente de nuevo con la contraseña correcta usando: "
+                      "-p [contraseña]");
           }
-          return false;
+          continue;
         } else {
-          cout << "✓ Contraseña correcta verificada!" << endl;
+          LOG_DEBUG("✓ Contraseña correcta verificada!");
         }
       } else {
-        cerr << "\n";
-        cerr << "╔══════════════════════════════════════════════════════════╗"
-             << endl;
-        cerr << "║                ¡ARCHIVO ENCRIPTADO!                     ║"
-             << endl;
-        cerr << "╠══════════════════════════════════════════════════════════╣"
-             << endl;
-        cerr << "║ Los archivos están protegidos con contraseña.           ║"
-             << endl;
-        cerr << "║ Debe proporcionar la contraseña para desencriptar.      ║"
-             << endl;
-        cerr << "╚══════════════════════════════════════════════════════════╝"
-             << endl;
-        cerr << "\n";
-        cerr << "Use el parámetro -p [contraseña] para proporcionar la "
-                "contraseña."
-             << endl;
-
-        // Cerrar archivos abiertos
-        for (auto &[path, arch] : allArchives) {
-          zip_close(arch);
+        if (!authFailed.exchange(true)) {
+          LOG_ERROR("");
+          LOG_ERROR(
+              "╔══════════════════════════════════════════════════════════╗");
+          LOG_ERROR(
+              "║                ¡ARCHIVO ENCRIPTADO!                     ║");
+          LOG_ERROR(
+              "╠══════════════════════════════════════════════════════════╣");
+          LOG_ERROR(
+              "║ Los archivos están protegidos con contraseña.           ║");
+          LOG_ERROR(
+              "║ Debe proporcionar la contraseña para desencriptar.      ║");
+          LOG_ERROR(
+              "╚══════════════════════════════════════════════════════════╝");
+          LOG_ERROR("");
+          LOG_ERROR("Use el parámetro -p [contraseña] para proporcionar la "
+                    "contraseña.");
         }
-        return false;
+        continue;
       }
     }
 
-    cout << "  Parte " << info.partNumber << " de " << info.totalParts
-         << " con " << info.filePathMapping.size() << " archivos"
-         << (info.encryptionHash.empty() ? "" : " (encriptada)") << endl;
+    LOG_DEBUG("  Parte " << info.partNumber
+                         << (info.totalParts > 0
+                                 ? " de " + to_string(info.totalParts)
+                                 : string(" adicional"))
+                         << " con " << info.filePathMapping.size()
+                         << " archivos"
+                         << (info.encryptionHash.empty() ? "" : " (encriptada)"));
 
     // Registrar todos los fragmentos encontrados
 #pragma omp critical(fragments)
     {
+      normalFiles += info.filePathMapping.size() - info.fragments.size();
+      for (const auto &block : info.solidBlocks) {
+        normalFiles += block.second.size();
+      }
       for (const auto &[zipPath, originalPath, fragNum, totalFrags] :
            info.fragments) {
         string baseName = zipPath.substr(0, zipPath.find(".fragment"));
@@ -465,12 +623,45 @@ bool decompressPartsWithPassword(const string &folderPath,
         allFragments[baseName].push_back(
             make_tuple(zipPath, originalPath, fragNum, totalFrags));
       }
+      sparseFragments.insert(info.sparseFragments.begin(),
+                             info.sparseFragments.end());
     }
   }
 
-  // Segunda pasada: procesar archivos normales
-  for (const auto &[zipPath, archive] : allArchives) {
-    cout << "Procesando " << zipPath << "..." << endl;
+  if (authFailed) {
+    // Cerrar archivos abiertos
+    for (auto &[path, arch] : allArchives) {
+      zip_close(arch);
+    }
+    return false;
+  }
+
+  // Cada archivo completo o reconstruido cuenta como un elemento
+  progressBegin("Extrayendo", normalFiles + allFragments.size(), 0);
+
+  // Repartir primero las partes más grandes (LPT): con schedule(dynamic)
+  // las pequeñas rellenan los huecos al final en lugar de que una parte
+  // grande al final de la lista deje al resto de hilos esperando
+  {
+    map<string, uintmax_t> archiveSizes;
+    for (const auto &[path, arch] : allArchives) {
+      error_code ec;
+      archiveSizes[path] = filesystem::file_size(path, ec);
+    }
+    sort(allArchives.begin(), allArchives.end(),
+         [&archiveSizes](const auto &a, const auto &b) {
+           uintmax_t sizeA = archiveSizes[a.first];
+           uintmax_t sizeB = archiveSizes[b.first];
+           return sizeA != sizeB ? sizeA > sizeB : a.first < b.first;
+         });
+  }
+
+  // Segunda pasada: procesar archivos normales. Cada hilo trabaja con
+  // partes distintas, así que ningún zip_t se comparte entre hilos
+#pragma omp parallel for schedule(dynamic) num_threads(compressThreadCount())
+  for (size_t a = 0; a < allArchives.size(); a++) {
+    const auto &[zipPath, archive] = allArchives[a];
+    LOG_DEBUG("Procesando " << zipPath << "...");
 
     // Buscar el archivo .info dentro del ZIP
     string infoFileName;
@@ -484,7 +675,7 @@ bool decompressPartsWithPassword(const string &folderPath,
     }
 
     if (infoFileName.empty()) {
-      cerr << "No se encontró archivo .info en " << zipPath << endl;
+      LOG_ERROR("No se encontró archivo .info en " << zipPath);
       continue;
     }
 
@@ -496,7 +687,7 @@ bool decompressPartsWithPassword(const string &folderPath,
     }
 
     if (infoContent.empty()) {
-      cerr << "No se pudo leer el archivo .info en " << zipPath << endl;
+      LOG_ERROR("No se pudo leer el archivo .info en " << zipPath);
       continue;
     }
 
@@ -513,11 +704,19 @@ bool decompressPartsWithPassword(const string &folderPath,
       // Construir la ruta de salida manteniendo la estructura de carpetas
       filesystem::path destPath = filesystem::path(outputPath) / zipPath;
 
-      cout << "  Extrayendo " << zipPath << " a " << destPath << endl;
+      LOG_DEBUG("  Extrayendo " << zipPath << " a " << destPath);
 
       if (!extractFileFromZipWithDecryption(archive, zipPath, destPath.string(),
                                             password)) {
-        cerr << "  Error al extraer " << zipPath << endl;
+        LOG_ERROR("  Error al extraer " << zipPath);
+      }
+    }
+
+    // Archivos pequeños empaquetados en bloques sólidos
+    for (const auto &[blockName, members] : info.solidBlocks) {
+      if (!extractSolidBlock(archive, blockName, members, outputPath,
+                             password)) {
+        LOG_ERROR("  Error al extraer el bloque " << blockName);
       }
     }
   }
@@ -537,13 +736,13 @@ bool decompressPartsWithPassword(const string &folderPath,
     }
 
     if (foundFragNumbers.size() != static_cast<size_t>(totalFrags)) {
-      cerr << "¡Advertencia! No se encontraron todos los fragmentos para "
-           << baseName << ". Encontrados: " << foundFragNumbers.size() << " de "
-           << totalFrags << endl;
+      LOG_ERROR("¡Advertencia! No se encontraron todos los fragmentos para "
+                << baseName << ". Encontrados: " << foundFragNumbers.size()
+                << " de " << totalFrags);
       continue;
     }
 
-    cout << "Reconstruyendo archivo fragmentado: " << baseName << endl;
+    LOG_DEBUG("Reconstruyendo archivo fragmentado: " << baseName);
 
     // Ruta de salida para el archivo reconstruido (mantener estructura de
     // carpetas)
@@ -552,16 +751,25 @@ bool decompressPartsWithPassword(const string &folderPath,
     // Asegurarse que el directorio existe
     filesystem::create_directories(outputFilePath.parent_path());
 
-    ofstream outFile(outputFilePath, ios::binary);
+    FILE *outFile = fopen(outputFilePath.string().c_str(), "wb");
 
     if (!outFile) {
-      cerr << "No se pudo crear el archivo reconstruido: " << outputFilePath
-           << endl;
+      LOG_ERROR("No se pudo crear el archivo reconstruido: " << outputFilePath);
       continue;
     }
 
     bool reconstructionSuccess = true;
 
+    // Rango escrito con el fragmento anterior: cada fragmento nuevo inicia
+    // su escritura a disco y descarta de la caché el anterior, ya escrito
+    uint64_t writtenBytes = 0;
+    uint64_t previousOffset = 0;
+    uint64_t previousLength = 0;
+
+    // Tamaño final si el archivo es disperso: sus fragmentos se escriben en
+    // su posición y lo que queda entre ellos son huecos
+    uint64_t sparseSize = 0;
+
     // Ordenar fragmentos por número
     vector<tuple<string, string, int, int>> sortedFragments = fragments;
     sort(sortedFragments.begin(), sortedFragments.end(),
@@ -579,72 +787,82 @@ bool decompressPartsWithPassword(const string &folderPath,
           // Encontramos el fragmento, extraerlo
           zip_file_t *zf = zip_fopen_index(archive, index, 0);
           if (!zf) {
-            cerr << "Error al abrir fragmento: " << fragZipPath << endl;
+            LOG_ERROR("Error al abrir fragmento: " << fragZipPath);
             reconstructionSuccess = false;
             break;
           }
 
           zip_stat_t stat;
           if (zip_stat_index(archive, index, 0, &stat) < 0) {
-            cerr << "Error al obtener información de fragmento: " << fragZipPath
-                 << endl;
+            LOG_ERROR("Error al obtener información de fragmento: "
+                      << fragZipPath);
             zip_fclose(zf);
             reconstructionSuccess = false;
             break;
           }
 
-          // Read entire fragment into memory
-          vector<unsigned char> buffer(stat.size);
-          zip_int64_t bytesRead = zip_fread(zf, buffer.data(), stat.size);
+          // Write fragment to output file
+          auto sparseInfo = sparseFragments.find(fragZipPath);
+          bool writeOk = true;
+          if (sparseInfo != sparseFragments.end()) {
+            writtenBytes = sparseInfo->second.first;
+            sparseSize = sparseInfo->second.second;
+            writeOk = fseeko(outFile, static_cast<off_t>(writtenBytes),
+                             SEEK_SET) == 0;
+          }
+          uint64_t copied = 0;
+          writeOk = writeOk && copyEntryToFile(zf, stat, outFile,
+                                               writtenBytes, password, copied);
           zip_fclose(zf);
-
-          if (bytesRead < 0 ||
-              bytesRead != static_cast<zip_int64_t>(stat.size)) {
-            cerr << "Error al leer fragmento completo: " << fragZipPath << endl;
+          if (!writeOk) {
+            LOG_ERROR("Error al escribir fragmento al archivo de salida: "
+                      << fragZipPath);
             reconstructionSuccess = false;
             break;
           }
-
-          // Decrypt fragment if password is provided
-          if (!password.empty()) {
-            auto decrypted =
-                crypto.decrypt(buffer.data(), buffer.size(), password);
-            buffer = decrypted;
-          }
-
-          // Write fragment to output file
-          outFile.write(reinterpret_cast<const char *>(buffer.data()),
-                        buffer.size());
-          if (!outFile) {
-            cerr << "Error al escribir fragmento al archivo de salida" << endl;
-            reconstructionSuccess = false;
-            break;
+          // Descartar de la caché lo que quede del fragmento anterior (su
+          // último trozo; el resto ya se descartó al copiarlo)
+          if (previousLength > 0) {
+            dropWrittenCache(fileno(outFile), previousOffset, previousLength);
           }
+          previousOffset = writtenBytes;
+          previousLength = copied;
+          writtenBytes += copied;
 
           fragFound = true;
-          cout << "  Procesado fragmento"
-               << (password.empty() ? "" : " (desencriptado)") << " "
-               << fragNumber << " de " << totalFrags << " ("
-               << (buffer.size() / 1024) << "KB)" << endl;
+          LOG_DEBUG("  Procesado fragmento"
+                    << (password.empty() ? "" : " (desencriptado)") << " "
+                    << fragNumber << " de " << totalFrags << " ("
+                    << (copied / 1024) << "KB)");
           break;
         }
       }
 
       if (!fragFound) {
-        cerr << "No se encontró el fragmento: " << fragZipPath << endl;
+        LOG_ERROR("No se encontró el fragmento: " << fragZipPath);
         reconstructionSuccess = false;
         break;
       }
     }
 
-    outFile.close();
+    // El hueco final no se escribe: fijar el tamaño completo
+    if (reconstructionSuccess && sparseSize > 0 &&
+        ftruncate(fileno(outFile), static_cast<off_t>(sparseSize)) != 0) {
+      LOG_ERROR("No se pudo fijar el tamaño de " << outputFilePath);
+      reconstructionSuccess = false;
+    }
+    if (fclose(outFile) != 0) {
+      reconstructionSuccess = false;
+    }
 
     if (reconstructionSuccess) {
-      cout << "Archivo reconstruido correctamente: " << outputFilePath << " ("
-           << (filesystem::file_size(outputFilePath) / 1024 / 1024) << "MB)"
-           << endl;
+      progressAdvance(1, 0);
+      LOG_DEBUG("Archivo reconstruido correctamente: "
+                << outputFilePath << " ("
+                << (filesystem::file_size(outputFilePath) / 1024 / 1024)
+                << "MB)");
     } else {
-      cerr << "Error al reconstruir archivo fragmentado: " << baseName << endl;
+      LOG_ERROR("Error al reconstruir archivo fragmentado: " << baseName);
     }
   }
 
@@ -653,8 +871,10 @@ bool decompressPartsWithPassword(const string &folderPath,
     zip_close(archive);
   }
 
-  cout << "Descompresión" << (password.empty() ? "" : " y desencriptado")
-       << " completada en " << outputPath << endl;
+  progressEnd();
+  LOG_INFO("Descompresión" << (password.empty() ? "" : " y desencriptado")
+                           << " completada en " << outputPath);
+  logFlush();
   return true;
 }
 
@@ -662,60 +882,3 @@ bool decompressPartsWithPassword(const string &folderPath,
 bool decompressParts(const string &folderPath, const string &outputPath) {
   return decompressPartsWithPassword(folderPath, outputPath, "");
 }
-
-int main(int argc, char *argv[]) {
-  string inputFolder = "./output";
-  string outputFolder = "./extracted";
-  string password = "";
-
-  // Parse command line arguments
-  for (int i = 1; i < argc; i++) {
-    if (string(argv[i]) == "-i" && i + 1 < argc) {
-      inputFolder = argv[i + 1];
-      i++;
-    } else if (string(argv[i]) == "-o" && i + 1 < argc) {
-      outputFolder = argv[i + 1];
-      i++;
-    } else if (string(argv[i]) == "-p" && i + 1 < argc) {
-      password = argv[i + 1];
-      i++;
-    } else if (string(argv[i]) == "-h" || string(argv[i]) == "--help") {
-      cout << "Uso: decompressor [-i carpeta_entrada] [-o carpeta_salida] [-p "
-              "contraseña]"
-           << endl;
-      cout << "  -i : Directorio con archivos ZIP (default: ./output)" << endl;
-      cout << "  -o : Directorio de salida (default: ./extracted)" << endl;
-      cout << "  -p : Contraseña para desencriptar (opcional)" << endl;
-      cout << "  -h : Mostrar esta ayuda" << endl;
-      return 0;
-    } else if (i == 1) {
-      inputFolder = argv[i];
-    } else if (i == 2) {
-      outputFolder = argv[i];
-    }
-  }
-
-  // Asegurar que el directorio de salida exista
-  filesystem::create_directories(outputFolder);
-
-  cout << "Descomprimiendo archivos de " << inputFolder << " a " << outputFolder
-       << endl;
-
-  if (password != "") {
-    if (decompressPartsWithPassword(inputFolder, outputFolder, password)) {
-      cout << "Operación completada con éxito." << endl;
-      return 0;
-    } else {
-      cerr << "Error durante la operación." << endl;
-      return 1;
-    }
-  } else {
-    if (decompressParts(inputFolder, outputFolder)) {
-      cout << "Operación completada con éxito." << endl;
-      return 0;
-    } else {
-      cerr << "Error durante la operación." << endl;
-      return 1;
-    }
-  }
-}
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define DECOMPRESS_H
 
 #include <algorithm>
+#include <cstdint>
 #include <cstring>
 #include <filesystem>
 #include <fstream>
@@ -27,6 +28,11 @@ struct PartInfo {
   std::map<std::string, std::string> filePathMapping; // zipPath -> originalPath
   std::vector<std::tuple<std::string, std::string, int, int>>
       fragments; // zipPath, originalPath, fragNum, totalFrags
+  std::map<std::string, std::pair<uint64_t, uint64_t>>
+      sparseFragments; // zipPath -> posición, tamaño total del archivo
+  std::map<std::string,
+           std::vector<std::tuple<std::string, uint64_t, uint64_t>>>
+      solidBlocks; // bloque -> zipPath, posición y longitud de cada archivo
 };
 
 /**
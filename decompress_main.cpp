@@ -0,0 +1,202 @@
+#include "decompress.h"
+#include "instrumentation.h"
+#include "logger.h"
+#include "low_impact.h"
+#include "native_format.h"
+#include "thread_config.h"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main(int argc, char *argv[]) {
+  string inputFolder = "./output";
+  string outputFolder = "./extracted";
+  string password = "";
+  string stageReportPath = "";
+  string tracePath = "";
+  string onlyPath = "";   // Restaurar solo este archivo (formato nativo)
+  string baseFolder = ""; // Copia base de una copia delta, si se movió
+  bool rangeSet = false;  // Escribir un rango de onlyPath por la salida
+  uint64_t rangeOffset = 0;
+  uint64_t rangeLength = 0;
+
+  // Parse command line arguments
+  for (int i = 1; i < argc; i++) {
+    if (string(argv[i]) == "-i" && i + 1 < argc) {
+      inputFolder = argv[i + 1];
+      i++;
+    } else if (string(argv[i]) == "-o" && i + 1 < argc) {
+      outputFolder = argv[i + 1];
+      i++;
+    } else if (string(argv[i]) == "-p" && i + 1 < argc) {
+      password = argv[i + 1];
+      i++;
+    } else if (string(argv[i]) == "-f" && i + 1 < argc) {
+      onlyPath = argv[i + 1];
+      i++;
+    } else if (string(argv[i]) == "-c" && i + 1 < argc) {
+      baseFolder = argv[i + 1];
+      i++;
+    } else if (string(argv[i]) == "-r" && i + 1 < argc) {
+      unsigned long long offset = 0;
+      unsigned long long length = 0;
+      char extra = 0;
+      if (sscanf(argv[i + 1], "%llu,%llu%c", &offset, &length, &extra) != 2) {
+        cerr << "Error: -r espera inicio,longitud en bytes, p. ej. 0,4096"
+             << endl;
+        return 1;
+      }
+      rangeSet = true;
+      rangeOffset = offset;
+      rangeLength = length;
+      i++;
+    } else if (string(argv[i]) == "-I" && i + 1 < argc) {
+      stageReportPath = argv[i + 1];
+      i++;
+    } else if (string(argv[i]) == "-T" && i + 1 < argc) {
+      tracePath = argv[i + 1];
+      i++;
+    } else if (string(argv[i]) == "-j" && i + 1 < argc) {
+      if (!parseThreadCount(argv[i + 1], threadConfig().compressThreads)) {
+        cerr << "Error: -j requiere un número de hilos positivo" << endl;
+        return 1;
+      }
+      i++;
+    } else if (string(argv[i]) == "-J" && i + 1 < argc) {
+      if (!parseStagePools(argv[i + 1], threadConfig())) {
+        cerr << "Error: -J espera hilos de E/S,descompresión, p. ej. 2,8"
+             << endl;
+        return 1;
+      }
+      i++;
+    } else if (string(argv[i]) == "-P" && i + 1 < argc) {
+      if (!parseIoPriority(argv[i + 1], impactConfig())) {
+        cerr << "Error: -P espera idle, be o be:0-7" << endl;
+        return 1;
+      }
+      i++;
+    } else if (string(argv[i]) == "-N" && i + 1 < argc) {
+      if (!parseNiceLevel(argv[i + 1], impactConfig())) {
+        cerr << "Error: -N espera un nice entre -20 y 19" << endl;
+        return 1;
+      }
+      i++;
+    } else if (string(argv[i]) == "-L" && i + 1 < argc) {
+      if (!parseDiskLimit(argv[i + 1], impactConfig())) {
+        cerr << "Error: -L espera un tope positivo en MB/s" << endl;
+        return 1;
+      }
+      i++;
+    } else if (string(argv[i]) == "-A") {
+      impactConfig().adaptive = true;
+    } else if (string(argv[i]) == "-q") {
+      setLogLevel(LogLevel::QUIET);
+    } else if (string(argv[i]) == "-v") {
+      setLogLevel(LogLevel::DEBUG);
+    } else if (string(argv[i]) == "-h" || string(argv[i]) == "--help") {
+      cout << "Uso: decompressor [-i carpeta_entrada] [-o carpeta_salida] [-p "
+              "contraseña] [-j hilos] [-J e/s,descompresión] [-I informe.json] "
+              "[-T traza.json] [-P idle|be[:n]] [-N nice] [-L MB/s] [-A] "
+              "[-f ruta [-r inicio,longitud]] [-q | -v]"
+           << endl;
+      cout << "  -i : Directorio con archivos ZIP (default: ./output)" << endl;
+      cout << "  -o : Directorio de salida (default: ./extracted)" << endl;
+      cout << "  -p : Contraseña para desencriptar (opcional)" << endl;
+      cout << "  -j : Hilos de descompresión/descifrado (default: todos los "
+              "núcleos)"
+           << endl;
+      cout << "  -J : Hilos por etapa como E/S,descompresión (p. ej. 2,8)"
+           << endl;
+      cout << "  -I : Guardar un informe JSON con tiempo y bytes por etapa"
+           << endl;
+      cout << "  -T : Guardar una traza en formato Chrome trace" << endl;
+      cout << "  -P : Clase de E/S: idle o be[:0-7]" << endl;
+      cout << "  -N : Prioridad de CPU (nice), de -20 a 19" << endl;
+      cout << "  -L : Tope de lectura + escritura en disco en MB/s" << endl;
+      cout << "  -A : Frenar la E/S cuando sube la presión del sistema"
+           << endl;
+      cout << "  -f : Formato nativo: restaurar solo este archivo de la copia"
+           << endl;
+      cout << "  -r : Con -f, escribir solo ese rango de bytes por la salida "
+              "estándar"
+           << endl;
+      cout << "  -c : Copia delta: carpeta de su copia base, si ya no está "
+              "donde se hizo"
+           << endl;
+      cout << "  -q : Silencioso, solo errores y avisos" << endl;
+      cout << "  -v : Detallado, una línea por archivo y fragmento" << endl;
+      cout << "  -h : Mostrar esta ayuda" << endl;
+      return 0;
+    } else if (i == 1) {
+      inputFolder = argv[i];
+    } else if (i == 2) {
+      outputFolder = argv[i];
+    }
+  }
+
+  if (rangeSet && onlyPath.empty()) {
+    cerr << "Error: -r requiere -f con el archivo a leer" << endl;
+    return 1;
+  }
+  bool native = hasNativeBackup(inputFolder);
+  if ((!onlyPath.empty() || !baseFolder.empty()) && !native) {
+    cerr << "Error: -f y -c solo se admiten con copias en formato nativo"
+         << endl;
+    return 1;
+  }
+  if (rangeSet) {
+    // La salida estándar lleva los datos: solo errores por consola
+    setLogLevel(LogLevel::QUIET);
+  }
+
+  // Antes de crear hilos: los de OpenMP heredan las prioridades
+  applyImpactConfig();
+
+  if (rangeSet) {
+    bool ok = readNativeRange(inputFolder, onlyPath, rangeOffset, rangeLength,
+                              password, stdout, baseFolder);
+    ok = fflush(stdout) == 0 && ok;
+    logFlush();
+    return ok ? 0 : 1;
+  }
+
+  // Asegurar que el directorio de salida exista
+  filesystem::create_directories(outputFolder);
+
+  LOG_INFO("Descomprimiendo archivos de " << inputFolder << " a "
+                                          << outputFolder);
+
+  if (!stageReportPath.empty() || !tracePath.empty()) {
+    enableInstrumentation(!tracePath.empty());
+  }
+  auto start = chrono::steady_clock::now();
+
+  // Las copias en formato nativo se reconocen por sus volúmenes .bkp.NNN
+  bool ok = native ? restoreNativeBackup(inputFolder, outputFolder, password,
+                                         onlyPath, baseFolder)
+            : password != ""
+                ? decompressPartsWithPassword(inputFolder, outputFolder,
+                                              password)
+                : decompressParts(inputFolder, outputFolder);
+
+  double wallSeconds =
+      chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  if (!stageReportPath.empty()) {
+    writeInstrumentationReport(stageReportPath, wallSeconds);
+  }
+  if (!tracePath.empty()) {
+    writeChromeTrace(tracePath);
+  }
+
+  if (ok) {
+    LOG_INFO("Operación completada con éxito.");
+  } else {
+    LOG_ERROR("Error durante la operación.");
+  }
+  logFlush();
+  return ok ? 0 : 1;
+}
@@ -1,6 +1,6 @@
 #include "dropbox_uploader.h"
+#include "logger.h"
 #include <algorithm>
-#include <atomic>
 #include <chrono>
 #include <ctime>
 #include <curl/curl.h>
@@ -8,51 +8,25 @@
 #include <iomanip>
 #include <iostream>
 #include <jsoncpp/json/json.h>
-#include <mutex>
 #include <sstream>
 
 using namespace std;
 
-// Variables globales para progreso
-std::mutex progressMutex;
-std::atomic<int> totalFilesUploaded{0};
-std::atomic<int> totalFilesToUpload{0};
+static const char *DROPBOX_API = "https://api.dropboxapi.com/2/";
+static const char *DROPBOX_CONTENT = "https://content.dropboxapi.com/2/";
 
-// Callback para recibir datos de respuesta HTTP
-size_t WriteCallback(void *contents, size_t size, size_t nmemb, string *s) {
-  s->append((char *)contents, size * nmemb);
-  return size * nmemb;
+// Serializar JSON en una sola línea (para la cabecera Dropbox-API-Arg)
+static string compactJson(const Json::Value &value) {
+  Json::FastWriter writer;
+  string json = writer.write(value);
+  json.erase(std::remove(json.begin(), json.end(), '\n'), json.end());
+  return json;
 }
 
-// Callback para mostrar progreso de subida
-int ProgressCallback(void *clientp, curl_off_t dltotal, curl_off_t dlnow,
-                     curl_off_t ultotal, curl_off_t ulnow) {
-  if (ultotal == 0)
-    return 0;
-
-  static int lastPercent = 0;
-  int percent = static_cast<int>((ulnow * 100) / ultotal);
-
-  if (percent != lastPercent && percent % 5 == 0) {
-    std::lock_guard<std::mutex> guard(progressMutex);
-    lastPercent = percent;
-
-    int barWidth = 30;
-    int pos = barWidth * percent / 100;
-
-    std::cout << "\r[";
-    for (int i = 0; i < barWidth; ++i) {
-      if (i < pos)
-        std::cout << "=";
-      else if (i == pos)
-        std::cout << ">";
-      else
-        std::cout << " ";
-    }
-    std::cout << "] " << percent << "% " << std::flush;
-  }
-
-  return 0;
+// Ruta absoluta de Dropbox a partir de una ruta relativa del destino
+static string dropboxPath(const string &remotePath) {
+  return remotePath.empty() || remotePath[0] == '/' ? remotePath
+                                                    : "/" + remotePath;
 }
 
 // Constructor
@@ -169,28 +143,18 @@ bool DropboxUploader::initialize() {
     }
 
     // Intercambiar código por token de acceso
-    CURL *curl = curl_easy_init();
-    if (!curl) {
-      cout << "Error inicializando CURL." << endl;
-      return false;
-    }
-
     string postFields = "code=" + authCode + "&grant_type=authorization_code" +
                         "&client_id=" + authConfig.appKey +
                         "&client_secret=" + authConfig.appSecret;
 
-    string readBuffer;
-    curl_easy_setopt(curl, CURLOPT_URL,
-                     "https://api.dropboxapi.com/oauth2/token");
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, postFields.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
-
-    CURLcode res = curl_easy_perform(curl);
-    curl_easy_cleanup(curl);
+    HttpRequest request;
+    request.url = "https://api.dropboxapi.com/oauth2/token";
+    request.body = postFields.data();
+    request.bodySize = postFields.size();
+    HttpResponse tokenResponse = performHttpRequest(request);
 
-    if (res != CURLE_OK) {
-      cout << "Error al obtener token de acceso: " << curl_easy_strerror(res)
+    if (!tokenResponse.error.empty()) {
+      cout << "Error al obtener token de acceso: " << tokenResponse.error
            << endl;
       return false;
     }
@@ -198,7 +162,7 @@ bool DropboxUploader::initialize() {
     // Parsear respuesta
     Json::Value root;
     Json::Reader reader;
-    if (!reader.parse(readBuffer, root)) {
+    if (!reader.parse(tokenResponse.body, root)) {
       cout << "Error al parsear respuesta de Dropbox." << endl;
       return false;
     }
@@ -243,258 +207,306 @@ bool DropboxUploader::initialize() {
   return true;
 }
 
+// Llamada RPC (cuerpo JSON) a api.dropboxapi.com
+HttpResponse DropboxUploader::apiCall(const string &endpoint,
+                                      const Json::Value &args) {
+  string body = compactJson(args);
+
+  HttpRequest request;
+  request.url = string(DROPBOX_API) + endpoint;
+  request.headers = {"Content-Type: application/json",
+                     "Authorization: Bearer " + authConfig.accessToken};
+  request.body = body.data();
+  request.bodySize = body.size();
+  return performHttpRequest(request);
+}
+
+// Llamada de contenido (argumentos en cabecera) a content.dropboxapi.com
+HttpResponse DropboxUploader::contentCall(const string &endpoint,
+                                          const Json::Value &args,
+                                          const char *data, size_t size,
+                                          const vector<string> &extraHeaders) {
+  HttpRequest request;
+  request.url = string(DROPBOX_CONTENT) + endpoint;
+  request.headers = {"Dropbox-API-Arg: " + compactJson(args),
+                     "Authorization: Bearer " + authConfig.accessToken};
+  if (data != nullptr) {
+    request.headers.push_back("Content-Type: application/octet-stream");
+    // La barra por petición solo en modo detallado: por defecto la
+    // sustituye la línea de progreso agregada
+    request.showProgress = size > 0 && logEnabled(LogLevel::DEBUG);
+  }
+  request.headers.insert(request.headers.end(), extraHeaders.begin(),
+                         extraHeaders.end());
+  request.body = data;
+  request.bodySize = size;
+  return performHttpRequest(request);
+}
+
 // Crear una carpeta en Dropbox
 bool DropboxUploader::createFolder(const string &folderPath) {
-  CURL *curl = curl_easy_init();
-  if (!curl) {
-    return false;
-  }
-
-  // Preparar JSON para la solicitud
   Json::Value root;
-  root["path"] = "/" + folderPath;
+  root["path"] = dropboxPath(folderPath);
   root["autorename"] = false;
 
-  Json::FastWriter writer;
-  string postData = writer.write(root);
+  HttpResponse response = apiCall("files/create_folder_v2", root);
+  if (!response.error.empty()) {
+    return false;
+  }
 
-  string readBuffer;
-  struct curl_slist *headers = NULL;
-  headers = curl_slist_append(headers, "Content-Type: application/json");
+  // Si la carpeta ya existe, Dropbox responde 409 con path/conflict
+  if (response.body.find("path/conflict") != string::npos) {
+    return true;
+  }
 
-  string authHeader = "Authorization: Bearer " + authConfig.accessToken;
-  headers = curl_slist_append(headers, authHeader.c_str());
+  return response.ok();
+}
 
-  curl_easy_setopt(curl, CURLOPT_URL,
-                   "https://api.dropboxapi.com/2/files/create_folder_v2");
-  curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-  curl_easy_setopt(curl, CURLOPT_POSTFIELDS, postData.c_str());
-  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-  curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
+bool DropboxUploader::prepareFolder(const string &remoteFolder,
+                                    string &error) {
+  if (!createFolder(remoteFolder)) {
+    error = "No se pudo crear la carpeta " + remoteFolder;
+    return false;
+  }
+  return true;
+}
+
+// Argumentos de confirmación comunes a upload y upload_session/finish
+static Json::Value commitInfo(const string &remotePath) {
+  Json::Value commit;
+  commit["path"] = dropboxPath(remotePath);
+  commit["mode"] = "overwrite";
+  commit["autorename"] = true;
+  commit["mute"] = false;
+  commit["strict_conflict"] = false;
+  return commit;
+}
 
-  CURLcode res = curl_easy_perform(curl);
-  curl_slist_free_all(headers);
-  curl_easy_cleanup(curl);
+bool DropboxUploader::put(const string &remotePath, const char *data,
+                          size_t size, string &error) {
+  HttpResponse response =
+      contentCall("files/upload", commitInfo(remotePath), data, size);
 
-  if (res != CURLE_OK) {
+  Json::Value root;
+  Json::Reader reader;
+  if (!response.ok() || !reader.parse(response.body, root) ||
+      !root.isMember("id")) {
+    error = response.ok() ? "Respuesta inesperada de Dropbox"
+                          : describeHttpError(response);
     return false;
   }
+  return true;
+}
+
+bool DropboxUploader::beginMultipart(const string &remotePath,
+                                     MultipartUpload &upload, string &error) {
+  upload = MultipartUpload();
+  upload.remotePath = remotePath;
+
+  Json::Value args;
+  args["close"] = false;
+  static const char empty = 0;
+  HttpResponse response =
+      contentCall("files/upload_session/start", args, &empty, 0);
 
-  Json::Value response;
+  Json::Value root;
   Json::Reader reader;
-  if (!reader.parse(readBuffer, response)) {
+  if (!response.ok() || !reader.parse(response.body, root) ||
+      !root.isMember("session_id")) {
+    error = describeHttpError(response);
     return false;
   }
+  upload.uploadId = root["session_id"].asString();
+  return true;
+}
 
-  // Verificar si hay error
-  if (response.isMember("error")) {
-    string errorTag = response["error"].asString();
-    if (errorTag == "path/conflict") {
-      // La carpeta ya existe, lo que está bien
-      return true;
-    }
+bool DropboxUploader::uploadPart(MultipartUpload &upload, const char *data,
+                                 size_t size, string &error) {
+  Json::Value args;
+  args["cursor"]["session_id"] = upload.uploadId;
+  args["cursor"]["offset"] = Json::UInt64(upload.offset);
+  args["close"] = false;
+
+  HttpResponse response =
+      contentCall("files/upload_session/append_v2", args, data, size);
+  if (!response.ok()) {
+    error = describeHttpError(response);
     return false;
   }
-
+  upload.offset += size;
+  upload.partNumber++;
   return true;
 }
 
-// Subir un archivo a Dropbox
-DropboxUploadResponse DropboxUploader::uploadFile(const string &filePath,
-                                                  const string &folderPath) {
-  DropboxUploadResponse response;
+bool DropboxUploader::completeMultipart(MultipartUpload &upload,
+                                        string &error) {
+  Json::Value args;
+  args["cursor"]["session_id"] = upload.uploadId;
+  args["cursor"]["offset"] = Json::UInt64(upload.offset);
+  args["commit"] = commitInfo(upload.remotePath);
 
-  // Verificar que el archivo existe
-  if (!filesystem::exists(filePath)) {
-    response.error = "El archivo no existe: " + filePath;
-    return response;
+  static const char empty = 0;
+  HttpResponse response =
+      contentCall("files/upload_session/finish", args, &empty, 0);
+
+  Json::Value root;
+  Json::Reader reader;
+  if (!response.ok() || !reader.parse(response.body, root) ||
+      !root.isMember("id")) {
+    error = describeHttpError(response);
+    return false;
   }
+  return true;
+}
 
-  // Construir la ruta de destino
-  string fileName = filesystem::path(filePath).filename().string();
-  string dropboxPath = folderPath.empty() ? ("/" + fileName)
-                                          : ("/" + folderPath + "/" + fileName);
+bool DropboxUploader::get(const string &remotePath, vector<char> &out,
+                          string &error) {
+  Json::Value args;
+  args["path"] = dropboxPath(remotePath);
 
-  // Leer el archivo
-  ifstream file(filePath, ios::binary | ios::ate);
-  if (!file.is_open()) {
-    response.error = "No se puede abrir el archivo: " + filePath;
-    return response;
+  HttpResponse response = contentCall("files/download", args, nullptr, 0);
+  if (!response.ok()) {
+    error = describeHttpError(response);
+    return false;
   }
+  out.assign(response.body.begin(), response.body.end());
+  return true;
+}
 
-  streamsize fileSize = file.tellg();
-  file.seekg(0, ios::beg);
+bool DropboxUploader::getRange(const string &remotePath, uint64_t offset,
+                               uint64_t length, vector<char> &out,
+                               string &error) {
+  if (length == 0) {
+    out.clear();
+    return true;
+  }
 
-  vector<char> buffer(fileSize);
-  if (!file.read(buffer.data(), fileSize)) {
-    response.error = "Error al leer el archivo: " + filePath;
-    return response;
+  Json::Value args;
+  args["path"] = dropboxPath(remotePath);
+  string range = "Range: bytes=" + to_string(offset) + "-" +
+                 to_string(offset + length - 1);
+
+  HttpResponse response =
+      contentCall("files/download", args, nullptr, 0, {range});
+  if (!response.ok()) {
+    error = describeHttpError(response);
+    return false;
   }
+  out.assign(response.body.begin(), response.body.end());
+  return true;
+}
 
-  // Mostrar información
-  cout << "Subiendo " << fileName << " (" << (fileSize / 1024)
-       << "KB) a Dropbox..." << endl;
+bool DropboxUploader::list(const string &remoteFolder,
+                           vector<StorageObject> &objects, string &error) {
+  objects.clear();
 
-  CURL *curl = curl_easy_init();
-  if (!curl) {
-    response.error = "Error al inicializar curl";
-    return response;
+  Json::Value args;
+  args["path"] = dropboxPath(remoteFolder);
+  args["recursive"] = false;
+  HttpResponse response = apiCall("files/list_folder", args);
+
+  while (true) {
+    Json::Value root;
+    Json::Reader reader;
+    if (!response.ok() || !reader.parse(response.body, root)) {
+      // Una carpeta inexistente no es un error: simplemente está vacía
+      if (response.body.find("not_found") != string::npos) {
+        return true;
+      }
+      error = describeHttpError(response);
+      return false;
+    }
+
+    for (const auto &entry : root["entries"]) {
+      if (entry[".tag"].asString() != "file")
+        continue;
+      objects.push_back({entry["name"].asString(), entry["size"].asUInt64(),
+                         entry["content_hash"].asString()});
+    }
+
+    if (!root["has_more"].asBool())
+      break;
+
+    Json::Value next;
+    next["cursor"] = root["cursor"];
+    response = apiCall("files/list_folder/continue", next);
   }
 
-  // Preparar JSON para los argumentos
+  return true;
+}
+
+bool DropboxUploader::remove(const string &remotePath, string &error) {
   Json::Value args;
-  args["path"] = dropboxPath;
-  args["mode"] = "overwrite";
-  args["autorename"] = true;
-  args["mute"] = false;
-  args["strict_conflict"] = false;
+  args["path"] = dropboxPath(remotePath);
 
-  Json::FastWriter writer;
-  string argsJson = writer.write(args);
-
-  // Eliminar saltos de línea del JSON
-  argsJson.erase(std::remove(argsJson.begin(), argsJson.end(), '\n'),
-                 argsJson.end());
-
-  struct curl_slist *headers = NULL;
-  headers =
-      curl_slist_append(headers, ("Dropbox-API-Arg: " + argsJson).c_str());
-  headers =
-      curl_slist_append(headers, "Content-Type: application/octet-stream");
-
-  string authHeader = "Authorization: Bearer " + authConfig.accessToken;
-  headers = curl_slist_append(headers, authHeader.c_str());
-
-  string readBuffer;
-  curl_easy_setopt(curl, CURLOPT_URL,
-                   "https://content.dropboxapi.com/2/files/upload");
-  curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-  curl_easy_setopt(curl, CURLOPT_POSTFIELDS, buffer.data());
-  curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, fileSize);
-  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-  curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
-
-  // Configurar barra de progreso
-  curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
-  curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, ProgressCallback);
-
-  CURLcode res = curl_easy_perform(curl);
-  curl_slist_free_all(headers);
-  curl_easy_cleanup(curl);
-
-  cout << endl; // Nueva línea después de la barra de progreso
-
-  if (res != CURLE_OK) {
-    response.error = curl_easy_strerror(res);
-    return response;
+  HttpResponse response = apiCall("files/delete_v2", args);
+  if (!response.ok()) {
+    error = describeHttpError(response);
+    return false;
   }
+  return true;
+}
 
-  // Parsear respuesta
-  Json::Value root;
-  Json::Reader reader;
-  if (!reader.parse(readBuffer, root)) {
-    response.error = "Error al parsear respuesta de Dropbox";
+string DropboxUploader::shareLink(const string &remotePath) {
+  return createSharedLink(dropboxPath(remotePath));
+}
+
+// Subir un archivo a Dropbox
+DropboxUploadResponse DropboxUploader::uploadFile(const string &filePath,
+                                                  const string &folderPath) {
+  DropboxUploadResponse response;
+
+  // Verificar que el archivo existe
+  if (!filesystem::exists(filePath)) {
+    response.error = "El archivo no existe: " + filePath;
     return response;
   }
 
-  if (root.isMember("id")) {
-    response.fileId = root["id"].asString();
-    response.path = root["path_display"].asString();
+  // Construir la ruta de destino
+  string fileName = filesystem::path(filePath).filename().string();
+  string remotePath = folderPath.empty() ? fileName : folderPath + "/" + fileName;
 
-    // Obtener enlace compartido
-    response.shareUrl = createSharedLink(response.path);
-  } else {
-    response.error = "Respuesta inesperada de Dropbox";
+  // Mostrar información
+  LOG_DEBUG("Subiendo " << fileName << " ("
+                        << (filesystem::file_size(filePath) / 1024)
+                        << "KB) a Dropbox...");
+
+  // Archivos grandes se envían por sesión de subida en trozos
+  if (!putFile(filePath, remotePath, response.error)) {
+    return response;
   }
 
+  response.path = dropboxPath(remotePath);
+  response.shareUrl = createSharedLink(response.path);
   return response;
 }
 
 // Implementación alternativa (reemplazar la función completa)
 string DropboxUploader::createSharedLink(const string &path) {
-  CURL *curl = curl_easy_init();
-  if (!curl) {
-    cerr << "Error inicializando CURL" << endl;
-    return "";
-  }
-
   // Usar la API más simple
   Json::Value args;
   args["path"] = path;
   args["short_url"] = false;
 
-  Json::FastWriter writer;
-  string argsJson = writer.write(args);
-
-  // Eliminar saltos de línea del JSON
-  argsJson.erase(::std::remove(argsJson.begin(), argsJson.end(), '\n'),
-                 argsJson.end());
-
-  struct curl_slist *headers = NULL;
-  headers = curl_slist_append(headers, "Content-Type: application/json");
-
-  string authHeader = "Authorization: Bearer " + authConfig.accessToken;
-  headers = curl_slist_append(headers, authHeader.c_str());
-
-  string readBuffer;
+  HttpResponse response = apiCall("sharing/create_shared_link", args);
 
-  // API más simple y compatible
-  curl_easy_setopt(curl, CURLOPT_URL,
-                   "https://api.dropboxapi.com/2/sharing/create_shared_link");
-  curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-  curl_easy_setopt(curl, CURLOPT_POSTFIELDS, argsJson.c_str());
-  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-  curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
-  curl_easy_setopt(curl, CURLOPT_VERBOSE, 0L);
-
-  CURLcode res = curl_easy_perform(curl);
-  curl_slist_free_all(headers);
-  curl_easy_cleanup(curl);
-
-  cout << "Respuesta de create_shared_link: " << readBuffer << endl;
-
-  if (res != CURLE_OK) {
+  if (!response.ok()) {
     // Si hay error, puede ser porque el enlace ya existe
-    if (readBuffer.find("shared_link_already_exists") != string::npos) {
-      cout << "El enlace ya existe, intentando obtenerlo..." << endl;
+    if (response.body.find("shared_link_already_exists") != string::npos) {
+      LOG_DEBUG("El enlace ya existe, intentando obtenerlo...");
 
       // Intentar obtener el enlace existente con una petición separada
-      CURL *curl2 = curl_easy_init();
-      if (!curl2) {
-        return "";
-      }
-
       Json::Value listArgs;
       listArgs["path"] = path;
 
-      string listArgsJson = Json::FastWriter().write(listArgs);
-      listArgsJson.erase(
-          ::std::remove(listArgsJson.begin(), listArgsJson.end(), '\n'),
-          listArgsJson.end());
-
-      struct curl_slist *headers2 = NULL;
-      headers2 = curl_slist_append(headers2, "Content-Type: application/json");
-      headers2 = curl_slist_append(headers2, authHeader.c_str());
-
-      string listBuffer;
-      curl_easy_setopt(
-          curl2, CURLOPT_URL,
-          "https://api.dropboxapi.com/2/sharing/list_shared_links");
-      curl_easy_setopt(curl2, CURLOPT_HTTPHEADER, headers2);
-      curl_easy_setopt(curl2, CURLOPT_POSTFIELDS, listArgsJson.c_str());
-      curl_easy_setopt(curl2, CURLOPT_WRITEFUNCTION, WriteCallback);
-      curl_easy_setopt(curl2, CURLOPT_WRITEDATA, &listBuffer);
-      curl_easy_setopt(curl2, CURLOPT_VERBOSE, 0L);
-
-      res = curl_easy_perform(curl2);
-      curl_slist_free_all(headers2);
-      curl_easy_cleanup(curl2);
-
-      if (res == CURLE_OK) {
+      HttpResponse listResponse =
+          apiCall("sharing/list_shared_links", listArgs);
+      if (listResponse.ok()) {
         Json::Value listRoot;
         Json::Reader reader;
-        if (reader.parse(listBuffer, listRoot) && listRoot.isMember("links") &&
-            listRoot["links"].isArray() && listRoot["links"].size() > 0) {
+        if (reader.parse(listResponse.body, listRoot) &&
+            listRoot.isMember("links") && listRoot["links"].isArray() &&
+            listRoot["links"].size() > 0) {
           return listRoot["links"][0]["url"].asString();
         }
       }
@@ -504,7 +516,7 @@ string DropboxUploader::createSharedLink(const string &path) {
 
   Json::Value root;
   Json::Reader reader;
-  if (!reader.parse(readBuffer, root)) {
+  if (!reader.parse(response.body, root)) {
     return "";
   }
 
@@ -514,183 +526,3 @@ string DropboxUploader::createSharedLink(const string &path) {
 
   return "";
 }
-
-// Subir múltiples archivos a una carpeta
-bool DropboxUploader::uploadFiles(const vector<string> &filePaths,
-                                  const string &folderPath) {
-  if (filePaths.empty()) {
-    cout << "No hay archivos para subir." << endl;
-    return true;
-  }
-
-  // Crear la carpeta si se especificó una
-  string uploadFolder = folderPath;
-  if (!folderPath.empty()) {
-    if (!createFolder(folderPath)) {
-      cerr << "❌ Error al crear la carpeta en Dropbox: " << folderPath << endl;
-      // Continuar de todos modos, podría ser que la carpeta ya exista
-    }
-  } else {
-    // Si no se especificó carpeta, crear una con timestamp
-    auto now = chrono::system_clock::now();
-    auto nowTime = chrono::system_clock::to_time_t(now);
-
-    stringstream folderName;
-    folderName << "Archivos_" << put_time(localtime(&nowTime), "%Y%m%d_%H%M%S");
-
-    uploadFolder = folderName.str();
-    if (!createFolder(uploadFolder)) {
-      cerr << "❌ Error al crear la carpeta en Dropbox: " << uploadFolder
-           << endl;
-      return false;
-    }
-
-    cout << "📁 Carpeta creada en Dropbox: " << uploadFolder << endl;
-  }
-
-  bool overallSuccess = true;
-  vector<DropboxUploadResponse> uploadResults;
-
-  // Verificar que los archivos existen
-  vector<string> validFilePaths;
-  for (const auto &filePath : filePaths) {
-    if (filesystem::exists(filePath)) {
-      validFilePaths.push_back(filePath);
-    } else {
-      cerr << "⚠️ El archivo no existe y será ignorado: " << filePath
-           << endl;
-    }
-  }
-
-  if (validFilePaths.empty()) {
-    cerr << "❌ No se encontraron archivos válidos para subir." << endl;
-    return false;
-  }
-
-  cout << "\n🚀 Iniciando subida de " << validFilePaths.size()
-       << " archivos a Dropbox..." << endl;
-
-  // Configurar variables para seguimiento del progreso
-  totalFilesToUpload = validFilePaths.size();
-  totalFilesUploaded = 0;
-
-  for (const auto &filePath : validFilePaths) {
-    string fileName = filesystem::path(filePath).filename().string();
-    cout << "📤 (" << (totalFilesUploaded.load() + 1) << "/"
-         << totalFilesToUpload.load() << ") Subiendo: " << fileName << endl;
-
-    auto response = uploadFile(filePath, uploadFolder);
-
-    if (!response.error.empty()) {
-      cerr << "  ❌ Error al subir " << fileName << ": " << response.error
-           << endl;
-      overallSuccess = false;
-    } else {
-      cout << "  ✅ Subido correctamente: " << response.shareUrl << endl;
-      uploadResults.push_back(response);
-    }
-
-    totalFilesUploaded++;
-  }
-
-  // Generar archivo de enlaces
-  if (!uploadResults.empty()) {
-    ofstream linksFile("dropbox_links.txt");
-    if (linksFile.is_open()) {
-      linksFile << "╔══════════════════════════════════════════════════════════"
-                   "════════╗"
-                << endl;
-      linksFile << "║  Enlaces de descarga de Dropbox                          "
-                   "        ║"
-                << endl;
-      linksFile << "╚══════════════════════════════════════════════════════════"
-                   "════════╝"
-                << endl;
-      linksFile << endl;
-
-      for (size_t i = 0; i < uploadResults.size(); i++) {
-        string fileName =
-            filesystem::path(validFilePaths[i]).filename().string();
-        linksFile << "📄 " << fileName << ":" << endl;
-        linksFile << "   🔗 " << uploadResults[i].shareUrl << endl << endl;
-      }
-
-      linksFile << "Generado el: " << __DATE__ << " " << __TIME__ << endl;
-      linksFile.close();
-
-      cout << "\n📋 Enlaces guardados en: dropbox_links.txt" << endl;
-    }
-  }
-
-  if (overallSuccess) {
-    cout << "\n✨ Todos los archivos se subieron correctamente ✨" << endl;
-  } else {
-    cout << "\n⚠️ Algunos archivos no pudieron ser subidos. Revisa los "
-            "mensajes anteriores."
-         << endl;
-  }
-
-  return overallSuccess;
-}
-
-// Subir todos los archivos de una carpeta local
-bool DropboxUploader::uploadFolderContents(const string &folderPath,
-                                           bool onlyZipFiles) {
-  // Verificar que la carpeta existe
-  if (!filesystem::exists(folderPath) ||
-      !filesystem::is_directory(folderPath)) {
-    cerr << "❌ Error: La carpeta especificada no existe: " << folderPath
-         << endl;
-    return false;
-  }
-
-  // Recopilar los archivos a subir
-  vector<string> filesToUpload;
-  for (const auto &entry : filesystem::directory_iterator(folderPath)) {
-    if (entry.is_regular_file()) {
-      string extension = entry.path().extension().string();
-      if (!onlyZipFiles || extension == ".zip") {
-        filesToUpload.push_back(entry.path().string());
-      }
-    }
-  }
-
-  if (filesToUpload.empty()) {
-    cout << "⚠️ No se encontraron archivos" << (onlyZipFiles ? " ZIP" : "")
-         << " para subir en: " << folderPath << endl;
-    return true;
-  }
-
-  // Crear carpeta en Dropbox con el nombre de la carpeta local más timestamp
-  string folderName = filesystem::path(folderPath).filename().string();
-  auto now = chrono::system_clock::now();
-  auto nowTime = chrono::system_clock::to_time_t(now);
-
-  stringstream dropboxFolderName;
-  dropboxFolderName << folderName << "_"
-                    << put_time(localtime(&nowTime), "%Y%m%d_%H%M%S");
-
-  // Subir los archivos a esta carpeta
-  return uploadFiles(filesToUpload, dropboxFolderName.str());
-}
-
-// Funciones de conveniencia para usar desde main.cpp
-bool uploadFolderContents(const std::string &folderPath, bool onlyZipFiles,
-                          UploadService service) {
-  DropboxUploader uploader;
-  if (!uploader.initialize()) {
-    cerr << "❌ Error inicializando conexión a Dropbox." << endl;
-    return false;
-  }
-  return uploader.uploadFolderContents(folderPath, onlyZipFiles);
-}
-
-bool uploadFileList(const std::vector<std::string> &filePaths,
-                    UploadService service) {
-  DropboxUploader uploader;
-  if (!uploader.initialize()) {
-    cerr << "❌ Error inicializando conexión a Dropbox." << endl;
-    return false;
-  }
-  return uploader.uploadFiles(filePaths);
-}
\ No newline at end of file
@@ -1,7 +1,10 @@
 #ifndef DROPBOX_UPLOADER_H
 #define DROPBOX_UPLOADER_H
 
+#include "http_client.h"
+#include "storage_backend.h"
 #include <filesystem>
+#include <jsoncpp/json/json.h>
 #include <string>
 #include <vector>
 
@@ -22,11 +25,8 @@ struct DropboxAuthConfig {
   std::string tokenExpiry;
 };
 
-// Enumeración para mantener compatibilidad con el código existente
-enum UploadService { DROPBOX };
-
-// Clase para manejar la subida a Dropbox
-class DropboxUploader {
+// Destino Dropbox: subida simple o por sesión, descarga, listado y borrado
+class DropboxUploader : public StorageBackend {
 private:
   DropboxAuthConfig authConfig;
   bool loadCredentials();
@@ -37,34 +37,48 @@ private:
   // Función interna para obtener URL compartida
   std::string createSharedLink(const std::string &path);
 
+  // Peticiones a los dos tipos de endpoint de la API v2
+  HttpResponse apiCall(const std::string &endpoint, const Json::Value &args);
+  HttpResponse contentCall(const std::string &endpoint,
+                           const Json::Value &args, const char *data,
+                           size_t size,
+                           const std::vector<std::string> &extraHeaders = {});
+
 public:
   DropboxUploader();
   ~DropboxUploader();
 
+  std::string name() const override { return "dropbox"; }
+
   // Inicializar y verificar credenciales
-  bool initialize();
+  bool initialize() override;
 
-  // Subir un archivo a Dropbox
+  // Subir un archivo a Dropbox y obtener su enlace compartido
   DropboxUploadResponse uploadFile(const std::string &filePath,
                                    const std::string &folderPath = "");
 
   // Crear una carpeta en Dropbox
   bool createFolder(const std::string &folderPath);
 
-  // Subir múltiples archivos a una carpeta
-  bool uploadFiles(const std::vector<std::string> &filePaths,
-                   const std::string &folderPath = "");
-
-  // Subir todos los archivos de una carpeta local
-  bool uploadFolderContents(const std::string &folderPath,
-                            bool onlyZipFiles = true);
+  // Interfaz StorageBackend
+  bool prepareFolder(const std::string &remoteFolder,
+                     std::string &error) override;
+  bool put(const std::string &remotePath, const char *data, size_t size,
+           std::string &error) override;
+  bool beginMultipart(const std::string &remotePath, MultipartUpload &upload,
+                      std::string &error) override;
+  bool uploadPart(MultipartUpload &upload, const char *data, size_t size,
+                  std::string &error) override;
+  bool completeMultipart(MultipartUpload &upload, std::string &error) override;
+  bool get(const std::string &remotePath, std::vector<char> &out,
+           std::string &error) override;
+  bool getRange(const std::string &remotePath, uint64_t offset,
+                uint64_t length, std::vector<char> &out,
+                std::string &error) override;
+  bool list(const std::string &remoteFolder,
+            std::vector<StorageObject> &objects, std::string &error) override;
+  bool remove(const std::string &remotePath, std::string &error) override;
+  std::string shareLink(const std::string &remotePath) override;
 };
 
-// Funciones de conveniencia para usar directamente desde main.cpp
-bool uploadFolderContents(const std::string &folderPath,
-                          bool onlyZipFiles = true,
-                          UploadService service = DROPBOX);
-bool uploadFileList(const std::vector<std::string> &filePaths,
-                    UploadService service = DROPBOX);
-
-#endif // DROPBOX_UPLOADER_H
\ No newline at end of file
+#endif // DROPBOX_UPLOADER_H
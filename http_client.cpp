@@ -0,0 +1,207 @@
+#include "http_client.h"
+#include "instrumentation.h"
+#include "logger.h"
+#include "transfer_policy.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <curl/curl.h>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+static std::mutex progressMutex;
+static std::once_flag curlInitFlag;
+
+// Callback para recibir datos de respuesta HTTP
+static size_t WriteCallback(void *contents, size_t size, size_t nmemb,
+                            string *s) {
+  throttleTransfer(size * nmemb);
+  s->append((char *)contents, size * nmemb);
+  return size * nmemb;
+}
+
+// Cuerpo de la petición entregado a curl por bloques, para poder aplicar el
+// límite de ancho de banda mientras se envía
+struct BodyReader {
+  const char *data;
+  size_t size;
+  size_t position = 0;
+};
+
+static size_t ReadCallback(char *buffer, size_t size, size_t nitems,
+                           BodyReader *reader) {
+  size_t len = min(size * nitems, reader->size - reader->position);
+  throttleTransfer(len);
+  memcpy(buffer, reader->data + reader->position, len);
+  reader->position += len;
+  return len;
+}
+
+// curl rebobina el cuerpo si tiene que reenviarlo (redirecciones, 401...)
+static int SeekCallback(BodyReader *reader, curl_off_t offset, int origin) {
+  if (origin != SEEK_SET || offset < 0 ||
+      static_cast<size_t>(offset) > reader->size) {
+    return CURL_SEEKFUNC_CANTSEEK;
+  }
+  reader->position = static_cast<size_t>(offset);
+  return CURL_SEEKFUNC_OK;
+}
+
+// Callback para guardar las cabeceras de la respuesta
+static size_t HeaderCallback(char *buffer, size_t size, size_t nitems,
+                             map<string, string> *headers) {
+  string line(buffer, size * nitems);
+  size_t colon = line.find(':');
+  if (colon != string::npos) {
+    string name = line.substr(0, colon);
+    string value = line.substr(colon + 1);
+    transform(name.begin(), name.end(), name.begin(), ::tolower);
+    value.erase(0, value.find_first_not_of(" \t"));
+    value.erase(value.find_last_not_of(" \t\r\n") + 1);
+    (*headers)[name] = value;
+  }
+  return size * nitems;
+}
+
+// Callback para mostrar progreso de subida
+static int ProgressCallback(void *clientp, curl_off_t dltotal,
+                            curl_off_t dlnow, curl_off_t ultotal,
+                            curl_off_t ulnow) {
+  if (ultotal == 0)
+    return 0;
+
+  static int lastPercent = 0;
+  int percent = static_cast<int>((ulnow * 100) / ultotal);
+
+  if (percent != lastPercent && percent % 5 == 0) {
+    std::lock_guard<std::mutex> guard(progressMutex);
+    lastPercent = percent;
+
+    int barWidth = 30;
+    int pos = barWidth * percent / 100;
+
+    std::cout << "\r[";
+    for (int i = 0; i < barWidth; ++i) {
+      if (i < pos)
+        std::cout << "=";
+      else if (i == pos)
+        std::cout << ">";
+      else
+        std::cout << " ";
+    }
+    std::cout << "] " << percent << "% " << std::flush;
+  }
+
+  return 0;
+}
+
+// Un único intento de la petición
+static HttpResponse performOnce(const HttpRequest &request) {
+  HttpResponse response;
+
+  // curl_global_init no es seguro entre hilos: hacerlo una sola vez
+  std::call_once(curlInitFlag, [] { curl_global_init(CURL_GLOBAL_ALL); });
+
+  CURL *curl = curl_easy_init();
+  if (!curl) {
+    response.error = "Error al inicializar curl";
+    return response;
+  }
+
+  BodyReader reader{request.body ? request.body : "", request.bodySize};
+
+  struct curl_slist *headers = NULL;
+  for (const auto &header : request.headers) {
+    headers = curl_slist_append(headers, header.c_str());
+  }
+
+  curl_easy_setopt(curl, CURLOPT_URL, request.url.c_str());
+  curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response.body);
+  curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, HeaderCallback);
+  curl_easy_setopt(curl, CURLOPT_HEADERDATA, &response.headers);
+
+  if (request.method == "GET") {
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+  } else {
+    if (request.method != "POST") {
+      curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, request.method.c_str());
+    }
+    // Sin cuerpo se envía igualmente un POST/PUT de longitud cero
+    curl_easy_setopt(curl, CURLOPT_POST, 1L);
+    curl_easy_setopt(curl, CURLOPT_READFUNCTION, ReadCallback);
+    curl_easy_setopt(curl, CURLOPT_READDATA, &reader);
+    curl_easy_setopt(curl, CURLOPT_SEEKFUNCTION, SeekCallback);
+    curl_easy_setopt(curl, CURLOPT_SEEKDATA, &reader);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE,
+                     static_cast<curl_off_t>(request.bodySize));
+  }
+
+  if (request.showProgress) {
+    curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+    curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, ProgressCallback);
+  }
+
+  CURLcode res;
+  {
+    ScopedStage timer(Stage::NETWORK, request.bodySize);
+    res = curl_easy_perform(curl);
+    timer.addBytes(response.body.size());
+  }
+  if (res != CURLE_OK) {
+    response.error = curl_easy_strerror(res);
+  }
+  curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response.status);
+
+  curl_slist_free_all(headers);
+  curl_easy_cleanup(curl);
+
+  if (request.showProgress) {
+    cout << endl; // Nueva línea después de la barra de progreso
+  }
+
+  return response;
+}
+
+HttpResponse performHttpRequest(const HttpRequest &request) {
+  const RetryPolicy &policy = transferRetryPolicy();
+  HttpResponse response;
+
+  for (int attempt = 1;; attempt++) {
+    response = performOnce(request);
+    if (response.ok() || !isRetryableResponse(response) ||
+        attempt >= policy.maxAttempts) {
+      return response;
+    }
+
+    // Los reintentos de todas las peticiones de una parte salen del mismo
+    // presupuesto; fuera de una parte solo cuenta maxAttempts
+    RetryBudget *budget = RetryBudget::current();
+    if (budget && !budget->consume()) {
+      LOG_ERROR("⚠️ Presupuesto de reintentos agotado: "
+                << describeHttpError(response));
+      return response;
+    }
+
+    double delay = retryDelaySeconds(attempt, response);
+    LOG_ERROR("⚠️ " << describeHttpError(response).substr(0, 80)
+                    << " — reintento " << attempt << "/"
+                    << policy.maxAttempts - 1 << " en " << fixed
+                    << setprecision(1) << delay << " s");
+    this_thread::sleep_for(chrono::duration<double>(delay));
+  }
+}
+
+string describeHttpError(const HttpResponse &response) {
+  if (!response.error.empty()) {
+    return response.error;
+  }
+  string body = response.body.substr(0, 300);
+  return "HTTP " + to_string(response.status) +
+         (body.empty() ? "" : ": " + body);
+}
@@ -0,0 +1,36 @@
+#ifndef HTTP_CLIENT_H
+#define HTTP_CLIENT_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+// Petición HTTP genérica usada por los backends de almacenamiento
+struct HttpRequest {
+  std::string method = "POST";
+  std::string url;
+  std::vector<std::string> headers;
+  const char *body = nullptr; // El buffer debe vivir hasta que termine
+  size_t bodySize = 0;
+  bool showProgress = false; // Barra de progreso de subida en consola
+};
+
+// Respuesta HTTP: código, cuerpo y cabeceras (con nombres en minúsculas)
+struct HttpResponse {
+  long status = 0;
+  std::string body;
+  std::map<std::string, std::string> headers;
+  std::string error; // Error de transporte (CURLcode), vacío si no hubo
+
+  bool ok() const { return error.empty() && status >= 200 && status < 300; }
+};
+
+// Ejecutar una petición con libcurl y devolver la respuesta completa. Los
+// fallos transitorios (transporte, 408, 429, 5xx) se reintentan con backoff
+// según transferRetryPolicy(), y el envío respeta el límite de ancho de banda
+HttpResponse performHttpRequest(const HttpRequest &request);
+
+// Describir una respuesta fallida para mensajes de error
+std::string describeHttpError(const HttpResponse &response);
+
+#endif // HTTP_CLIENT_H
@@ -0,0 +1,205 @@
+#include "instrumentation.h"
+#include <array>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+static const size_t STAGE_COUNT = static_cast<size_t>(Stage::COUNT);
+
+// Máximo de intervalos guardados por hilo para la traza
+static const size_t MAX_TRACE_EVENTS = 1 << 20;
+
+struct StageCounters {
+  uint64_t calls = 0;
+  uint64_t nanos = 0;
+  uint64_t bytes = 0;
+};
+
+struct TraceEvent {
+  Stage stage;
+  uint64_t startNanos;
+  uint64_t durationNanos;
+  uint64_t bytes;
+};
+
+// Contadores de un hilo. Solo los escribe su hilo; se leen al generar el
+// informe, cuando el trabajo ya terminó
+struct ThreadCounters {
+  int threadIndex;
+  array<StageCounters, STAGE_COUNT> stages;
+  vector<TraceEvent> events;
+};
+
+static atomic<bool> enabled{false};
+static atomic<bool> tracing{false};
+static steady_clock::time_point epoch = steady_clock::now();
+
+static mutex registryMutex;
+static vector<unique_ptr<ThreadCounters>> registry;
+static thread_local ThreadCounters *localCounters = nullptr;
+
+// Los contadores de cada hilo se registran en su primera medida y se
+// conservan aunque el hilo termine
+static ThreadCounters &countersForThisThread() {
+  if (!localCounters) {
+    lock_guard<mutex> lock(registryMutex);
+    registry.push_back(make_unique<ThreadCounters>());
+    registry.back()->threadIndex = static_cast<int>(registry.size()) - 1;
+    localCounters = registry.back().get();
+  }
+  return *localCounters;
+}
+
+const char *stageName(Stage stage) {
+  static const char *names[] = {
+      "walk",     "stat",    "estimate", "read",    "encrypt",
+      "zip_add",  "zip_close", "deflate", "train", "delta",
+      "hash",     "zip_open", "inflate", "decrypt", "write",
+      "queue_wait", "upload", "network"};
+  return names[static_cast<size_t>(stage)];
+}
+
+void enableInstrumentation(bool trace) {
+  epoch = steady_clock::now();
+  tracing = trace;
+  enabled = true;
+}
+
+bool instrumentationEnabled() {
+  return enabled.load(memory_order_relaxed);
+}
+
+void resetInstrumentation() {
+  lock_guard<mutex> lock(registryMutex);
+  for (auto &counters : registry) {
+    counters->stages = {};
+    counters->events.clear();
+  }
+  epoch = steady_clock::now();
+}
+
+void recordStage(Stage stage, steady_clock::time_point start,
+                 steady_clock::time_point end, uint64_t bytes) {
+  ThreadCounters &counters = countersForThisThread();
+  uint64_t nanos = duration_cast<nanoseconds>(end - start).count();
+  StageCounters &stats = counters.stages[static_cast<size_t>(stage)];
+  stats.calls++;
+  stats.nanos += nanos;
+  stats.bytes += bytes;
+
+  if (tracing.load(memory_order_relaxed) &&
+      counters.events.size() < MAX_TRACE_EVENTS) {
+    uint64_t startNanos =
+        start > epoch ? duration_cast<nanoseconds>(start - epoch).count() : 0;
+    counters.events.push_back({stage, startNanos, nanos, bytes});
+  }
+}
+
+static Json::Value stageJson(const StageCounters &stats) {
+  Json::Value value;
+  double seconds = stats.nanos / 1e9;
+  value["calls"] = static_cast<Json::UInt64>(stats.calls);
+  value["seconds"] = seconds;
+  value["bytes"] = static_cast<Json::UInt64>(stats.bytes);
+  if (stats.bytes > 0 && seconds > 0) {
+    value["mb_per_s"] = stats.bytes / (1024.0 * 1024.0) / seconds;
+  }
+  return value;
+}
+
+Json::Value instrumentationReport(double wallSeconds) {
+  Json::Value report;
+  report["wall_seconds"] = wallSeconds;
+  report["stages"] = Json::objectValue;
+  report["threads"] = Json::arrayValue;
+
+  array<StageCounters, STAGE_COUNT> totals{};
+  {
+    lock_guard<mutex> lock(registryMutex);
+    for (const auto &counters : registry) {
+      Json::Value thread;
+      thread["thread"] = counters->threadIndex;
+      thread["stages"] = Json::objectValue;
+      for (size_t s = 0; s < STAGE_COUNT; s++) {
+        const StageCounters &stats = counters->stages[s];
+        if (stats.calls == 0) {
+          continue;
+        }
+        thread["stages"][stageName(static_cast<Stage>(s))] = stageJson(stats);
+        totals[s].calls += stats.calls;
+        totals[s].nanos += stats.nanos;
+        totals[s].bytes += stats.bytes;
+      }
+      if (!thread["stages"].empty()) {
+        report["threads"].append(thread);
+      }
+    }
+  }
+
+  for (size_t s = 0; s < STAGE_COUNT; s++) {
+    if (totals[s].calls > 0) {
+      report["stages"][stageName(static_cast<Stage>(s))] =
+          stageJson(totals[s]);
+    }
+  }
+  return report;
+}
+
+bool writeInstrumentationReport(const string &path, double wallSeconds) {
+  Json::Value report = instrumentationReport(wallSeconds);
+  ofstream out(path);
+  if (!out) {
+    cerr << "No se pudo escribir el informe de etapas en " << path << endl;
+    return false;
+  }
+  Json::StreamWriterBuilder writer;
+  writer["indentation"] = "  ";
+  out << Json::writeString(writer, report) << endl;
+  cout << "📊 Informe de etapas guardado en " << path << endl;
+  return true;
+}
+
+bool writeChromeTrace(const string &path) {
+  ofstream out(path);
+  if (!out) {
+    cerr << "No se pudo escribir la traza en " << path << endl;
+    return false;
+  }
+
+  // Se escribe a mano: con muchos eventos, construir un Json::Value
+  // completo duplicaría la memoria de la traza
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  bool first = true;
+  size_t dropped = 0;
+  lock_guard<mutex> lock(registryMutex);
+  for (const auto &counters : registry) {
+    out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\","
+        << "\"pid\":1,\"tid\":" << counters->threadIndex
+        << ",\"args\":{\"name\":\"hilo " << counters->threadIndex << "\"}}";
+    first = false;
+    for (const auto &event : counters->events) {
+      out << ",\n{\"name\":\"" << stageName(event.stage)
+          << "\",\"cat\":\"backup\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+          << counters->threadIndex << ",\"ts\":" << event.startNanos / 1000.0
+          << ",\"dur\":" << event.durationNanos / 1000.0
+          << ",\"args\":{\"bytes\":" << event.bytes << "}}";
+    }
+    if (counters->events.size() >= MAX_TRACE_EVENTS) {
+      dropped++;
+    }
+  }
+  out << "\n]}\n";
+
+  if (dropped > 0) {
+    cerr << "⚠️ La traza de " << dropped
+         << " hilos se truncó al máximo de eventos" << endl;
+  }
+  cout << "🕒 Traza guardada en " << path << endl;
+  return true;
+}
@@ -0,0 +1,110 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <chrono>
+#include <cstdint>
+#include <jsoncpp/json/json.h>
+#include <string>
+
+// Etapas medidas del proceso de respaldo y restauración
+enum class Stage {
+  WALK,       // Recorrido del directorio y filtro de .ignore
+  STAT,       // Consultas de tamaño (file_size)
+  ESTIMATE,   // Estimación del tamaño comprimido al planificar las partes
+  READ,       // Lectura de archivos de origen
+  ENCRYPT,    // SimpleCrypto::encrypt
+  ZIP_ADD,    // Registro de entradas en el ZIP (zip_file_add)
+  ZIP_CLOSE,  // Deflate y escritura de la parte dentro de zip_close
+  DEFLATE,    // Compresión de bloques del formato nativo
+  TRAIN,      // Entrenamiento de diccionarios del formato nativo
+  DELTA,      // Firmas y búsqueda de bloques de la copia base
+  HASH,       // Hash de contenido de las partes
+  ZIP_OPEN,   // Apertura e índice de partes al descomprimir
+  INFLATE,    // Lectura y descompresión de entradas (zip_fread)
+  DECRYPT,    // SimpleCrypto::decrypt
+  WRITE,      // Escritura de archivos restaurados
+  QUEUE_WAIT, // Esperas en la cola de subida (productor o consumidor)
+  UPLOAD,     // Subida completa de una parte al destino
+  NETWORK,    // Peticiones HTTP individuales
+  COUNT
+};
+
+// Nombre corto de una etapa, usado en el informe y en la traza
+const char *stageName(Stage stage);
+
+/**
+ * Activa la recogida de contadores. Mientras esté desactivada, los
+ * temporizadores no consultan el reloj y su coste es una comprobación.
+ *
+ * @param trace Si es true, guarda además cada intervalo para la traza
+ */
+void enableInstrumentation(bool trace = false);
+
+bool instrumentationEnabled();
+
+// Poner a cero todos los contadores y la traza (entre casos de benchmark)
+void resetInstrumentation();
+
+// Registrar una medida ya tomada en los contadores del hilo actual
+void recordStage(Stage stage, std::chrono::steady_clock::time_point start,
+                 std::chrono::steady_clock::time_point end, uint64_t bytes);
+
+/**
+ * Temporizador de ámbito: mide desde su creación hasta su destrucción y lo
+ * suma a los contadores del hilo que lo creó, sin bloqueos.
+ */
+class ScopedStage {
+private:
+  Stage stage;
+  uint64_t bytes;
+  bool active;
+  std::chrono::steady_clock::time_point start;
+
+public:
+  explicit ScopedStage(Stage stage, uint64_t bytes = 0)
+      : stage(stage), bytes(bytes), active(instrumentationEnabled()) {
+    if (active) {
+      start = std::chrono::steady_clock::now();
+    }
+  }
+
+  ~ScopedStage() {
+    if (active) {
+      recordStage(stage, start, std::chrono::steady_clock::now(), bytes);
+    }
+  }
+
+  // Añadir bytes procesados cuando no se conocen al empezar
+  void addBytes(uint64_t count) { bytes += count; }
+
+  ScopedStage(const ScopedStage &) = delete;
+  ScopedStage &operator=(const ScopedStage &) = delete;
+};
+
+/**
+ * Construye el informe: por etapa, llamadas, segundos acumulados, bytes y
+ * MB/s, en total y desglosado por hilo.
+ *
+ * @param wallSeconds Duración real de la operación (para comparar)
+ */
+Json::Value instrumentationReport(double wallSeconds);
+
+/**
+ * Escribe el informe de instrumentationReport en un archivo JSON.
+ *
+ * @param path Archivo de destino
+ * @param wallSeconds Duración real de la operación (para comparar)
+ * @return true si se pudo escribir
+ */
+bool writeInstrumentationReport(const std::string &path, double wallSeconds);
+
+/**
+ * Escribe la línea de tiempo en formato Chrome trace (chrome://tracing o
+ * Perfetto). Solo tiene contenido si se activó con trace = true.
+ *
+ * @param path Archivo de destino
+ * @return true si se pudo escribir
+ */
+bool writeChromeTrace(const std::string &path);
+
+#endif // INSTRUMENTATION_H
@@ -0,0 +1,280 @@
+#include "logger.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+atomic<int> currentLogLevel{static_cast<int>(LogLevel::PROGRESS)};
+
+struct LogEntry {
+  uint64_t sequence = 0;
+  LogStream stream = LogStream::OUT;
+  string text;
+};
+
+// Anillo de un solo productor (el hilo dueño) y un solo consumidor (el
+// escritor). Sin bloqueos: cada lado solo escribe su propio índice
+class LogRing {
+private:
+  static const size_t CAPACITY = 4096;
+  array<LogEntry, CAPACITY> slots;
+  atomic<size_t> head{0}; // Siguiente a leer (escritor)
+  atomic<size_t> tail{0}; // Siguiente a escribir (productor)
+
+public:
+  bool push(LogEntry &&entry) {
+    size_t t = tail.load(memory_order_relaxed);
+    if (t - head.load(memory_order_acquire) == CAPACITY) {
+      return false;
+    }
+    slots[t % CAPACITY] = std::move(entry);
+    tail.store(t + 1, memory_order_release);
+    return true;
+  }
+
+  bool pop(LogEntry &entry) {
+    size_t h = head.load(memory_order_relaxed);
+    if (h == tail.load(memory_order_acquire)) {
+      return false;
+    }
+    entry = std::move(slots[h % CAPACITY]);
+    head.store(h + 1, memory_order_release);
+    return true;
+  }
+};
+
+// Estado de la línea de progreso; los contadores se actualizan sin bloqueo
+struct ProgressState {
+  atomic<bool> active{false};
+  mutex labelMutex; // La etiqueta y los totales cambian entre operaciones
+  string label;
+  uint64_t totalItems = 0;
+  uint64_t totalBytes = 0;
+  atomic<uint64_t> items{0};
+  atomic<uint64_t> bytes{0};
+  steady_clock::time_point start;
+};
+
+class AsyncLogger {
+private:
+  mutex registryMutex;
+  vector<unique_ptr<LogRing>> rings;
+  atomic<uint64_t> nextSequence{0};
+  atomic<uint64_t> written{0};
+  atomic<bool> stopping{false};
+  thread writer;
+  once_flag startFlag;
+  bool interactive = isatty(STDOUT_FILENO);
+  bool progressShown = false; // Solo lo usa el hilo escritor
+
+  void writerLoop();
+  size_t drain();
+  void drawProgress();
+  void clearProgress();
+
+public:
+  ProgressState progress;
+
+  ~AsyncLogger() {
+    if (writer.joinable()) {
+      stopping = true;
+      writer.join();
+    }
+  }
+
+  LogRing &ringForThisThread();
+  void submit(LogStream stream, string &&text);
+  void flush();
+};
+
+static AsyncLogger logger;
+static thread_local LogRing *localRing = nullptr;
+
+LogRing &AsyncLogger::ringForThisThread() {
+  if (!localRing) {
+    lock_guard<mutex> lock(registryMutex);
+    rings.push_back(make_unique<LogRing>());
+    localRing = rings.back().get();
+  }
+  return *localRing;
+}
+
+void AsyncLogger::submit(LogStream stream, string &&text) {
+  call_once(startFlag,
+            [this] { writer = thread(&AsyncLogger::writerLoop, this); });
+
+  LogEntry entry;
+  entry.sequence = nextSequence.fetch_add(1, memory_order_relaxed);
+  entry.stream = stream;
+  entry.text = std::move(text);
+
+  // Con el anillo lleno, ceder el procesador hasta que el escritor avance
+  LogRing &ring = ringForThisThread();
+  while (!ring.push(std::move(entry))) {
+    this_thread::yield();
+  }
+}
+
+void AsyncLogger::flush() {
+  uint64_t target = nextSequence.load();
+  while (written.load() < target && writer.joinable()) {
+    this_thread::sleep_for(milliseconds(1));
+  }
+  cout.flush();
+  cerr.flush();
+}
+
+void AsyncLogger::clearProgress() {
+  if (progressShown) {
+    cout << "\r\033[K";
+    progressShown = false;
+  }
+}
+
+void AsyncLogger::drawProgress() {
+  if (!interactive || !progress.active || !logEnabled(LogLevel::PROGRESS)) {
+    return;
+  }
+  lock_guard<mutex> lock(progress.labelMutex);
+  uint64_t items = progress.items.load(memory_order_relaxed);
+  uint64_t bytes = progress.bytes.load(memory_order_relaxed);
+  double seconds =
+      duration<double>(steady_clock::now() - progress.start).count();
+  double mb = bytes / (1024.0 * 1024.0);
+
+  cout << "\r\033[K" << progress.label << ": " << items;
+  if (progress.totalItems > 0) {
+    cout << "/" << progress.totalItems;
+  }
+  cout << " · " << fixed << setprecision(1) << mb << " MB";
+  if (progress.totalBytes > 0) {
+    cout << " (" << setprecision(0)
+         << min(100.0, 100.0 * bytes / progress.totalBytes) << "%)";
+  }
+  if (seconds > 0) {
+    cout << " · " << setprecision(1) << mb / seconds << " MB/s";
+  }
+  cout.flush();
+  progressShown = true;
+}
+
+size_t AsyncLogger::drain() {
+  vector<LogRing *> snapshot;
+  {
+    lock_guard<mutex> lock(registryMutex);
+    for (auto &ring : rings) {
+      snapshot.push_back(ring.get());
+    }
+  }
+
+  // Juntar lo disponible de todos los hilos y escribirlo en el orden en que
+  // se generó
+  vector<LogEntry> batch;
+  LogEntry entry;
+  for (LogRing *ring : snapshot) {
+    while (ring->pop(entry)) {
+      batch.push_back(std::move(entry));
+    }
+  }
+  if (batch.empty()) {
+    return 0;
+  }
+  sort(batch.begin(), batch.end(), [](const auto &a, const auto &b) {
+    return a.sequence < b.sequence;
+  });
+
+  clearProgress();
+  for (const auto &line : batch) {
+    if (line.stream == LogStream::ERR) {
+      cout.flush();
+      cerr << line.text << '\n';
+      cerr.flush();
+    } else {
+      cout << line.text << '\n';
+    }
+  }
+  cout.flush();
+  written.fetch_add(batch.size());
+  return batch.size();
+}
+
+void AsyncLogger::writerLoop() {
+  auto lastDraw = steady_clock::now();
+  while (true) {
+    bool stop = stopping.load();
+    size_t count = drain();
+
+    auto now = steady_clock::now();
+    if (count > 0 || now - lastDraw > milliseconds(200)) {
+      drawProgress();
+      lastDraw = now;
+    }
+    if (stop && count == 0) {
+      clearProgress();
+      cout.flush();
+      return;
+    }
+    if (count == 0) {
+      this_thread::sleep_for(milliseconds(10));
+    }
+  }
+}
+
+void setLogLevel(LogLevel level) {
+  currentLogLevel.store(static_cast<int>(level));
+}
+
+void logMessage(LogStream stream, string &&text) {
+  logger.submit(stream, std::move(text));
+}
+
+void logFlush() { logger.flush(); }
+
+void progressBegin(const string &label, uint64_t totalItems,
+                   uint64_t totalBytes) {
+  ProgressState &progress = logger.progress;
+  logFlush();
+  lock_guard<mutex> lock(progress.labelMutex);
+  progress.label = label;
+  progress.totalItems = totalItems;
+  progress.totalBytes = totalBytes;
+  progress.items = 0;
+  progress.bytes = 0;
+  progress.start = steady_clock::now();
+  progress.active = true;
+}
+
+void progressAdvance(uint64_t items, uint64_t bytes) {
+  ProgressState &progress = logger.progress;
+  progress.items.fetch_add(items, memory_order_relaxed);
+  progress.bytes.fetch_add(bytes, memory_order_relaxed);
+}
+
+void progressEnd() {
+  ProgressState &progress = logger.progress;
+  if (!progress.active) {
+    return;
+  }
+  double seconds =
+      duration<double>(steady_clock::now() - progress.start).count();
+  double mb = progress.bytes.load() / (1024.0 * 1024.0);
+  ostringstream summary;
+  summary << progress.label << ": " << progress.items.load() << " elementos, "
+          << fixed << setprecision(1) << mb << " MB en " << setprecision(2)
+          << seconds << " s";
+  if (seconds > 0) {
+    summary << " (" << setprecision(1) << mb / seconds << " MB/s)";
+  }
+  progress.active = false;
+  LOG_INFO(summary.str());
+  logFlush();
+}
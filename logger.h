@@ -0,0 +1,72 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <atomic>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+// Niveles de detalle de la salida por consola
+enum class LogLevel {
+  QUIET = 0,    // Solo errores y avisos
+  PROGRESS = 1, // Hitos y una línea de progreso agregada (por defecto)
+  DEBUG = 2     // Además, una línea por archivo, fragmento y parte
+};
+
+// Flujo de destino de un mensaje
+enum class LogStream { OUT, ERR };
+
+extern std::atomic<int> currentLogLevel;
+
+// Comprobación barata usada por las macros antes de formatear nada
+inline bool logEnabled(LogLevel level) {
+  return static_cast<int>(level) <=
+         currentLogLevel.load(std::memory_order_relaxed);
+}
+
+void setLogLevel(LogLevel level);
+
+/**
+ * Encola un mensaje en el anillo del hilo actual. Un hilo de fondo lo
+ * escribe en orden de llegada, de modo que los hilos de trabajo nunca
+ * esperan a la consola (salvo que su anillo esté lleno).
+ *
+ * @param stream Flujo de destino
+ * @param text Línea sin salto final
+ */
+void logMessage(LogStream stream, std::string &&text);
+
+// Esperar a que todo lo encolado hasta ahora esté escrito
+void logFlush();
+
+/**
+ * Inicia la línea de progreso agregada. Mientras esté activa, el escritor
+ * la redibuja en la misma línea de la terminal.
+ *
+ * @param label Operación en curso ("Comprimiendo", "Extrayendo"...)
+ * @param totalItems Elementos esperados (0 si se desconoce)
+ * @param totalBytes Bytes esperados (0 si se desconoce)
+ */
+void progressBegin(const std::string &label, uint64_t totalItems,
+                   uint64_t totalBytes);
+
+// Sumar elementos y bytes terminados (sin bloqueos, desde cualquier hilo)
+void progressAdvance(uint64_t items, uint64_t bytes);
+
+// Cerrar la línea de progreso e imprimir el resumen final
+void progressEnd();
+
+#define LOG_AT(level, stream, expr)                                            \
+  do {                                                                         \
+    if (logEnabled(level)) {                                                   \
+      std::ostringstream logLine_;                                             \
+      logLine_ << expr;                                                        \
+      logMessage(stream, logLine_.str());                                      \
+    }                                                                          \
+  } while (0)
+
+#define LOG_ERROR(expr) LOG_AT(LogLevel::QUIET, LogStream::ERR, expr)
+#define LOG_INFO(expr) LOG_AT(LogLevel::PROGRESS, LogStream::OUT, expr)
+#define LOG_DEBUG(expr) LOG_AT(LogLevel::DEBUG, LogStream::OUT, expr)
+
+#endif // LOGGER_H
@@ -0,0 +1,194 @@
+#include "low_impact.h"
+#include "logger.h"
+#include "transfer_policy.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace std;
+
+// Valores de ioprio_set (linux/ioprio.h no está en todas las distribuciones)
+static const int IOPRIO_WHO_PROCESS = 1;
+static const int IOPRIO_CLASS_SHIFT = 13;
+
+// Presión (% de tiempo con tareas esperando, media de 10 s) por debajo de
+// la cual la pausa se reduce y por encima de la cual se duplica
+static const double PRESSURE_LOW = 10.0;
+static const double PRESSURE_HIGH = 30.0;
+
+// Pausa por bloque de E/S en modo adaptativo
+static const int MIN_PAUSE_MS = 10;
+static const int MAX_PAUSE_MS = 1000;
+
+// Cada cuánto se vuelve a medir la presión
+static const chrono::milliseconds PRESSURE_INTERVAL(1000);
+
+static ImpactConfig globalImpact;
+static TokenBucket diskBucket;
+static atomic<bool> diskThrottled{false};
+static atomic<int> pauseMs{0};
+static atomic<int64_t> nextCheck{0};
+
+ImpactConfig &impactConfig() { return globalImpact; }
+
+bool parseIoPriority(const string &text, ImpactConfig &config) {
+  if (text == "idle") {
+    config.ioClass = 3;
+    return true;
+  }
+  if (text == "be") {
+    config.ioClass = 2;
+    return true;
+  }
+  if (text.size() == 4 && text.compare(0, 3, "be:") == 0 && text[3] >= '0' &&
+      text[3] <= '7') {
+    config.ioClass = 2;
+    config.ioLevel = text[3] - '0';
+    return true;
+  }
+  return false;
+}
+
+bool parseNiceLevel(const string &text, ImpactConfig &config) {
+  try {
+    size_t used = 0;
+    int value = stoi(text, &used);
+    if (used != text.size() || value < -20 || value > 19) {
+      return false;
+    }
+    config.niceSet = true;
+    config.niceLevel = value;
+    return true;
+  } catch (const exception &) {
+    return false;
+  }
+}
+
+bool parseDiskLimit(const string &text, ImpactConfig &config) {
+  try {
+    size_t used = 0;
+    double megabytes = stod(text, &used);
+    if (used != text.size() || megabytes <= 0) {
+      return false;
+    }
+    config.diskBytesPerSecond =
+        static_cast<uint64_t>(megabytes * 1024 * 1024);
+    return true;
+  } catch (const exception &) {
+    return false;
+  }
+}
+
+// "some avg10" de un archivo de /proc/pressure; -1 si no existe (núcleos
+// sin PSI)
+static double readPressure(const char *path) {
+  ifstream file(path);
+  string line;
+  while (getline(file, line)) {
+    if (line.compare(0, 5, "some ") != 0) {
+      continue;
+    }
+    size_t pos = line.find("avg10=");
+    if (pos != string::npos) {
+      return atof(line.c_str() + pos + 6);
+    }
+  }
+  return -1;
+}
+
+// Presión del sistema en %: la mayor de CPU y E/S según PSI o, sin PSI, la
+// carga media de 1 minuto por encima del número de núcleos
+static double systemPressure() {
+  double pressure = max(readPressure("/proc/pressure/io"),
+                        readPressure("/proc/pressure/cpu"));
+  if (pressure >= 0) {
+    return pressure;
+  }
+  double load = 0;
+  ifstream loadavg("/proc/loadavg");
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  if (!(loadavg >> load) || cores <= 0) {
+    return 0;
+  }
+  return max(0.0, (load / cores - 1.0) * 100.0);
+}
+
+// Recalcular la pausa si toca. Solo un hilo mide en cada intervalo; la
+// propia copia también genera presión, así que la pausa oscila alrededor
+// del punto en que el sistema deja de notarla
+static void updatePause() {
+  int64_t now = chrono::duration_cast<chrono::milliseconds>(
+                    chrono::steady_clock::now().time_since_epoch())
+                    .count();
+  int64_t due = nextCheck.load();
+  if (now < due || !nextCheck.compare_exchange_strong(
+                       due, now + PRESSURE_INTERVAL.count())) {
+    return;
+  }
+
+  double pressure = systemPressure();
+  int pause = pauseMs.load();
+  int updated = pause;
+  if (pressure > PRESSURE_HIGH) {
+    updated = min(MAX_PAUSE_MS, max(MIN_PAUSE_MS, pause * 2));
+  } else if (pressure < PRESSURE_LOW) {
+    updated = pause / 2 < MIN_PAUSE_MS ? 0 : pause / 2;
+  }
+  if (updated != pause) {
+    pauseMs = updated;
+    LOG_DEBUG("Presión del sistema " << pressure << "%: pausa de " << updated
+                                     << " ms por bloque de E/S");
+  }
+}
+
+bool applyImpactConfig() {
+  bool ok = true;
+  const ImpactConfig &config = globalImpact;
+
+#ifdef SYS_ioprio_set
+  if (config.ioClass != 0) {
+    int data = config.ioClass == 2 ? config.ioLevel : 0;
+    if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0,
+                (config.ioClass << IOPRIO_CLASS_SHIFT) | data) != 0) {
+      LOG_ERROR("No se pudo fijar la prioridad de E/S: " << strerror(errno));
+      ok = false;
+    }
+  }
+#endif
+
+  if (config.niceSet && setpriority(PRIO_PROCESS, 0, config.niceLevel) != 0) {
+    LOG_ERROR("No se pudo fijar la prioridad de CPU (nice "
+              << config.niceLevel << "): " << strerror(errno));
+    ok = false;
+  }
+
+  diskBucket.setRate(config.diskBytesPerSecond);
+  diskThrottled = config.diskBytesPerSecond > 0;
+  if (config.adaptive) {
+    LOG_INFO("Modo adaptativo: la E/S se frena cuando sube la presión del "
+             "sistema");
+  }
+  return ok;
+}
+
+void throttleDisk(size_t bytes) {
+  if (diskThrottled) {
+    diskBucket.acquire(bytes);
+  }
+  if (!globalImpact.adaptive) {
+    return;
+  }
+  updatePause();
+  int pause = pauseMs.load();
+  if (pause > 0) {
+    this_thread::sleep_for(chrono::milliseconds(pause));
+  }
+}
@@ -0,0 +1,71 @@
+#ifndef LOW_IMPACT_H
+#define LOW_IMPACT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * Opciones para que la copia moleste lo menos posible a los servicios que
+ * corren en el mismo equipo.
+ */
+struct ImpactConfig {
+  int ioClass = 0;       // Clase de E/S: 0 = sin cambio, 2 = normal, 3 = ociosa
+  int ioLevel = 4;       // Nivel dentro de la clase normal (0-7)
+  bool niceSet = false;  // Si se fijó -N
+  int niceLevel = 0;     // Prioridad de CPU (nice)
+  uint64_t diskBytesPerSecond = 0; // Tope de lectura + escritura (0 = no)
+  bool adaptive = false; // Frenar cuando sube la presión del sistema
+};
+
+// Configuración global usada por compresión y descompresión
+ImpactConfig &impactConfig();
+
+/**
+ * Interpreta la clase de E/S de -P: "idle" o "be" con nivel opcional
+ * ("be:7").
+ *
+ * @param text Texto a interpretar
+ * @param config Configuración a actualizar si es válido
+ * @return true si el texto es válido
+ */
+bool parseIoPriority(const std::string &text, ImpactConfig &config);
+
+/**
+ * Interpreta el nice de -N (de -20 a 19; los negativos requieren
+ * privilegios).
+ *
+ * @param text Texto a interpretar
+ * @param config Configuración a actualizar si es válido
+ * @return true si es un entero en el rango
+ */
+bool parseNiceLevel(const std::string &text, ImpactConfig &config);
+
+/**
+ * Interpreta el tope de disco de -L en MB/s (admite decimales).
+ *
+ * @param text Texto a interpretar
+ * @param config Configuración a actualizar si es válido
+ * @return true si es un número mayor que 0
+ */
+bool parseDiskLimit(const std::string &text, ImpactConfig &config);
+
+/**
+ * Aplica la clase de E/S y el nice de impactConfig() al hilo que llama y
+ * activa el tope de disco. Hay que llamarla antes de crear hilos: los de
+ * OpenMP y los de subida heredan la prioridad de quien los crea.
+ *
+ * @return false si alguna prioridad no se pudo aplicar (la copia sigue)
+ */
+bool applyImpactConfig();
+
+/**
+ * Espera lo necesario antes de leer o escribir bytes en disco: respeta el
+ * tope de -L y, en modo adaptativo, la pausa que marque la presión del
+ * sistema. Sin ninguno de los dos vuelve al momento.
+ *
+ * @param bytes Bytes que se van a leer o escribir
+ */
+void throttleDisk(size_t bytes);
+
+#endif // LOW_IMPACT_H
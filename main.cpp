@@ -1,9 +1,20 @@
+#include "auto_tune.h"
 #include "compress.h"
-#include "dropbox_uploader.h"
+#include "instrumentation.h"
+#include "logger.h"
+#include "low_impact.h"
+#include "native_format.h"
+#include "page_cache.h"
+#include "repository.h"
+#include "storage_backend.h"
+#include "thread_config.h"
+#include "transfer_policy.h"
+#include "upload_manager.h"
 #include <chrono>
 #include <filesystem>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 #include <omp.h>
 
 using namespace std;
@@ -17,10 +28,15 @@ struct PerformanceStats {
 };
 
 void showHelp(int maxSizeMB = 50) {
-  cout << "Uso: compressor -d [carpeta] -o [archivo_zip] [-s tamaño_MB] [-e "
-          "contraseña] [-p] [-u | -g]"
+  cout << "Uso: compressor -d [carpeta] [-d carpeta...] -o [archivo_zip] "
+          "[-s tamaño_MB] [-e contraseña] [-p] [-j hilos] "
+          "[-J e/s,comp,subida] [-a] [-D] [-P idle|be[:n]] [-N nice] "
+          "[-L MB/s] [-A] [-S] [-B [-k] [-c carpeta_base | -G repositorio "
+          "[-K días[,semanas]]]] [-u | -g] [-q | -v]"
+       << endl;
+  cout << "  -d : Directorio a comprimir; repetir para respaldar varios en "
+          "un mismo juego de partes (default: ./test)"
        << endl;
-  cout << "  -d : Directorio a comprimir (default: ./test)" << endl;
   cout << "  -o : Archivo ZIP de salida (default: "
           "./output/archivo_comprimido.zip)"
        << endl;
@@ -28,14 +44,76 @@ void showHelp(int maxSizeMB = 50) {
        << ")" << endl;
   cout << "  -e : Contraseña para encriptado (opcional)" << endl;
   cout << "  -p : Usar procesamiento paralelo (default: desactivado)" << endl;
+  cout << "  -j : Hilos de compresión/cifrado; implica -p (default: todos los "
+          "núcleos)"
+       << endl;
+  cout << "  -J : Hilos por etapa como E/S,compresión,subida (p. ej. 2,8,4; "
+          "default: -j,-j,1)"
+       << endl;
+  cout << "  -a : Calibrar hilos, nivel de compresión y partes en vuelo con "
+          "una muestra (se guarda en " TUNING_PROFILE_FILE ")"
+       << endl;
+  cout << "  -S : Empaquetar los archivos pequeños en bloques sólidos de "
+          "4 MB dentro de cada parte"
+       << endl;
+  cout << "  -B : Formato nativo por bloques (.bkp.001...) en lugar de ZIP "
+          "dividido"
+       << endl;
+  cout << "  -k : Con -B, comprimir los archivos pequeños con un diccionario "
+          "entrenado por extensión"
+       << endl;
+  cout << "  -c : Con -B, copia delta: guardar solo lo que cambió respecto a "
+          "la copia nativa de esta carpeta"
+       << endl;
+  cout << "  -G : Con -B, guardar la copia como una generación nueva de este "
+          "repositorio, incremental sobre la anterior"
+       << endl;
+  cout << "  -K : Con -G, conservar la última generación de los N días y M "
+          "semanas más recientes (N[,M])"
+       << endl;
+  cout << "  -D : Leer los archivos de origen con O_DIRECT, sin pasar por la "
+          "caché de páginas"
+       << endl;
+  cout << "  -P : Clase de E/S de todos los hilos: idle (solo con el disco "
+          "libre) o be[:0-7]"
+       << endl;
+  cout << "  -N : Prioridad de CPU (nice) de todos los hilos, de -20 a 19"
+       << endl;
+  cout << "  -L : Tope de lectura + escritura en disco en MB/s" << endl;
+  cout << "  -A : Frenar la E/S cuando sube la presión del sistema "
+          "(/proc/pressure o carga media)"
+       << endl;
   cout << "  -u : Subir archivos ZIP generados a Transfer.sh (default: "
           "desactivado)"
        << endl;
   cout << "  -g : Subir archivos ZIP generados a Google Drive (default: "
           "desactivado)"
        << endl;
+  cout << "  -t : Destino de subida: dropbox, local:/ruta o s3:bucket[/prefijo]"
+       << endl;
+  cout << "  -x : Con -u/-t, borrar cada parte local cuando se confirme su "
+          "subida"
+       << endl;
+  cout << "  -m : Con -u/-t, subir cada parte desde memoria sin escribirla "
+          "en disco"
+       << endl;
+  cout << "  -R : Carpeta remota fija; las partes que ya estén allí con el "
+          "mismo hash no se vuelven a subir"
+       << endl;
+  cout << "  -l : Límite global de ancho de banda en KB/s (default: sin "
+          "límite)"
+       << endl;
+  cout << "  -r : Reintentos permitidos por parte ante fallos transitorios "
+          "(default: 8)"
+       << endl;
+  cout << "  -I : Guardar un informe JSON con tiempo, bytes y MB/s por etapa"
+       << endl;
+  cout << "  -T : Guardar una traza de la ejecución en formato Chrome trace"
+       << endl;
   cout << "  -b : Ejecutar benchmark comparativo entre serial y paralelo"
        << endl;
+  cout << "  -q : Silencioso, solo errores y avisos" << endl;
+  cout << "  -v : Detallado, una línea por archivo, fragmento y parte" << endl;
   cout << "  -h : Mostrar esta ayuda" << endl;
 }
 
@@ -78,7 +156,7 @@ void showPerformanceComparison(const PerformanceStats &stats) {
        << endl;
 
   double speedup = stats.timeSerial / stats.timeParallel;
-  double efficiency = speedup / omp_get_max_threads() * 100.0;
+  double efficiency = speedup / compressThreadCount() * 100.0;
 
   cout << "║ Aceleración (Speedup)         ║ " << fixed << setprecision(2)
        << setw(15) << speedup << " ║                   ║" << endl;
@@ -88,7 +166,7 @@ void showPerformanceComparison(const PerformanceStats &stats) {
           "═════════╣"
        << endl;
   cout << "║ Núcleos utilizados            ║ " << setw(15)
-       << omp_get_max_threads() << " ║                   ║" << endl;
+       << compressThreadCount() << " ║                   ║" << endl;
   cout << "║ Total archivos procesados     ║ " << setw(15) << stats.totalFiles
        << " ║                   ║" << endl;
   cout << "║ Tamaño total (MB)             ║ " << setw(15)
@@ -104,14 +182,17 @@ void showPerformanceComparison(const PerformanceStats &stats) {
 }
 
 // Función para ejecutar benchmark
-PerformanceStats runBenchmark(const string &sourceDir, const string &outputZip,
-                              int maxSizeMB, const string &encryptPassword) {
-  PerformanceStats stats;
-  set<string> ignorePatterns = readIgnorePatterns(sourceDir);
-  vector<filesystem::path> allFiles = collectFiles(sourceDir, ignorePatterns);
+PerformanceStats runBenchmark(const vector<string> &sourceDirs,
+                              const string &outputZip, int maxSizeMB,
+                              const string &encryptPassword) {
+  PerformanceStats stats = {0, 0, 0, 0};
+  SourceFiles sources;
+  if (!collectSources(sourceDirs, sources)) {
+    return stats;
+  }
 
-  stats.totalFiles = allFiles.size();
-  stats.totalSize = calculateTotalSize(allFiles);
+  stats.totalFiles = sources.paths.size();
+  stats.totalSize = calculateTotalSize(sources.paths);
 
   cout << "\n▶ Ejecutando versión SERIAL para comparación..." << endl;
 
@@ -126,8 +207,8 @@ PerformanceStats runBenchmark(const string &sourceDir, const string &outputZip,
 
   // Medir tiempo de versión serial
   auto startSerial = high_resolution_clock::now();
-  bool successSerial = compressFolderToSplitZip(
-      sourceDir, serialOutput, maxSizeMB, encryptPassword, false);
+  bool successSerial = compressFoldersToSplitZip(
+      sourceDirs, serialOutput, maxSizeMB, encryptPassword, false);
   auto endSerial = high_resolution_clock::now();
   stats.timeSerial = duration<double>(endSerial - startSerial).count();
 
@@ -144,8 +225,8 @@ PerformanceStats runBenchmark(const string &sourceDir, const string &outputZip,
 
   // Medir tiempo de versión paralela
   auto startParallel = high_resolution_clock::now();
-  bool successParallel = compressFolderToSplitZip(
-      sourceDir, parallelOutput, maxSizeMB, encryptPassword, true);
+  bool successParallel = compressFoldersToSplitZip(
+      sourceDirs, parallelOutput, maxSizeMB, encryptPassword, true);
   auto endParallel = high_resolution_clock::now();
   stats.timeParallel = duration<double>(endParallel - startParallel).count();
 
@@ -156,75 +237,300 @@ int main(int argc, char *argv[]) {
   int maxSizeMB = 50;            // Tamaño máximo por fragmento en MB
   bool useParallel = false;      // Por defecto se usa procesamiento serial
   bool runBenchmarkFlag = false; // Flag para ejecutar benchmark
+  bool autoTune = false;         // Calibrar antes de comprimir
   bool uploadFlag = false;       // Flag para subir archivos - Nueva variable
   bool uploadToDrive = false;    // Nueva bandera para Google Drive
+  bool deleteAfterUpload = false; // Borrar partes locales ya subidas
+  bool streamFromMemory = false;  // Subir las partes sin escribirlas a disco
+  bool nativeFormat = false;      // Volúmenes por bloques en lugar de ZIP
+  NativeOptions nativeOptions;    // Diccionarios y copia base (con -B)
+  string repositoryPath = "";     // Repositorio de generaciones (con -B)
+  RetentionPolicy retention;      // Generaciones que se conservan
+  bool retentionSet = false;
+  bool solidMode = false;         // Bloques sólidos de archivos pequeños
+  UploadTarget uploadTarget;      // Destino de subida (Dropbox por defecto)
+  string remoteFolder = "";       // Carpeta remota fija (vacío = timestamp)
+  string stageReportPath = "";    // Informe JSON de tiempos por etapa
+  string tracePath = "";          // Traza en formato Chrome trace
 
   if (argc < 2) {
     showHelp(maxSizeMB);
     return 0;
   }
 
-  string sourceDir = "./test";
+  vector<string> sourceDirs; // Carpetas a respaldar (-d, repetible)
   string outputZip = "./output/archivo_comprimido.zip";
   string encryptPassword = "";
 
+  // El nivel de detalle se fija antes que nada para que se aplique también a
+  // los mensajes que se emiten al interpretar el resto de opciones
+  for (int i = 1; i < argc; i++) {
+    if (string(argv[i]) == "-q") {
+      setLogLevel(LogLevel::QUIET);
+    } else if (string(argv[i]) == "-v") {
+      setLogLevel(LogLevel::DEBUG);
+    }
+  }
+
   for (int i = 0; i < argc; i++) {
     if (string(argv[i]) == "-d" && i + 1 < argc) {
-      sourceDir = argv[i + 1];
+      sourceDirs.push_back(argv[i + 1]);
+      i++;
     } else if (string(argv[i]) == "-o" && i + 1 < argc) {
       outputZip = argv[i + 1];
+      i++;
     } else if (string(argv[i]) == "-s" && i + 1 < argc) {
       try {
         maxSizeMB = stoi(argv[i + 1]);
         if (maxSizeMB <= 0) {
-          cerr << "Error: El número de partes debe ser positivo" << endl;
+          LOG_ERROR("Error: El número de partes debe ser positivo");
           return 1;
         }
       } catch (const exception &e) {
-        cerr << "Error al interpretar el número de partes: " << e.what()
-             << endl;
+        LOG_ERROR("Error al interpretar el número de partes: " << e.what());
         return 1;
       }
+      i++;
     } else if (string(argv[i]) == "-e" && i + 1 < argc) {
       encryptPassword = argv[i + 1];
-      cout << "Modo encriptado habilitado" << endl;
+      LOG_INFO("Modo encriptado habilitado");
+      i++;
     } else if (string(argv[i]) == "-p") {
       useParallel = true;
-      cout << "Modo paralelo habilitado con " << omp_get_max_threads()
-           << " hilos" << endl;
+      LOG_INFO("Modo paralelo habilitado");
+    } else if (string(argv[i]) == "-j" && i + 1 < argc) {
+      if (!parseThreadCount(argv[i + 1], threadConfig().compressThreads)) {
+        LOG_ERROR("Error: -j requiere un número de hilos positivo");
+        return 1;
+      }
+      useParallel = threadConfig().compressThreads > 1 || useParallel;
+      i++;
+    } else if (string(argv[i]) == "-J" && i + 1 < argc) {
+      if (!parseStagePools(argv[i + 1], threadConfig())) {
+        LOG_ERROR("Error: -J espera hilos de E/S,compresión,subida, p. ej. "
+                  "2,8,4");
+        return 1;
+      }
+      useParallel = true;
+      i++;
+    } else if (string(argv[i]) == "-a") {
+      autoTune = true;
+    } else if (string(argv[i]) == "-B") {
+      nativeFormat = true;
+    } else if (string(argv[i]) == "-k") {
+      nativeOptions.dictionaries = true;
+    } else if (string(argv[i]) == "-c" && i + 1 < argc) {
+      nativeOptions.baseFolder = argv[i + 1];
+      i++;
+    } else if (string(argv[i]) == "-G" && i + 1 < argc) {
+      repositoryPath = argv[i + 1];
+      i++;
+    } else if (string(argv[i]) == "-K" && i + 1 < argc) {
+      if (!parseRetentionPolicy(argv[i + 1], retention)) {
+        LOG_ERROR("Error: -K espera días[,semanas], p. ej. 7,4");
+        return 1;
+      }
+      retentionSet = true;
+      i++;
+    } else if (string(argv[i]) == "-S") {
+      solidMode = true;
+    } else if (string(argv[i]) == "-D") {
+      setDirectIO(true);
+    } else if (string(argv[i]) == "-P" && i + 1 < argc) {
+      if (!parseIoPriority(argv[i + 1], impactConfig())) {
+        LOG_ERROR("Error: -P espera idle, be o be:0-7");
+        return 1;
+      }
+      i++;
+    } else if (string(argv[i]) == "-N" && i + 1 < argc) {
+      if (!parseNiceLevel(argv[i + 1], impactConfig())) {
+        LOG_ERROR("Error: -N espera un nice entre -20 y 19");
+        return 1;
+      }
+      i++;
+    } else if (string(argv[i]) == "-L" && i + 1 < argc) {
+      if (!parseDiskLimit(argv[i + 1], impactConfig())) {
+        LOG_ERROR("Error: -L espera un tope positivo en MB/s");
+        return 1;
+      }
+      i++;
+    } else if (string(argv[i]) == "-A") {
+      impactConfig().adaptive = true;
     } else if (string(argv[i]) == "-u" || string(argv[i]) == "-g") {
       uploadFlag = true;
-      cout << "Modo de subida habilitado: los archivos ZIP generados se "
-              "subirán a Google Drive"
-           << endl;
+      LOG_INFO("Modo de subida habilitado: los archivos ZIP generados se "
+               "subirán a Google Drive");
+    } else if (string(argv[i]) == "-t" && i + 1 < argc) {
+      if (!parseUploadTarget(argv[i + 1], uploadTarget)) {
+        LOG_ERROR("Error: destino de subida no válido: " << argv[i + 1]);
+        return 1;
+      }
+      uploadFlag = true;
+      i++;
+    } else if (string(argv[i]) == "-x") {
+      deleteAfterUpload = true;
+    } else if (string(argv[i]) == "-m") {
+      streamFromMemory = true;
+    } else if (string(argv[i]) == "-R" && i + 1 < argc) {
+      remoteFolder = argv[i + 1];
+      i++;
+    } else if (string(argv[i]) == "-I" && i + 1 < argc) {
+      stageReportPath = argv[i + 1];
+      i++;
+    } else if (string(argv[i]) == "-T" && i + 1 < argc) {
+      tracePath = argv[i + 1];
+      i++;
+    } else if (string(argv[i]) == "-l" && i + 1 < argc) {
+      try {
+        long limitKB = stol(argv[i + 1]);
+        if (limitKB < 0) {
+          LOG_ERROR(
+              "Error: El límite de ancho de banda no puede ser negativo");
+          return 1;
+        }
+        setBandwidthLimit(static_cast<uint64_t>(limitKB) * 1024);
+        LOG_INFO("Ancho de banda limitado a " << limitKB << " KB/s");
+      } catch (const exception &e) {
+        LOG_ERROR("Error al interpretar el límite de ancho de banda: "
+                  << e.what());
+        return 1;
+      }
+      i++;
+    } else if (string(argv[i]) == "-r" && i + 1 < argc) {
+      try {
+        int retries = stoi(argv[i + 1]);
+        if (retries < 0) {
+          LOG_ERROR("Error: El número de reintentos no puede ser negativo");
+          return 1;
+        }
+        transferRetryPolicy().retriesPerPart = retries;
+      } catch (const exception &e) {
+        LOG_ERROR("Error al interpretar el número de reintentos: " << e.what());
+        return 1;
+      }
+      i++;
     } else if (string(argv[i]) == "-b") {
       runBenchmarkFlag = true;
-      cout << "Modo benchmark activado: se ejecutarán versiones serial y "
-              "paralela para comparar"
-           << endl;
+      LOG_INFO("Modo benchmark activado: se ejecutarán versiones serial y "
+               "paralela para comparar");
     } else if (string(argv[i]) == "-h" || string(argv[i]) == "--help") {
       showHelp();
       return 0;
     }
   }
 
+  if (sourceDirs.empty()) {
+    sourceDirs.push_back("./test");
+  }
+  if (nativeOptions.dictionaries && !nativeFormat) {
+    LOG_ERROR("Error: -k solo se aplica al formato nativo (-B)");
+    return 1;
+  }
+  if (!nativeOptions.baseFolder.empty() && !nativeFormat) {
+    LOG_ERROR("Error: -c solo se aplica al formato nativo (-B)");
+    return 1;
+  }
+  if (!repositoryPath.empty() && !nativeFormat) {
+    LOG_ERROR("Error: -G solo se aplica al formato nativo (-B)");
+    return 1;
+  }
+  if (!repositoryPath.empty() && !nativeOptions.baseFolder.empty()) {
+    LOG_ERROR("Error: con -G la base es la última generación; no use -c");
+    return 1;
+  }
+  if (!repositoryPath.empty() && (streamFromMemory || deleteAfterUpload)) {
+    LOG_ERROR("Error: con -G las generaciones se guardan en el repositorio; "
+              "no use -m ni -x");
+    return 1;
+  }
+  if (runBenchmarkFlag && nativeFormat) {
+    LOG_ERROR("Error: -b compara las partes ZIP serie y paralela; no use -B "
+              "ni -G");
+    return 1;
+  }
+  if (retentionSet && repositoryPath.empty()) {
+    LOG_ERROR("Error: -K requiere un repositorio (-G)");
+    return 1;
+  }
+  if (solidMode && nativeFormat) {
+    LOG_ERROR("Error: -S solo se aplica a las partes ZIP; el formato nativo "
+              "ya agrupa por bloques");
+    return 1;
+  }
+  setSolidBlocks(solidMode);
+
+  // Antes de crear hilos: los de OpenMP y los de subida heredan prioridades
+  applyImpactConfig();
+
+  if (!stageReportPath.empty() || !tracePath.empty()) {
+    enableInstrumentation(!tracePath.empty());
+  }
+
+  // Calibración automática: usar el perfil guardado para este directorio y
+  // configuración o medir una muestra y guardarlo para las siguientes veces
+  SourceFiles sampleSources;
+  if (autoTune && collectSources(sourceDirs, sampleSources)) {
+    string key =
+        tuningProfileKey(sourceDirs, maxSizeMB, !encryptPassword.empty());
+    TuningProfile profile;
+    if (loadTuningProfile(TUNING_PROFILE_FILE, key, profile)) {
+      LOG_INFO("Usando la calibración guardada en " TUNING_PROFILE_FILE);
+    } else {
+      LOG_INFO("Calibrando con una muestra de "
+               << sampleSources.paths.size() << " archivos...");
+      profile = calibrate(sampleSources.paths,
+                          static_cast<size_t>(maxSizeMB) * 1024 * 1024,
+                          encryptPassword);
+      profile.key = key;
+      if (!saveTuningProfile(TUNING_PROFILE_FILE, profile)) {
+        LOG_ERROR("No se pudo guardar la calibración en " TUNING_PROFILE_FILE);
+      }
+    }
+    LOG_INFO("  Lectura " << fixed << setprecision(1) << profile.readMBps
+                          << " MB/s, deflate " << profile.deflateMBps
+                          << " MB/s por núcleo"
+                          << (profile.cryptoMBps > 0
+                                  ? ", cifrado " +
+                                        to_string(static_cast<int>(
+                                            profile.cryptoMBps)) +
+                                        " MB/s por núcleo"
+                                  : ""));
+    applyTuningProfile(profile);
+    useParallel = compressThreadCount() > 1 || useParallel;
+    LOG_INFO("  Elegido: " << compressThreadCount()
+                           << " hilos de compresión, nivel "
+                           << (compressionLevel() < 0
+                                   ? string("predeterminado")
+                                   : to_string(compressionLevel()))
+                           << ", "
+                           << bufferedPartCount() << " partes en vuelo");
+  }
+  auto runStart = high_resolution_clock::now();
+
   PerformanceStats stats = {0, 0, 0, 0};
   bool success = false;
 
+  // En un repositorio la copia va a la carpeta de una generación nueva
+  BackupGeneration generation;
+  if (!repositoryPath.empty() &&
+      !beginGeneration(repositoryPath, generation, outputZip, nativeOptions)) {
+    return 1;
+  }
+
   // Extraer la carpeta de salida desde la ruta del ZIP
   filesystem::path outputPath(outputZip);
   filesystem::path outputDir = outputPath.parent_path();
 
   if (runBenchmarkFlag) {
     // Ejecutar ambas versiones y mostrar comparativa
-    stats = runBenchmark(sourceDir, outputZip, maxSizeMB, encryptPassword);
+    stats = runBenchmark(sourceDirs, outputZip, maxSizeMB, encryptPassword);
     showPerformanceComparison(stats);
     success = true; // Ambas versiones se ejecutaron
 
     // Si además se solicitó subir los archivos, intentar subir ambas versiones
     if (uploadFlag) {
-      cout << "\n🔄 Iniciando proceso de subida de archivos ZIP generados..."
-           << endl;
+      LOG_INFO(
+          "\n🔄 Iniciando proceso de subida de archivos ZIP generados...");
 
       // Subir los archivos de la versión serial y paralela
       string serialOutputDir =
@@ -234,39 +540,110 @@ int main(int argc, char *argv[]) {
           outputDir
               .string(); // La carpeta donde se guardaron los archivos paralelos
 
-      cout << "\n📂 Subiendo archivos de la carpeta: " << outputDir.string()
-           << endl;
-      uploadFolderContents(outputDir.string(), true); // Solo archivos ZIP
+      LOG_INFO("\n📂 Subiendo archivos de la carpeta: " << outputDir.string());
+      uploadFolderContents(outputDir.string(), true, uploadTarget,
+                           remoteFolder); // Solo archivos ZIP
     }
   } else {
     // Ejecutar solo la versión seleccionada
-    cout << "Comprimiendo"
-         << (!encryptPassword.empty() ? " con encriptado" : "")
-         << (useParallel ? " (modo paralelo)..." : " (modo serial)...") << endl;
+    LOG_INFO("Comprimiendo"
+             << (!encryptPassword.empty() ? " con encriptado" : "")
+             << (useParallel ? " (modo paralelo)..." : " (modo serial)..."));
+
+    // Si se pidió subir, las partes se suben a medida que se cierran en
+    // lugar de esperar a que termine toda la compresión
+    unique_ptr<StorageBackend> backend;
+    unique_ptr<PartUploadQueue> uploadQueue;
+    PartSink sink;
+    if (uploadFlag) {
+      LOG_INFO("\n🔄 Preparando subida de partes en paralelo con la "
+               "compresión...");
+      backend = createStorageBackend(uploadTarget);
+      if (!backend || !backend->initialize()) {
+        LOG_ERROR("❌ Error inicializando el destino de subida.");
+        return 1;
+      }
+      uploadQueue = make_unique<PartUploadQueue>(
+          *backend,
+          remoteFolder.empty() ? remoteFolderNameFor(outputDir.string())
+                               : remoteFolder,
+          deleteAfterUpload, uploadThreadCount(),
+          bufferedPartCount()); // Por defecto, una por hilo y otra en espera
+      if (!uploadQueue->start()) {
+        return 1;
+      }
+      if (streamFromMemory) {
+        // Las partes van de memoria al destino sin pasar por el disco
+        LOG_INFO("📡 Partes en memoria: no se escribirán en " << outputDir);
+        sink.onPartBuffer = [&uploadQueue, &backend](const string &partName,
+                                                     vector<char> &&data) {
+          string hash = backend->bufferContentHash(data.data(), data.size());
+          uploadQueue->enqueueBuffer(partName, std::move(data), hash);
+        };
+      } else {
+        // El hash se calcula en el hilo que acaba de cerrar la parte,
+        // mientras el archivo sigue en la caché de páginas
+        sink.onPartReady = [&uploadQueue,
+                            &backend](const filesystem::path &partPath) {
+          uploadQueue->enqueue(partPath.string(),
+                               backend->localContentHash(partPath.string()));
+        };
+      }
+    } else if (streamFromMemory) {
+      LOG_ERROR("Error: -m requiere un destino de subida (-u o -t)");
+      return 1;
+    }
 
     // Medir tiempo
     auto start = high_resolution_clock::now();
-    success = compressFolderToSplitZip(sourceDir, outputZip, maxSizeMB,
-                                       encryptPassword, useParallel);
+    success = nativeFormat
+                  ? compressFoldersToNative(sourceDirs, outputZip, maxSizeMB,
+                                            encryptPassword, useParallel, sink,
+                                            nativeOptions)
+                  : compressFoldersToSplitZip(sourceDirs, outputZip,
+                                              maxSizeMB, encryptPassword,
+                                              useParallel, sink);
     auto end = high_resolution_clock::now();
     double time_taken = duration<double>(end - start).count();
 
     if (success) {
-      cout << "¡Compresión exitosa en " << fixed << setprecision(2)
-           << time_taken << " segundos!" << endl;
-
-      // Si se activó la bandera de subida, iniciar el proceso
-      if (uploadFlag) {
-        cout << "\n🔄 Iniciando proceso de subida de archivos ZIP generados..."
-             << endl;
-        cout << "\n📂 Subiendo archivos de la carpeta: " << outputDir.string()
-             << endl;
-        uploadFolderContents(outputDir.string(), true);
-      }
+      LOG_INFO("¡Compresión exitosa en " << fixed << setprecision(2)
+                                         << time_taken << " segundos!");
+      success = repositoryPath.empty() ||
+                finishGeneration(repositoryPath, generation, encryptPassword);
     } else {
-      cerr << "Error en la compresión." << endl;
+      LOG_ERROR("Error en la compresión.");
     }
+
+    // Esperar a que terminen las subidas pendientes
+    if (uploadQueue) {
+      LOG_INFO("\n⏳ Esperando a que terminen las subidas pendientes...");
+      bool uploadSuccess = uploadQueue->finish();
+      auto uploadEnd = high_resolution_clock::now();
+      LOG_INFO("Compresión y subida completadas en "
+               << fixed << setprecision(2)
+               << duration<double>(uploadEnd - start).count() << " segundos.");
+      success = success && uploadSuccess;
+    }
+
+    // La retención puede renombrar o borrar volúmenes: solo cuando ya no
+    // queda ninguno por subir
+    success = success &&
+              (repositoryPath.empty() ||
+               pruneRepository(repositoryPath, generation.name,
+                               encryptPassword, retention, maxSizeMB,
+                               useParallel));
+  }
+
+  double wallSeconds =
+      duration<double>(high_resolution_clock::now() - runStart).count();
+  if (!stageReportPath.empty()) {
+    writeInstrumentationReport(stageReportPath, wallSeconds);
+  }
+  if (!tracePath.empty()) {
+    writeChromeTrace(tracePath);
   }
 
+  logFlush();
   return success ? 0 : 1;
 }
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include "instrumentation.h"
+#include "native_format.h"
+#include <cstring>
+#include <openssl/evp.h>
+
+using namespace std;
+
+void nativeWeakSums(const unsigned char *data, size_t size, uint32_t &a,
+                    uint32_t &b) {
+  // Sumas módulo 2^32: los 16 bits bajos, que son los que se usan, son los
+  // mismos que con las sumas módulo 2^16 de rsync
+  uint32_t sum = 0;
+  uint32_t weighted = 0;
+#pragma omp simd reduction(+ : sum, weighted)
+  for (size_t i = 0; i < size; i++) {
+    sum += data[i];
+    weighted += static_cast<uint32_t>(size - i) * data[i];
+  }
+  a = sum;
+  b = weighted;
+}
+
+// SHA-256 recortado a NATIVE_STRONG_BYTES
+static void strongHash(const unsigned char *data, size_t size,
+                       unsigned char *strong) {
+  unsigned char digest[EVP_MAX_MD_SIZE];
+  unsigned int digestLen = 0;
+  EVP_Digest(data, size, digest, &digestLen, EVP_sha256(), nullptr);
+  memcpy(strong, digest, NATIVE_STRONG_BYTES);
+}
+
+void nativeSignBlock(const unsigned char *data, size_t size,
+                     NativeSignature &signature) {
+  uint32_t a = 0;
+  uint32_t b = 0;
+  nativeWeakSums(data, size, a, b);
+  signature.weak = nativeWeakValue(a, b);
+  strongHash(data, size, signature.strong);
+}
+
+void buildNativeBaseIndex(const vector<NativeSignature> &signatures,
+                          NativeBaseIndex &index) {
+  index.signatures = &signatures;
+  index.weak.clear();
+  index.weak.reserve(signatures.size());
+  for (size_t i = 0; i < signatures.size(); i++) {
+    index.weak[signatures[i].weak].push_back(static_cast<uint32_t>(i));
+  }
+}
+
+vector<NativeDeltaOp> nativeDeltaSearch(const unsigned char *data,
+                                        size_t size,
+                                        const NativeBaseIndex &base) {
+  ScopedStage timer(Stage::DELTA, size);
+  const size_t window = NATIVE_DELTA_BLOCK_BYTES;
+  vector<NativeDeltaOp> ops;
+  size_t literal = 0; // Inicio de los bytes sin coincidencia pendientes
+  size_t position = 0;
+  uint32_t a = 0;
+  uint32_t b = 0;
+  bool rolling = false; // Si a y b corresponden a la ventana actual
+
+  auto addLiteral = [&ops, &literal](size_t end) {
+    if (end > literal) {
+      NativeDeltaOp op;
+      op.offset = literal;
+      op.length = end - literal;
+      ops.push_back(op);
+    }
+  };
+
+  while (position + window <= size) {
+    if (!rolling) {
+      nativeWeakSums(data + position, window, a, b);
+      rolling = true;
+    }
+    auto found = base.weak.find(nativeWeakValue(a, b));
+    if (found != base.weak.end()) {
+      unsigned char strong[NATIVE_STRONG_BYTES];
+      strongHash(data + position, window, strong);
+      for (uint32_t block : found->second) {
+        if (memcmp(strong, (*base.signatures)[block].strong,
+                   NATIVE_STRONG_BYTES) != 0) {
+          continue;
+        }
+        addLiteral(position);
+        NativeDeltaOp op;
+        op.offset = position;
+        op.length = window;
+        op.fromBase = true;
+        op.baseOffset = static_cast<uint64_t>(block) * window;
+        ops.push_back(op);
+        position += window;
+        literal = position;
+        rolling = false;
+        break;
+      }
+      if (!rolling) {
+        continue;
+      }
+    }
+    // Desplazar la ventana un byte
+    if (position + window < size) {
+      a += data[position + window] - data[position];
+      b += a - static_cast<uint32_t>(window) * data[position];
+    }
+    position++;
+  }
+  addLiteral(size);
+  return ops;
+}
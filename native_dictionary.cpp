@@ -0,0 +1,127 @@
+#include "instrumentation.h"
+#include "native_format.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <queue>
+#include <unordered_map>
+
+using namespace std;
+
+// Secuencias que se cuentan y trozos que se copian al diccionario
+static const size_t GRAM_BYTES = 8;
+static const size_t SEGMENT_BYTES = 64;
+
+// Cuántas muestras distintas contienen una secuencia
+struct GramCount {
+  uint32_t samples = 0;
+  uint32_t lastSample = 0; // Para contar cada muestra una sola vez
+};
+
+// Trozo candidato de una muestra
+struct Segment {
+  size_t sample;
+  size_t offset;
+  size_t length;
+};
+
+static uint64_t gramAt(const string &data, size_t offset) {
+  uint64_t gram = 0;
+  memcpy(&gram, data.data() + offset, GRAM_BYTES);
+  return gram;
+}
+
+// Valor de un trozo: para cada secuencia que contiene, en cuántas muestras
+// más aparece. Las que ya están en el diccionario cuentan 0
+static uint64_t segmentScore(const string &data, const Segment &segment,
+                             const unordered_map<uint64_t, GramCount> &grams) {
+  uint64_t score = 0;
+  for (size_t i = segment.offset;
+       i + GRAM_BYTES <= segment.offset + segment.length; i++) {
+    auto found = grams.find(gramAt(data, i));
+    if (found != grams.end() && found->second.samples > 1) {
+      score += found->second.samples - 1;
+    }
+  }
+  return score;
+}
+
+string trainNativeDictionary(const vector<string> &samples, size_t maxBytes) {
+  ScopedStage timer(Stage::TRAIN);
+  unordered_map<uint64_t, GramCount> grams;
+  for (size_t s = 0; s < samples.size(); s++) {
+    const string &data = samples[s];
+    for (size_t i = 0; i + GRAM_BYTES <= data.size(); i++) {
+      GramCount &count = grams[gramAt(data, i)];
+      if (count.samples == 0 || count.lastSample != s) {
+        count.samples++;
+        count.lastSample = static_cast<uint32_t>(s);
+      }
+    }
+  }
+
+  vector<Segment> segments;
+  for (size_t s = 0; s < samples.size(); s++) {
+    for (size_t offset = 0; offset + GRAM_BYTES <= samples[s].size();
+         offset += SEGMENT_BYTES) {
+      segments.push_back(
+          {s, offset, min(SEGMENT_BYTES, samples[s].size() - offset)});
+    }
+  }
+
+  // Voraz perezoso: al elegir un trozo sus secuencias dejan de valer, así
+  // que el valor de cada candidato solo puede bajar. Se recalcula al
+  // sacarlo de la cola y se acepta si sigue siendo el mejor
+  priority_queue<pair<uint64_t, size_t>> queue;
+  for (size_t i = 0; i < segments.size(); i++) {
+    uint64_t score =
+        segmentScore(samples[segments[i].sample], segments[i], grams);
+    if (score > 0) {
+      queue.emplace(score, i);
+    }
+  }
+
+  vector<const Segment *> chosen;
+  size_t total = 0;
+  while (!queue.empty() && total < maxBytes) {
+    size_t index = queue.top().second;
+    queue.pop();
+    const Segment &segment = segments[index];
+    const string &data = samples[segment.sample];
+    uint64_t score = segmentScore(data, segment, grams);
+    if (score == 0) {
+      continue;
+    }
+    if (!queue.empty() && score < queue.top().first) {
+      queue.emplace(score, index);
+      continue;
+    }
+    for (size_t i = segment.offset;
+         i + GRAM_BYTES <= segment.offset + segment.length; i++) {
+      grams[gramAt(data, i)].samples = 0;
+    }
+    chosen.push_back(&segment);
+    total += segment.length;
+  }
+
+  // Los mejores al final, cerca de los datos que se comprimen
+  string dictionary;
+  dictionary.reserve(min(total, maxBytes));
+  for (auto it = chosen.rbegin(); it != chosen.rend(); ++it) {
+    const Segment &segment = **it;
+    dictionary.append(samples[segment.sample], segment.offset,
+                      segment.length);
+  }
+  if (dictionary.size() > maxBytes) {
+    dictionary.erase(0, dictionary.size() - maxBytes);
+  }
+  return dictionary;
+}
+
+string nativeDictionaryGroup(const string &path) {
+  string extension = filesystem::path(path).extension().string();
+  transform(extension.begin(), extension.end(), extension.begin(),
+            [](unsigned char c) { return tolower(c); });
+  return extension;
+}
@@ -0,0 +1,381 @@
+#include "native_format.h"
+#include "crypto.h"
+#include "instrumentation.h"
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <zlib.h>
+
+using namespace std;
+
+static SimpleCrypto crypto;
+
+// Enteros del pie y de la cabecera en little-endian, sea cual sea el equipo
+static void putUint64(string &out, uint64_t value) {
+  for (int i = 0; i < 8; i++) {
+    out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+  }
+}
+
+static uint64_t getUint64(const char *data) {
+  uint64_t value = 0;
+  for (int i = 7; i >= 0; i--) {
+    value = (value << 8) | static_cast<unsigned char>(data[i]);
+  }
+  return value;
+}
+
+string nativeVolumeName(const string &base, int index) {
+  char number[16];
+  snprintf(number, sizeof(number), ".%03d", index);
+  return base + NATIVE_EXTENSION + number;
+}
+
+string encodeNativeHeader(uint64_t blockSize, bool encrypted) {
+  string header(NATIVE_MAGIC, NATIVE_MAGIC_BYTES);
+  putUint64(header, (blockSize & 0xffffffff) |
+                        (static_cast<uint64_t>(encrypted ? 1 : 0) << 32));
+  return header;
+}
+
+bool decodeNativeHeader(const char *header, uint64_t &blockSize,
+                        bool &encrypted) {
+  if (memcmp(header, NATIVE_MAGIC, NATIVE_MAGIC_BYTES) != 0) {
+    return false;
+  }
+  uint64_t fields = getUint64(header + NATIVE_MAGIC_BYTES);
+  blockSize = fields & 0xffffffff;
+  encrypted = (fields >> 32) & 1;
+  return blockSize > 0;
+}
+
+// compress2 con un diccionario cargado antes de los datos
+static bool deflateWithDictionary(const char *data, size_t size, int level,
+                                  const string &dictionary,
+                                  vector<char> &stored) {
+  z_stream stream{};
+  if (deflateInit(&stream, level) != Z_OK) {
+    return false;
+  }
+  bool ok = deflateSetDictionary(
+                &stream, reinterpret_cast<const Bytef *>(dictionary.data()),
+                dictionary.size()) == Z_OK;
+  stored.resize(deflateBound(&stream, size));
+  stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+  stream.avail_in = size;
+  stream.next_out = reinterpret_cast<Bytef *>(stored.data());
+  stream.avail_out = stored.size();
+  ok = ok && deflate(&stream, Z_FINISH) == Z_STREAM_END;
+  stored.resize(stream.total_out);
+  deflateEnd(&stream);
+  return ok;
+}
+
+// uncompress para bloques que piden diccionario (Z_NEED_DICT)
+static bool inflateWithDictionary(const char *stored, size_t storedSize,
+                                  const string &dictionary,
+                                  vector<char> &data) {
+  z_stream stream{};
+  if (inflateInit(&stream) != Z_OK) {
+    return false;
+  }
+  stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(stored));
+  stream.avail_in = storedSize;
+  stream.next_out = reinterpret_cast<Bytef *>(data.data());
+  stream.avail_out = data.size();
+  int result = inflate(&stream, Z_FINISH);
+  if (result == Z_NEED_DICT) {
+    result = inflateSetDictionary(
+                 &stream, reinterpret_cast<const Bytef *>(dictionary.data()),
+                 dictionary.size()) == Z_OK
+                 ? inflate(&stream, Z_FINISH)
+                 : Z_DATA_ERROR;
+  }
+  bool ok = result == Z_STREAM_END && stream.total_out == data.size();
+  inflateEnd(&stream);
+  return ok;
+}
+
+bool encodeNativeBlock(const char *data, size_t size, int level,
+                       const string &password, vector<char> &stored,
+                       const string &dictionary) {
+  bool compressed = false;
+  if (level != 0 && !dictionary.empty()) {
+    ScopedStage timer(Stage::DEFLATE, size);
+    compressed = deflateWithDictionary(data, size,
+                                       level < 0 ? Z_DEFAULT_COMPRESSION
+                                                 : level,
+                                       dictionary, stored) &&
+                 stored.size() < size;
+  } else if (level != 0) {
+    ScopedStage timer(Stage::DEFLATE, size);
+    uLongf storedSize = compressBound(size);
+    stored.resize(storedSize);
+    compressed =
+        compress2(reinterpret_cast<Bytef *>(stored.data()), &storedSize,
+                  reinterpret_cast<const Bytef *>(data), size,
+                  level < 0 ? Z_DEFAULT_COMPRESSION : level) == Z_OK &&
+        storedSize < size;
+    stored.resize(storedSize);
+  }
+  if (!compressed) {
+    stored.assign(data, data + size);
+  }
+  if (!password.empty()) {
+    ScopedStage timer(Stage::ENCRYPT, stored.size());
+    auto encrypted =
+        crypto.encrypt(reinterpret_cast<const unsigned char *>(stored.data()),
+                       stored.size(), password);
+    stored.assign(encrypted.begin(), encrypted.end());
+  }
+  return compressed;
+}
+
+bool decodeNativeBlock(const char *stored, size_t storedSize, bool compressed,
+                       size_t rawSize, const string &password,
+                       vector<char> &data, const string &dictionary) {
+  vector<unsigned char> decrypted;
+  if (!password.empty()) {
+    ScopedStage timer(Stage::DECRYPT, storedSize);
+    decrypted = crypto.decrypt(reinterpret_cast<const unsigned char *>(stored),
+                               storedSize, password);
+    stored = reinterpret_cast<const char *>(decrypted.data());
+  }
+  if (!compressed) {
+    if (storedSize != rawSize) {
+      return false;
+    }
+    data.assign(stored, stored + storedSize);
+    return true;
+  }
+  ScopedStage timer(Stage::INFLATE, rawSize);
+  data.resize(rawSize);
+  if (!dictionary.empty()) {
+    return inflateWithDictionary(stored, storedSize, dictionary, data);
+  }
+  uLongf dataSize = rawSize;
+  return uncompress(reinterpret_cast<Bytef *>(data.data()), &dataSize,
+                    reinterpret_cast<const Bytef *>(stored),
+                    storedSize) == Z_OK &&
+         dataSize == rawSize;
+}
+
+// Campos comunes de un bloque o un diccionario en el catálogo
+static void writeBlockFields(ostream &out, const NativeBlock &block) {
+  out << block.rawSize << " " << block.streamOffset << " "
+      << block.storedSize << " "
+      << (block.fromBase ? 'b' : block.compressed ? 'z' : 's');
+}
+
+// Los bloques copiados de la base se marcan con 'b'
+static bool readBlockFields(istream &in, NativeBlock &block) {
+  char method = 0;
+  if (!(in >> block.rawSize >> block.streamOffset >> block.storedSize >>
+        method) ||
+      (method != 'z' && method != 's' && method != 'b')) {
+    return false;
+  }
+  block.compressed = method == 'z';
+  block.fromBase = method == 'b';
+  return true;
+}
+
+string serializeNativeCatalog(const NativeCatalog &catalog) {
+  ostringstream out;
+  // Cada versión añade algo que las anteriores no entienden: la 2, los
+  // diccionarios; la 3, las firmas y las copias delta. Se marca la menor
+  // que basta para leer la copia
+  int version = catalog.dictionaries.empty() ? 1 : 2;
+  if (!catalog.id.empty() || !catalog.baseId.empty()) {
+    version = 3;
+  }
+  out << "version " << version << "\n";
+  out << "block_size " << catalog.blockSize << "\n";
+  if (!catalog.encryptionHash.empty()) {
+    out << "encrypted " << catalog.encryptionHash << "\n";
+  }
+  if (!catalog.id.empty()) {
+    out << "id " << catalog.id << "\n";
+  }
+  if (!catalog.baseId.empty()) {
+    // La carpeta va al final de la línea: puede contener espacios
+    out << "base " << catalog.baseId << " " << catalog.baseFolder << "\n";
+  }
+  if (catalog.signatureBlockSize > 0) {
+    out << "signatures " << catalog.signatureBlockSize << " ";
+    writeBlockFields(out, catalog.signatures);
+    out << "\n";
+  }
+  for (const auto &dictionary : catalog.dictionaries) {
+    out << "dictionary ";
+    writeBlockFields(out, dictionary.block);
+    out << " " << dictionary.extension << "\n";
+  }
+  for (const auto &file : catalog.files) {
+    // La ruta va al final de la línea: puede contener espacios
+    out << "file " << file.size << " " << file.blocks.size() << " "
+        << file.path << "\n";
+    for (const auto &block : file.blocks) {
+      out << block.fileOffset << " ";
+      writeBlockFields(out, block);
+      if (block.dictionary >= 0) {
+        out << " " << block.dictionary;
+      }
+      out << "\n";
+    }
+  }
+  return out.str();
+}
+
+bool parseNativeCatalog(const string &text, NativeCatalog &catalog) {
+  istringstream in(text);
+  string line;
+  if (!getline(in, line) ||
+      (line != "version 1" && line != "version 2" && line != "version 3")) {
+    return false;
+  }
+  catalog = NativeCatalog();
+  while (getline(in, line)) {
+    istringstream fields(line);
+    string key;
+    fields >> key;
+    if (key == "block_size") {
+      fields >> catalog.blockSize;
+    } else if (key == "encrypted") {
+      fields >> catalog.encryptionHash;
+    } else if (key == "id") {
+      fields >> catalog.id;
+    } else if (key == "base") {
+      fields >> catalog.baseId;
+      fields.get(); // Espacio antes de la carpeta
+      getline(fields, catalog.baseFolder);
+    } else if (key == "signatures") {
+      if (!(fields >> catalog.signatureBlockSize) ||
+          !readBlockFields(fields, catalog.signatures) ||
+          catalog.signatures.fromBase) {
+        return false;
+      }
+    } else if (key == "dictionary") {
+      NativeDictionary dictionary;
+      if (!readBlockFields(fields, dictionary.block) ||
+          dictionary.block.fromBase) {
+        return false;
+      }
+      fields.get(); // Espacio antes de la extensión, que puede faltar
+      getline(fields, dictionary.extension);
+      catalog.dictionaries.push_back(std::move(dictionary));
+    } else if (key == "file") {
+      NativeFile file;
+      size_t blockCount = 0;
+      if (!(fields >> file.size >> blockCount)) {
+        return false;
+      }
+      fields.get(); // Espacio antes de la ruta
+      getline(fields, file.path);
+      if (file.path.empty()) {
+        return false;
+      }
+      for (size_t i = 0; i < blockCount; i++) {
+        NativeBlock block;
+        if (!getline(in, line)) {
+          return false;
+        }
+        istringstream blockFields(line);
+        if (!(blockFields >> block.fileOffset) ||
+            !readBlockFields(blockFields, block) ||
+            (block.fromBase && catalog.baseId.empty())) {
+          return false;
+        }
+        // Los diccionarios van antes que los archivos en el catálogo
+        int dictionary = -1;
+        if (blockFields >> dictionary) {
+          if (!block.compressed || dictionary < 0 ||
+              static_cast<size_t>(dictionary) >=
+                  catalog.dictionaries.size()) {
+            return false;
+          }
+          block.dictionary = dictionary;
+        }
+        file.blocks.push_back(block);
+      }
+      catalog.files.push_back(std::move(file));
+    } else if (!key.empty()) {
+      return false;
+    }
+  }
+  return catalog.blockSize > 0;
+}
+
+string serializeNativeSignatures(const NativeCatalog &catalog) {
+  string data;
+  for (size_t i = 0; i < catalog.files.size(); i++) {
+    const auto &signatures = catalog.files[i].signatures;
+    if (signatures.empty()) {
+      continue;
+    }
+    putUint64(data, i);
+    putUint64(data, signatures.size());
+    for (const auto &signature : signatures) {
+      for (int b = 0; b < 4; b++) {
+        data.push_back(static_cast<char>((signature.weak >> (8 * b)) & 0xff));
+      }
+      data.append(reinterpret_cast<const char *>(signature.strong),
+                  NATIVE_STRONG_BYTES);
+    }
+  }
+  return data;
+}
+
+bool parseNativeSignatures(const string &data, NativeCatalog &catalog) {
+  const size_t recordBytes = 4 + NATIVE_STRONG_BYTES;
+  size_t position = 0;
+  while (position < data.size()) {
+    if (data.size() - position < 16) {
+      return false;
+    }
+    uint64_t file = getUint64(data.data() + position);
+    uint64_t count = getUint64(data.data() + position + 8);
+    position += 16;
+    if (file >= catalog.files.size() ||
+        count > (data.size() - position) / recordBytes) {
+      return false;
+    }
+    auto &signatures = catalog.files[file].signatures;
+    signatures.resize(count);
+    for (auto &signature : signatures) {
+      signature.weak = 0;
+      for (int b = 3; b >= 0; b--) {
+        signature.weak = (signature.weak << 8) |
+                         static_cast<unsigned char>(data[position + b]);
+      }
+      memcpy(signature.strong, data.data() + position + 4,
+             NATIVE_STRONG_BYTES);
+      position += recordBytes;
+    }
+  }
+  return true;
+}
+
+string encodeNativeFooter(const NativeFooter &footer) {
+  string data;
+  putUint64(data, footer.catalog.streamOffset);
+  putUint64(data, footer.catalog.storedSize);
+  putUint64(data, footer.catalog.rawSize);
+  putUint64(data, footer.catalog.compressed ? 1 : 0);
+  putUint64(data, footer.volumeSize);
+  data.append(NATIVE_FOOTER_MAGIC, NATIVE_MAGIC_BYTES);
+  return data;
+}
+
+bool decodeNativeFooter(const char *data, NativeFooter &footer) {
+  if (memcmp(data + NATIVE_FOOTER_BYTES - NATIVE_MAGIC_BYTES,
+             NATIVE_FOOTER_MAGIC, NATIVE_MAGIC_BYTES) != 0) {
+    return false;
+  }
+  footer.catalog.streamOffset = getUint64(data);
+  footer.catalog.storedSize = getUint64(data + 8);
+  footer.catalog.rawSize = getUint64(data + 16);
+  footer.catalog.compressed = getUint64(data + 24) != 0;
+  footer.volumeSize = getUint64(data + 32);
+  return footer.volumeSize > 0;
+}
@@ -0,0 +1,481 @@
+#ifndef NATIVE_FORMAT_H
+#define NATIVE_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Formato nativo por bloques, alternativo al ZIP dividido.
+ *
+ * La copia es un único flujo de bytes repartido en volúmenes de tamaño fijo
+ * (<base>.bkp.001, <base>.bkp.002...), cortados en cualquier byte:
+ *
+ *   cabecera | bloques | catálogo | pie
+ *
+ * Cada archivo se divide en bloques de NATIVE_BLOCK_BYTES que se comprimen
+ * (zlib) y cifran por separado, así que cualquier rango de un archivo se
+ * puede leer decodificando solo sus bloques, y los bloques de un mismo
+ * archivo se decodifican en paralelo. El catálogo es texto, como el .info
+ * de las partes ZIP, y se guarda comprimido y cifrado como un bloque más;
+ * el pie, de tamaño fijo, indica dónde está.
+ *
+ * Con diccionarios, tras la cabecera van los diccionarios de deflate
+ * entrenados para cada grupo de archivos pequeños de una misma extensión,
+ * también como bloques, y los bloques de esos archivos se comprimen con el
+ * diccionario de su grupo:
+ *
+ *   cabecera | diccionarios | bloques | catálogo | pie
+ *
+ * Los archivos grandes guardan además las firmas de sus bloques de
+ * NATIVE_DELTA_BLOCK_BYTES, como un bloque más antes del catálogo. Una
+ * copia delta (con una copia base) busca esas firmas en cada archivo con
+ * la suma rodante de rsync y solo guarda lo que no encuentra; lo demás
+ * queda en el catálogo como bloques copiados de la base.
+ */
+
+struct PartSink;
+
+// Extensión de los volúmenes (seguida de .001, .002...)
+#define NATIVE_EXTENSION ".bkp"
+
+// Datos de cada bloque antes de comprimir
+static const size_t NATIVE_BLOCK_BYTES = 1024 * 1024;
+
+// Cabecera al inicio del primer volumen y marca final del pie
+static const char NATIVE_MAGIC[] = "BKPNAT01";
+static const char NATIVE_FOOTER_MAGIC[] = "BKPFOOT1";
+static const size_t NATIVE_MAGIC_BYTES = 8;
+
+// Cabecera: marca, tamaño de bloque y si la copia está cifrada
+static const size_t NATIVE_HEADER_BYTES = NATIVE_MAGIC_BYTES + 8;
+
+// Pie: bloque del catálogo, tamaño de volumen y marca
+static const size_t NATIVE_FOOTER_BYTES = 5 * 8 + NATIVE_MAGIC_BYTES;
+
+// Archivos de hasta este tamaño pueden usar el diccionario de su extensión
+static const uint64_t NATIVE_DICTIONARY_MAX_FILE = 64 * 1024;
+
+// Archivos pequeños que necesita una extensión para tener diccionario
+static const size_t NATIVE_DICTIONARY_MIN_FILES = 16;
+
+// Muestras por extensión y bytes leídos de cada una para entrenar
+static const size_t NATIVE_DICTIONARY_SAMPLES = 256;
+static const size_t NATIVE_DICTIONARY_SAMPLE_BYTES = 8 * 1024;
+
+// Tamaño del diccionario: la ventana de deflate no alcanza más atrás
+static const size_t NATIVE_DICTIONARY_BYTES = 32 * 1024;
+
+// Bloques con firma para las copias delta: un cambio obliga a guardar de
+// nuevo como mucho un bloque de este tamaño
+static const size_t NATIVE_DELTA_BLOCK_BYTES = 64 * 1024;
+
+// Archivos desde este tamaño guardan firmas y se copian como delta
+static const uint64_t NATIVE_DELTA_MIN_FILE = NATIVE_BLOCK_BYTES;
+
+// Rango de un archivo en que cada tarea busca las firmas de la base: las
+// coincidencias no cruzan de un rango a otro
+static const uint64_t NATIVE_DELTA_SEGMENT_BYTES = 16 * 1024 * 1024;
+
+// Bytes del SHA-256 que se guardan en cada firma
+static const size_t NATIVE_STRONG_BYTES = 16;
+
+// Firma de un bloque: suma rodante de rsync y principio de su SHA-256
+struct NativeSignature {
+  uint32_t weak = 0;
+  unsigned char strong[NATIVE_STRONG_BYTES] = {};
+};
+
+// Bloque de un archivo dentro del flujo
+struct NativeBlock {
+  uint64_t fileOffset = 0;   // Posición de sus datos en el archivo
+  uint64_t rawSize = 0;      // Bytes originales
+  uint64_t streamOffset = 0; // Posición del bloque guardado en el flujo
+  uint64_t storedSize = 0;   // Bytes guardados (comprimidos y cifrados)
+  bool compressed = true;    // false si se guardó tal cual (no se reducía)
+  int dictionary = -1;       // Diccionario con que se comprimió (-1 = sin)
+  bool fromBase = false;     // Copiado del mismo archivo en la copia base:
+                             // streamOffset es su posición en ese archivo
+};
+
+// Archivo de la copia con su índice de bloques
+struct NativeFile {
+  std::string path; // Ruta relativa, como dentro del ZIP
+  uint64_t size = 0;
+  std::vector<NativeBlock> blocks;
+  std::vector<NativeSignature> signatures; // Aparte, no en el catálogo
+};
+
+// Final del flujo: dónde está el catálogo y cómo se cortaron los volúmenes
+struct NativeFooter {
+  NativeBlock catalog;     // fileOffset no se usa
+  uint64_t volumeSize = 0; // Bytes de cada volumen salvo el último
+};
+
+// Diccionario de deflate compartido por los archivos pequeños de una
+// extensión
+struct NativeDictionary {
+  std::string extension; // En minúsculas, con el punto ("" = sin extensión)
+  NativeBlock block;     // Dónde está guardado; fileOffset no se usa
+  std::string data;      // Contenido, una vez leído (no va en el catálogo)
+};
+
+struct NativeCatalog {
+  uint64_t blockSize = NATIVE_BLOCK_BYTES;
+  std::string encryptionHash; // Vacío si la copia no está cifrada
+  std::string id;             // Identificador, si la copia guarda firmas
+  std::string baseId;         // Copia base de una copia delta (o vacío)
+  std::string baseFolder;     // Carpeta donde estaba la base
+  uint64_t signatureBlockSize = 0; // 0 si no hay firmas
+  NativeBlock signatures;          // Dónde están las firmas
+  std::vector<NativeDictionary> dictionaries;
+  std::vector<NativeFile> files;
+};
+
+// Opciones de una copia en formato nativo
+struct NativeOptions {
+  bool dictionaries = false; // Diccionarios para los archivos pequeños
+  std::string baseFolder;    // Copia base para una copia delta (o vacía)
+};
+
+/**
+ * Nombre del volumen número index (desde 1) de una copia.
+ *
+ * @param base Ruta de salida sin extensión
+ * @param index Número de volumen
+ * @return Ruta del volumen
+ */
+std::string nativeVolumeName(const std::string &base, int index);
+
+// Cabecera del flujo
+std::string encodeNativeHeader(uint64_t blockSize, bool encrypted);
+
+/**
+ * Interpreta la cabecera del primer volumen.
+ *
+ * @param header NATIVE_HEADER_BYTES bytes del inicio del flujo
+ * @return false si no es una copia en formato nativo
+ */
+bool decodeNativeHeader(const char *header, uint64_t &blockSize,
+                        bool &encrypted);
+
+/**
+ * Comprime (zlib, con el nivel de compressionLevel()) y cifra un bloque. Si
+ * comprimido no ocupa menos, se guarda tal cual.
+ *
+ * @param data Datos originales
+ * @param size Bytes originales
+ * @param level Nivel de deflate (-1 = predeterminado, 0 = sin comprimir)
+ * @param password Contraseña (vacía = sin cifrar)
+ * @param stored Bytes a guardar en el flujo
+ * @param dictionary Diccionario de deflate (vacío = sin diccionario)
+ * @return true si el bloque quedó comprimido
+ */
+bool encodeNativeBlock(const char *data, size_t size, int level,
+                       const std::string &password, std::vector<char> &stored,
+                       const std::string &dictionary = std::string());
+
+/**
+ * Descifra y descomprime un bloque guardado.
+ *
+ * @param stored Bytes guardados
+ * @param storedSize Número de bytes guardados
+ * @param compressed Si el bloque se guardó comprimido
+ * @param rawSize Bytes originales esperados
+ * @param password Contraseña (vacía = sin cifrar)
+ * @param data Datos originales
+ * @param dictionary Diccionario con que se comprimió (vacío = sin)
+ * @return false si el bloque está dañado o la contraseña no es la correcta
+ */
+bool decodeNativeBlock(const char *stored, size_t storedSize, bool compressed,
+                       size_t rawSize, const std::string &password,
+                       std::vector<char> &data,
+                       const std::string &dictionary = std::string());
+
+/**
+ * Entrena un diccionario de deflate a partir de muestras de archivos
+ * parecidos: se queda con los trozos de 64 bytes cuyas secuencias de 8
+ * bytes aparecen en más muestras distintas, sin repetir secuencias, y deja
+ * los más comunes al final, donde deflate los alcanza con distancias más
+ * cortas.
+ *
+ * @param samples Contenido de las muestras
+ * @param maxBytes Tamaño máximo del diccionario
+ * @return Diccionario; vacío si las muestras no comparten nada
+ */
+std::string trainNativeDictionary(const std::vector<std::string> &samples,
+                                  size_t maxBytes);
+
+// Extensión con la que se agrupa un archivo para los diccionarios
+std::string nativeDictionaryGroup(const std::string &path);
+
+/**
+ * Sumas de rsync de un bloque: a es la suma de los bytes y b la suma de
+ * cada byte por su distancia al final. El bucle no depende de iteraciones
+ * anteriores y se vectoriza.
+ *
+ * @param data Bytes del bloque
+ * @param size Número de bytes
+ * @param a Suma simple
+ * @param b Suma ponderada
+ */
+void nativeWeakSums(const unsigned char *data, size_t size, uint32_t &a,
+                    uint32_t &b);
+
+// Suma rodante de 32 bits a partir de las dos sumas
+inline uint32_t nativeWeakValue(uint32_t a, uint32_t b) {
+  return (a & 0xffff) | (b << 16);
+}
+
+/**
+ * Firma completa de un bloque.
+ *
+ * @param data Bytes del bloque
+ * @param size Número de bytes
+ * @param signature Resultado
+ */
+void nativeSignBlock(const unsigned char *data, size_t size,
+                     NativeSignature &signature);
+
+// Firmas de un archivo de la copia base, por suma rodante
+struct NativeBaseIndex {
+  std::unordered_map<uint32_t, std::vector<uint32_t>> weak; // -> bloques
+  const std::vector<NativeSignature> *signatures = nullptr;
+};
+
+// Índice de las firmas de un archivo de la base
+void buildNativeBaseIndex(const std::vector<NativeSignature> &signatures,
+                          NativeBaseIndex &index);
+
+// Tramo de un rango nuevo: copiado de la base o guardado tal cual
+struct NativeDeltaOp {
+  uint64_t offset = 0; // Posición dentro del rango
+  uint64_t length = 0;
+  bool fromBase = false;
+  uint64_t baseOffset = 0; // Posición en el archivo de la base
+};
+
+/**
+ * Busca en un rango de un archivo los bloques de la base, en cualquier
+ * posición, como rsync: la suma rodante se actualiza byte a byte y solo si
+ * coincide se calcula el SHA-256 de la ventana.
+ *
+ * @param data Bytes del rango
+ * @param size Número de bytes
+ * @param base Firmas del mismo archivo en la base
+ * @return Tramos que cubren el rango en orden
+ */
+std::vector<NativeDeltaOp> nativeDeltaSearch(const unsigned char *data,
+                                             size_t size,
+                                             const NativeBaseIndex &base);
+
+// Firmas de todos los archivos, en binario, antes de comprimirlas y cifrarlas
+std::string serializeNativeSignatures(const NativeCatalog &catalog);
+
+/**
+ * Reparte en los archivos del catálogo las firmas guardadas.
+ *
+ * @param data Firmas en binario
+ * @param catalog Catálogo ya interpretado
+ * @return false si las firmas no corresponden al catálogo
+ */
+bool parseNativeSignatures(const std::string &data, NativeCatalog &catalog);
+
+// Catálogo en texto, antes de comprimirlo y cifrarlo
+std::string serializeNativeCatalog(const NativeCatalog &catalog);
+
+/**
+ * Interpreta un catálogo guardado.
+ *
+ * @param text Catálogo en texto
+ * @param catalog Resultado
+ * @return false si el texto no es un catálogo válido
+ */
+bool parseNativeCatalog(const std::string &text, NativeCatalog &catalog);
+
+// Pie del flujo
+std::string encodeNativeFooter(const NativeFooter &footer);
+
+/**
+ * Interpreta el pie de una copia.
+ *
+ * @param data NATIVE_FOOTER_BYTES bytes del final del flujo
+ * @param footer Resultado
+ * @return false si no es un pie válido
+ */
+bool decodeNativeFooter(const char *data, NativeFooter &footer);
+
+// ----------- Escritura (compresor) -----------
+
+/**
+ * Copia las carpetas en formato nativo: bloques comprimidos y cifrados en
+ * paralelo y escritos en orden en volúmenes de maxSizeMB. Cada volumen
+ * terminado se entrega como una parte, igual que las partes ZIP.
+ *
+ * @param folderPaths Carpetas a copiar
+ * @param outputPath Ruta de salida; su extensión se sustituye por .bkp.NNN
+ * @param maxSizeMB Tamaño de cada volumen en MB
+ * @param password Contraseña de cifrado (vacía si no se cifra)
+ * @param useParallel Comprimir los bloques con varios hilos
+ * @param sink Destino de cada volumen terminado
+ * @param options Diccionarios y copia base
+ * @return true si la copia se completó
+ */
+bool compressFoldersToNative(const std::vector<std::string> &folderPaths,
+                             const std::string &outputPath, int maxSizeMB,
+                             const std::string &password, bool useParallel,
+                             const PartSink &sink,
+                             const NativeOptions &options = NativeOptions());
+
+/**
+ * Fusiona una copia delta con su base inmediata, sin leer los archivos de
+ * origen: los bloques guardados se copian tal cual, lo que venía de la base
+ * y la base guardaba se lee de ella y se comprime de nuevo, y lo que la
+ * base tomaba a su vez de la suya sigue siendo una referencia a esa. Si la
+ * base es completa, el resultado es una copia completa. Los bloques se
+ * reescriben en paralelo. La copia nueva conserva el identificador, así que
+ * las copias delta hechas sobre la original pueden usarla como base; la
+ * ruta de la nueva base se guarda relativa a folderPath, donde se espera
+ * que la copia nueva sustituya a la original.
+ *
+ * @param folderPath Carpeta con la copia delta
+ * @param outputPath Ruta base de los volúmenes nuevos (como en
+ *        compressFoldersToNative)
+ * @param maxSizeMB Tamaño de cada volumen en MB
+ * @param password Contraseña (vacía si la copia no está cifrada)
+ * @param useParallel Reescribir los bloques con varios hilos
+ * @return true si la copia fusionada se escribió entera
+ */
+bool mergeNativeBase(const std::string &folderPath,
+                     const std::string &outputPath, int maxSizeMB,
+                     const std::string &password, bool useParallel);
+
+// ----------- Lectura (descompresor) -----------
+
+/**
+ * Indica si una carpeta contiene volúmenes en formato nativo.
+ *
+ * @param folderPath Carpeta de entrada
+ * @return true si hay algún <base>.bkp.NNN
+ */
+bool hasNativeBackup(const std::string &folderPath);
+
+/**
+ * Lee el catálogo de una copia, sin sus firmas ni su copia base.
+ *
+ * @param folderPath Carpeta con los volúmenes
+ * @param password Contraseña (vacía si la copia no está cifrada)
+ * @param catalog Catálogo leído
+ * @return false si no se pudo leer la copia
+ */
+bool readNativeCatalog(const std::string &folderPath,
+                       const std::string &password, NativeCatalog &catalog);
+
+/**
+ * Lee el catálogo y las firmas de una copia, para usarla como base de una
+ * copia delta.
+ *
+ * @param folderPath Carpeta con los volúmenes
+ * @param password Contraseña (vacía si la copia no está cifrada)
+ * @param catalog Catálogo con las firmas de cada archivo
+ * @return false si no se pudo leer la copia
+ */
+bool loadNativeSignatures(const std::string &folderPath,
+                          const std::string &password,
+                          NativeCatalog &catalog);
+
+// Copia abierta para leerla bloque a bloque, con su cadena de copias base
+struct NativeBackup;
+
+/**
+ * Abre una copia y, si es delta, las copias base de las que depende.
+ *
+ * @param folderPath Carpeta con los volúmenes
+ * @param password Contraseña (vacía si la copia no está cifrada)
+ * @return La copia abierta, o nullptr si no se pudo abrir
+ */
+std::shared_ptr<NativeBackup>
+openNativeBackupChain(const std::string &folderPath,
+                      const std::string &password);
+
+// Catálogo de una copia abierta
+const NativeCatalog &nativeBackupCatalog(const NativeBackup &backup);
+
+// Carpeta desde la que se abrió una copia
+const std::string &nativeBackupFolder(const NativeBackup &backup);
+
+// Copia base de una copia delta abierta (nullptr si no es delta)
+const NativeBackup *nativeBackupBase(const NativeBackup &backup);
+
+// Archivo de una copia abierta por su ruta (nullptr si no está)
+const NativeFile *nativeBackupFile(const NativeBackup &backup,
+                                   const std::string &path);
+
+/**
+ * Contenido de un bloque de un archivo, descifrado y descomprimido. Los
+ * bloques copiados de la base se leen de la base.
+ *
+ * @param backup Copia abierta
+ * @param file Archivo del catálogo de la copia
+ * @param block Bloque del archivo
+ * @param data Bytes del bloque
+ * @return false si no se pudo leer
+ */
+bool readNativeFileBlock(const NativeBackup &backup, const NativeFile &file,
+                         const NativeBlock &block, std::vector<char> &data);
+
+/**
+ * Bytes de un bloque tal como están en el flujo, comprimidos y cifrados,
+ * para copiarlo a otra copia sin decodificarlo.
+ *
+ * @param backup Copia abierta
+ * @param block Bloque guardado en la copia (no copiado de la base)
+ * @param stored Bytes guardados
+ * @return false si no se pudo leer
+ */
+bool readNativeStoredBlock(const NativeBackup &backup,
+                           const NativeBlock &block,
+                           std::vector<char> &stored);
+
+/**
+ * Restaura una copia en formato nativo decodificando todos los bloques en
+ * paralelo. Los bloques de una copia delta que vienen de su base se leen de
+ * la base (y de la base de esta, si también es delta).
+ *
+ * @param folderPath Carpeta con los volúmenes
+ * @param outputPath Carpeta de salida
+ * @param password Contraseña (vacía si la copia no está cifrada)
+ * @param onlyPath Si no está vacía, restaurar solo ese archivo
+ * @param baseFolder Carpeta de la copia base si ya no está donde se hizo
+ * @return true si se restauró todo lo pedido
+ */
+bool restoreNativeBackup(const std::string &folderPath,
+                         const std::string &outputPath,
+                         const std::string &password,
+                         const std::string &onlyPath = "",
+                         const std::string &baseFolder = "");
+
+/**
+ * Lee un rango de un archivo de la copia decodificando solo los bloques
+ * que lo cubren, en paralelo, y lo escribe en orden a medida que cada
+ * bloque está listo: la memoria no depende del tamaño del rango.
+ *
+ * @param folderPath Carpeta con los volúmenes
+ * @param path Ruta del archivo dentro de la copia
+ * @param offset Primer byte del rango
+ * @param length Bytes a leer (se recorta al final del archivo)
+ * @param password Contraseña (vacía si la copia no está cifrada)
+ * @param out Destino de los bytes (p. ej. stdout)
+ * @param baseFolder Carpeta de la copia base si ya no está donde se hizo
+ * @return true si se pudo leer el rango
+ */
+bool readNativeRange(const std::string &folderPath, const std::string &path,
+                     uint64_t offset, uint64_t length,
+                     const std::string &password, FILE *out,
+                     const std::string &baseFolder = "");
+
+#endif // NATIVE_FORMAT_H
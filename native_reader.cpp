@@ -0,0 +1,569 @@
+#include "crypto.h"
+#include "instrumentation.h"
+#include "logger.h"
+#include "low_impact.h"
+#include "native_format.h"
+#include "page_cache.h"
+#include "thread_config.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <regex>
+#include <unistd.h>
+#include <unordered_map>
+
+using namespace std;
+
+// Volúmenes de una copia vistos como un único flujo de bytes
+class VolumeReader {
+private:
+  vector<int> fds;
+  vector<uint64_t> starts; // Posición en el flujo del primer byte de cada uno
+  uint64_t total = 0;
+
+public:
+  VolumeReader() = default;
+  VolumeReader(const VolumeReader &) = delete;
+  VolumeReader &operator=(const VolumeReader &) = delete;
+
+  ~VolumeReader() {
+    for (int fd : fds) {
+      close(fd);
+    }
+  }
+
+  bool open(const vector<filesystem::path> &paths) {
+    for (const auto &path : paths) {
+      int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+      if (fd < 0) {
+        LOG_ERROR("No se pudo abrir el volumen: " << path);
+        return false;
+      }
+      fds.push_back(fd);
+      starts.push_back(total);
+      total += lseek(fd, 0, SEEK_END);
+    }
+    return true;
+  }
+
+  uint64_t size() const { return total; }
+
+  // Bytes de cada volumen salvo el último, que puede ser más corto
+  bool uniformVolumes(uint64_t volumeSize) const {
+    for (size_t i = 1; i < starts.size(); i++) {
+      if (starts[i] - starts[i - 1] != volumeSize) {
+        return false;
+      }
+    }
+    return total - starts.back() <= volumeSize;
+  }
+
+  // Leer un rango del flujo, repartido en los volúmenes que haga falta.
+  // pread no mueve la posición del descriptor: es seguro entre hilos
+  bool read(uint64_t offset, size_t length, char *buffer) const {
+    if (offset + length > total) {
+      return false;
+    }
+    size_t volume =
+        upper_bound(starts.begin(), starts.end(), offset) - starts.begin() - 1;
+    while (length > 0) {
+      uint64_t end = volume + 1 < starts.size() ? starts[volume + 1] : total;
+      size_t chunk = static_cast<size_t>(min<uint64_t>(length, end - offset));
+      ssize_t got = pread(fds[volume], buffer, chunk,
+                          static_cast<off_t>(offset - starts[volume]));
+      if (got < 0 && errno == EINTR) {
+        continue;
+      }
+      if (got <= 0) {
+        return false;
+      }
+      buffer += got;
+      offset += got;
+      length -= got;
+      if (offset == end) {
+        volume++;
+      }
+    }
+    return true;
+  }
+};
+
+// Volúmenes <base>.bkp.NNN de una carpeta, ordenados por número. Si hay
+// más de una copia se usa la primera por nombre
+static vector<filesystem::path> findVolumes(const string &folderPath) {
+  static const regex pattern(R"((.+)\.bkp\.(\d{3,}))");
+  map<string, map<int, filesystem::path>> copies;
+  error_code ec;
+  for (const auto &entry : filesystem::directory_iterator(folderPath, ec)) {
+    smatch match;
+    string name = entry.path().filename().string();
+    if (entry.is_regular_file() && regex_match(name, match, pattern)) {
+      copies[match[1]][stoi(match[2])] = entry.path();
+    }
+  }
+
+  vector<filesystem::path> volumes;
+  if (copies.empty()) {
+    return volumes;
+  }
+  if (copies.size() > 1) {
+    LOG_INFO("Hay " << copies.size() << " copias en formato nativo; se usa "
+                    << copies.begin()->first);
+  }
+  int expected = 1;
+  for (const auto &numbered : copies.begin()->second) {
+    if (numbered.first != expected++) {
+      LOG_ERROR("Falta el volumen "
+                << nativeVolumeName(copies.begin()->first, expected - 1));
+      return vector<filesystem::path>();
+    }
+    volumes.push_back(numbered.second);
+  }
+  return volumes;
+}
+
+bool hasNativeBackup(const string &folderPath) {
+  static const regex pattern(R"(.+\.bkp\.\d{3,})");
+  error_code ec;
+  for (const auto &entry : filesystem::directory_iterator(folderPath, ec)) {
+    if (regex_match(entry.path().filename().string(), pattern)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Leer y decodificar un bloque del flujo
+static bool readNativeBlock(const VolumeReader &reader,
+                            const NativeBlock &block, const string &password,
+                            vector<char> &data,
+                            const string &dictionary = string()) {
+  vector<char> stored(block.storedSize);
+  throttleDisk(stored.size());
+  {
+    ScopedStage timer(Stage::READ, stored.size());
+    if (!reader.read(block.streamOffset, stored.size(), stored.data())) {
+      return false;
+    }
+  }
+  return decodeNativeBlock(stored.data(), stored.size(), block.compressed,
+                           block.rawSize, password, data, dictionary);
+}
+
+// Diccionario con que se comprimió un bloque (vacío si no usa)
+static const string &blockDictionary(const NativeCatalog &catalog,
+                                     const NativeBlock &block) {
+  static const string none;
+  return block.dictionary >= 0 ? catalog.dictionaries[block.dictionary].data
+                               : none;
+}
+
+// Copia abierta: sus volúmenes, su catálogo y, si es delta, su base
+struct NativeBackup {
+  string folder; // Carpeta desde la que se abrió
+  VolumeReader reader;
+  NativeCatalog catalog;
+  string key; // Contraseña con que se descifra (vacía si no está cifrada)
+  unordered_map<string, size_t> files; // Ruta -> índice en el catálogo
+  unique_ptr<NativeBackup> base;
+};
+
+// Una cadena de copias delta más larga que esto es un ciclo
+static const int MAX_BASE_DEPTH = 256;
+
+// Abrir los volúmenes y leer el catálogo, comprobando la contraseña. Si la
+// copia es delta y openBase es true, se abre también su base (en baseFolder
+// o, si está vacía, donde estaba al hacer la copia)
+static bool openNativeBackup(const string &folderPath, const string &password,
+                             NativeBackup &backup, bool openBase = true,
+                             const string &baseFolder = "", int depth = 0) {
+  VolumeReader &reader = backup.reader;
+  NativeCatalog &catalog = backup.catalog;
+  backup.folder = folderPath;
+  vector<filesystem::path> volumes = findVolumes(folderPath);
+  if (volumes.empty()) {
+    LOG_ERROR("No hay volúmenes en formato nativo en " << folderPath);
+    return false;
+  }
+  if (!reader.open(volumes)) {
+    return false;
+  }
+
+  char header[NATIVE_HEADER_BYTES];
+  char tail[NATIVE_FOOTER_BYTES];
+  uint64_t blockSize = 0;
+  bool encrypted = false;
+  NativeFooter footer;
+  if (reader.size() < NATIVE_HEADER_BYTES + NATIVE_FOOTER_BYTES ||
+      !reader.read(0, sizeof(header), header) ||
+      !decodeNativeHeader(header, blockSize, encrypted)) {
+    LOG_ERROR("El primer volumen no es una copia en formato nativo: "
+              << volumes.front());
+    return false;
+  }
+  if (!reader.read(reader.size() - sizeof(tail), sizeof(tail), tail) ||
+      !decodeNativeFooter(tail, footer)) {
+    LOG_ERROR("La copia está incompleta: falta el pie en el último volumen "
+              << volumes.back());
+    return false;
+  }
+  if (!reader.uniformVolumes(footer.volumeSize)) {
+    LOG_ERROR("Los volúmenes no tienen el tamaño esperado de "
+              << footer.volumeSize << " bytes; falta o sobra alguno");
+    return false;
+  }
+
+  if (encrypted && password.empty()) {
+    LOG_ERROR("La copia está encriptada: indique la contraseña con -p");
+    return false;
+  }
+  if (!encrypted && !password.empty()) {
+    LOG_INFO("La copia no está encriptada; se ignora la contraseña");
+  }
+  backup.key = encrypted ? password : string();
+  const string &key = backup.key;
+
+  vector<char> text;
+  if (!readNativeBlock(reader, footer.catalog, key, text) ||
+      !parseNativeCatalog(string(text.begin(), text.end()), catalog)) {
+    LOG_ERROR((encrypted ? "Contraseña incorrecta o catálogo dañado"
+                         : "El catálogo de la copia está dañado"));
+    return false;
+  }
+  if (encrypted &&
+      catalog.encryptionHash != SimpleCrypto().generatePasswordHash(password)) {
+    LOG_ERROR("Contraseña incorrecta");
+    return false;
+  }
+
+  // Los diccionarios se cargan una vez y los comparten todos los bloques
+  for (auto &dictionary : catalog.dictionaries) {
+    vector<char> data;
+    if (!readNativeBlock(reader, dictionary.block, key, data)) {
+      LOG_ERROR("Diccionario dañado en la copia: " << dictionary.extension);
+      return false;
+    }
+    dictionary.data.assign(data.begin(), data.end());
+  }
+  for (size_t i = 0; i < catalog.files.size(); i++) {
+    backup.files[catalog.files[i].path] = i;
+  }
+  LOG_DEBUG("Copia en formato nativo: " << volumes.size() << " volúmenes, "
+                                        << catalog.files.size()
+                                        << " archivos, "
+                                        << catalog.dictionaries.size()
+                                        << " diccionarios");
+
+  if (!openBase || catalog.baseId.empty()) {
+    return true;
+  }
+  if (depth >= MAX_BASE_DEPTH) {
+    LOG_ERROR("La cadena de copias base es demasiado larga en " << folderPath);
+    return false;
+  }
+  // Una ruta relativa es relativa a la carpeta de esta copia
+  string folder =
+      !baseFolder.empty() ? baseFolder
+      : filesystem::path(catalog.baseFolder).is_relative()
+          ? (filesystem::path(folderPath) / catalog.baseFolder).string()
+          : catalog.baseFolder;
+  LOG_DEBUG("Copia delta: su base está en " << folder);
+  backup.base = make_unique<NativeBackup>();
+  if (!openNativeBackup(folder, password, *backup.base, true, "",
+                        depth + 1)) {
+    LOG_ERROR("No se pudo abrir la copia base de " << folderPath
+                                                   << " (indíquela con -c)");
+    return false;
+  }
+  if (backup.base->catalog.id != catalog.baseId) {
+    LOG_ERROR("La copia de " << folder << " no es la base de " << folderPath);
+    return false;
+  }
+  return true;
+}
+
+static bool readFileRange(const NativeBackup &backup, const NativeFile &file,
+                          uint64_t offset, uint64_t length, char *out);
+
+// Contenido de un bloque de un archivo: decodificado del flujo o, si viene
+// de la base, leído del mismo archivo en la base
+static bool readFileBlock(const NativeBackup &backup, const NativeFile &file,
+                          const NativeBlock &block, vector<char> &data) {
+  if (!block.fromBase) {
+    return readNativeBlock(backup.reader, block, backup.key, data,
+                           blockDictionary(backup.catalog, block));
+  }
+  auto found = backup.base ? backup.base->files.find(file.path)
+                           : unordered_map<string, size_t>::const_iterator();
+  if (!backup.base || found == backup.base->files.end()) {
+    LOG_ERROR("El archivo " << file.path << " no está en la copia base");
+    return false;
+  }
+  const NativeFile &baseFile = backup.base->catalog.files[found->second];
+  if (block.streamOffset + block.rawSize > baseFile.size) {
+    return false;
+  }
+  data.resize(block.rawSize);
+  return readFileRange(*backup.base, baseFile, block.streamOffset,
+                       block.rawSize, data.data());
+}
+
+// Lee un rango de un archivo decodificando solo los bloques que lo cubren
+static bool readFileRange(const NativeBackup &backup, const NativeFile &file,
+                          uint64_t offset, uint64_t length, char *out) {
+  // Los bloques están ordenados por posición: el primero que interesa es el
+  // último que empieza en offset o antes
+  auto block = upper_bound(file.blocks.begin(), file.blocks.end(), offset,
+                           [](uint64_t value, const NativeBlock &b) {
+                             return value < b.fileOffset;
+                           });
+  if (block != file.blocks.begin()) {
+    --block;
+  }
+  for (; block != file.blocks.end() && block->fileOffset < offset + length;
+       ++block) {
+    if (block->fileOffset + block->rawSize <= offset) {
+      continue;
+    }
+    vector<char> data;
+    if (!readFileBlock(backup, file, *block, data)) {
+      return false;
+    }
+    uint64_t from = max(offset, block->fileOffset);
+    uint64_t to = min(offset + length, block->fileOffset + block->rawSize);
+    memcpy(out + (from - offset), data.data() + (from - block->fileOffset),
+           static_cast<size_t>(to - from));
+  }
+  return true;
+}
+
+shared_ptr<NativeBackup> openNativeBackupChain(const string &folderPath,
+                                               const string &password) {
+  auto backup = make_shared<NativeBackup>();
+  if (!openNativeBackup(folderPath, password, *backup)) {
+    return nullptr;
+  }
+  return backup;
+}
+
+const NativeCatalog &nativeBackupCatalog(const NativeBackup &backup) {
+  return backup.catalog;
+}
+
+const string &nativeBackupFolder(const NativeBackup &backup) {
+  return backup.folder;
+}
+
+const NativeBackup *nativeBackupBase(const NativeBackup &backup) {
+  return backup.base.get();
+}
+
+const NativeFile *nativeBackupFile(const NativeBackup &backup,
+                                   const string &path) {
+  auto found = backup.files.find(path);
+  return found == backup.files.end()
+             ? nullptr
+             : &backup.catalog.files[found->second];
+}
+
+bool readNativeFileBlock(const NativeBackup &backup, const NativeFile &file,
+                         const NativeBlock &block, vector<char> &data) {
+  return readFileBlock(backup, file, block, data);
+}
+
+bool readNativeStoredBlock(const NativeBackup &backup,
+                           const NativeBlock &block, vector<char> &stored) {
+  if (block.fromBase) {
+    return false;
+  }
+  stored.resize(block.storedSize);
+  throttleDisk(stored.size());
+  ScopedStage timer(Stage::READ, stored.size());
+  return backup.reader.read(block.streamOffset, stored.size(), stored.data());
+}
+
+bool readNativeCatalog(const string &folderPath, const string &password,
+                       NativeCatalog &catalog) {
+  NativeBackup backup;
+  if (!openNativeBackup(folderPath, password, backup, false)) {
+    return false;
+  }
+  catalog = std::move(backup.catalog);
+  return true;
+}
+
+bool loadNativeSignatures(const string &folderPath, const string &password,
+                          NativeCatalog &catalog) {
+  NativeBackup backup;
+  if (!openNativeBackup(folderPath, password, backup, false)) {
+    return false;
+  }
+  catalog = std::move(backup.catalog);
+  if (catalog.id.empty()) {
+    LOG_ERROR("La copia de " << folderPath
+                             << " no guarda firmas: no puede ser base");
+    return false;
+  }
+  vector<char> data;
+  if (catalog.signatureBlockSize > 0 &&
+      (!readNativeBlock(backup.reader, catalog.signatures, backup.key, data) ||
+       !parseNativeSignatures(string(data.begin(), data.end()), catalog))) {
+    LOG_ERROR("Las firmas de la copia de " << folderPath << " están dañadas");
+    return false;
+  }
+  return true;
+}
+
+bool restoreNativeBackup(const string &folderPath, const string &outputPath,
+                         const string &password, const string &onlyPath,
+                         const string &baseFolder) {
+  NativeBackup backup;
+  if (!openNativeBackup(folderPath, password, backup, true, baseFolder)) {
+    return false;
+  }
+  const NativeCatalog &catalog = backup.catalog;
+  const string &key = backup.key;
+
+  // Crear cada archivo con su tamaño final: así los bloques se escriben en
+  // su posición desde cualquier hilo y en cualquier orden
+  vector<const NativeFile *> files;
+  vector<pair<size_t, size_t>> jobs; // Archivo y bloque
+  uintmax_t totalBytes = 0;
+  for (const auto &file : catalog.files) {
+    if (!onlyPath.empty() && file.path != onlyPath) {
+      continue;
+    }
+    filesystem::path target = filesystem::path(outputPath) / file.path;
+    filesystem::create_directories(target.parent_path());
+    int fd = open(target.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                  0644);
+    if (fd < 0 || ftruncate(fd, static_cast<off_t>(file.size)) != 0) {
+      LOG_ERROR("No se pudo crear el archivo: " << target);
+      if (fd >= 0) {
+        close(fd);
+      }
+      return false;
+    }
+    close(fd);
+    for (size_t b = 0; b < file.blocks.size(); b++) {
+      jobs.emplace_back(files.size(), b);
+    }
+    files.push_back(&file);
+    totalBytes += file.size;
+  }
+  if (files.empty()) {
+    LOG_ERROR("El archivo " << onlyPath << " no está en la copia");
+    return false;
+  }
+
+  LOG_INFO("Restaurando " << files.size() << " archivos (" << jobs.size()
+                          << " bloques) en formato nativo");
+  progressBegin("Extrayendo", files.size(), totalBytes);
+  progressAdvance(files.size() - count_if(files.begin(), files.end(),
+                                          [](const NativeFile *file) {
+                                            return file->size > 0;
+                                          }),
+                  0);
+
+  // Los bloques son independientes: cada hilo lee, descifra, descomprime y
+  // escribe el suyo con pwrite, también dentro de un mismo archivo
+  atomic<bool> success{true};
+#pragma omp parallel for schedule(dynamic) num_threads(compressThreadCount())
+  for (size_t i = 0; i < jobs.size(); i++) {
+    const NativeFile &file = *files[jobs[i].first];
+    const NativeBlock &block = file.blocks[jobs[i].second];
+    vector<char> data;
+    if (!readFileBlock(backup, file, block, data)) {
+      LOG_ERROR("Bloque dañado en " << file.path << " (byte "
+                                    << block.fileOffset << ")");
+      success = false;
+      continue;
+    }
+
+    filesystem::path target = filesystem::path(outputPath) / file.path;
+    throttleDisk(data.size());
+    ScopedStage timer(Stage::WRITE, data.size());
+    int fd = open(target.c_str(), O_WRONLY | O_CLOEXEC);
+    bool written =
+        fd >= 0 && pwrite(fd, data.data(), data.size(),
+                          static_cast<off_t>(block.fileOffset)) ==
+                       static_cast<ssize_t>(data.size());
+    if (fd >= 0) {
+      startWriteback(fd, block.fileOffset, data.size());
+      close(fd);
+    }
+    if (!written) {
+      LOG_ERROR("Error al escribir " << target);
+      success = false;
+      continue;
+    }
+    bool lastBlock = block.fileOffset + block.rawSize == file.size;
+    progressAdvance(lastBlock ? 1 : 0, data.size());
+  }
+  progressEnd();
+
+  LOG_INFO("Descompresión" << (key.empty() ? "" : " y desencriptado")
+                           << (success ? " completada" : " con errores")
+                           << ": " << files.size() << " archivos.");
+  return success;
+}
+
+bool readNativeRange(const string &folderPath, const string &path,
+                     uint64_t offset, uint64_t length, const string &password,
+                     FILE *out, const string &baseFolder) {
+  NativeBackup backup;
+  if (!openNativeBackup(folderPath, password, backup, true, baseFolder)) {
+    return false;
+  }
+  auto found = backup.files.find(path);
+  if (found == backup.files.end()) {
+    LOG_ERROR("El archivo " << path << " no está en la copia");
+    return false;
+  }
+  const NativeFile &file = backup.catalog.files[found->second];
+  offset = min(offset, file.size);
+  length = min(length, file.size - offset);
+
+  // Solo los bloques que se solapan con el rango. Se decodifican en
+  // paralelo y se escriben en orden: en memoria hay como mucho un bloque
+  // por hilo
+  vector<const NativeBlock *> blocks;
+  for (const auto &block : file.blocks) {
+    if (block.fileOffset < offset + length &&
+        block.fileOffset + block.rawSize > offset) {
+      blocks.push_back(&block);
+    }
+  }
+  atomic<bool> success{true};
+  int threads = compressThreadCount();
+#pragma omp parallel for ordered schedule(dynamic) num_threads(threads)
+  for (size_t i = 0; i < blocks.size(); i++) {
+    const NativeBlock &block = *blocks[i];
+    vector<char> raw;
+    bool ok = success && readFileBlock(backup, file, block, raw);
+
+#pragma omp ordered
+    {
+      if (success && !ok) {
+        LOG_ERROR("Bloque dañado en " << path << " (byte " << block.fileOffset
+                                      << ")");
+        success = false;
+      } else if (success) {
+        uint64_t from = max(offset, block.fileOffset);
+        uint64_t to = min(offset + length, block.fileOffset + block.rawSize);
+        size_t size = static_cast<size_t>(to - from);
+        ScopedStage timer(Stage::WRITE, size);
+        if (fwrite(raw.data() + (from - block.fileOffset), 1, size, out) !=
+            size) {
+          LOG_ERROR("Error al escribir el rango de " << path);
+          success = false;
+        }
+      }
+    }
+  }
+  return success;
+}
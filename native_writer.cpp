@@ -0,0 +1,817 @@
+#include "compress.h"
+#include "crypto.h"
+#include "instrumentation.h"
+#include "logger.h"
+#include "low_impact.h"
+#include "native_format.h"
+#include "page_cache.h"
+#include "thread_config.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fcntl.h>
+#include <iomanip>
+#include <map>
+#include <random>
+#include <sstream>
+#include <unistd.h>
+
+using namespace std;
+
+// Trozo de un archivo que se comprime como un bloque
+struct BlockJob {
+  size_t file = 0;     // Índice en el catálogo
+  uint64_t offset = 0; // Primer byte dentro del archivo
+  size_t length = 0;
+  bool delta = false; // Buscar en el rango los bloques de la copia base
+};
+
+// Bloque ya preparado para escribirse en el flujo
+struct EncodedBlock {
+  NativeBlock block;
+  vector<char> stored; // Vacío en los bloques copiados de la base
+};
+
+// Reparte el flujo de la copia en volúmenes de volumeSize bytes, cortando
+// en cualquier byte, y entrega cada volumen en cuanto se completa
+class VolumeWriter {
+private:
+  filesystem::path base;
+  uint64_t volumeSize;
+  const PartSink &sink;
+  int index = 0;
+  uint64_t used = 0;     // Bytes del volumen actual
+  uint64_t position = 0; // Bytes de todo el flujo
+  FILE *file = nullptr;
+  vector<char> memory;
+  bool volumeOpen = false;
+
+  filesystem::path currentPath() const {
+    return nativeVolumeName(base.string(), index);
+  }
+
+  bool openNext() {
+    index++;
+    used = 0;
+    volumeOpen = true;
+    if (sink.inMemory()) {
+      memory.clear();
+      memory.reserve(volumeSize);
+      return true;
+    }
+    file = fopen(currentPath().string().c_str(), "wb");
+    if (!file) {
+      LOG_ERROR("No se pudo crear el volumen: " << currentPath());
+      return false;
+    }
+    return true;
+  }
+
+  bool closeCurrent() {
+    volumeOpen = false;
+    if (sink.inMemory()) {
+      sink.onPartBuffer(currentPath().filename().string(), std::move(memory));
+      memory = vector<char>();
+      return true;
+    }
+    startWriteback(fileno(file), 0, used);
+    bool ok = fclose(file) == 0;
+    file = nullptr;
+    if (!ok) {
+      LOG_ERROR("Error al cerrar el volumen: " << currentPath());
+      return false;
+    }
+    LOG_DEBUG("  Volumen terminado: " << currentPath().filename());
+    if (sink.onPartReady) {
+      sink.onPartReady(currentPath());
+    }
+    return true;
+  }
+
+public:
+  VolumeWriter(const filesystem::path &base, uint64_t volumeSize,
+               const PartSink &sink)
+      : base(base), volumeSize(volumeSize), sink(sink) {}
+
+  ~VolumeWriter() {
+    if (file) {
+      fclose(file);
+    }
+  }
+
+  // Posición en el flujo del próximo byte que se escriba
+  uint64_t tell() const { return position; }
+
+  // Cantidad de volúmenes empezados hasta ahora
+  int volumes() const { return index; }
+
+  bool write(const char *data, size_t size) {
+    while (size > 0) {
+      if (!volumeOpen && !openNext()) {
+        return false;
+      }
+      size_t chunk =
+          static_cast<size_t>(min<uint64_t>(size, volumeSize - used));
+      throttleDisk(chunk);
+      {
+        ScopedStage timer(Stage::WRITE, chunk);
+        if (sink.inMemory()) {
+          memory.insert(memory.end(), data, data + chunk);
+        } else if (fwrite(data, 1, chunk, file) != chunk) {
+          LOG_ERROR("Error al escribir el volumen: " << currentPath());
+          return false;
+        }
+      }
+      data += chunk;
+      size -= chunk;
+      used += chunk;
+      position += chunk;
+      if (used == volumeSize && !closeCurrent()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Cerrar el último volumen si quedó a medias
+  bool finish() { return !volumeOpen || closeCurrent(); }
+};
+
+// Lee un bloque de un archivo de origen. Cada llamada abre su propio
+// descriptor, así los bloques de un mismo archivo se leen a la vez desde
+// varios hilos
+static bool readBlock(const filesystem::path &path, const BlockJob &job,
+                      vector<char> &buffer) {
+  buffer.resize(job.length);
+  throttleDisk(job.length);
+  ScopedStage timer(Stage::READ, job.length);
+  if (directIO() &&
+      readDirect(path.string(), job.offset, job.length, buffer.data())) {
+    return true;
+  }
+
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    LOG_ERROR("No se pudo abrir el archivo: " << path);
+    return false;
+  }
+  adviseSequential(fd, job.offset, job.length);
+  size_t done = 0;
+  while (done < job.length) {
+    ssize_t got = pread(fd, buffer.data() + done, job.length - done,
+                        static_cast<off_t>(job.offset + done));
+    if (got <= 0) {
+      break;
+    }
+    done += static_cast<size_t>(got);
+  }
+  dropReadCache(fd, job.offset, job.length);
+  close(fd);
+  if (done != job.length) {
+    LOG_ERROR("Error al leer el archivo: " << path);
+    return false;
+  }
+  return true;
+}
+
+// Agrupa los archivos pequeños por extensión y entrena un diccionario para
+// cada grupo con bastantes archivos, leyendo una muestra repartida por todo
+// el grupo. fileDictionary queda con el diccionario de cada archivo
+static bool trainDictionaries(const SourceFiles &sources,
+                              NativeCatalog &catalog,
+                              vector<int> &fileDictionary, int threads) {
+  map<string, vector<size_t>> groups;
+  for (size_t i = 0; i < catalog.files.size(); i++) {
+    uint64_t size = catalog.files[i].size;
+    if (size > 0 && size <= NATIVE_DICTIONARY_MAX_FILE) {
+      groups[nativeDictionaryGroup(catalog.files[i].path)].push_back(i);
+    }
+  }
+  vector<pair<string, vector<size_t>>> candidates;
+  for (auto &group : groups) {
+    if (group.second.size() >= NATIVE_DICTIONARY_MIN_FILES) {
+      candidates.emplace_back(group.first, std::move(group.second));
+    }
+  }
+
+  vector<string> trained(candidates.size());
+  atomic<bool> success{true};
+#pragma omp parallel for schedule(dynamic) num_threads(threads)
+  for (size_t g = 0; g < candidates.size(); g++) {
+    const vector<size_t> &files = candidates[g].second;
+    size_t count = min(files.size(), NATIVE_DICTIONARY_SAMPLES);
+    vector<string> samples;
+    for (size_t k = 0; k < count && success; k++) {
+      BlockJob job;
+      job.file = files[k * files.size() / count];
+      job.length = static_cast<size_t>(min<uint64_t>(
+          catalog.files[job.file].size, NATIVE_DICTIONARY_SAMPLE_BYTES));
+      vector<char> buffer;
+      if (!readBlock(sources.paths[job.file], job, buffer)) {
+        success = false;
+      }
+      samples.emplace_back(buffer.begin(), buffer.end());
+    }
+    if (success) {
+      trained[g] = trainNativeDictionary(samples, NATIVE_DICTIONARY_BYTES);
+    }
+  }
+  if (!success) {
+    return false;
+  }
+
+  size_t covered = 0;
+  for (size_t g = 0; g < candidates.size(); g++) {
+    const string &extension = candidates[g].first;
+    if (trained[g].empty()) {
+      LOG_DEBUG("  Sin diccionario para "
+                << (extension.empty() ? "(sin extensión)" : extension)
+                << ": las muestras no comparten contenido");
+      continue;
+    }
+    LOG_DEBUG("  Diccionario para "
+              << (extension.empty() ? "(sin extensión)" : extension) << ": "
+              << trained[g].size() << " bytes, "
+              << candidates[g].second.size() << " archivos");
+    for (size_t file : candidates[g].second) {
+      fileDictionary[file] = static_cast<int>(catalog.dictionaries.size());
+    }
+    NativeDictionary dictionary;
+    dictionary.extension = extension;
+    dictionary.data = std::move(trained[g]);
+    catalog.dictionaries.push_back(std::move(dictionary));
+    covered += candidates[g].second.size();
+  }
+  LOG_INFO("Diccionarios entrenados: " << catalog.dictionaries.size()
+                                       << " para " << covered
+                                       << " archivos pequeños");
+  return true;
+}
+
+// Los diccionarios, justo detrás de la cabecera y sin diccionario propio
+static bool writeDictionaries(VolumeWriter &writer, NativeCatalog &catalog,
+                              int level, const string &password) {
+  for (auto &dictionary : catalog.dictionaries) {
+    vector<char> stored;
+    dictionary.block.rawSize = dictionary.data.size();
+    dictionary.block.streamOffset = writer.tell();
+    dictionary.block.compressed =
+        encodeNativeBlock(dictionary.data.data(), dictionary.data.size(),
+                          level, password, stored);
+    dictionary.block.storedSize = stored.size();
+    if (!writer.write(stored.data(), stored.size())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Final de la copia: las firmas y el catálogo como dos bloques más, y el pie
+static bool writeCatalog(VolumeWriter &writer, NativeCatalog &catalog,
+                         uint64_t volumeSize, int level,
+                         const string &password) {
+  if (catalog.signatureBlockSize > 0) {
+    string signatures = serializeNativeSignatures(catalog);
+    vector<char> stored;
+    catalog.signatures.rawSize = signatures.size();
+    catalog.signatures.streamOffset = writer.tell();
+    catalog.signatures.compressed = encodeNativeBlock(
+        signatures.data(), signatures.size(), level, password, stored);
+    catalog.signatures.storedSize = stored.size();
+    if (!writer.write(stored.data(), stored.size())) {
+      return false;
+    }
+  }
+
+  string text = serializeNativeCatalog(catalog);
+  vector<char> stored;
+  NativeFooter footer;
+  footer.volumeSize = volumeSize;
+  footer.catalog.rawSize = text.size();
+  footer.catalog.streamOffset = writer.tell();
+  footer.catalog.compressed =
+      encodeNativeBlock(text.data(), text.size(), level, password, stored);
+  footer.catalog.storedSize = stored.size();
+  string tail = encodeNativeFooter(footer);
+  return writer.write(stored.data(), stored.size()) &&
+         writer.write(tail.data(), tail.size()) && writer.finish();
+}
+
+// Identificador aleatorio con que una copia delta reconoce a su base
+static string newBackupId() {
+  random_device device;
+  ostringstream out;
+  out << hex << setfill('0');
+  for (int i = 0; i < 4; i++) {
+    out << setw(8) << device();
+  }
+  return out.str();
+}
+
+// Firmas de los bloques completos de NATIVE_DELTA_BLOCK_BYTES de un trozo
+// leído en job.offset, que siempre empieza en el borde de uno
+static void signBlocks(const BlockJob &job, const vector<char> &raw,
+                       vector<NativeSignature> &signatures) {
+  const auto *data = reinterpret_cast<const unsigned char *>(raw.data());
+  size_t first = static_cast<size_t>(job.offset / NATIVE_DELTA_BLOCK_BYTES);
+  size_t count = raw.size() / NATIVE_DELTA_BLOCK_BYTES;
+  for (size_t k = 0; k < count && first + k < signatures.size(); k++) {
+    nativeSignBlock(data + k * NATIVE_DELTA_BLOCK_BYTES,
+                    NATIVE_DELTA_BLOCK_BYTES, signatures[first + k]);
+  }
+}
+
+// Convierte los tramos de la búsqueda en bloques: lo nuevo se comprime en
+// trozos de hasta blockSize y las copias seguidas de la base se unen
+static void encodeDelta(const BlockJob &job, const vector<char> &raw,
+                        const vector<NativeDeltaOp> &ops, uint64_t blockSize,
+                        int level, const string &password,
+                        vector<EncodedBlock> &encoded) {
+  for (const auto &op : ops) {
+    if (op.fromBase) {
+      if (!encoded.empty()) {
+        NativeBlock &last = encoded.back().block;
+        if (last.fromBase &&
+            last.fileOffset + last.rawSize == job.offset + op.offset &&
+            last.streamOffset + last.rawSize == op.baseOffset &&
+            last.rawSize + op.length <= blockSize) {
+          last.rawSize += op.length;
+          continue;
+        }
+      }
+      EncodedBlock piece;
+      piece.block.fileOffset = job.offset + op.offset;
+      piece.block.rawSize = op.length;
+      piece.block.streamOffset = op.baseOffset;
+      piece.block.compressed = false;
+      piece.block.fromBase = true;
+      encoded.push_back(std::move(piece));
+      continue;
+    }
+    for (uint64_t done = 0; done < op.length; done += blockSize) {
+      size_t length =
+          static_cast<size_t>(min<uint64_t>(blockSize, op.length - done));
+      EncodedBlock piece;
+      piece.block.fileOffset = job.offset + op.offset + done;
+      piece.block.rawSize = length;
+      piece.block.compressed =
+          encodeNativeBlock(raw.data() + op.offset + done, length, level,
+                            password, piece.stored);
+      encoded.push_back(std::move(piece));
+    }
+  }
+}
+
+// Carga las firmas de la copia base y deja en baseIndex, para cada archivo
+// que también está en la base, el índice de sus firmas
+static bool loadBase(const string &baseFolder, const string &outputPath,
+                     const string &password, NativeCatalog &catalog,
+                     NativeCatalog &baseCatalog,
+                     vector<NativeBaseIndex> &baseIndex,
+                     vector<int> &fileBase, int threads) {
+  error_code ec;
+  filesystem::path folder =
+      filesystem::weakly_canonical(filesystem::absolute(baseFolder), ec);
+  filesystem::path output = filesystem::weakly_canonical(
+      filesystem::absolute(filesystem::path(outputPath).parent_path()), ec);
+  if (folder == output) {
+    LOG_ERROR("La copia base no puede estar en la carpeta de salida");
+    return false;
+  }
+  if (!loadNativeSignatures(folder.string(), password, baseCatalog)) {
+    return false;
+  }
+  if (baseCatalog.signatureBlockSize != NATIVE_DELTA_BLOCK_BYTES) {
+    LOG_ERROR("La copia de " << folder
+                             << " no tiene firmas que se puedan usar");
+    return false;
+  }
+  // La ruta de la base se guarda relativa a la copia, así las dos se
+  // pueden mover juntas
+  filesystem::path relative = folder.lexically_relative(output);
+  catalog.baseId = baseCatalog.id;
+  catalog.baseFolder =
+      relative.empty() ? folder.string() : relative.string();
+
+  map<string, size_t> basePaths;
+  for (size_t i = 0; i < baseCatalog.files.size(); i++) {
+    if (!baseCatalog.files[i].signatures.empty()) {
+      basePaths[baseCatalog.files[i].path] = i;
+    }
+  }
+  vector<size_t> baseFiles;
+  for (size_t i = 0; i < catalog.files.size(); i++) {
+    auto found = basePaths.find(catalog.files[i].path);
+    if (found != basePaths.end() &&
+        catalog.files[i].size >= NATIVE_DELTA_MIN_FILE) {
+      fileBase[i] = static_cast<int>(baseFiles.size());
+      baseFiles.push_back(found->second);
+    }
+  }
+  baseIndex.resize(baseFiles.size());
+#pragma omp parallel for schedule(dynamic) num_threads(threads)
+  for (size_t k = 0; k < baseFiles.size(); k++) {
+    buildNativeBaseIndex(baseCatalog.files[baseFiles[k]].signatures,
+                         baseIndex[k]);
+  }
+  LOG_INFO("Copia delta sobre " << folder << ": " << baseFiles.size()
+                                << " archivos con firmas en la base");
+  return true;
+}
+
+bool compressFoldersToNative(const vector<string> &folderPaths,
+                             const string &outputPath, int maxSizeMB,
+                             const string &password, bool useParallel,
+                             const PartSink &sink,
+                             const NativeOptions &options) {
+  if (maxSizeMB <= 0) {
+    LOG_ERROR("El tamaño máximo debe ser positivo");
+    return false;
+  }
+  uint64_t volumeSize = static_cast<uint64_t>(maxSizeMB) * 1024 * 1024;
+
+  int compressThreads = useParallel ? compressThreadCount() : 1;
+  int ioThreads = useParallel ? ioThreadCount() : 1;
+  if (!useParallel) {
+    LOG_INFO("Modo serial activado (sin paralelismo)");
+  } else {
+    LOG_INFO("Modo paralelo activado con " << compressThreads
+                                           << " hilos de compresión y "
+                                           << ioThreads << " de E/S");
+  }
+
+  if (folderPaths.size() > 1) {
+    LOG_INFO("Carpetas de origen: " << folderPaths.size());
+  }
+  SourceFiles sources;
+  if (!collectSources(folderPaths, sources, ioThreads)) {
+    return false;
+  }
+  if (sources.paths.empty()) {
+    LOG_ERROR("No hay archivos para comprimir");
+    return false;
+  }
+
+  NativeCatalog catalog;
+  if (!password.empty()) {
+    catalog.encryptionHash = SimpleCrypto().generatePasswordHash(password);
+    LOG_INFO("Modo encriptado activado");
+    LOG_INFO("Hash de verificación: " << catalog.encryptionHash);
+  }
+
+  catalog.files.resize(sources.paths.size());
+  bool anyLarge = false;
+  for (size_t i = 0; i < sources.paths.size(); i++) {
+    NativeFile &entry = catalog.files[i];
+    entry.path = sources.zipPaths[i];
+    ScopedStage timer(Stage::STAT);
+    error_code ec;
+    entry.size = filesystem::file_size(sources.paths[i], ec);
+    if (ec) {
+      LOG_ERROR("No se pudo obtener el tamaño de " << sources.paths[i]);
+      return false;
+    }
+    anyLarge = anyLarge || entry.size >= NATIVE_DELTA_MIN_FILE;
+  }
+
+  // Los archivos grandes guardan las firmas de sus bloques, para que la
+  // copia pueda servir de base a una copia delta
+  if (anyLarge) {
+    catalog.id = newBackupId();
+    catalog.signatureBlockSize = NATIVE_DELTA_BLOCK_BYTES;
+  }
+  NativeCatalog baseCatalog;
+  vector<NativeBaseIndex> baseIndex;
+  vector<int> fileBase(catalog.files.size(), -1);
+  if (!options.baseFolder.empty() &&
+      !loadBase(options.baseFolder, outputPath, password, catalog,
+                baseCatalog, baseIndex, fileBase, compressThreads)) {
+    return false;
+  }
+
+  // Índice de bloques: cada archivo se corta en trozos de blockSize, y los
+  // que están en la base en rangos más grandes donde buscar sus bloques
+  vector<BlockJob> jobs;
+  uintmax_t totalBytes = 0;
+  uint64_t emptyFiles = 0;
+  for (size_t i = 0; i < catalog.files.size(); i++) {
+    NativeFile &entry = catalog.files[i];
+    if (entry.size >= NATIVE_DELTA_MIN_FILE) {
+      entry.signatures.resize(entry.size / NATIVE_DELTA_BLOCK_BYTES);
+    }
+    bool delta = fileBase[i] >= 0;
+    uint64_t step = delta ? NATIVE_DELTA_SEGMENT_BYTES : catalog.blockSize;
+    for (uint64_t offset = 0; offset < entry.size; offset += step) {
+      BlockJob job;
+      job.file = i;
+      job.offset = offset;
+      job.length =
+          static_cast<size_t>(min<uint64_t>(step, entry.size - offset));
+      job.delta = delta;
+      jobs.push_back(job);
+    }
+    emptyFiles += entry.size == 0 ? 1 : 0;
+    totalBytes += entry.size;
+  }
+
+  LOG_INFO("Total de archivos a comprimir: "
+           << sources.paths.size() << " en " << jobs.size()
+           << " bloques de hasta " << catalog.blockSize / 1024 << " KB");
+
+  int level = compressionLevel();
+  vector<int> fileDictionary(catalog.files.size(), -1);
+  if (options.dictionaries && level == 0) {
+    LOG_INFO("Nivel de compresión 0: no se entrenan diccionarios");
+  } else if (options.dictionaries &&
+             !trainDictionaries(sources, catalog, fileDictionary,
+                                compressThreads)) {
+    return false;
+  }
+
+  filesystem::path baseOutputPath(outputPath);
+  filesystem::path base =
+      baseOutputPath.parent_path() / baseOutputPath.stem();
+  if (!sink.inMemory()) {
+    filesystem::create_directories(baseOutputPath.parent_path());
+  }
+
+  VolumeWriter writer(base, volumeSize, sink);
+  string header = encodeNativeHeader(catalog.blockSize, !password.empty());
+  // Lo leen todos los hilos fuera de la sección ordenada
+  atomic<bool> success{writer.write(header.data(), header.size()) &&
+                       writeDictionaries(writer, catalog, level, password)};
+
+  progressBegin("Comprimiendo", sources.paths.size(), totalBytes);
+  progressAdvance(emptyFiles, 0);
+  const string noDictionary;
+  uint64_t fromBaseBytes = 0;
+
+  // Cada hilo lee, comprime y cifra bloques por su cuenta; solo la
+  // escritura en el flujo va en orden. Así el índice queda en el orden de
+  // los archivos y cada volumen se entrega en cuanto se llena
+#pragma omp parallel for ordered schedule(dynamic) num_threads(compressThreads)
+  for (size_t i = 0; i < jobs.size(); i++) {
+    const BlockJob &job = jobs[i];
+    NativeFile &entry = catalog.files[job.file];
+    vector<char> raw;
+    vector<EncodedBlock> encoded;
+    int dictionary = fileDictionary[job.file];
+    bool ok = success && readBlock(sources.paths[job.file], job, raw);
+    if (ok) {
+      // Cada tarea firma sus propios bloques: las posiciones no se pisan
+      signBlocks(job, raw, entry.signatures);
+    }
+    if (ok && job.delta) {
+      auto ops = nativeDeltaSearch(
+          reinterpret_cast<const unsigned char *>(raw.data()), raw.size(),
+          baseIndex[fileBase[job.file]]);
+      encodeDelta(job, raw, ops, catalog.blockSize, level, password,
+                  encoded);
+    } else if (ok) {
+      EncodedBlock piece;
+      piece.block.fileOffset = job.offset;
+      piece.block.rawSize = job.length;
+      piece.block.compressed = encodeNativeBlock(
+          raw.data(), raw.size(), level, password, piece.stored,
+          dictionary >= 0 ? catalog.dictionaries[dictionary].data
+                          : noDictionary);
+      piece.block.dictionary = piece.block.compressed ? dictionary : -1;
+      encoded.push_back(std::move(piece));
+    }
+    raw = vector<char>();
+
+#pragma omp ordered
+    {
+      if (!ok) {
+        success = false;
+      } else if (success) {
+        for (auto &piece : encoded) {
+          NativeBlock &block = piece.block;
+          if (block.fromBase) {
+            fromBaseBytes += block.rawSize;
+          } else {
+            block.streamOffset = writer.tell();
+            block.storedSize = piece.stored.size();
+            success = success &&
+                      writer.write(piece.stored.data(), piece.stored.size());
+          }
+          entry.blocks.push_back(block);
+        }
+        bool lastBlock = job.offset + job.length == entry.size;
+        progressAdvance(lastBlock ? 1 : 0, job.length);
+      }
+    }
+  }
+  progressEnd();
+
+  // Sin ningún bloque tomado de la base la copia es completa: no se anota
+  // una base de la que no depende
+  if (fromBaseBytes == 0 && !catalog.baseId.empty()) {
+    LOG_INFO("Ningún bloque coincide con la copia base: copia completa");
+    catalog.baseId.clear();
+    catalog.baseFolder.clear();
+  }
+  success = success &&
+            writeCatalog(writer, catalog, volumeSize, level, password);
+
+  if (!success) {
+    LOG_ERROR("Error al escribir la copia en formato nativo");
+    return false;
+  }
+  LOG_INFO("Compresión" << (password.empty() ? "" : " encriptada")
+                        << " completada en " << writer.volumes()
+                        << " volúmenes (" << writer.tell()
+                        << " bytes en formato nativo).");
+  if (!catalog.baseId.empty()) {
+    LOG_INFO("Copia delta: " << fromBaseBytes << " de " << totalBytes
+                             << " bytes se toman de la copia base");
+  }
+  logFlush();
+  return true;
+}
+
+// Bloques de la copia nueva que sustituyen a un bloque copiado de la base:
+// lo que en la base venía a su vez de la suya sigue siendo una referencia,
+// y lo que la base guardaba se decodifica y se comprime de nuevo
+static bool resolveFromBase(const NativeBackup &base, const NativeFile &file,
+                            const NativeBlock &block, int level,
+                            const string &password,
+                            vector<EncodedBlock> &encoded) {
+  const NativeFile *baseFile = nativeBackupFile(base, file.path);
+  if (!baseFile) {
+    LOG_ERROR("El archivo " << file.path << " no está en la copia base");
+    return false;
+  }
+  uint64_t start = block.streamOffset; // Posición en el archivo de la base
+  uint64_t end = start + block.rawSize;
+  auto covering = upper_bound(baseFile->blocks.begin(), baseFile->blocks.end(),
+                              start, [](uint64_t value, const NativeBlock &b) {
+                                return value < b.fileOffset;
+                              });
+  if (covering != baseFile->blocks.begin()) {
+    --covering;
+  }
+  for (; covering != baseFile->blocks.end() && covering->fileOffset < end;
+       ++covering) {
+    uint64_t from = max(start, covering->fileOffset);
+    uint64_t to = min(end, covering->fileOffset + covering->rawSize);
+    if (from >= to) {
+      continue;
+    }
+    EncodedBlock piece;
+    piece.block.fileOffset = block.fileOffset + (from - start);
+    piece.block.rawSize = to - from;
+    if (covering->fromBase) {
+      piece.block.streamOffset =
+          covering->streamOffset + (from - covering->fileOffset);
+      piece.block.compressed = false;
+      piece.block.fromBase = true;
+    } else {
+      vector<char> raw;
+      if (!readNativeFileBlock(base, *baseFile, *covering, raw)) {
+        return false;
+      }
+      piece.block.compressed = encodeNativeBlock(
+          raw.data() + (from - covering->fileOffset),
+          static_cast<size_t>(to - from), level, password, piece.stored);
+    }
+    encoded.push_back(std::move(piece));
+  }
+  return true;
+}
+
+bool mergeNativeBase(const string &folderPath, const string &outputPath,
+                     int maxSizeMB, const string &password,
+                     bool useParallel) {
+  if (maxSizeMB <= 0) {
+    LOG_ERROR("El tamaño máximo debe ser positivo");
+    return false;
+  }
+  uint64_t volumeSize = static_cast<uint64_t>(maxSizeMB) * 1024 * 1024;
+  shared_ptr<NativeBackup> backup = openNativeBackupChain(folderPath, password);
+  if (!backup) {
+    return false;
+  }
+  const NativeCatalog &source = nativeBackupCatalog(*backup);
+  const NativeBackup *base = nativeBackupBase(*backup);
+  if (!base) {
+    LOG_ERROR("La copia de " << folderPath << " no es delta");
+    return false;
+  }
+  const NativeCatalog &baseCatalog = nativeBackupCatalog(*base);
+  NativeCatalog signatures;
+  if (!source.id.empty() &&
+      !loadNativeSignatures(folderPath, password, signatures)) {
+    return false;
+  }
+  const string &key = source.encryptionHash.empty() ? string() : password;
+
+  // El mismo catálogo, con el mismo identificador para que las copias delta
+  // hechas sobre esta sigan encontrándola, y con la base de su base
+  NativeCatalog catalog;
+  catalog.blockSize = source.blockSize;
+  catalog.encryptionHash = source.encryptionHash;
+  catalog.id = source.id;
+  catalog.signatureBlockSize = source.signatureBlockSize;
+  catalog.dictionaries = source.dictionaries;
+  if (!baseCatalog.baseId.empty()) {
+    // La ruta de la nueva base, relativa a la carpeta de esta copia
+    filesystem::path folder(baseCatalog.baseFolder);
+    if (folder.is_relative()) {
+      folder = filesystem::path(nativeBackupFolder(*base)) / folder;
+    }
+    error_code ec;
+    filesystem::path absolute =
+        filesystem::weakly_canonical(filesystem::absolute(folder), ec);
+    filesystem::path relative = absolute.lexically_relative(
+        filesystem::weakly_canonical(filesystem::absolute(folderPath), ec));
+    catalog.baseId = baseCatalog.baseId;
+    catalog.baseFolder =
+        relative.empty() ? absolute.string() : relative.string();
+  }
+  catalog.files.resize(source.files.size());
+  vector<pair<size_t, size_t>> jobs; // Archivo y bloque
+  uintmax_t totalBytes = 0;
+  uint64_t emptyFiles = 0;
+  for (size_t i = 0; i < source.files.size(); i++) {
+    catalog.files[i].path = source.files[i].path;
+    catalog.files[i].size = source.files[i].size;
+    if (!signatures.files.empty()) {
+      catalog.files[i].signatures = std::move(signatures.files[i].signatures);
+    }
+    for (size_t b = 0; b < source.files[i].blocks.size(); b++) {
+      jobs.emplace_back(i, b);
+    }
+    emptyFiles += source.files[i].size == 0 ? 1 : 0;
+    totalBytes += source.files[i].size;
+  }
+
+  filesystem::path baseOutputPath(outputPath);
+  filesystem::create_directories(baseOutputPath.parent_path());
+  PartSink sink;
+  VolumeWriter writer(baseOutputPath.parent_path() / baseOutputPath.stem(),
+                      volumeSize, sink);
+  int level = compressionLevel();
+  string header = encodeNativeHeader(catalog.blockSize, !key.empty());
+  // Lo leen todos los hilos fuera de la sección ordenada
+  atomic<bool> success{writer.write(header.data(), header.size()) &&
+                       writeDictionaries(writer, catalog, level, key)};
+
+  // Los bloques guardados en la copia se copian tal cual; solo los que
+  // venían de la base se resuelven en ella, todos en paralelo
+  progressBegin("Fusionando", source.files.size(), totalBytes);
+  progressAdvance(emptyFiles, 0);
+  uint64_t rewrittenBytes = 0;
+  int threads = useParallel ? compressThreadCount() : 1;
+#pragma omp parallel for ordered schedule(dynamic) num_threads(threads)
+  for (size_t i = 0; i < jobs.size(); i++) {
+    const NativeFile &file = source.files[jobs[i].first];
+    const NativeBlock &original = file.blocks[jobs[i].second];
+    vector<EncodedBlock> encoded;
+    bool ok = success;
+    if (ok && original.fromBase) {
+      ok = resolveFromBase(*base, file, original, level, key, encoded);
+    } else if (ok) {
+      EncodedBlock piece;
+      piece.block = original;
+      ok = readNativeStoredBlock(*backup, original, piece.stored);
+      encoded.push_back(std::move(piece));
+    }
+
+#pragma omp ordered
+    {
+      if (!ok) {
+        success = false;
+      } else if (success) {
+        for (auto &piece : encoded) {
+          NativeBlock &block = piece.block;
+          if (!block.fromBase) {
+            rewrittenBytes += original.fromBase ? block.rawSize : 0;
+            block.streamOffset = writer.tell();
+            block.storedSize = piece.stored.size();
+            success = success &&
+                      writer.write(piece.stored.data(), piece.stored.size());
+          }
+          catalog.files[jobs[i].first].blocks.push_back(block);
+        }
+        bool lastBlock = original.fileOffset + original.rawSize == file.size;
+        progressAdvance(lastBlock ? 1 : 0, original.rawSize);
+      }
+    }
+  }
+  progressEnd();
+
+  success = success &&
+            writeCatalog(writer, catalog, volumeSize, level, key);
+  if (!success) {
+    LOG_ERROR("Error al fusionar la copia de " << folderPath);
+    return false;
+  }
+  LOG_INFO("Copia de " << folderPath << " fusionada con su base: "
+                       << rewrittenBytes << " bytes tomados de la base, "
+                       << writer.tell() << " bytes"
+                       << (catalog.baseId.empty() ? " (copia completa)"
+                                                  : ""));
+  logFlush();
+  return true;
+}
@@ -0,0 +1,113 @@
+#include "page_cache.h"
+#include "logger.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <unistd.h>
+
+using namespace std;
+
+// Alineación de O_DIRECT (tamaño de bloque lógico habitual; vale también
+// para discos de 512 bytes)
+static const size_t DIRECT_ALIGNMENT = 4096;
+
+// Tamaño del buffer alineado de cada hilo
+static const size_t DIRECT_BUFFER_BYTES = 4 * 1024 * 1024;
+
+static atomic<bool> directEnabled{false};
+
+void setDirectIO(bool enabled) { directEnabled = enabled; }
+
+bool directIO() { return directEnabled; }
+
+void adviseSequential(int fd, uint64_t offset, uint64_t length) {
+  posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(length),
+                POSIX_FADV_SEQUENTIAL);
+}
+
+void dropReadCache(int fd, uint64_t offset, uint64_t length) {
+  posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(length),
+                POSIX_FADV_DONTNEED);
+}
+
+void startWriteback(int fd, uint64_t offset, uint64_t length) {
+#ifdef __linux__
+  sync_file_range(fd, static_cast<off_t>(offset), static_cast<off_t>(length),
+                  SYNC_FILE_RANGE_WRITE);
+#else
+  (void)fd;
+  (void)offset;
+  (void)length;
+#endif
+}
+
+void dropWrittenCache(int fd, uint64_t offset, uint64_t length) {
+#ifdef __linux__
+  // Las páginas sucias o en escritura no se pueden descartar: primero
+  // esperar a que lleguen a disco
+  sync_file_range(fd, static_cast<off_t>(offset), static_cast<off_t>(length),
+                  SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+                      SYNC_FILE_RANGE_WAIT_AFTER);
+#endif
+  dropReadCache(fd, offset, length);
+}
+
+bool readDirect(const string &path, uint64_t offset, size_t length,
+                char *buffer) {
+#ifdef O_DIRECT
+  // Buffer alineado por hilo, reservado en la primera lectura
+  static thread_local unique_ptr<char, decltype(&free)> aligned(nullptr,
+                                                                 free);
+  if (!aligned) {
+    void *memory = nullptr;
+    if (posix_memalign(&memory, DIRECT_ALIGNMENT, DIRECT_BUFFER_BYTES) != 0) {
+      return false;
+    }
+    aligned.reset(static_cast<char *>(memory));
+  }
+
+  int fd = open(path.c_str(), O_RDONLY | O_DIRECT | O_CLOEXEC);
+  if (fd < 0) {
+    if (errno == EINVAL) {
+      LOG_DEBUG("O_DIRECT no admitido para " << path
+                                             << "; se lee de la forma normal");
+    }
+    return false;
+  }
+
+  // O_DIRECT exige desplazamiento y longitud alineados: se lee desde el
+  // bloque que contiene el siguiente byte pendiente y se copia lo útil
+  size_t copied = 0;
+  while (copied < length) {
+    uint64_t next = offset + copied;
+    uint64_t start = next & ~static_cast<uint64_t>(DIRECT_ALIGNMENT - 1);
+    size_t skip = static_cast<size_t>(next - start);
+    // Solo los bloques que cubren lo que falta, sin pasar del buffer
+    size_t wanted = (skip + (length - copied) + DIRECT_ALIGNMENT - 1) &
+                    ~(DIRECT_ALIGNMENT - 1);
+    ssize_t got = pread(fd, aligned.get(), min(wanted, DIRECT_BUFFER_BYTES),
+                        static_cast<off_t>(start));
+    if (got < 0 && errno == EINTR) {
+      continue;
+    }
+    if (got <= 0 || static_cast<size_t>(got) <= skip) {
+      break; // Error o fin de archivo antes de tiempo
+    }
+    size_t take = min(static_cast<size_t>(got) - skip, length - copied);
+    memcpy(buffer + copied, aligned.get() + skip, take);
+    copied += take;
+  }
+  close(fd);
+  return copied == length;
+#else
+  (void)path;
+  (void)offset;
+  (void)length;
+  (void)buffer;
+  return false;
+#endif
+}
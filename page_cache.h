@@ -0,0 +1,76 @@
+#ifndef PAGE_CACHE_H
+#define PAGE_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * Activa la lectura de los archivos de origen con O_DIRECT, sin pasar por
+ * la caché de páginas. Si el sistema de archivos no lo admite se lee de la
+ * forma normal.
+ *
+ * @param enabled true para leer con O_DIRECT
+ */
+void setDirectIO(bool enabled);
+
+// Si la lectura con O_DIRECT está activa
+bool directIO();
+
+/**
+ * Avisa al núcleo de que un rango se va a leer de principio a fin, para
+ * que agrande la lectura anticipada.
+ *
+ * @param fd Descriptor del archivo
+ * @param offset Primer byte del rango
+ * @param length Longitud del rango
+ */
+void adviseSequential(int fd, uint64_t offset, uint64_t length);
+
+/**
+ * Descarta de la caché de páginas un rango ya leído, para que la copia no
+ * desplace los datos de otros procesos.
+ *
+ * @param fd Descriptor del archivo
+ * @param offset Primer byte del rango
+ * @param length Longitud del rango
+ */
+void dropReadCache(int fd, uint64_t offset, uint64_t length);
+
+/**
+ * Empieza a escribir a disco un rango recién escrito sin esperar. Las
+ * páginas quedan limpias en cuanto termina y el núcleo las reclama antes
+ * que las del resto de procesos.
+ *
+ * @param fd Descriptor del archivo
+ * @param offset Primer byte del rango
+ * @param length Longitud del rango
+ */
+void startWriteback(int fd, uint64_t offset, uint64_t length);
+
+/**
+ * Espera a que un rango escrito llegue a disco y lo descarta de la caché.
+ * Pensado para el rango anterior al último escrito, cuya escritura ya se
+ * inició con startWriteback y casi nunca obliga a esperar.
+ *
+ * @param fd Descriptor del archivo
+ * @param offset Primer byte del rango
+ * @param length Longitud del rango
+ */
+void dropWrittenCache(int fd, uint64_t offset, uint64_t length);
+
+/**
+ * Lee un rango con O_DIRECT a través de un buffer alineado que cada hilo
+ * reserva una vez y reutiliza.
+ *
+ * @param path Archivo a leer
+ * @param offset Primer byte del rango
+ * @param length Bytes a leer
+ * @param buffer Destino de length bytes (sin requisitos de alineación)
+ * @return false si no se pudo (p. ej. el sistema de archivos no admite
+ * O_DIRECT); hay que leer de la forma normal
+ */
+bool readDirect(const std::string &path, uint64_t offset, size_t length,
+                char *buffer);
+
+#endif // PAGE_CACHE_H
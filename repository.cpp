@@ -0,0 +1,370 @@
+#include "repository.h"
+#include "logger.h"
+#include "native_format.h"
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <set>
+#include <sstream>
+
+using namespace std;
+
+// Los campos vacíos se guardan como "-" para poder separar por espacios
+static string field(const string &value) { return value.empty() ? "-" : value; }
+
+static string unfield(const string &value) {
+  return value == "-" ? string() : value;
+}
+
+static filesystem::path generationFolder(const string &repositoryPath,
+                                         const string &name) {
+  return filesystem::path(repositoryPath) / name;
+}
+
+// Escribe el catálogo entero en un archivo temporal y lo renombra encima
+// del anterior, así nunca queda a medias
+static bool saveRepository(const string &repositoryPath,
+                           const vector<BackupGeneration> &generations) {
+  filesystem::path path =
+      filesystem::path(repositoryPath) / REPOSITORY_CATALOG;
+  filesystem::path temporary = path.string() + ".tmp";
+  {
+    ofstream out(temporary);
+    out << "repository 1\n";
+    for (const auto &generation : generations) {
+      out << "generation " << generation.name << " " << generation.kind << " "
+          << field(generation.base) << " " << field(generation.id) << " "
+          << generation.time << " " << generation.storedBytes << " "
+          << generation.reusedBytes << "\n";
+    }
+    if (!out) {
+      LOG_ERROR("No se pudo escribir el catálogo del repositorio: " << path);
+      return false;
+    }
+  }
+  error_code ec;
+  filesystem::rename(temporary, path, ec);
+  if (ec) {
+    LOG_ERROR("No se pudo escribir el catálogo del repositorio: " << path);
+    return false;
+  }
+  return true;
+}
+
+bool parseRetentionPolicy(const string &text, RetentionPolicy &policy) {
+  int daily = 0;
+  int weekly = 0;
+  char extra = 0;
+  int fields = sscanf(text.c_str(), "%d,%d%c", &daily, &weekly, &extra);
+  if ((fields != 1 && fields != 2) || daily < 0 || weekly < 0) {
+    return false;
+  }
+  policy.daily = daily;
+  policy.weekly = fields == 2 ? weekly : 0;
+  return true;
+}
+
+bool loadRepository(const string &repositoryPath,
+                    vector<BackupGeneration> &generations) {
+  generations.clear();
+  filesystem::path path =
+      filesystem::path(repositoryPath) / REPOSITORY_CATALOG;
+  ifstream in(path);
+  if (!in.is_open()) {
+    return true;
+  }
+  string line;
+  while (getline(in, line)) {
+    istringstream fields(line);
+    string key;
+    fields >> key;
+    if (key == "repository") {
+      int version = 0;
+      if (!(fields >> version) || version != 1) {
+        LOG_ERROR("Versión de repositorio desconocida en " << path);
+        return false;
+      }
+    } else if (key == "generation") {
+      BackupGeneration generation;
+      string base;
+      string id;
+      if (!(fields >> generation.name >> generation.kind >> base >> id >>
+            generation.time >> generation.storedBytes >>
+            generation.reusedBytes)) {
+        LOG_ERROR("Catálogo del repositorio dañado: " << path);
+        return false;
+      }
+      generation.base = unfield(base);
+      generation.id = unfield(id);
+      generations.push_back(std::move(generation));
+    }
+  }
+  return true;
+}
+
+// Clave del día o de la semana (ISO) de una generación, en hora local
+static string periodKey(int64_t seconds, const char *format) {
+  time_t value = static_cast<time_t>(seconds);
+  tm local{};
+  localtime_r(&value, &local);
+  ostringstream out;
+  out << put_time(&local, format);
+  return out.str();
+}
+
+vector<bool>
+selectRetainedGenerations(const vector<BackupGeneration> &generations,
+                          const RetentionPolicy &policy) {
+  vector<bool> keep(generations.size(), false);
+  if (generations.empty()) {
+    return keep;
+  }
+  keep.back() = true;
+
+  // De la más reciente a la más antigua: la primera de cada periodo nuevo
+  // es la última copia de ese periodo
+  auto keepLastPerPeriod = [&generations, &keep](int count,
+                                                 const char *format) {
+    set<string> periods;
+    for (size_t i = generations.size(); i-- > 0;) {
+      if (static_cast<int>(periods.size()) >= count) {
+        break;
+      }
+      if (periods.insert(periodKey(generations[i].time, format)).second) {
+        keep[i] = true;
+      }
+    }
+  };
+  keepLastPerPeriod(policy.daily, "%Y-%m-%d");
+  keepLastPerPeriod(policy.weekly, "%G-W%V");
+  return keep;
+}
+
+bool beginGeneration(const string &repositoryPath,
+                     BackupGeneration &generation, string &outputPath,
+                     NativeOptions &options) {
+  vector<BackupGeneration> generations;
+  if (!loadRepository(repositoryPath, generations)) {
+    return false;
+  }
+  filesystem::create_directories(repositoryPath);
+
+  generation = BackupGeneration();
+  generation.time = static_cast<int64_t>(time(nullptr));
+  time_t now = static_cast<time_t>(generation.time);
+  tm local{};
+  localtime_r(&now, &local);
+  ostringstream name;
+  name << put_time(&local, "%Y%m%d_%H%M%S");
+  generation.name = name.str();
+  for (int suffix = 2;
+       filesystem::exists(generationFolder(repositoryPath, generation.name));
+       suffix++) {
+    generation.name = name.str() + "_" + to_string(suffix);
+  }
+
+  // Sobre la última generación si guarda firmas; si no, copia completa
+  if (!generations.empty() && !generations.back().id.empty()) {
+    generation.base = generations.back().name;
+    options.baseFolder =
+        generationFolder(repositoryPath, generation.base).string();
+  }
+  outputPath = (generationFolder(repositoryPath, generation.name) /
+                (string(REPOSITORY_VOLUME_STEM) + ".zip"))
+                   .string();
+  LOG_INFO("Generación " << generation.name << " en " << repositoryPath
+                         << (generation.base.empty()
+                                 ? " (completa)"
+                                 : " (incremental sobre " + generation.base +
+                                       ")"));
+  return true;
+}
+
+// Bytes de los volúmenes de una generación
+static uint64_t folderBytes(const filesystem::path &folder) {
+  uint64_t total = 0;
+  error_code ec;
+  for (const auto &entry : filesystem::directory_iterator(folder, ec)) {
+    if (entry.is_regular_file()) {
+      total += entry.file_size();
+    }
+  }
+  return total;
+}
+
+// Completa una generación con lo que dice el catálogo de su copia
+static bool describeGeneration(const string &repositoryPath,
+                               const string &password,
+                               BackupGeneration &generation) {
+  filesystem::path folder = generationFolder(repositoryPath, generation.name);
+  NativeCatalog catalog;
+  if (!readNativeCatalog(folder.string(), password, catalog)) {
+    return false;
+  }
+  generation.id = catalog.id;
+  if (catalog.baseId.empty()) {
+    generation.base.clear();
+    if (generation.kind != "synthetic") {
+      generation.kind = "full";
+    }
+  } else {
+    generation.kind = "incremental";
+  }
+  generation.reusedBytes = 0;
+  for (const auto &file : catalog.files) {
+    for (const auto &block : file.blocks) {
+      generation.reusedBytes += block.fromBase ? block.rawSize : 0;
+    }
+  }
+  generation.storedBytes = folderBytes(folder);
+  return true;
+}
+
+// Fusiona una generación incremental con su base, que pasa a ser la base de
+// esta; la copia nueva la sustituye en su misma carpeta
+static bool mergeGeneration(const string &repositoryPath,
+                            const string &password, int maxSizeMB,
+                            bool useParallel, const string &newBase,
+                            BackupGeneration &generation) {
+  filesystem::path folder = generationFolder(repositoryPath, generation.name);
+  filesystem::path temporary = folder.string() + ".tmp";
+  filesystem::path previous = folder.string() + ".old";
+  error_code ec;
+  filesystem::remove_all(temporary, ec);
+  LOG_INFO("Generación " << generation.name << ": fusionando con su base "
+                         << generation.base);
+  if (!mergeNativeBase(
+          folder.string(),
+          (temporary / (string(REPOSITORY_VOLUME_STEM) + ".zip")).string(),
+          maxSizeMB, password, useParallel)) {
+    filesystem::remove_all(temporary, ec);
+    return false;
+  }
+  // La carpeta conserva su nombre: las incrementales que la usan como base
+  // la siguen encontrando, y la copia nueva tiene el mismo identificador
+  filesystem::rename(folder, previous, ec);
+  bool moved = !ec;
+  if (moved) {
+    filesystem::rename(temporary, folder, ec);
+  }
+  if (ec) {
+    LOG_ERROR("No se pudo sustituir la generación " << generation.name << ": "
+                                                     << ec.message());
+    // La generación vuelve a su carpeta: las que dependen de ella siguen
+    // teniendo base
+    error_code ignored;
+    if (moved) {
+      filesystem::rename(previous, folder, ignored);
+    }
+    filesystem::remove_all(temporary, ignored);
+    return false;
+  }
+  filesystem::remove_all(previous, ec);
+  generation.base = newBase;
+  generation.kind = "synthetic"; // Se queda así si ya no tiene base
+  return describeGeneration(repositoryPath, password, generation);
+}
+
+bool finishGeneration(const string &repositoryPath,
+                      BackupGeneration &generation, const string &password) {
+  vector<BackupGeneration> generations;
+  if (!loadRepository(repositoryPath, generations) ||
+      !describeGeneration(repositoryPath, password, generation)) {
+    return false;
+  }
+  generations.push_back(generation);
+  if (!saveRepository(repositoryPath, generations)) {
+    return false;
+  }
+
+  LOG_INFO("Generaciones en " << repositoryPath << ": "
+                              << generations.size());
+  for (const auto &entry : generations) {
+    LOG_INFO("  " << entry.name << " " << entry.kind
+                  << (entry.base.empty() ? "" : " sobre " + entry.base) << ", "
+                  << entry.storedBytes << " bytes guardados, "
+                  << entry.reusedBytes << " tomados de la base");
+  }
+  return true;
+}
+
+bool pruneRepository(const string &repositoryPath, const string &currentName,
+                     const string &password, const RetentionPolicy &policy,
+                     int maxSizeMB, bool useParallel) {
+  if (policy.daily <= 0 && policy.weekly <= 0) {
+    return true;
+  }
+  vector<BackupGeneration> generations;
+  if (!loadRepository(repositoryPath, generations)) {
+    return false;
+  }
+  vector<bool> keep = selectRetainedGenerations(generations, policy);
+  vector<bool> drop(generations.size(), false);
+
+  // De la más reciente a la más antigua: al fusionar una generación con sus
+  // hijas, estas pasan a depender de su base, que se trata después
+  for (size_t i = generations.size(); i-- > 0;) {
+    if (keep[i]) {
+      continue;
+    }
+    vector<size_t> children;
+    bool baseOfCurrent = false;
+    for (size_t j = i + 1; j < generations.size(); j++) {
+      if (!drop[j] && generations[j].base == generations[i].name) {
+        children.push_back(j);
+        baseOfCurrent = baseOfCurrent || generations[j].name == currentName;
+      }
+    }
+    // La copia de esta ejecución no se reescribe: su base espera a la
+    // siguiente, cuando fusionarla con ella cuesta lo que guardó
+    if (baseOfCurrent) {
+      LOG_DEBUG("  Generación " << generations[i].name
+                                << " conservada: es la base de la actual");
+      continue;
+    }
+    // Una incremental se fusiona con sus hijas, que es barato; una completa
+    // solo con las que se conservan, porque sus hijas se reescriben enteras
+    bool full = generations[i].base.empty();
+    size_t pending = 0;
+    for (size_t j : children) {
+      if (full && !keep[j]) {
+        pending++;
+        continue;
+      }
+      if (!mergeGeneration(repositoryPath, password, maxSizeMB, useParallel,
+                           generations[i].base, generations[j]) ||
+          !saveRepository(repositoryPath, generations)) {
+        return false;
+      }
+    }
+    drop[i] = pending == 0;
+  }
+
+  if (count(drop.begin(), drop.end(), true) == 0) {
+    return true;
+  }
+  vector<BackupGeneration> remaining;
+  uint64_t freed = 0;
+  for (size_t i = 0; i < generations.size(); i++) {
+    if (!drop[i]) {
+      remaining.push_back(std::move(generations[i]));
+      continue;
+    }
+    error_code ec;
+    filesystem::remove_all(
+        generationFolder(repositoryPath, generations[i].name), ec);
+    if (ec) {
+      LOG_ERROR("No se pudo borrar la generación " << generations[i].name);
+      return false;
+    }
+    freed += generations[i].storedBytes;
+    LOG_DEBUG("  Generación borrada: " << generations[i].name);
+  }
+  LOG_INFO("Retención: se borran " << generations.size() - remaining.size()
+                                   << " generaciones (" << freed
+                                   << " bytes), quedan " << remaining.size());
+  return saveRepository(repositoryPath, remaining);
+}
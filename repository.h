@@ -0,0 +1,128 @@
+#ifndef REPOSITORY_H
+#define REPOSITORY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct NativeOptions;
+
+/*
+ * Repositorio de copias: una carpeta con una subcarpeta por generación
+ * (copia en formato nativo) y un catálogo de texto, generaciones.txt, con
+ * una línea por generación:
+ *
+ *   generation <nombre> <tipo> <base> <id> <fecha> <guardados> <reusados>
+ *
+ * El tipo es full (copia completa), incremental (copia delta sobre la
+ * generación base, que guarda solo referencias a los bloques que no
+ * cambiaron) o synthetic (incremental que la retención fusionó con sus
+ * bases hasta quedar completa). Los campos vacíos se escriben como "-".
+ */
+
+// Catálogo de generaciones dentro de la carpeta del repositorio
+static const char REPOSITORY_CATALOG[] = "generaciones.txt";
+
+// Nombre de los volúmenes de cada generación (copia.bkp.001...)
+static const char REPOSITORY_VOLUME_STEM[] = "copia";
+
+// Generación de un repositorio
+struct BackupGeneration {
+  std::string name;          // Subcarpeta: fecha y hora de la copia
+  std::string kind;          // full, incremental o synthetic
+  std::string base;          // Generación base de una incremental
+  std::string id;            // Identificador de la copia (vacío sin firmas)
+  int64_t time = 0;          // Segundos desde epoch
+  uint64_t storedBytes = 0;  // Bytes de sus volúmenes
+  uint64_t reusedBytes = 0;  // Bytes que toma de su base sin guardarlos
+};
+
+// Cuántas generaciones se conservan: la última de cada día y de cada
+// semana, para los días y semanas más recientes que tienen copias
+struct RetentionPolicy {
+  int daily = 0;
+  int weekly = 0;
+};
+
+/**
+ * Interpreta una política de retención "diarias[,semanales]", p. ej. "7,4".
+ *
+ * @param text Texto de la opción
+ * @param policy Política resultante
+ * @return false si el texto no es válido
+ */
+bool parseRetentionPolicy(const std::string &text, RetentionPolicy &policy);
+
+/**
+ * Lee el catálogo de un repositorio. Un repositorio sin catálogo está
+ * vacío.
+ *
+ * @param repositoryPath Carpeta del repositorio
+ * @param generations Generaciones, de la más antigua a la más reciente
+ * @return false si el catálogo existe pero no se puede leer
+ */
+bool loadRepository(const std::string &repositoryPath,
+                    std::vector<BackupGeneration> &generations);
+
+/**
+ * Generaciones que conserva una política: siempre la más reciente, y la
+ * última de cada uno de los días y semanas más recientes.
+ *
+ * @param generations Generaciones, de la más antigua a la más reciente
+ * @param policy Política de retención
+ * @return Para cada generación, si se conserva
+ */
+std::vector<bool>
+selectRetainedGenerations(const std::vector<BackupGeneration> &generations,
+                          const RetentionPolicy &policy);
+
+/**
+ * Prepara una generación nueva: elige su nombre y, si la última generación
+ * guarda firmas, la usa como base para que la copia sea incremental.
+ *
+ * @param repositoryPath Carpeta del repositorio (se crea si no existe)
+ * @param generation Generación nueva (nombre y base)
+ * @param outputPath Ruta base de los volúmenes, para compressFoldersToNative
+ * @param options Opciones del formato nativo: se fija la copia base
+ * @return false si el repositorio no se puede leer
+ */
+bool beginGeneration(const std::string &repositoryPath,
+                     BackupGeneration &generation, std::string &outputPath,
+                     NativeOptions &options);
+
+/**
+ * Registra en el catálogo una generación ya escrita.
+ *
+ * @param repositoryPath Carpeta del repositorio
+ * @param generation Generación preparada con beginGeneration
+ * @param password Contraseña de las copias (vacía si no se cifran)
+ * @return true si la generación quedó registrada
+ */
+bool finishGeneration(const std::string &repositoryPath,
+                      BackupGeneration &generation,
+                      const std::string &password);
+
+/**
+ * Aplica la retención: borra las generaciones que la política no conserva.
+ * Antes, cada incremental que se borra se fusiona con las generaciones que
+ * dependen de ella, y una completa solo con las que se conservan, sin leer
+ * los archivos de origen; una generación que queda sin base es una copia
+ * completa sintética. La generación actual nunca se reescribe: si su base
+ * no se conserva, se borra en una ejecución posterior. Se llama cuando ya
+ * no quedan volúmenes por subir, porque renombra y borra carpetas.
+ *
+ * @param repositoryPath Carpeta del repositorio
+ * @param currentName Generación escrita en esta ejecución
+ * @param password Contraseña de las copias (vacía si no se cifran)
+ * @param policy Política de retención (sin efecto si es 0,0)
+ * @param maxSizeMB Tamaño de los volúmenes de las copias fusionadas
+ * @param useParallel Reescribir las copias fusionadas con varios hilos
+ * @return true si la retención se aplicó entera
+ */
+bool pruneRepository(const std::string &repositoryPath,
+                     const std::string &currentName,
+                     const std::string &password,
+                     const RetentionPolicy &policy, int maxSizeMB,
+                     bool useParallel);
+
+#endif // REPOSITORY_H
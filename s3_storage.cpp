@@ -0,0 +1,382 @@
+#include "s3_storage.h"
+#include "logger.h"
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <jsoncpp/json/json.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <sstream>
+
+using namespace std;
+
+// ----------- Utilidades de firma (AWS Signature V4) -----------
+
+static string toHex(const unsigned char *data, size_t len) {
+  stringstream ss;
+  for (size_t i = 0; i < len; i++) {
+    ss << hex << setw(2) << setfill('0') << static_cast<int>(data[i]);
+  }
+  return ss.str();
+}
+
+static string sha256Hex(const char *data, size_t len) {
+  unsigned char digest[EVP_MAX_MD_SIZE];
+  unsigned int digestLen = 0;
+  EVP_Digest(data, len, digest, &digestLen, EVP_sha256(), nullptr);
+  return toHex(digest, digestLen);
+}
+
+static string hmacSha256(const string &key, const string &data) {
+  unsigned char digest[EVP_MAX_MD_SIZE];
+  unsigned int digestLen = 0;
+  HMAC(EVP_sha256(), key.data(), static_cast<int>(key.size()),
+       reinterpret_cast<const unsigned char *>(data.data()), data.size(),
+       digest, &digestLen);
+  return string(reinterpret_cast<char *>(digest), digestLen);
+}
+
+// Codificación URI de S3: todo salvo A-Z a-z 0-9 - _ . ~ (y "/" en rutas)
+static string uriEncode(const string &value, bool keepSlash) {
+  stringstream ss;
+  for (unsigned char c : value) {
+    if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~' ||
+        (keepSlash && c == '/')) {
+      ss << c;
+    } else {
+      ss << '%' << uppercase << hex << setw(2) << setfill('0')
+         << static_cast<int>(c) << nouppercase << dec;
+    }
+  }
+  return ss.str();
+}
+
+// Extraer el contenido de todas las etiquetas <tag>...</tag> de un XML simple
+static vector<string> xmlValues(const string &xml, const string &tag) {
+  vector<string> values;
+  string open = "<" + tag + ">";
+  string close = "</" + tag + ">";
+  size_t pos = 0;
+  while ((pos = xml.find(open, pos)) != string::npos) {
+    size_t start = pos + open.size();
+    size_t end = xml.find(close, start);
+    if (end == string::npos)
+      break;
+    values.push_back(xml.substr(start, end - start));
+    pos = end + close.size();
+  }
+  return values;
+}
+
+// ----------- Destino S3 -----------
+
+S3Storage::S3Storage(const string &location) {
+  size_t slash = location.find('/');
+  bucket = location.substr(0, slash);
+  if (slash != string::npos) {
+    prefix = location.substr(slash + 1);
+    while (!prefix.empty() && prefix.back() == '/')
+      prefix.pop_back();
+  }
+}
+
+// Cargar credenciales desde s3_credentials.json
+bool S3Storage::loadCredentials() {
+  ifstream credFile("s3_credentials.json");
+  if (!credFile.is_open()) {
+    return false;
+  }
+
+  Json::Value root;
+  Json::Reader reader;
+  if (!reader.parse(credFile, root)) {
+    return false;
+  }
+
+  if (root.isMember("endpoint"))
+    config.endpoint = root["endpoint"].asString();
+  if (root.isMember("region"))
+    config.region = root["region"].asString();
+  config.accessKey = root["access_key"].asString();
+  config.secretKey = root["secret_key"].asString();
+
+  while (!config.endpoint.empty() && config.endpoint.back() == '/')
+    config.endpoint.pop_back();
+
+  return !config.accessKey.empty() && !config.secretKey.empty();
+}
+
+bool S3Storage::initialize() {
+  if (bucket.empty()) {
+    cerr << "❌ Debe indicar un bucket: -t s3:bucket[/prefijo]" << endl;
+    return false;
+  }
+  if (!loadCredentials()) {
+    cerr << "❌ No se encontraron credenciales válidas en s3_credentials.json"
+         << endl;
+    cerr << "   Formato: {\"endpoint\": \"http://127.0.0.1:9000\", "
+            "\"region\": \"us-east-1\", \"access_key\": \"...\", "
+            "\"secret_key\": \"...\"}"
+         << endl;
+    return false;
+  }
+  LOG_INFO("Destino S3: " << config.endpoint << "/" << bucket
+                          << (prefix.empty() ? "" : "/" + prefix));
+  return true;
+}
+
+string S3Storage::objectKey(const string &remotePath) const {
+  return prefix.empty() ? remotePath : prefix + "/" + remotePath;
+}
+
+HttpResponse S3Storage::send(const string &method, const string &key,
+                             const vector<pair<string, string>> &query,
+                             const char *body, size_t bodySize,
+                             const vector<string> &extraHeaders) {
+  // Fecha de la firma
+  time_t now = chrono::system_clock::to_time_t(chrono::system_clock::now());
+  tm utc;
+  gmtime_r(&now, &utc);
+  char amzDate[17];
+  char dateStamp[9];
+  strftime(amzDate, sizeof(amzDate), "%Y%m%dT%H%M%SZ", &utc);
+  strftime(dateStamp, sizeof(dateStamp), "%Y%m%d", &utc);
+
+  // Host a partir del endpoint (sin esquema)
+  string host = config.endpoint;
+  size_t scheme = host.find("://");
+  if (scheme != string::npos)
+    host = host.substr(scheme + 3);
+
+  string canonicalUri = "/" + uriEncode(bucket, false);
+  if (!key.empty())
+    canonicalUri += "/" + uriEncode(key, true);
+
+  vector<pair<string, string>> sortedQuery;
+  for (const auto &[k, v] : query)
+    sortedQuery.push_back({uriEncode(k, false), uriEncode(v, false)});
+  sort(sortedQuery.begin(), sortedQuery.end());
+  string canonicalQuery;
+  for (const auto &[k, v] : sortedQuery) {
+    if (!canonicalQuery.empty())
+      canonicalQuery += "&";
+    canonicalQuery += k + "=" + v;
+  }
+
+  string payloadHash = sha256Hex(body ? body : "", bodySize);
+  string canonicalHeaders = "host:" + host + "\n" +
+                            "x-amz-content-sha256:" + payloadHash + "\n" +
+                            "x-amz-date:" + amzDate + "\n";
+  string signedHeaders = "host;x-amz-content-sha256;x-amz-date";
+
+  string canonicalRequest = method + "\n" + canonicalUri + "\n" +
+                            canonicalQuery + "\n" + canonicalHeaders + "\n" +
+                            signedHeaders + "\n" + payloadHash;
+
+  string scope =
+      string(dateStamp) + "/" + config.region + "/s3/aws4_request";
+  string stringToSign =
+      "AWS4-HMAC-SHA256\n" + string(amzDate) + "\n" + scope + "\n" +
+      sha256Hex(canonicalRequest.data(), canonicalRequest.size());
+
+  string signingKey = hmacSha256("AWS4" + config.secretKey, dateStamp);
+  signingKey = hmacSha256(signingKey, config.region);
+  signingKey = hmacSha256(signingKey, "s3");
+  signingKey = hmacSha256(signingKey, "aws4_request");
+  string signatureRaw = hmacSha256(signingKey, stringToSign);
+  string signature = toHex(
+      reinterpret_cast<const unsigned char *>(signatureRaw.data()),
+      signatureRaw.size());
+
+  HttpRequest request;
+  request.method = method;
+  request.url = config.endpoint + canonicalUri +
+                (canonicalQuery.empty() ? "" : "?" + canonicalQuery);
+  request.headers = {
+      "x-amz-date: " + string(amzDate),
+      "x-amz-content-sha256: " + payloadHash,
+      "Authorization: AWS4-HMAC-SHA256 Credential=" + config.accessKey + "/" +
+          scope + ", SignedHeaders=" + signedHeaders +
+          ", Signature=" + signature,
+      "Expect:"};
+  request.headers.insert(request.headers.end(), extraHeaders.begin(),
+                         extraHeaders.end());
+  request.body = body;
+  request.bodySize = bodySize;
+
+  return performHttpRequest(request);
+}
+
+bool S3Storage::prepareFolder(const string & /*remoteFolder*/,
+                              string & /*error*/) {
+  // En S3 las carpetas son solo prefijos de las claves
+  return true;
+}
+
+bool S3Storage::put(const string &remotePath, const char *data, size_t size,
+                    string &error) {
+  HttpResponse response = send("PUT", objectKey(remotePath), {}, data, size);
+  if (!response.ok()) {
+    error = describeHttpError(response);
+    return false;
+  }
+  return true;
+}
+
+bool S3Storage::beginMultipart(const string &remotePath,
+                               MultipartUpload &upload, string &error) {
+  upload = MultipartUpload();
+  upload.remotePath = remotePath;
+
+  HttpResponse response =
+      send("POST", objectKey(remotePath), {{"uploads", ""}}, nullptr, 0);
+  vector<string> ids = xmlValues(response.body, "UploadId");
+  if (!response.ok() || ids.empty()) {
+    error = describeHttpError(response);
+    return false;
+  }
+  upload.uploadId = ids[0];
+  return true;
+}
+
+bool S3Storage::uploadPart(MultipartUpload &upload, const char *data,
+                           size_t size, string &error) {
+  int partNumber = upload.partNumber + 1;
+  HttpResponse response =
+      send("PUT", objectKey(upload.remotePath),
+           {{"partNumber", to_string(partNumber)},
+            {"uploadId", upload.uploadId}},
+           data, size);
+  if (!response.ok() || response.headers.count("etag") == 0) {
+    error = describeHttpError(response);
+    return false;
+  }
+  upload.partTags.push_back(response.headers["etag"]);
+  upload.partNumber = partNumber;
+  upload.offset += size;
+  return true;
+}
+
+bool S3Storage::completeMultipart(MultipartUpload &upload, string &error) {
+  stringstream xml;
+  xml << "<CompleteMultipartUpload>";
+  for (size_t i = 0; i < upload.partTags.size(); i++) {
+    xml << "<Part><PartNumber>" << (i + 1) << "</PartNumber><ETag>"
+        << upload.partTags[i] << "</ETag></Part>";
+  }
+  xml << "</CompleteMultipartUpload>";
+  string body = xml.str();
+
+  HttpResponse response =
+      send("POST", objectKey(upload.remotePath),
+           {{"uploadId", upload.uploadId}}, body.data(), body.size(),
+           {"Content-Type: application/xml"});
+  // S3 puede responder 200 con un <Error> en el cuerpo
+  if (!response.ok() || response.body.find("<Error>") != string::npos) {
+    error = describeHttpError(response);
+    return false;
+  }
+  return true;
+}
+
+void S3Storage::abortMultipart(MultipartUpload &upload) {
+  if (upload.uploadId.empty())
+    return;
+  send("DELETE", objectKey(upload.remotePath),
+       {{"uploadId", upload.uploadId}}, nullptr, 0);
+}
+
+bool S3Storage::get(const string &remotePath, vector<char> &out,
+                    string &error) {
+  HttpResponse response = send("GET", objectKey(remotePath), {}, nullptr, 0);
+  if (!response.ok()) {
+    error = describeHttpError(response);
+    return false;
+  }
+  out.assign(response.body.begin(), response.body.end());
+  return true;
+}
+
+bool S3Storage::getRange(const string &remotePath, uint64_t offset,
+                         uint64_t length, vector<char> &out, string &error) {
+  if (length == 0) {
+    out.clear();
+    return true;
+  }
+  string range = "Range: bytes=" + to_string(offset) + "-" +
+                 to_string(offset + length - 1);
+  HttpResponse response =
+      send("GET", objectKey(remotePath), {}, nullptr, 0, {range});
+  if (!response.ok()) {
+    error = describeHttpError(response);
+    return false;
+  }
+  out.assign(response.body.begin(), response.body.end());
+  return true;
+}
+
+bool S3Storage::list(const string &remoteFolder,
+                     vector<StorageObject> &objects, string &error) {
+  objects.clear();
+  string listPrefix = objectKey(remoteFolder);
+  if (!listPrefix.empty() && listPrefix.back() != '/')
+    listPrefix += "/";
+
+  string continuation;
+  do {
+    vector<pair<string, string>> query = {{"list-type", "2"},
+                                          {"prefix", listPrefix}};
+    if (!continuation.empty())
+      query.push_back({"continuation-token", continuation});
+
+    HttpResponse response = send("GET", "", query, nullptr, 0);
+    if (!response.ok()) {
+      error = describeHttpError(response);
+      return false;
+    }
+
+    for (const auto &contents : xmlValues(response.body, "Contents")) {
+      vector<string> keys = xmlValues(contents, "Key");
+      vector<string> sizes = xmlValues(contents, "Size");
+      vector<string> etags = xmlValues(contents, "ETag");
+      if (keys.empty())
+        continue;
+
+      StorageObject object;
+      object.name = keys[0].substr(listPrefix.size());
+      object.size = sizes.empty() ? 0 : stoull(sizes[0]);
+      if (!etags.empty()) {
+        object.contentHash = etags[0];
+        // Quitar comillas (literales o escapadas en XML)
+        for (const string quote : {"&quot;", "&#34;", "\""}) {
+          size_t pos;
+          while ((pos = object.contentHash.find(quote)) != string::npos)
+            object.contentHash.erase(pos, quote.size());
+        }
+      }
+      objects.push_back(object);
+    }
+
+    vector<string> truncated = xmlValues(response.body, "IsTruncated");
+    vector<string> next = xmlValues(response.body, "NextContinuationToken");
+    continuation = (!truncated.empty() && truncated[0] == "true" &&
+                    !next.empty())
+                       ? next[0]
+                       : "";
+  } while (!continuation.empty());
+
+  return true;
+}
+
+bool S3Storage::remove(const string &remotePath, string &error) {
+  HttpResponse response =
+      send("DELETE", objectKey(remotePath), {}, nullptr, 0);
+  if (!response.ok()) {
+    error = describeHttpError(response);
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,63 @@
+#ifndef S3_STORAGE_H
+#define S3_STORAGE_H
+
+#include "http_client.h"
+#include "storage_backend.h"
+#include <string>
+#include <vector>
+
+// Configuración de un destino compatible con S3 (MinIO, Ceph, mock local...)
+struct S3Config {
+  std::string endpoint = "http://127.0.0.1:9000";
+  std::string region = "us-east-1";
+  std::string accessKey;
+  std::string secretKey;
+};
+
+// Destino compatible con S3 con firma AWS Signature V4 y rutas path-style
+class S3Storage : public StorageBackend {
+private:
+  S3Config config;
+  std::string bucket;
+  std::string prefix; // Prefijo opcional dentro del bucket
+
+  bool loadCredentials();
+  std::string objectKey(const std::string &remotePath) const;
+
+  // Construye y firma una petición a /bucket/key?query
+  HttpResponse send(const std::string &method, const std::string &key,
+                    const std::vector<std::pair<std::string, std::string>>
+                        &query,
+                    const char *body, size_t bodySize,
+                    const std::vector<std::string> &extraHeaders = {});
+
+public:
+  // location: "bucket" o "bucket/prefijo"
+  explicit S3Storage(const std::string &location);
+
+  std::string name() const override { return "s3"; }
+  ContentHashKind contentHashKind() const override {
+    return ContentHashKind::S3_ETAG;
+  }
+  bool initialize() override;
+  bool prepareFolder(const std::string &remoteFolder,
+                     std::string &error) override;
+  bool put(const std::string &remotePath, const char *data, size_t size,
+           std::string &error) override;
+  bool beginMultipart(const std::string &remotePath, MultipartUpload &upload,
+                      std::string &error) override;
+  bool uploadPart(MultipartUpload &upload, const char *data, size_t size,
+                  std::string &error) override;
+  bool completeMultipart(MultipartUpload &upload, std::string &error) override;
+  void abortMultipart(MultipartUpload &upload) override;
+  bool get(const std::string &remotePath, std::vector<char> &out,
+           std::string &error) override;
+  bool getRange(const std::string &remotePath, uint64_t offset,
+                uint64_t length, std::vector<char> &out,
+                std::string &error) override;
+  bool list(const std::string &remoteFolder,
+            std::vector<StorageObject> &objects, std::string &error) override;
+  bool remove(const std::string &remotePath, std::string &error) override;
+};
+
+#endif // S3_STORAGE_H
@@ -0,0 +1,317 @@
+#include "storage_backend.h"
+#include "dropbox_uploader.h"
+#include "instrumentation.h"
+#include "logger.h"
+#include "s3_storage.h"
+#include "transfer_policy.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+// ----------- Operaciones comunes -----------
+
+bool StorageBackend::putBuffer(const string &remotePath, const char *data,
+                               size_t size, string &error) {
+  size_t chunkSize = multipartChunkSize();
+  if (size <= chunkSize) {
+    return put(remotePath, data, size, error);
+  }
+
+  // Objetos grandes: subir por trozos usando una sesión
+  MultipartUpload upload;
+  if (!beginMultipart(remotePath, upload, error)) {
+    return false;
+  }
+  for (size_t offset = 0; offset < size; offset += chunkSize) {
+    size_t len = min(chunkSize, size - offset);
+    if (!uploadPart(upload, data + offset, len, error)) {
+      abortMultipart(upload);
+      return false;
+    }
+  }
+  if (!completeMultipart(upload, error)) {
+    abortMultipart(upload);
+    return false;
+  }
+  return true;
+}
+
+bool StorageBackend::putFile(const string &localPath, const string &remotePath,
+                             string &error) {
+  ifstream file(localPath, ios::binary | ios::ate);
+  if (!file.is_open()) {
+    error = "No se puede abrir el archivo: " + localPath;
+    return false;
+  }
+
+  uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+  file.seekg(0, ios::beg);
+
+  size_t chunkSize = multipartChunkSize();
+  if (fileSize <= chunkSize) {
+    vector<char> buffer(fileSize);
+    if (!file.read(buffer.data(), fileSize)) {
+      error = "Error al leer el archivo: " + localPath;
+      return false;
+    }
+    return put(remotePath, buffer.data(), buffer.size(), error);
+  }
+
+  // Leer y enviar un trozo cada vez: la memoria queda acotada al trozo
+  MultipartUpload upload;
+  if (!beginMultipart(remotePath, upload, error)) {
+    return false;
+  }
+  vector<char> buffer(chunkSize);
+  uint64_t remaining = fileSize;
+  while (remaining > 0) {
+    size_t len = static_cast<size_t>(min<uint64_t>(chunkSize, remaining));
+    if (!file.read(buffer.data(), len)) {
+      error = "Error al leer el archivo: " + localPath;
+      abortMultipart(upload);
+      return false;
+    }
+    if (!uploadPart(upload, buffer.data(), len, error)) {
+      abortMultipart(upload);
+      return false;
+    }
+    remaining -= len;
+  }
+  if (!completeMultipart(upload, error)) {
+    abortMultipart(upload);
+    return false;
+  }
+  return true;
+}
+
+string StorageBackend::localContentHash(const string &localPath) const {
+  ScopedStage timer(Stage::HASH);
+  if (instrumentationEnabled()) {
+    error_code ec;
+    timer.addBytes(filesystem::file_size(localPath, ec));
+  }
+  return computeFileContentHash(contentHashKind(), localPath,
+                                multipartChunkSize());
+}
+
+string StorageBackend::bufferContentHash(const char *data, size_t size) const {
+  ScopedStage timer(Stage::HASH, size);
+  return computeContentHash(contentHashKind(), data, size,
+                            multipartChunkSize());
+}
+
+// ----------- Destino en directorio local / NAS -----------
+
+LocalStorage::LocalStorage(const string &rootDir) : rootDir(rootDir) {}
+
+string LocalStorage::fullPath(const string &remotePath) const {
+  return (filesystem::path(rootDir) / remotePath).string();
+}
+
+bool LocalStorage::initialize() {
+  error_code ec;
+  filesystem::create_directories(rootDir, ec);
+  if (ec || !filesystem::is_directory(rootDir)) {
+    cerr << "❌ No se puede usar el directorio de destino " << rootDir << ": "
+         << ec.message() << endl;
+    return false;
+  }
+  LOG_INFO("Destino local: " << rootDir);
+  return true;
+}
+
+bool LocalStorage::prepareFolder(const string &remoteFolder, string &error) {
+  error_code ec;
+  filesystem::create_directories(fullPath(remoteFolder), ec);
+  if (ec) {
+    error = ec.message();
+    return false;
+  }
+  return true;
+}
+
+// El hash de cada parte se guarda al lado, en <parte>.hash, junto con su
+// tamaño: listar no vuelve a leer las partes de copias anteriores
+static string hashFilePath(const string &path) { return path + ".hash"; }
+
+static bool writeStoredHash(const string &path, const string &hash,
+                            uint64_t size) {
+  ofstream out(hashFilePath(path), ios::trunc);
+  out << hash << " " << size << "\n";
+  return static_cast<bool>(out);
+}
+
+// false si no hay hash guardado o es de otro contenido (otro tamaño)
+static bool readStoredHash(const string &path, uint64_t size, string &hash) {
+  ifstream in(hashFilePath(path));
+  uint64_t storedSize = 0;
+  return static_cast<bool>(in >> hash >> storedSize) && storedSize == size;
+}
+
+bool LocalStorage::put(const string &remotePath, const char *data, size_t size,
+                       string &error) {
+  MultipartUpload upload;
+  return beginMultipart(remotePath, upload, error) &&
+         uploadPart(upload, data, size, error) &&
+         completeMultipart(upload, error);
+}
+
+bool LocalStorage::beginMultipart(const string &remotePath,
+                                  MultipartUpload &upload, string &error) {
+  // Se escribe en un temporal y se renombra al completar, para que nunca
+  // quede visible una parte a medias
+  upload = MultipartUpload();
+  upload.remotePath = remotePath;
+  upload.uploadId = fullPath(remotePath) + ".partial";
+
+  error_code ec;
+  filesystem::create_directories(
+      filesystem::path(upload.uploadId).parent_path(), ec);
+  ofstream out(upload.uploadId, ios::binary | ios::trunc);
+  if (!out) {
+    error = "No se puede crear " + upload.uploadId;
+    return false;
+  }
+  return true;
+}
+
+bool LocalStorage::uploadPart(MultipartUpload &upload, const char *data,
+                              size_t size, string &error) {
+  throttleTransfer(size); // El NAS también comparte el enlace de la oficina
+  ofstream out(upload.uploadId, ios::binary | ios::app);
+  if (!out || !out.write(data, size)) {
+    error = "Error al escribir en " + upload.uploadId;
+    return false;
+  }
+  upload.offset += size;
+  upload.partNumber++;
+  return true;
+}
+
+bool LocalStorage::completeMultipart(MultipartUpload &upload, string &error) {
+  // El hash se escribe antes del renombrado: una parte visible siempre
+  // tiene el suyo
+  string target = fullPath(upload.remotePath);
+  error_code ec;
+  uint64_t size = filesystem::file_size(upload.uploadId, ec);
+  if (ec ||
+      !writeStoredHash(target, localContentHash(upload.uploadId), size)) {
+    error = "No se puede escribir " + hashFilePath(target);
+    return false;
+  }
+  filesystem::rename(upload.uploadId, target, ec);
+  if (ec) {
+    error = ec.message();
+    return false;
+  }
+  return true;
+}
+
+void LocalStorage::abortMultipart(MultipartUpload &upload) {
+  error_code ec;
+  filesystem::remove(upload.uploadId, ec);
+}
+
+bool LocalStorage::get(const string &remotePath, vector<char> &out,
+                       string &error) {
+  error_code ec;
+  uint64_t size = filesystem::file_size(fullPath(remotePath), ec);
+  if (ec) {
+    error = ec.message();
+    return false;
+  }
+  return getRange(remotePath, 0, size, out, error);
+}
+
+bool LocalStorage::getRange(const string &remotePath, uint64_t offset,
+                            uint64_t length, vector<char> &out,
+                            string &error) {
+  ifstream in(fullPath(remotePath), ios::binary);
+  if (!in) {
+    error = "No se puede abrir " + fullPath(remotePath);
+    return false;
+  }
+  in.seekg(static_cast<streamoff>(offset));
+  out.resize(length);
+  in.read(out.data(), length);
+  out.resize(static_cast<size_t>(in.gcount()));
+  return true;
+}
+
+bool LocalStorage::list(const string &remoteFolder,
+                        vector<StorageObject> &objects, string &error) {
+  objects.clear();
+  string folder = fullPath(remoteFolder);
+  if (!filesystem::exists(folder)) {
+    return true; // Carpeta aún no creada: no hay objetos
+  }
+
+  error_code ec;
+  for (const auto &entry : filesystem::directory_iterator(folder, ec)) {
+    string extension = entry.path().extension().string();
+    if (!entry.is_regular_file() || extension == ".partial" ||
+        extension == ".hash") {
+      continue;
+    }
+    // Las partes subidas antes de guardar hashes se resumen una sola vez
+    string path = entry.path().string();
+    uint64_t size = entry.file_size();
+    string hash;
+    if (!readStoredHash(path, size, hash)) {
+      hash = localContentHash(path);
+      writeStoredHash(path, hash, size);
+    }
+    objects.push_back({entry.path().filename().string(), size, hash});
+  }
+  if (ec) {
+    error = ec.message();
+    return false;
+  }
+  sort(objects.begin(), objects.end(),
+       [](const auto &a, const auto &b) { return a.name < b.name; });
+  return true;
+}
+
+bool LocalStorage::remove(const string &remotePath, string &error) {
+  error_code ec;
+  filesystem::remove(hashFilePath(fullPath(remotePath)), ec);
+  filesystem::remove(fullPath(remotePath), ec);
+  if (ec) {
+    error = ec.message();
+    return false;
+  }
+  return true;
+}
+
+// ----------- Selección del destino -----------
+
+bool parseUploadTarget(const string &spec, UploadTarget &target) {
+  if (spec == "dropbox") {
+    target = {DROPBOX, ""};
+    return true;
+  }
+  if (spec.rfind("local:", 0) == 0 && spec.size() > 6) {
+    target = {LOCAL_FS, spec.substr(6)};
+    return true;
+  }
+  if (spec.rfind("s3:", 0) == 0 && spec.size() > 3) {
+    target = {S3, spec.substr(3)};
+    return true;
+  }
+  return false;
+}
+
+unique_ptr<StorageBackend> createStorageBackend(const UploadTarget &target) {
+  switch (target.service) {
+  case DROPBOX:
+    return make_unique<DropboxUploader>();
+  case LOCAL_FS:
+    return make_unique<LocalStorage>(target.location);
+  case S3:
+    return make_unique<S3Storage>(target.location);
+  }
+  return nullptr;
+}
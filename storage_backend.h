@@ -0,0 +1,161 @@
+#ifndef STORAGE_BACKEND_H
+#define STORAGE_BACKEND_H
+
+#include "content_hash.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Servicios de destino soportados para los respaldos
+enum UploadService { DROPBOX, LOCAL_FS, S3 };
+
+// Destino de subida: servicio más ubicación (carpeta local o bucket/prefijo)
+struct UploadTarget {
+  UploadService service = DROPBOX;
+  std::string location;
+};
+
+// Objeto almacenado en el destino (resultado de list)
+struct StorageObject {
+  std::string name; // Nombre relativo a la carpeta listada
+  uint64_t size = 0;
+  std::string contentHash; // Hash que reporta el proveedor (si existe)
+};
+
+// Estado de una subida por partes (sesión de subida)
+struct MultipartUpload {
+  std::string remotePath;
+  std::string uploadId; // Identificador de sesión del proveedor
+  uint64_t offset = 0;  // Bytes ya enviados
+  int partNumber = 0;   // Número de la última parte enviada
+  std::vector<std::string> partTags; // ETags de S3 por parte
+};
+
+/**
+ * Interfaz de un destino de almacenamiento para las partes del respaldo.
+ *
+ * Las rutas remotas son relativas a la raíz del destino y usan "/" como
+ * separador (p. ej. "carpeta/archivo_part1_of_3.zip"). Todas las operaciones
+ * devuelven false y rellenan error si fallan.
+ */
+class StorageBackend {
+public:
+  virtual ~StorageBackend() = default;
+
+  // Nombre corto del destino ("dropbox", "local", "s3")
+  virtual std::string name() const = 0;
+
+  // Cargar credenciales o verificar el destino antes de usarlo
+  virtual bool initialize() { return true; }
+
+  // Crear la carpeta (o prefijo) remota si hace falta
+  virtual bool prepareFolder(const std::string &remoteFolder,
+                             std::string &error) = 0;
+
+  // Subir un objeto completo desde memoria
+  virtual bool put(const std::string &remotePath, const char *data,
+                   size_t size, std::string &error) = 0;
+
+  // Subida por partes: iniciar, enviar trozos en orden y completar
+  virtual bool beginMultipart(const std::string &remotePath,
+                              MultipartUpload &upload, std::string &error) = 0;
+  virtual bool uploadPart(MultipartUpload &upload, const char *data,
+                          size_t size, std::string &error) = 0;
+  virtual bool completeMultipart(MultipartUpload &upload,
+                                 std::string &error) = 0;
+  virtual void abortMultipart(MultipartUpload & /*upload*/) {}
+
+  // Descargar un objeto completo o un rango de bytes
+  virtual bool get(const std::string &remotePath, std::vector<char> &out,
+                   std::string &error) = 0;
+  virtual bool getRange(const std::string &remotePath, uint64_t offset,
+                        uint64_t length, std::vector<char> &out,
+                        std::string &error) = 0;
+
+  // Listar los objetos de una carpeta remota
+  virtual bool list(const std::string &remoteFolder,
+                    std::vector<StorageObject> &objects,
+                    std::string &error) = 0;
+
+  // Borrar un objeto remoto
+  virtual bool remove(const std::string &remotePath, std::string &error) = 0;
+
+  // Enlace público para compartir (vacío si el destino no los ofrece)
+  virtual std::string shareLink(const std::string & /*remotePath*/) {
+    return "";
+  }
+
+  // Tamaño de trozo para subidas por partes
+  virtual size_t multipartChunkSize() const { return 8 * 1024 * 1024; }
+
+  // Esquema del hash que el destino devuelve en StorageObject::contentHash
+  virtual ContentHashKind contentHashKind() const {
+    return ContentHashKind::DROPBOX;
+  }
+
+  // Hash de un archivo local comparable con el que reporta list()
+  std::string localContentHash(const std::string &localPath) const;
+
+  // Hash de un buffer en memoria comparable con el que reporta list()
+  std::string bufferContentHash(const char *data, size_t size) const;
+
+  // Subir un buffer usando put o subida por partes según su tamaño
+  bool putBuffer(const std::string &remotePath, const char *data, size_t size,
+                 std::string &error);
+
+  // Subir un archivo local leyéndolo por trozos si es grande
+  bool putFile(const std::string &localPath, const std::string &remotePath,
+               std::string &error);
+};
+
+// Destino en un directorio local o montado por red (NAS)
+class LocalStorage : public StorageBackend {
+private:
+  std::string rootDir;
+  std::string fullPath(const std::string &remotePath) const;
+
+public:
+  explicit LocalStorage(const std::string &rootDir);
+
+  std::string name() const override { return "local"; }
+  bool initialize() override;
+  bool prepareFolder(const std::string &remoteFolder,
+                     std::string &error) override;
+  bool put(const std::string &remotePath, const char *data, size_t size,
+           std::string &error) override;
+  bool beginMultipart(const std::string &remotePath, MultipartUpload &upload,
+                      std::string &error) override;
+  bool uploadPart(MultipartUpload &upload, const char *data, size_t size,
+                  std::string &error) override;
+  bool completeMultipart(MultipartUpload &upload, std::string &error) override;
+  void abortMultipart(MultipartUpload &upload) override;
+  bool get(const std::string &remotePath, std::vector<char> &out,
+           std::string &error) override;
+  bool getRange(const std::string &remotePath, uint64_t offset,
+                uint64_t length, std::vector<char> &out,
+                std::string &error) override;
+  bool list(const std::string &remoteFolder,
+            std::vector<StorageObject> &objects, std::string &error) override;
+  bool remove(const std::string &remotePath, std::string &error) override;
+};
+
+/**
+ * Interpreta una especificación de destino:
+ *   "dropbox", "local:/ruta/al/nas" o "s3:bucket[/prefijo]"
+ *
+ * @param spec Texto indicado por el usuario
+ * @param target Destino resultante
+ * @return true si la especificación es válida
+ */
+bool parseUploadTarget(const std::string &spec, UploadTarget &target);
+
+/**
+ * Crea el backend de almacenamiento correspondiente a un destino.
+ *
+ * @param target Destino ya interpretado
+ * @return Backend listo para initialize(), o nullptr si no es válido
+ */
+std::unique_ptr<StorageBackend> createStorageBackend(const UploadTarget &target);
+
+#endif // STORAGE_BACKEND_H
@@ -0,0 +1,69 @@
+#include "thread_config.h"
+#include <algorithm>
+#include <omp.h>
+#include <sstream>
+#include <vector>
+
+using namespace std;
+
+static ThreadConfig globalConfig;
+
+ThreadConfig &threadConfig() { return globalConfig; }
+
+int compressThreadCount() {
+  return globalConfig.compressThreads > 0 ? globalConfig.compressThreads
+                                          : omp_get_max_threads();
+}
+
+int ioThreadCount() {
+  return globalConfig.ioThreads > 0 ? globalConfig.ioThreads
+                                    : compressThreadCount();
+}
+
+int uploadThreadCount() { return max(1, globalConfig.uploadThreads); }
+
+int bufferedPartCount() {
+  return globalConfig.bufferedParts > 0 ? globalConfig.bufferedParts
+                                        : uploadThreadCount() + 1;
+}
+
+bool parseThreadCount(const string &text, int &count) {
+  try {
+    size_t used = 0;
+    int value = stoi(text, &used);
+    if (used != text.size() || value <= 0) {
+      return false;
+    }
+    count = value;
+    return true;
+  } catch (const exception &) {
+    return false;
+  }
+}
+
+bool parseStagePools(const string &spec, ThreadConfig &config) {
+  vector<string> fields;
+  string field;
+  istringstream stream(spec);
+  while (getline(stream, field, ',')) {
+    fields.push_back(field);
+  }
+  if (fields.empty() || fields.size() > 3) {
+    return false;
+  }
+
+  // Se valida todo antes de tocar la configuración
+  ThreadConfig parsed = config;
+  int *targets[] = {&parsed.ioThreads, &parsed.compressThreads,
+                    &parsed.uploadThreads};
+  for (size_t i = 0; i < fields.size(); i++) {
+    if (fields[i].empty() || fields[i] == "0") {
+      continue;
+    }
+    if (!parseThreadCount(fields[i], *targets[i])) {
+      return false;
+    }
+  }
+  config = parsed;
+  return true;
+}
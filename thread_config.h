@@ -0,0 +1,53 @@
+#ifndef THREAD_CONFIG_H
+#define THREAD_CONFIG_H
+
+#include <string>
+
+/**
+ * Tamaño del grupo de hilos de cada etapa. Un valor 0 toma el
+ * predeterminado. Los grupos de OpenMP se fijan por región con
+ * num_threads en lugar de omp_set_num_threads, así no se filtran al resto
+ * del proceso y el runtime reutiliza los mismos hilos entre etapas.
+ */
+struct ThreadConfig {
+  int ioThreads = 0;       // Recorrido, apertura e índice de partes
+  int compressThreads = 0; // Deflate, inflate, cifrado y hash
+  int uploadThreads = 1;   // Hilos de la cola de subida
+  int bufferedParts = 0;   // Partes en espera de subida (0 = subida + 1)
+};
+
+// Configuración global usada por compresión, descompresión y subida
+ThreadConfig &threadConfig();
+
+// Hilos de compresión/cifrado (0 = omp_get_max_threads())
+int compressThreadCount();
+
+// Hilos de E/S (0 = los mismos que de compresión)
+int ioThreadCount();
+
+// Hilos de subida (al menos 1)
+int uploadThreadCount();
+
+// Partes terminadas que pueden esperar en memoria a la cola de subida
+int bufferedPartCount();
+
+/**
+ * Interpreta un número de hilos positivo, como el de -j.
+ *
+ * @param text Texto a interpretar
+ * @param count Resultado si es válido
+ * @return true si es un entero mayor que 0
+ */
+bool parseThreadCount(const std::string &text, int &count);
+
+/**
+ * Interpreta los grupos por etapa "E/S,compresión,subida", como el de -J.
+ * Se pueden omitir valores ("4,,2" o "2,8"); los omitidos o a 0 no cambian.
+ *
+ * @param spec Texto con hasta tres números separados por comas
+ * @param config Configuración a actualizar
+ * @return true si el formato es válido
+ */
+bool parseStagePools(const std::string &spec, ThreadConfig &config);
+
+#endif // THREAD_CONFIG_H
@@ -0,0 +1,129 @@
+#include "transfer_policy.h"
+#include "http_client.h"
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <random>
+#include <thread>
+
+using namespace std;
+
+static TokenBucket globalBucket;
+static RetryPolicy globalPolicy;
+static thread_local RetryBudget *activeBudget = nullptr;
+
+// ----------- Cubeta de tokens -----------
+
+void TokenBucket::setRate(uint64_t bytesPerSecond) {
+  lock_guard<mutex> lock(bucketMutex);
+  rate = static_cast<double>(bytesPerSecond);
+  // Ráfaga de un cuarto de segundo: suficiente para no frenar bloques de
+  // red pequeños sin permitir picos apreciables
+  burst = max(rate / 4, 64.0 * 1024);
+  tokens = burst;
+  lastRefill = chrono::steady_clock::now();
+}
+
+bool TokenBucket::limited() {
+  lock_guard<mutex> lock(bucketMutex);
+  return rate > 0;
+}
+
+void TokenBucket::acquire(size_t bytes) {
+  double waitSeconds = 0;
+  {
+    lock_guard<mutex> lock(bucketMutex);
+    if (rate <= 0) {
+      return;
+    }
+    auto now = chrono::steady_clock::now();
+    double elapsed = chrono::duration<double>(now - lastRefill).count();
+    lastRefill = now;
+    tokens = min(burst, tokens + elapsed * rate);
+    tokens -= static_cast<double>(bytes);
+    if (tokens < 0) {
+      waitSeconds = -tokens / rate;
+    }
+  }
+  // Dormir fuera del cerrojo: los demás hilos ven la deuda y esperan más
+  if (waitSeconds > 0) {
+    this_thread::sleep_for(chrono::duration<double>(waitSeconds));
+  }
+}
+
+// ----------- Presupuesto de reintentos -----------
+
+RetryBudget::RetryBudget(int retries)
+    : remaining(retries), previous(activeBudget) {
+  activeBudget = this;
+}
+
+RetryBudget::~RetryBudget() { activeBudget = previous; }
+
+RetryBudget *RetryBudget::current() { return activeBudget; }
+
+bool RetryBudget::consume() {
+  if (remaining <= 0) {
+    return false;
+  }
+  remaining--;
+  return true;
+}
+
+// ----------- Política global -----------
+
+RetryPolicy &transferRetryPolicy() { return globalPolicy; }
+
+void setBandwidthLimit(uint64_t bytesPerSecond) {
+  globalBucket.setRate(bytesPerSecond);
+}
+
+void throttleTransfer(size_t bytes) { globalBucket.acquire(bytes); }
+
+bool bandwidthLimited() { return globalBucket.limited(); }
+
+bool isRetryableResponse(const HttpResponse &response) {
+  if (!response.error.empty()) {
+    return true; // Timeout, conexión cortada, DNS...
+  }
+  return response.status == 408 || response.status == 429 ||
+         response.status >= 500;
+}
+
+// Interpretar Retry-After: segundos o fecha HTTP; negativo si no hay
+static double parseRetryAfter(const HttpResponse &response) {
+  auto it = response.headers.find("retry-after");
+  if (it == response.headers.end() || it->second.empty()) {
+    return -1;
+  }
+  try {
+    size_t used = 0;
+    double seconds = stod(it->second, &used);
+    if (used == it->second.size()) {
+      return max(0.0, seconds);
+    }
+  } catch (const exception &) {
+  }
+
+  struct tm tm = {};
+  if (strptime(it->second.c_str(), "%a, %d %b %Y %H:%M:%S", &tm)) {
+    return max(0.0, difftime(timegm(&tm), time(nullptr)));
+  }
+  return -1;
+}
+
+double retryDelaySeconds(int attempt, const HttpResponse &response) {
+  const RetryPolicy &policy = globalPolicy;
+  double retryAfter = parseRetryAfter(response);
+  if (retryAfter >= 0) {
+    return min(retryAfter, policy.maxDelaySeconds);
+  }
+
+  // Jitter completo: uniforme entre 0 y el tope exponencial, para que los
+  // hilos que fallaron a la vez no reintenten todos juntos
+  static thread_local mt19937 rng(random_device{}());
+  double cap = min(policy.maxDelaySeconds,
+                   policy.baseDelaySeconds * pow(2.0, attempt - 1));
+  uniform_real_distribution<double> dist(0.0, cap);
+  return dist(rng);
+}
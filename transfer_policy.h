@@ -0,0 +1,90 @@
+#ifndef TRANSFER_POLICY_H
+#define TRANSFER_POLICY_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+struct HttpResponse;
+
+// Parámetros de reintento de las peticiones a los destinos
+struct RetryPolicy {
+  int maxAttempts = 5;          // Intentos por petición (incluye el primero)
+  int retriesPerPart = 8;       // Reintentos totales permitidos por parte
+  double baseDelaySeconds = 0.5; // Espera antes del primer reintento
+  double maxDelaySeconds = 60.0; // Tope de espera (también para Retry-After)
+};
+
+/**
+ * Cubeta de tokens para limitar el ancho de banda total.
+ *
+ * Los tokens son bytes. Se permite quedar en negativo: quien consume más de
+ * lo disponible duerme el tiempo necesario para saldar la deuda, de modo
+ * que bloques grandes no requieren una ráfaga igual de grande.
+ */
+class TokenBucket {
+private:
+  std::mutex bucketMutex;
+  double rate = 0;  // Bytes por segundo (0 = sin límite)
+  double burst = 0; // Máximo de tokens acumulables
+  double tokens = 0;
+  std::chrono::steady_clock::time_point lastRefill;
+
+public:
+  void setRate(uint64_t bytesPerSecond);
+  bool limited();
+
+  // Consumir bytes, durmiendo si se supera el ritmo configurado
+  void acquire(size_t bytes);
+};
+
+// Presupuesto de reintentos compartido por todas las peticiones de una parte
+class RetryBudget {
+private:
+  int remaining;
+  RetryBudget *previous;
+
+public:
+  explicit RetryBudget(int retries);
+  ~RetryBudget();
+
+  // Presupuesto activo en este hilo (nullptr si no hay ninguno)
+  static RetryBudget *current();
+
+  // Consumir un reintento; false si ya no quedan
+  bool consume();
+  int left() const { return remaining; }
+};
+
+// Política global usada por performHttpRequest
+RetryPolicy &transferRetryPolicy();
+
+/**
+ * Fija el límite global de ancho de banda para todas las transferencias.
+ *
+ * @param bytesPerSecond Bytes por segundo; 0 desactiva el límite
+ */
+void setBandwidthLimit(uint64_t bytesPerSecond);
+
+// Esperar hasta poder transferir bytes sin superar el límite global
+void throttleTransfer(size_t bytes);
+
+// true si el límite global está activo
+bool bandwidthLimited();
+
+// true si el fallo es transitorio: error de transporte, 408, 429 o 5xx
+bool isRetryableResponse(const HttpResponse &response);
+
+/**
+ * Calcula la espera antes del siguiente intento. Si el servidor envió
+ * Retry-After se respeta; si no, backoff exponencial con jitter completo.
+ *
+ * @param attempt Número del intento que acaba de fallar (1 = primero)
+ * @param response Respuesta fallida
+ * @return Segundos a esperar
+ */
+double retryDelaySeconds(int attempt, const HttpResponse &response);
+
+#endif // TRANSFER_POLICY_H
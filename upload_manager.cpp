@@ -0,0 +1,456 @@
+#include "upload_manager.h"
+#include "instrumentation.h"
+#include "logger.h"
+#include "transfer_policy.h"
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+// Crear el nombre de la carpeta remota a partir de la carpeta local
+string remoteFolderNameFor(const string &localFolder) {
+  string folderName = filesystem::path(localFolder).filename().string();
+  auto now = chrono::system_clock::now();
+  auto nowTime = chrono::system_clock::to_time_t(now);
+
+  stringstream remoteFolderName;
+  remoteFolderName << folderName << "_"
+                   << put_time(localtime(&nowTime), "%Y%m%d_%H%M%S");
+  return remoteFolderName.str();
+}
+
+// Escribir el archivo de enlaces de descarga
+void writeLinksFile(const StorageBackend &backend,
+                    const vector<UploadResult> &results) {
+  bool hasLinks = any_of(results.begin(), results.end(),
+                         [](const auto &r) { return !r.shareUrl.empty(); });
+  if (!hasLinks) {
+    return;
+  }
+
+  string linksPath = backend.name() + "_links.txt";
+  ofstream linksFile(linksPath);
+  if (!linksFile.is_open()) {
+    return;
+  }
+
+  linksFile << "╔══════════════════════════════════════════════════════════"
+               "════════╗"
+            << endl;
+  linksFile << "║  Enlaces de descarga de " << left << setw(41)
+            << backend.name() << "║" << endl;
+  linksFile << "╚══════════════════════════════════════════════════════════"
+               "════════╝"
+            << endl;
+  linksFile << endl;
+
+  for (const auto &result : results) {
+    linksFile << "📄 " << result.fileName << ":" << endl;
+    linksFile << "   🔗 " << result.shareUrl << endl << endl;
+  }
+
+  linksFile << "Generado el: " << __DATE__ << " " << __TIME__ << endl;
+  linksFile.close();
+
+  LOG_INFO("\n📋 Enlaces guardados en: " << linksPath);
+}
+
+RemoteIndex loadRemoteIndex(StorageBackend &backend,
+                            const string &remoteFolder) {
+  RemoteIndex index;
+  vector<StorageObject> objects;
+  string error;
+  if (!backend.list(remoteFolder, objects, error)) {
+    LOG_ERROR("⚠️ No se pudo listar " << remoteFolder
+                                      << ", se subirán todas las partes: "
+                                      << error);
+    return index;
+  }
+  for (const auto &object : objects) {
+    index[object.name] = object;
+  }
+  return index;
+}
+
+uint64_t PendingPart::size() const {
+  return inMemory() ? data.size() : filesystem::file_size(localPath);
+}
+
+// Subir una parte a la carpeta remota y obtener su enlace. Si el índice
+// remoto ya tiene un objeto con el mismo nombre, tamaño y hash, no se sube
+static bool uploadOne(StorageBackend &backend, PendingPart &part,
+                      const string &remoteFolder, const RemoteIndex &remote,
+                      UploadResult &result, string &error) {
+  result.fileName = part.fileName;
+  result.remotePath = remoteFolder.empty()
+                          ? result.fileName
+                          : remoteFolder + "/" + result.fileName;
+
+  auto existing = remote.find(result.fileName);
+  if (existing != remote.end() && !existing->second.contentHash.empty() &&
+      existing->second.size == part.size()) {
+    if (part.contentHash.empty()) {
+      part.contentHash =
+          part.inMemory()
+              ? backend.bufferContentHash(part.data.data(), part.data.size())
+              : backend.localContentHash(part.localPath);
+    }
+    if (part.contentHash == existing->second.contentHash) {
+      LOG_DEBUG("⏭️  Sin cambios, no se vuelve a subir: " << result.fileName);
+      result.skipped = true;
+      result.shareUrl = backend.shareLink(result.remotePath);
+      return true;
+    }
+  }
+
+  // Todas las peticiones de esta parte comparten el presupuesto de reintentos
+  RetryBudget retryBudget(transferRetryPolicy().retriesPerPart);
+
+  LOG_DEBUG("Subiendo " << result.fileName << " (" << (part.size() / 1024)
+                        << "KB" << (part.inMemory() ? ", desde memoria" : "")
+                        << ") a " << backend.name() << "...");
+
+  // Los archivos grandes se envían por partes
+  ScopedStage timer(Stage::UPLOAD, part.size());
+  bool uploaded =
+      part.inMemory()
+          ? backend.putBuffer(result.remotePath, part.data.data(),
+                              part.data.size(), error)
+          : backend.putFile(part.localPath, result.remotePath, error);
+  if (!uploaded) {
+    return false;
+  }
+  result.shareUrl = backend.shareLink(result.remotePath);
+  return true;
+}
+
+// Subir múltiples archivos a una carpeta
+bool uploadFiles(StorageBackend &backend, const vector<string> &filePaths,
+                 const string &remoteFolder) {
+  if (filePaths.empty()) {
+    LOG_INFO("No hay archivos para subir.");
+    return true;
+  }
+
+  // Crear la carpeta remota
+  string error;
+  if (!backend.prepareFolder(remoteFolder, error)) {
+    LOG_ERROR("❌ Error al crear la carpeta en " << backend.name() << ": "
+                                                << remoteFolder << " ("
+                                                << error << ")");
+    return false;
+  }
+  LOG_INFO("📁 Carpeta de destino: " << remoteFolder);
+
+  bool overallSuccess = true;
+  vector<UploadResult> uploadResults;
+
+  // Verificar que los archivos existen
+  vector<string> validFilePaths;
+  for (const auto &filePath : filePaths) {
+    if (filesystem::exists(filePath)) {
+      validFilePaths.push_back(filePath);
+    } else {
+      LOG_ERROR("⚠️ El archivo no existe y será ignorado: " << filePath);
+    }
+  }
+
+  if (validFilePaths.empty()) {
+    LOG_ERROR("❌ No se encontraron archivos válidos para subir.");
+    return false;
+  }
+
+  LOG_INFO("\n🚀 Iniciando subida de " << validFilePaths.size()
+                                      << " archivos a " << backend.name()
+                                      << "...");
+
+  RemoteIndex remote = loadRemoteIndex(backend, remoteFolder);
+  int skipped = 0;
+
+  for (size_t i = 0; i < validFilePaths.size(); i++) {
+    string fileName = filesystem::path(validFilePaths[i]).filename().string();
+    LOG_DEBUG("📤 (" << (i + 1) << "/" << validFilePaths.size()
+                    << ") Subiendo: " << fileName);
+
+    PendingPart part;
+    part.fileName = fileName;
+    part.localPath = validFilePaths[i];
+    UploadResult result;
+    if (!uploadOne(backend, part, remoteFolder, remote, result, error)) {
+      LOG_ERROR("  ❌ Error al subir " << fileName << ": " << error);
+      overallSuccess = false;
+    } else if (result.skipped) {
+      skipped++;
+      uploadResults.push_back(result);
+    } else {
+      LOG_DEBUG("  ✅ Subido correctamente: " << (result.shareUrl.empty()
+                                                       ? result.remotePath
+                                                       : result.shareUrl));
+      uploadResults.push_back(result);
+    }
+  }
+
+  // Generar archivo de enlaces
+  writeLinksFile(backend, uploadResults);
+
+  if (skipped > 0) {
+    LOG_INFO("\n⏭️  " << skipped << " de " << validFilePaths.size()
+                      << " archivos ya estaban en el destino sin cambios");
+  }
+
+  if (overallSuccess) {
+    LOG_INFO("\n✨ Todos los archivos se subieron correctamente ✨");
+  } else {
+    LOG_ERROR("\n⚠️ Algunos archivos no pudieron ser subidos. Revisa los "
+              "mensajes anteriores.");
+  }
+
+  logFlush();
+  return overallSuccess;
+}
+
+// ----------- Cola de subida solapada con la compresión -----------
+
+PartUploadQueue::PartUploadQueue(StorageBackend &backend,
+                                 const string &remoteFolder,
+                                 bool deleteAfterUpload, int numWorkers,
+                                 int maxBufferedParts)
+    : backend(backend), remoteFolder(remoteFolder),
+      deleteAfterUpload(deleteAfterUpload), numWorkers(max(1, numWorkers)),
+      maxBufferedParts(max(1, maxBufferedParts)) {}
+
+PartUploadQueue::~PartUploadQueue() {
+  if (!workers.empty()) {
+    finish();
+  }
+}
+
+bool PartUploadQueue::start() {
+  string error;
+  if (!backend.prepareFolder(remoteFolder, error)) {
+    LOG_ERROR("❌ Error al crear la carpeta en " << backend.name() << ": "
+                                                << remoteFolder << " ("
+                                                << error << ")");
+    return false;
+  }
+  LOG_INFO("📁 Carpeta de destino: " << remoteFolder);
+
+  // Un único listado al inicio: las partes idénticas a las de una ejecución
+  // anterior se detectan sin más llamadas al destino
+  remoteIndex = loadRemoteIndex(backend, remoteFolder);
+  if (!remoteIndex.empty()) {
+    LOG_INFO("   " << remoteIndex.size()
+                   << " objetos ya presentes en el destino");
+  }
+
+  for (int i = 0; i < numWorkers; i++) {
+    workers.emplace_back(&PartUploadQueue::workerLoop, this);
+  }
+  return true;
+}
+
+void PartUploadQueue::push(PendingPart &&part) {
+  {
+    lock_guard<mutex> lock(queueMutex);
+    pending.push_back(std::move(part));
+  }
+  enqueuedCount++;
+  queueCv.notify_one();
+}
+
+void PartUploadQueue::enqueue(const string &partPath,
+                              const string &contentHash) {
+  PendingPart part;
+  part.fileName = filesystem::path(partPath).filename().string();
+  part.localPath = partPath;
+  part.contentHash = contentHash;
+  push(std::move(part));
+}
+
+void PartUploadQueue::enqueueBuffer(const string &partName,
+                                    vector<char> &&data,
+                                    const string &contentHash) {
+  {
+    // Espera del productor: la compresión va por delante de la subida
+    ScopedStage timer(Stage::QUEUE_WAIT);
+    unique_lock<mutex> lock(queueMutex);
+    bufferCv.wait(lock,
+                  [this] { return bufferedParts < maxBufferedParts; });
+    bufferedParts++;
+  }
+  PendingPart part;
+  part.fileName = partName;
+  part.data = std::move(data);
+  part.contentHash = contentHash;
+  push(std::move(part));
+}
+
+void PartUploadQueue::workerLoop() {
+  while (true) {
+    PendingPart part;
+    {
+      // Espera del consumidor: la subida va por delante de la compresión
+      ScopedStage timer(Stage::QUEUE_WAIT);
+      unique_lock<mutex> lock(queueMutex);
+      queueCv.wait(lock, [this] { return closed || !pending.empty(); });
+      if (pending.empty()) {
+        return; // Cola cerrada y sin trabajo pendiente
+      }
+      part = std::move(pending.front());
+      pending.pop_front();
+    }
+
+    uint64_t partSize = part.size();
+    UploadResult result;
+    string error;
+    bool uploaded =
+        uploadOne(backend, part, remoteFolder, remoteIndex, result, error);
+
+    // Liberar cuanto antes el buffer para que la compresión pueda continuar
+    if (part.inMemory()) {
+      vector<char>().swap(part.data);
+      {
+        lock_guard<mutex> lock(queueMutex);
+        bufferedParts--;
+      }
+      bufferCv.notify_one();
+    }
+
+    if (!uploaded) {
+      LOG_ERROR("  ❌ Error al subir " << result.fileName << ": " << error);
+      allSucceeded = false;
+      continue;
+    }
+
+    int done = ++uploadedCount;
+    if (result.skipped) {
+      skippedCount++;
+      skippedBytes += partSize;
+    } else {
+      LOG_DEBUG("  ✅ Subido (" << done << "/" << enqueuedCount.load() << "): "
+                               << result.fileName);
+    }
+
+    // Solo se borra la copia local cuando el destino confirmó la subida
+    if (deleteAfterUpload && !part.inMemory()) {
+      error_code ec;
+      filesystem::remove(part.localPath, ec);
+      if (ec) {
+        LOG_ERROR("  ⚠️ No se pudo borrar la parte local " << part.localPath
+                      << ": " << ec.message());
+      }
+    }
+
+    lock_guard<mutex> lock(resultsMutex);
+    results.push_back(result);
+  }
+}
+
+bool PartUploadQueue::finish() {
+  {
+    lock_guard<mutex> lock(queueMutex);
+    closed = true;
+  }
+  queueCv.notify_all();
+
+  for (auto &worker : workers) {
+    if (worker.joinable()) {
+      worker.join();
+    }
+  }
+  workers.clear();
+
+  sort(results.begin(), results.end(),
+       [](const auto &a, const auto &b) { return a.fileName < b.fileName; });
+  writeLinksFile(backend, results);
+
+  if (skippedCount > 0) {
+    LOG_INFO("\n⏭️  " << skippedCount << " de " << enqueuedCount.load()
+                      << " partes ya estaban en el destino sin cambios ("
+                      << (skippedBytes / 1024 / 1024)
+                      << "MB no se volvieron a enviar)");
+  }
+
+  if (allSucceeded) {
+    LOG_INFO("\n✨ Todas las partes se subieron correctamente ✨");
+  } else {
+    LOG_ERROR("\n⚠️ Algunas partes no pudieron ser subidas. Revisa los "
+              "mensajes anteriores.");
+  }
+  logFlush();
+  return allSucceeded;
+}
+
+// ----------- Funciones de conveniencia para usar desde main.cpp -----------
+
+// Crear e inicializar el backend del destino indicado
+static unique_ptr<StorageBackend> openBackend(const UploadTarget &target) {
+  unique_ptr<StorageBackend> backend = createStorageBackend(target);
+  if (!backend || !backend->initialize()) {
+    LOG_ERROR("❌ Error inicializando el destino de subida.");
+    return nullptr;
+  }
+  return backend;
+}
+
+bool uploadFolderContents(const std::string &folderPath, bool onlyZipFiles,
+                          const UploadTarget &target,
+                          const std::string &remoteFolder) {
+  // Verificar que la carpeta existe
+  if (!filesystem::exists(folderPath) ||
+      !filesystem::is_directory(folderPath)) {
+    LOG_ERROR("❌ Error: La carpeta especificada no existe: " << folderPath);
+    return false;
+  }
+
+  // Recopilar los archivos a subir
+  vector<string> filesToUpload;
+  for (const auto &entry : filesystem::directory_iterator(folderPath)) {
+    if (entry.is_regular_file()) {
+      string extension = entry.path().extension().string();
+      if (!onlyZipFiles || extension == ".zip") {
+        filesToUpload.push_back(entry.path().string());
+      }
+    }
+  }
+  sort(filesToUpload.begin(), filesToUpload.end());
+
+  if (filesToUpload.empty()) {
+    LOG_INFO("⚠️ No se encontraron archivos" << (onlyZipFiles ? " ZIP" : "")
+                                             << " para subir en: "
+                                             << folderPath);
+    return true;
+  }
+
+  unique_ptr<StorageBackend> backend = openBackend(target);
+  if (!backend) {
+    return false;
+  }
+
+  // Sin carpeta fija, usar el nombre local más timestamp
+  return uploadFiles(*backend, filesToUpload,
+                     remoteFolder.empty() ? remoteFolderNameFor(folderPath)
+                                          : remoteFolder);
+}
+
+bool uploadFileList(const std::vector<std::string> &filePaths,
+                    const UploadTarget &target) {
+  unique_ptr<StorageBackend> backend = openBackend(target);
+  if (!backend) {
+    return false;
+  }
+
+  // Si no se especificó carpeta, crear una con timestamp
+  auto now = chrono::system_clock::now();
+  auto nowTime = chrono::system_clock::to_time_t(now);
+  stringstream folderName;
+  folderName << "Archivos_" << put_time(localtime(&nowTime), "%Y%m%d_%H%M%S");
+
+  return uploadFiles(*backend, filePaths, folderName.str());
+}
@@ -0,0 +1,119 @@
+#ifndef UPLOAD_MANAGER_H
+#define UPLOAD_MANAGER_H
+
+#include "storage_backend.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Resultado de la subida de un archivo
+struct UploadResult {
+  std::string fileName;
+  std::string remotePath;
+  std::string shareUrl;
+  bool skipped = false; // Ya existía en el destino con el mismo hash
+};
+
+// Parte pendiente de subir: un archivo en disco o un buffer en memoria
+struct PendingPart {
+  std::string fileName;
+  std::string localPath;   // Vacío si la parte solo existe en memoria
+  std::vector<char> data;  // Contenido cuando la parte está en memoria
+  std::string contentHash; // Vacío si aún no se calculó
+
+  bool inMemory() const { return localPath.empty(); }
+  uint64_t size() const;
+};
+
+// Objetos ya presentes en la carpeta remota, obtenidos con un solo listado
+using RemoteIndex = std::map<std::string, StorageObject>;
+
+// Nombre de carpeta remota: nombre de la carpeta local más timestamp
+std::string remoteFolderNameFor(const std::string &localFolder);
+
+// Escribe <destino>_links.txt con los enlaces compartidos (si los hay)
+void writeLinksFile(const StorageBackend &backend,
+                    const std::vector<UploadResult> &results);
+
+// Listar una vez la carpeta remota para poder saltar partes idénticas
+RemoteIndex loadRemoteIndex(StorageBackend &backend,
+                            const std::string &remoteFolder);
+
+// Subir varios archivos a una carpeta remota del destino, omitiendo los que
+// ya existen allí con el mismo hash de contenido
+bool uploadFiles(StorageBackend &backend,
+                 const std::vector<std::string> &filePaths,
+                 const std::string &remoteFolder);
+
+// Cola de partes terminadas que se suben mientras la compresión continúa.
+// La compresión encola cada parte en cuanto se cierra y los hilos de subida
+// la envían al destino; opcionalmente se borra la copia local al confirmarse.
+class PartUploadQueue {
+private:
+  StorageBackend &backend;
+  std::string remoteFolder;
+  bool deleteAfterUpload;
+  int numWorkers;
+
+  std::deque<PendingPart> pending;
+  RemoteIndex remoteIndex;
+  std::mutex queueMutex;
+  std::condition_variable queueCv;
+  bool closed = false;
+
+  // Las partes en memoria cuentan hasta que termina su subida; al llegar al
+  // máximo, enqueueBuffer bloquea a la compresión
+  int maxBufferedParts;
+  int bufferedParts = 0;
+  std::condition_variable bufferCv;
+
+  std::vector<std::thread> workers;
+  std::vector<UploadResult> results;
+  std::mutex resultsMutex;
+  std::atomic<bool> allSucceeded{true};
+  std::atomic<int> uploadedCount{0};
+  std::atomic<int> enqueuedCount{0};
+  std::atomic<int> skippedCount{0};
+  std::atomic<uint64_t> skippedBytes{0};
+
+  void workerLoop();
+  void push(PendingPart &&part);
+
+public:
+  PartUploadQueue(StorageBackend &backend, const std::string &remoteFolder,
+                  bool deleteAfterUpload = false, int numWorkers = 1,
+                  int maxBufferedParts = 2);
+  ~PartUploadQueue();
+
+  // Crear la carpeta remota, listar su contenido y arrancar los hilos
+  bool start();
+
+  // Añadir una parte terminada (seguro entre hilos). El hash puede venir
+  // calculado por el hilo que cerró la parte; si no, lo calcula el de subida
+  void enqueue(const std::string &partPath,
+               const std::string &contentHash = "");
+
+  // Añadir una parte que solo existe en memoria. Bloquea mientras haya
+  // maxBufferedParts partes en memoria sin terminar de subir, de modo que
+  // la memoria queda acotada por las partes en vuelo
+  void enqueueBuffer(const std::string &partName, std::vector<char> &&data,
+                     const std::string &contentHash = "");
+
+  // Cerrar la cola, esperar a que terminen las subidas y devolver el resultado
+  bool finish();
+};
+
+// Funciones de conveniencia para usar directamente desde main.cpp
+bool uploadFolderContents(const std::string &folderPath,
+                          bool onlyZipFiles = true,
+                          const UploadTarget &target = UploadTarget(),
+                          const std::string &remoteFolder = "");
+bool uploadFileList(const std::vector<std::string> &filePaths,
+                    const UploadTarget &target = UploadTarget());
+
+#endif // UPLOAD_MANAGER_H